@@ -1,3 +1,4 @@
+using System.Collections.Generic;
 using UnityEngine;
 
 namespace UnityPhysXFlow
@@ -17,10 +18,32 @@ public class FlowEmitter : MonoBehaviour
         [Range(0.1f, 10f)]
         public float density = 1.0f;
 
+        [Header("Optional Channels")]
+        [Tooltip("Temperature cells are pulled toward (grids with a Temperature channel)")]
+        [Range(-1f, 1f)]
+        public float temperature = 0f;
+
+        [Tooltip("Fuel added per second (grids with a Fuel channel)")]
+        [Range(0f, 10f)]
+        public float fuel = 0f;
+
+        [Tooltip("Smoke added per second (grids with a Smoke channel)")]
+        [Range(0f, 10f)]
+        public float smoke = 0f;
+
         [Tooltip("Auto-create emitter on Start")]
         public bool autoCreate = true;
 
+        [Tooltip("Send parameters together with other batched emitters in a single native call")]
+        public bool batchUpdate = true;
+
         private int _emitterHandle = -1;
+        private Vector3 _sentChannels;
+
+        // Emitters synced together by the first batched emitter to update each frame
+        private static readonly List<FlowEmitter> s_batchedEmitters = new List<FlowEmitter>();
+        private static EmitterDesc[] s_batchDescs = new EmitterDesc[16];
+        private static int s_lastBatchFrame = -1;
 
         private void Start()
         {
@@ -34,13 +57,57 @@ private void Start()
 
         private void Update()
         {
-            if (_emitterHandle >= 0)
+            if (_emitterHandle < 0) return;
+
+            SyncChannels();
+
+            // Sync position and parameters to native side
+            if (batchUpdate)
+            {
+                SyncBatchedEmitters();
+            }
+            else
             {
-                // Sync position and parameters to native side
                 UnityPhysXFlow.SetEmitterParams(_emitterHandle, transform.position, radius, density);
             }
         }
 
+        // Channel values rarely change, so they are only sent when they do
+        private void SyncChannels()
+        {
+            Vector3 current = new Vector3(temperature, fuel, smoke);
+            if (current == _sentChannels) return;
+            UnityPhysXFlow.SetEmitterChannels(_emitterHandle, temperature, fuel, smoke);
+            _sentChannels = current;
+        }
+
+        private static void SyncBatchedEmitters()
+        {
+            if (s_lastBatchFrame == Time.frameCount) return;
+            s_lastBatchFrame = Time.frameCount;
+
+            if (s_batchDescs.Length < s_batchedEmitters.Count)
+            {
+                s_batchDescs = new EmitterDesc[Mathf.NextPowerOfTwo(s_batchedEmitters.Count)];
+            }
+
+            int count = 0;
+            foreach (var emitter in s_batchedEmitters)
+            {
+                if (emitter._emitterHandle < 0 || !emitter.batchUpdate || !emitter.isActiveAndEnabled) continue;
+
+                Vector3 p = emitter.transform.position;
+                s_batchDescs[count++] = new EmitterDesc
+                {
+                    handle = emitter._emitterHandle,
+                    x = p.x, y = p.y, z = p.z,
+                    radius = emitter.radius,
+                    density = emitter.density
+                };
+            }
+            UnityPhysXFlow.SetEmittersBatch(s_batchDescs, count);
+        }
+
         public void CreateEmitter()
         {
             if (_emitterHandle >= 0) return; // Already created
@@ -60,6 +127,9 @@ public void CreateEmitter()
             else
             {
                 Debug.Log($"[FlowEmitter] Created emitter {_emitterHandle} at {transform.position}");
+                _sentChannels = Vector3.zero;
+                SyncChannels();
+                s_batchedEmitters.Add(this);
             }
         }
 
@@ -67,6 +137,7 @@ public void DestroyEmitter()
         {
             if (_emitterHandle < 0) return;
 
+            s_batchedEmitters.Remove(this);
             UnityPhysXFlow.DestroyEmitter(_emitterHandle);
             Debug.Log($"[FlowEmitter] Destroyed emitter {_emitterHandle}");
             _emitterHandle = -1;
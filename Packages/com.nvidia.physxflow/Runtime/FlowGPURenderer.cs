@@ -138,38 +138,12 @@ private void Update()
         
         private void UploadDataToGPU()
         {
-            // Get data from FlowGrid
-            var densityData = flowGrid.GetDensityData();
-            var velocityData = flowGrid.GetVelocityData();
-            
-            if (densityData != null && densityData.Length > 0)
-            {
-                // Upload density (single channel float)
-                densityTexture.SetPixelData(densityData, 0);
-                densityTexture.Apply();
-            }
-            
-            if (velocityData != null && velocityData.Length > 0)
-            {
-                // Convert velocity data (3 floats per cell) to Color format (4 floats)
-                Vector3Int dims = flowGrid.GridDimensions;
-                int cellCount = dims.x * dims.y * dims.z;
-                Color[] velocityColors = new Color[cellCount];
-                
-                for (int i = 0; i < cellCount; i++)
-                {
-                    int idx = i * 3;
-                    velocityColors[i] = new Color(
-                        velocityData[idx + 0],
-                        velocityData[idx + 1],
-                        velocityData[idx + 2],
-                        0f
-                    );
-                }
-                
-                velocityTexture.SetPixels(velocityColors);
-                velocityTexture.Apply();
-            }
+            // Native code writes straight into the textures' pixel data (no managed allocations)
+            int gridHandle = flowGrid.GridHandle;
+            if (gridHandle < 0) return;
+
+            UnityPhysXFlow.ExportGridDensityInto(gridHandle, densityTexture);
+            UnityPhysXFlow.ExportGridVelocityInto(gridHandle, velocityTexture);
         }
         
         private void RenderVolume()
@@ -1,3 +1,4 @@
+using System.Collections.Generic;
 using UnityEngine;
 
 namespace UnityPhysXFlow
@@ -33,6 +34,96 @@ public class FlowGrid : MonoBehaviour
         [Range(0, 10)]
         public int updateInterval = 1;
 
+        [Tooltip("Density texture format: RFloat, RHalf, R8 (quantized over the density range) or BC4")]
+        public TextureFormat densityTextureFormat = TextureFormat.RFloat;
+
+        [Tooltip("Velocity texture format: RGBAFloat or RGBAHalf")]
+        public TextureFormat velocityTextureFormat = TextureFormat.RGBAFloat;
+
+        [Tooltip("Upload only the box of bricks changed since the last upload (RFloat/RHalf density; needs 3D texture copies)")]
+        public bool partialUploads = false;
+
+        [Tooltip("Step together with other batched grids in a single native call (grids step in parallel)")]
+        public bool batchStepping = true;
+
+        [Tooltip("Step on the native worker thread: kicked in Update, consumed in LateUpdate")]
+        public bool asyncStepping = false;
+
+        [Tooltip("Advection scheme: MacCormack/BFECC keep detail sharp at 2-3x the advection cost")]
+        public AdvectionMode advection = AdvectionMode.SemiLagrangian;
+
+        [Tooltip("Optional channels simulated besides density (Temperature + Fuel for fire); fixed at creation")]
+        public GridChannels channels = GridChannels.None;
+
+        [Header("Pressure Projection")]
+        [Tooltip("Make the velocity divergence free each step (multigrid solve)")]
+        public bool pressureProjection = false;
+
+        [Tooltip("Maximum multigrid V-cycles per step")]
+        [Range(1, 16)]
+        public int projectionCycles = 4;
+
+        [Tooltip("Time budget for the projection in milliseconds (0 = no budget)")]
+        public float projectionBudgetMs = 0f;
+
+        [Header("Adaptive Substeps")]
+        [Tooltip("Split each frame into CFL-limited substeps and carry unsimulated time to the next frame")]
+        public bool adaptiveSubsteps = false;
+
+        [Tooltip("Largest velocity * substep / cellSize allowed")]
+        [Range(0.25f, 4f)]
+        public float substepMaxCfl = 1f;
+
+        [Tooltip("Maximum substeps per frame")]
+        [Range(1, 32)]
+        public int maxSubsteps = 8;
+
+        [Tooltip("Time budget for the substeps in milliseconds (0 = no budget)")]
+        public float substepBudgetMs = 0f;
+
+        [Header("Level of Detail")]
+        [Tooltip("Lower the resolution as the grid gets far from the camera or small on screen (built-in solver only)")]
+        public bool autoLod = false;
+
+        [Tooltip("Camera the level of detail follows (main camera if empty)")]
+        public Camera lodCamera;
+
+        [Tooltip("Camera distance past which the grid drops to level 1; each doubling drops another level (0 = ignore distance)")]
+        public float lodDistance = 20f;
+
+        [Tooltip("Fraction of the screen height the grid must cover to keep full resolution; each halving drops a level (0 = ignore coverage)")]
+        [Range(0f, 1f)]
+        public float lodScreenCoverage = 0.25f;
+
+        [Tooltip("Coarsest level: each halves the resolution (3 = 1/512 of the cells)")]
+        [Range(0, 3)]
+        public int maxLodLevel = 2;
+
+        [Tooltip("How far past a threshold distance and coverage must go before the level changes back")]
+        [Range(0f, 0.5f)]
+        public float lodHysteresis = 0.15f;
+
+        [Header("Scrolling")]
+        [Tooltip("Keep the simulation centered on a moving transform: the window scrolls in whole cells and only the cells it moves onto start empty (built-in solver only)")]
+        public bool scrollWithTarget = false;
+
+        [Tooltip("Transform the window follows (this one if empty)")]
+        public Transform scrollTarget;
+
+        [Header("Warm Start")]
+        [Tooltip("Grid state loaded right after the grid is created (see SaveState); relative paths are under StreamingAssets")]
+        public string warmStartState = "";
+
+        [Header("NanoVDB Cache")]
+        [Tooltip("Play this recorded cache back instead of simulating (the grid takes its size); relative paths are under StreamingAssets")]
+        public string playbackCache = "";
+
+        [Tooltip("Restart the cache when it ends")]
+        public bool loopPlayback = true;
+
+        [Tooltip("Record every step to this cache file from the moment the grid is created (see StartRecording)")]
+        public string recordCache = "";
+
         [Header("Debug")]
         [Tooltip("Use placeholder test data if simulation isn't working")]
         public bool usePlaceholderData = false;
@@ -40,9 +131,27 @@ public class FlowGrid : MonoBehaviour
         private int _gridHandle = -1;
         private Texture3D _densityTexture;
         private Texture3D _velocityTexture;
+        private Texture3D _densityStaging;
+        private Texture3D _velocityStaging;
         private int _frameCounter = 0;
+        private long _pendingFence = 0;
+        private long _uploadedVersion = -1;
         private GameObject _visualCube;
         private MeshRenderer _meshRenderer;
+        private Vector3Int _resolution;
+        private int _lodLevel = 0;
+        private float _nextLodChange = 0f;
+        private bool _lodUnsupported = false;
+        private bool _scrollUnsupported = false;
+        private Vector3 _visualOrigin;
+
+        // Seconds between level changes, so a camera cut settles one level at a time
+        private const float LodCooldown = 0.5f;
+
+        // Grids stepped together by the first batched grid to update each frame
+        private static readonly List<FlowGrid> s_batchedGrids = new List<FlowGrid>();
+        private static int[] s_batchHandles = new int[8];
+        private static int s_lastBatchFrame = -1;
 
         private void Start()
         {
@@ -57,17 +166,70 @@ private void Start()
         private void Update()
         {
             if (_gridHandle < 0) return;
+            if (autoLod) UpdateLod();
+            if (scrollWithTarget) FollowScrollTarget();
 
             // Step simulation
-            UnityPhysXFlow.StepGrid(_gridHandle, Time.deltaTime);
+            if (asyncStepping)
+            {
+                // Kick the step now and let game logic run; results are consumed in LateUpdate
+                _pendingFence = UnityPhysXFlow.StepGridAsync(_gridHandle, Time.deltaTime);
+                return;
+            }
+            else if (batchStepping)
+            {
+                StepBatchedGrids();
+            }
+            else
+            {
+                UnityPhysXFlow.StepGrid(_gridHandle, Time.deltaTime);
+            }
 
+            TickTextures();
+        }
+
+        private void LateUpdate()
+        {
+            if (_gridHandle < 0 || _pendingFence <= 0) return;
+
+            UnityPhysXFlow.WaitGrid(_gridHandle, _pendingFence);
+            _pendingFence = 0;
+            TickTextures();
+        }
+
+        private void TickTextures()
+        {
             // Update textures at specified interval
             _frameCounter++;
             if (updateInterval == 0 || _frameCounter >= updateInterval)
             {
                 _frameCounter = 0;
                 UpdateTextures();
+                if (scrollWithTarget) UnityPhysXFlow.GetGridOrigin(_gridHandle, out _visualOrigin);
+            }
+            // The volume sits where the uploaded window was, not where the target is now
+            if (scrollWithTarget && _visualCube != null) _visualCube.transform.position = _visualOrigin;
+        }
+
+        private static void StepBatchedGrids()
+        {
+            if (s_lastBatchFrame == Time.frameCount) return;
+            s_lastBatchFrame = Time.frameCount;
+
+            if (s_batchHandles.Length < s_batchedGrids.Count)
+            {
+                s_batchHandles = new int[Mathf.NextPowerOfTwo(s_batchedGrids.Count)];
+            }
+
+            int count = 0;
+            foreach (var grid in s_batchedGrids)
+            {
+                if (grid._gridHandle >= 0 && grid.batchStepping && !grid.asyncStepping && grid.isActiveAndEnabled)
+                {
+                    s_batchHandles[count++] = grid._gridHandle;
+                }
             }
+            UnityPhysXFlow.StepGrids(s_batchHandles, count, Time.deltaTime);
         }
 
         public void CreateGrid()
@@ -81,7 +243,13 @@ public void CreateGrid()
                 return;
             }
 
-            _gridHandle = UnityPhysXFlow.CreateGrid(sizeX, sizeY, sizeZ, cellSize);
+            if (!string.IsNullOrEmpty(playbackCache))
+            {
+                CreatePlaybackGrid();
+                return;
+            }
+
+            _gridHandle = UnityPhysXFlow.CreateGrid(sizeX, sizeY, sizeZ, cellSize, channels);
             if (_gridHandle < 0)
             {
                 Debug.LogError($"[FlowGrid] Failed to create grid {sizeX}x{sizeY}x{sizeZ}");
@@ -89,20 +257,204 @@ public void CreateGrid()
             else
             {
                 Debug.Log($"[FlowGrid] Created grid {_gridHandle}: {sizeX}x{sizeY}x{sizeZ}, cellSize={cellSize}");
+                _resolution = new Vector3Int(sizeX, sizeY, sizeZ);
+                if (advection != AdvectionMode.SemiLagrangian)
+                {
+                    UnityPhysXFlow.SetGridAdvection(_gridHandle, advection);
+                }
+                if (pressureProjection)
+                {
+                    UnityPhysXFlow.SetGridProjection(_gridHandle, true, projectionCycles, projectionBudgetMs);
+                }
+                if (adaptiveSubsteps)
+                {
+                    UnityPhysXFlow.SetGridSubstepping(_gridHandle, true, substepMaxCfl, maxSubsteps, substepBudgetMs);
+                }
+                if (!string.IsNullOrEmpty(warmStartState))
+                {
+                    LoadState(warmStartState);
+                }
+                if (!string.IsNullOrEmpty(recordCache))
+                {
+                    StartRecording(recordCache);
+                }
+                s_batchedGrids.Add(this);
                 CreateVisualCube();
             }
         }
 
+        // A grid stepping through playbackCache: no simulation, so the solver settings don't apply
+        private void CreatePlaybackGrid()
+        {
+            _gridHandle = UnityPhysXFlow.CreatePlaybackGrid(ResolveStatePath(playbackCache), loopPlayback);
+            if (_gridHandle < 0)
+            {
+                Debug.LogError($"[FlowGrid] Failed to open NanoVDB cache {playbackCache}");
+                return;
+            }
+            UnityPhysXFlow.GetGridPlaybackInfo(_gridHandle, out PlaybackInfo info);
+            sizeX = info.sizeX;
+            sizeY = info.sizeY;
+            sizeZ = info.sizeZ;
+            cellSize = info.cellSize;
+            _resolution = new Vector3Int(sizeX, sizeY, sizeZ);
+            Debug.Log($"[FlowGrid] Playing {playbackCache} on grid {_gridHandle}: {info.frameCount} frames, {info.duration:F2}s");
+            s_batchedGrids.Add(this);
+            CreateVisualCube();
+        }
+
+        private static string ResolveStatePath(string path)
+        {
+            return System.IO.Path.IsPathRooted(path) ? path : System.IO.Path.Combine(Application.streamingAssetsPath, path);
+        }
+
+        /// <summary>
+        /// Save the grid's current fields (e.g. after pre-rolling it) for warmStartState.
+        /// </summary>
+        public bool SaveState(string path)
+        {
+            if (_gridHandle < 0) return false;
+            long bytes = UnityPhysXFlow.SaveGridState(_gridHandle, ResolveStatePath(path));
+            if (bytes < 0) Debug.LogError($"[FlowGrid] Failed to save grid state to {path} ({bytes})");
+            return bytes >= 0;
+        }
+
+        /// <summary>
+        /// Replace the grid's fields with a saved state of the same resolution.
+        /// </summary>
+        public bool LoadState(string path)
+        {
+            if (_gridHandle < 0) return false;
+            int result = UnityPhysXFlow.LoadGridState(_gridHandle, ResolveStatePath(path));
+            if (result < 0) Debug.LogError($"[FlowGrid] Failed to load grid state {path} ({result})");
+            return result >= 0;
+        }
+
+        /// <summary>
+        /// Record every following step to a NanoVDB cache, for playbackCache.
+        /// </summary>
+        public bool StartRecording(string path)
+        {
+            if (_gridHandle < 0) return false;
+            int result = UnityPhysXFlow.StartGridRecording(_gridHandle, ResolveStatePath(path));
+            if (result < 0) Debug.LogError($"[FlowGrid] Failed to start recording to {path} ({result})");
+            return result >= 0;
+        }
+
+        /// <summary>
+        /// Finish the recording. Returns the number of frames written, or -1.
+        /// </summary>
+        public int StopRecording()
+        {
+            if (_gridHandle < 0) return -1;
+            int frames = UnityPhysXFlow.StopGridRecording(_gridHandle);
+            if (frames == -2) Debug.LogError("[FlowGrid] Failed to write the NanoVDB cache");
+            _lodUnsupported = false;
+            return frames;
+        }
+
+        /// <summary>
+        /// Jump a playback grid to a time in seconds.
+        /// </summary>
+        public void SeekPlayback(float seconds)
+        {
+            if (_gridHandle >= 0) UnityPhysXFlow.SeekGridPlayback(_gridHandle, seconds);
+        }
+
+        /// <summary>
+        /// Resample the grid to a level of detail (0 = full resolution, each level halves it)
+        /// keeping its smoke. Returns the level in effect, or -1 if the grid can't change
+        /// resolution (Flow-backed, playback or recording).
+        /// </summary>
+        public int SetLod(int level)
+        {
+            if (_gridHandle < 0) return -1;
+            int result = UnityPhysXFlow.SetGridLod(_gridHandle, level);
+            if (result < 0)
+            {
+                if (!_lodUnsupported) Debug.LogWarning($"[FlowGrid] Grid {_gridHandle} can't change its level of detail ({result})");
+                _lodUnsupported = true;
+                return -1;
+            }
+            _lodLevel = result;
+            _nextLodChange = Time.time + LodCooldown;
+
+            // Textures are recreated at the new size (and fully uploaded) on the next update
+            UnityPhysXFlow.GetGridLod(_gridHandle, out GridLod lod);
+            _resolution = new Vector3Int(lod.sizeX, lod.sizeY, lod.sizeZ);
+            if (_visualCube != null)
+            {
+                _visualCube.transform.localScale = new Vector3(lod.sizeX, lod.sizeY, lod.sizeZ) * lod.cellSize;
+            }
+            return result;
+        }
+
+        // Move one level toward the one camera distance and screen coverage call for. Each
+        // threshold must be passed by lodHysteresis, so the level doesn't flicker around it.
+        private void UpdateLod()
+        {
+            if (_lodUnsupported || Time.time < _nextLodChange) return;
+            Camera cam = lodCamera != null ? lodCamera : Camera.main;
+            if (cam == null) return;
+
+            float distance = Vector3.Distance(cam.transform.position, transform.position);
+            float radius = 0.5f * Vector3.Scale(GridWorldSize, transform.lossyScale).magnitude;
+            float halfHeight = cam.orthographic
+                ? cam.orthographicSize
+                : Mathf.Max(distance, cam.nearClipPlane) * Mathf.Tan(0.5f * cam.fieldOfView * Mathf.Deg2Rad);
+            float coverage = radius / halfHeight;
+
+            int target = _lodLevel;
+            if (LodFor(distance * (1f - lodHysteresis), coverage / (1f - lodHysteresis)) > _lodLevel) target++;
+            else if (LodFor(distance * (1f + lodHysteresis), coverage / (1f + lodHysteresis)) < _lodLevel) target--;
+            if (target != _lodLevel) SetLod(target);
+        }
+
+        // Center the window on the target; the native side snaps it to whole cells.
+        private void FollowScrollTarget()
+        {
+            if (_scrollUnsupported) return;
+            Vector3 position = (scrollTarget != null ? scrollTarget : transform).position;
+            int result = UnityPhysXFlow.SetGridOrigin(_gridHandle, position);
+            if (result < 0)
+            {
+                Debug.LogWarning($"[FlowGrid] Grid {_gridHandle} can't scroll ({result})");
+                _scrollUnsupported = true;
+            }
+        }
+
+        private int LodFor(float distance, float coverage)
+        {
+            int level = 0;
+            if (lodDistance > 0f && distance > lodDistance)
+            {
+                level = Mathf.FloorToInt(Mathf.Log(distance / lodDistance, 2f)) + 1;
+            }
+            if (lodScreenCoverage > 0f && coverage < lodScreenCoverage)
+            {
+                level = Mathf.Max(level, Mathf.FloorToInt(Mathf.Log(lodScreenCoverage / Mathf.Max(coverage, 1e-4f), 2f)) + 1);
+            }
+            return Mathf.Min(level, maxLodLevel);
+        }
+
         public void DestroyGrid()
         {
             if (_gridHandle < 0) return;
 
+            s_batchedGrids.Remove(this);
+            _pendingFence = 0;
+            _uploadedVersion = -1;
+            _lodLevel = 0;
+            _lodUnsupported = false;
+            _scrollUnsupported = false;
             UnityPhysXFlow.DestroyGrid(_gridHandle);
             Debug.Log($"[FlowGrid] Destroyed grid {_gridHandle}");
             _gridHandle = -1;
 
             if (_densityTexture != null) Destroy(_densityTexture);
             if (_velocityTexture != null) Destroy(_velocityTexture);
+            if (_densityStaging != null) Destroy(_densityStaging);
+            if (_velocityStaging != null) Destroy(_velocityStaging);
             
             DestroyVisualCube();
         }
@@ -155,37 +507,78 @@ private void UpdateTextures()
                 return;
             }
 
-            // Export density
-            Texture3D densityTex = UnityPhysXFlow.ExportGridDensityAsTexture3D(_gridHandle);
-            if (densityTex != null)
+            // Nothing new published since the last upload
+            long version = UnityPhysXFlow.GetGridSnapshotVersion(_gridHandle);
+            if (version == _uploadedVersion) return;
+
+            // New textures need a full upload
+            bool created = EnsureTextures();
+            if (partialUploads && !created && _uploadedVersion >= 0 && UploadDirtyRegion()) return;
+            _uploadedVersion = version;
+
+            // Write straight into the persistent textures' pixel data: no per-frame allocations
+            if (!UnityPhysXFlow.ExportGridDensityInto(_gridHandle, _densityTexture, out float densityMin, out float densityMax))
             {
-                if (_densityTexture != null) Destroy(_densityTexture);
-                _densityTexture = densityTex;
+                Debug.LogWarning("[FlowGrid] ExportGridDensityInto failed. Enable 'Use Placeholder Data' to test rendering.");
+            }
+            else if (volumetricMaterial != null)
+            {
+                // R8/BC4 store (density - min) / (max - min); float formats decode as-is
+                volumetricMaterial.SetVector("_DensityDecode", new Vector4(densityMin, densityMax - densityMin, 0f, 0f));
+            }
+            UnityPhysXFlow.ExportGridVelocityInto(_gridHandle, _velocityTexture);
+        }
 
-                // Bind to material
+        // Copy the bricks changed since the last upload into the textures. Returns false
+        // (and uploads nothing) where a full upload is needed or as cheap.
+        private bool UploadDirtyRegion()
+        {
+            if (densityTextureFormat != TextureFormat.RFloat && densityTextureFormat != TextureFormat.RHalf) return false;
+            if ((SystemInfo.copyTextureSupport & UnityEngine.Rendering.CopyTextureSupport.Copy3D) == 0) return false;
+            if (!UnityPhysXFlow.GetDirtyRegion(_gridHandle, _uploadedVersion, out DirtyRegion region)) return false;
+            if ((long)region.sizeX * region.sizeY * region.sizeZ * 2 > (long)_resolution.x * _resolution.y * _resolution.z) return false;
+
+            if (!UnityPhysXFlow.ExportGridRegionInto(_gridHandle, region, _densityTexture, ref _densityStaging) ||
+                !UnityPhysXFlow.ExportGridRegionInto(_gridHandle, region, _velocityTexture, ref _velocityStaging))
+            {
+                return false;
+            }
+            _uploadedVersion = region.version;
+            return true;
+        }
+
+        // Returns true if a texture was (re)created, at the grid's current resolution.
+        private bool EnsureTextures()
+        {
+            bool created = false;
+            int sizeX = _resolution.x, sizeY = _resolution.y, sizeZ = _resolution.z;
+            if (_densityTexture == null || _densityTexture.format != densityTextureFormat ||
+                _densityTexture.width != sizeX || _densityTexture.height != sizeY || _densityTexture.depth != sizeZ)
+            {
+                if (_densityTexture != null) Destroy(_densityTexture);
+                _densityTexture = new Texture3D(sizeX, sizeY, sizeZ, densityTextureFormat, false);
+                _densityTexture.wrapMode = TextureWrapMode.Clamp;
+                _densityTexture.filterMode = FilterMode.Bilinear;
                 if (volumetricMaterial != null)
                 {
                     volumetricMaterial.SetTexture("_DensityTex", _densityTexture);
                 }
-            }
-            else
-            {
-                Debug.LogWarning("[FlowGrid] ExportGridDensityAsTexture3D returned null. Enable 'Use Placeholder Data' to test rendering.");
+                created = true;
             }
 
-            // Export velocity
-            Texture3D velocityTex = UnityPhysXFlow.ExportGridVelocityAsTexture3D(_gridHandle);
-            if (velocityTex != null)
+            if (_velocityTexture == null || _velocityTexture.format != velocityTextureFormat ||
+                _velocityTexture.width != sizeX || _velocityTexture.height != sizeY || _velocityTexture.depth != sizeZ)
             {
                 if (_velocityTexture != null) Destroy(_velocityTexture);
-                _velocityTexture = velocityTex;
-
-                // Bind to material
+                _velocityTexture = new Texture3D(sizeX, sizeY, sizeZ, velocityTextureFormat, false);
+                _velocityTexture.wrapMode = TextureWrapMode.Clamp;
                 if (volumetricMaterial != null)
                 {
                     volumetricMaterial.SetTexture("_VelocityTex", _velocityTexture);
                 }
+                created = true;
             }
+            return created;
         }
 
         private void UpdatePlaceholderTextures()
@@ -281,7 +674,9 @@ private void OnDrawGizmosSelected()
         // Public API for GPU renderer
         public int GridHandle => _gridHandle;
         
-        public Vector3Int GridDimensions => new Vector3Int(sizeX, sizeY, sizeZ);
+        public Vector3Int GridDimensions => _gridHandle >= 0 ? _resolution : new Vector3Int(sizeX, sizeY, sizeZ);
+
+        public int LodLevel => _lodLevel;
         
         public Vector3 GridWorldSize => new Vector3(sizeX * cellSize, sizeY * cellSize, sizeZ * cellSize);
 
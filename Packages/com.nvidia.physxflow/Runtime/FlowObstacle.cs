@@ -0,0 +1,148 @@
+using UnityEngine;
+
+namespace UnityPhysXFlow
+{
+    /// <summary>
+    /// PhysX Flow Obstacle Component - blocks fluid with the Collider on the same GameObject
+    /// (BoxCollider, SphereCollider, CapsuleCollider or MeshCollider).
+    /// </summary>
+    [AddComponentMenu("PhysX Flow/Flow Obstacle")]
+    public class FlowObstacle : MonoBehaviour
+    {
+        [Tooltip("Send the transform to the grids whenever it moves; static obstacles are voxelized once")]
+        public bool kinematic = false;
+
+        [Tooltip("Auto-create obstacle on Start")]
+        public bool autoCreate = true;
+
+        private int _obstacleHandle = -1;
+        private Vector3 _bakedScale;
+
+        private void Start()
+        {
+            if (autoCreate)
+            {
+                UnityPhysXFlow.EnsureInitialized();
+                CreateObstacle();
+            }
+        }
+
+        private void Update()
+        {
+            if (_obstacleHandle < 0 || !kinematic || !transform.hasChanged) return;
+            transform.hasChanged = false;
+
+            // Scale is baked into the shape; anything else is a cheap transform update
+            if (transform.lossyScale != _bakedScale)
+            {
+                DestroyObstacle();
+                CreateObstacle();
+                return;
+            }
+            Vector3 position;
+            Quaternion rotation;
+            GetPose(GetComponent<Collider>(), out position, out rotation);
+            UnityPhysXFlow.SetObstacleTransform(_obstacleHandle, position, rotation);
+        }
+
+        // World pose of the collider's shape: its center offset, and for capsules the
+        // rotation taking local Y onto the capsule's axis.
+        private void GetPose(Collider collider, out Vector3 position, out Quaternion rotation)
+        {
+            position = transform.position;
+            rotation = transform.rotation;
+            switch (collider)
+            {
+                case BoxCollider box:
+                    position = transform.TransformPoint(box.center);
+                    break;
+                case SphereCollider sphere:
+                    position = transform.TransformPoint(sphere.center);
+                    break;
+                case CapsuleCollider capsule:
+                    position = transform.TransformPoint(capsule.center);
+                    if (capsule.direction == 0) rotation *= Quaternion.Euler(0f, 0f, 90f);
+                    else if (capsule.direction == 2) rotation *= Quaternion.Euler(90f, 0f, 0f);
+                    break;
+            }
+        }
+
+        public void CreateObstacle()
+        {
+            if (_obstacleHandle >= 0) return; // Already created
+
+            if (!UnityPhysXFlow.IsInitialized)
+            {
+                Debug.LogError("[FlowObstacle] Cannot create obstacle: Flow not initialized. Call UnityPhysXFlow.Init() first.");
+                return;
+            }
+
+            Collider collider = GetComponent<Collider>();
+            Vector3 scale = transform.lossyScale;
+            Vector3 absScale = new Vector3(Mathf.Abs(scale.x), Mathf.Abs(scale.y), Mathf.Abs(scale.z));
+            Vector3 position;
+            Quaternion rotation;
+            GetPose(collider, out position, out rotation);
+
+            switch (collider)
+            {
+                case BoxCollider box:
+                    _obstacleHandle = UnityPhysXFlow.CreateObstacle(new ObstacleDesc(ObstacleType.Box, position, rotation,
+                        Vector3.Scale(box.size, absScale) * 0.5f));
+                    break;
+                case SphereCollider sphere:
+                {
+                    float radius = sphere.radius * Mathf.Max(absScale.x, Mathf.Max(absScale.y, absScale.z));
+                    _obstacleHandle = UnityPhysXFlow.CreateObstacle(new ObstacleDesc(ObstacleType.Sphere, position, rotation,
+                        new Vector3(radius, 0f, 0f)));
+                    break;
+                }
+                case CapsuleCollider capsule:
+                {
+                    // Unity scales the radius by the larger of the two cross-axis scales
+                    int axis = capsule.direction;
+                    float axisScale = absScale[axis];
+                    float radiusScale = Mathf.Max(absScale[(axis + 1) % 3], absScale[(axis + 2) % 3]);
+                    float radius = capsule.radius * radiusScale;
+                    float halfSegment = Mathf.Max(0f, capsule.height * axisScale * 0.5f - radius);
+                    _obstacleHandle = UnityPhysXFlow.CreateObstacle(new ObstacleDesc(ObstacleType.Capsule, position, rotation,
+                        new Vector3(radius, halfSegment, 0f)));
+                    break;
+                }
+                case MeshCollider meshCollider when meshCollider.sharedMesh != null:
+                {
+                    Mesh mesh = meshCollider.sharedMesh;
+                    Vector3[] vertices = mesh.vertices;
+                    for (int i = 0; i < vertices.Length; i++) vertices[i] = Vector3.Scale(vertices[i], scale);
+                    _obstacleHandle = UnityPhysXFlow.CreateMeshObstacle(new ObstacleDesc(ObstacleType.Mesh, position, rotation,
+                        Vector3.zero), vertices, mesh.triangles);
+                    break;
+                }
+                default:
+                    Debug.LogError($"[FlowObstacle] {name} needs a BoxCollider, SphereCollider, CapsuleCollider or MeshCollider");
+                    return;
+            }
+
+            if (_obstacleHandle < 0)
+            {
+                Debug.LogError($"[FlowObstacle] Failed to create obstacle for {name}");
+                return;
+            }
+            _bakedScale = scale;
+            transform.hasChanged = false;
+        }
+
+        public void DestroyObstacle()
+        {
+            if (_obstacleHandle < 0) return;
+
+            UnityPhysXFlow.DestroyObstacle(_obstacleHandle);
+            _obstacleHandle = -1;
+        }
+
+        private void OnDestroy()
+        {
+            DestroyObstacle();
+        }
+    }
+}
@@ -1,10 +1,287 @@
 using System;
 using System.Runtime.InteropServices;
 using System.Threading;
+using Unity.Collections;
+using Unity.Collections.LowLevel.Unsafe;
 using UnityEngine;
 
 namespace UnityPhysXFlow
 {
+    /// <summary>
+    /// Immutable, versioned view of a grid's fields (mirrors UpfGridSnapshot).
+    /// Valid until passed to UnityPhysXFlow.ReleaseGridSnapshot.
+    /// </summary>
+    [StructLayout(LayoutKind.Sequential)]
+    public struct GridSnapshot
+    {
+        public IntPtr density;   // sizeX*sizeY*sizeZ floats
+        public IntPtr velocity;  // sizeX*sizeY*sizeZ*3 floats (vx, vy, vz)
+        public int sizeX, sizeY, sizeZ;
+        public int slot;
+        public long version;
+    }
+
+    /// <summary>
+    /// Brick-aligned box of a snapshot that changed since an earlier version (mirrors UpfDirtyRegion).
+    /// </summary>
+    [StructLayout(LayoutKind.Sequential)]
+    public struct DirtyRegion
+    {
+        public long version;     // snapshot the region was computed for
+        public int x, y, z;      // first cell
+        public int sizeX, sizeY, sizeZ; // 0 when nothing changed
+        public int brickCount;
+    }
+
+    /// <summary>
+    /// Flow device the bridge initializes on (mirrors UpfContextApi).
+    /// </summary>
+    public enum ContextApi
+    {
+        None = 0,    // no Flow device: built-in solver only, Flow libraries not loaded
+        Vulkan = 1,  // default; grids use the built-in solver
+        D3D12 = 2,
+        CPU = 3,     // Flow's CPU device; grids run Flow's sparse solver (no GPU needed)
+    }
+
+    /// <summary>
+    /// Solver stepping a grid (mirrors UpfGridBackend).
+    /// </summary>
+    public enum GridBackend
+    {
+        Builtin = 0,
+        Flow = 1,
+        Playback = 2,   // frames of a recorded NanoVDB cache, not simulated
+    }
+
+    /// <summary>
+    /// Advection scheme of a grid's fused steps (mirrors UpfAdvectionMode).
+    /// </summary>
+    public enum AdvectionMode
+    {
+        SemiLagrangian = 0,     // first order, one sweep
+        MacCormack = 1,         // second order, two sweeps
+        BFECC = 2,              // second order, three sweeps
+    }
+
+    /// <summary>
+    /// Cell formats for the ExportGrid*Into functions (mirrors UpfExportFormat).
+    /// </summary>
+    public enum ExportFormat
+    {
+        R32F = 0,     // density: 1 float per cell (TextureFormat.RFloat)
+        RGB32F = 1,   // velocity: 3 floats per cell
+        RGBA32F = 2,  // velocity: 4 floats per cell, w = 0 (TextureFormat.RGBAFloat)
+        R16F = 3,     // density: 1 half per cell (TextureFormat.RHalf)
+        RGBA16F = 4,  // velocity: 4 halves per cell, w = 0 (TextureFormat.RGBAHalf)
+        R8_UNORM = 5, // density: 1 byte per cell over [min, max] (TextureFormat.R8)
+        BC4_UNORM = 6,// density: BC4 blocks per z-slice over [min, max] (TextureFormat.BC4)
+    }
+
+    /// <summary>
+    /// Optional simulation channels of a built-in grid (mirrors UpfGridChannel). Density is
+    /// always simulated; grids pay only for the channels they are created with.
+    /// </summary>
+    [Flags]
+    public enum GridChannels
+    {
+        None = 0,
+        Temperature = 1 << 0,   // buoyancy and ignition; cools over time, kept in [-1, 1]
+        Fuel = 1 << 1,          // burns where hot enough, releasing heat and smoke
+        Burn = 1 << 2,          // fuel burned in the last step (flame intensity); not advected
+        Smoke = 1 << 3,         // combustion smoke, separate from the emitted density
+        Fire = Temperature | Fuel | Burn | Smoke,
+    }
+
+    /// <summary>
+    /// Combustion and channel decay of a grid with optional channels (mirrors UpfCombustionParams).
+    /// </summary>
+    [StructLayout(LayoutKind.Sequential)]
+    public struct CombustionParams
+    {
+        public float ignitionTemp;      // 0.05
+        public float burnPerTemp;       // 4
+        public float fuelPerBurn;       // 0.25
+        public float tempPerBurn;       // 5
+        public float smokePerBurn;      // 3
+        public float buoyancyPerTemp;   // upward acceleration per unit temperature (10)
+        public float coolingRate;       // fraction of temperature lost per second (1.5)
+        public float fuelFade;          // fraction of fuel lost per second (0)
+        public float smokeFade;         // fraction of smoke lost per second (0.65)
+    }
+
+    /// <summary>
+    /// Emitter parameters for UnityPhysXFlow.SetEmittersBatch (mirrors UpfEmitterDesc).
+    /// </summary>
+    [StructLayout(LayoutKind.Sequential)]
+    public struct EmitterDesc
+    {
+        public int handle;
+        public float x, y, z;
+        public float radius;
+        public float density;
+    }
+
+    /// <summary>
+    /// Obstacle shapes (mirrors UpfObstacleType).
+    /// </summary>
+    public enum ObstacleType
+    {
+        Box = 0,
+        Sphere = 1,
+        Capsule = 2,
+        Mesh = 3,       // CreateMeshObstacle only
+    }
+
+    /// <summary>
+    /// Obstacle placement and size in world units (mirrors UpfObstacleDesc). Box: half extents;
+    /// sphere: radius in sx; capsule: radius in sx and half length of its segment along local Y in sy.
+    /// </summary>
+    [StructLayout(LayoutKind.Sequential)]
+    public struct ObstacleDesc
+    {
+        public ObstacleType type;
+        public float px, py, pz;
+        public float qx, qy, qz, qw;
+        public float sx, sy, sz;
+
+        public ObstacleDesc(ObstacleType type, Vector3 position, Quaternion rotation, Vector3 size)
+        {
+            this.type = type;
+            px = position.x; py = position.y; pz = position.z;
+            qx = rotation.x; qy = rotation.y; qz = rotation.z; qw = rotation.w;
+            sx = size.x; sy = size.y; sz = size.z;
+        }
+    }
+
+    /// <summary>
+    /// Obstacle state of a grid (mirrors UpfObstacleStats).
+    /// </summary>
+    [StructLayout(LayoutKind.Sequential)]
+    public struct ObstacleStats
+    {
+        public int obstacles;           // obstacles overlapping the grid
+        public int obstacleBricks;      // bricks within one cell of an obstacle
+        public int rasterizedBricks;    // bricks re-rasterized by the last step
+        public float milliseconds;
+    }
+
+    /// <summary>
+    /// Pressure projection results of a grid's last step (mirrors UpfProjectionStats).
+    /// </summary>
+    [StructLayout(LayoutKind.Sequential)]
+    public struct ProjectionStats
+    {
+        public int cycles;          // multigrid V-cycles run
+        public float divergence;    // RMS velocity divergence per cell before projection
+        public float residual;      // RMS pressure residual after the last cycle
+        public float milliseconds;
+    }
+
+    /// <summary>
+    /// Adaptive substepping results of a grid's last step (mirrors UpfSubstepStats).
+    /// </summary>
+    [StructLayout(LayoutKind.Sequential)]
+    public struct SubstepStats
+    {
+        public int substeps;
+        public float substepDt;     // seconds per substep
+        public float cfl;           // largest velocity component * substepDt / cellSize
+        public float deficit;       // simulated seconds carried to the next frame
+        public float dropped;       // seconds discarded because the backlog exceeded 0.25 s
+        public float milliseconds;
+    }
+
+    /// <summary>
+    /// Milliseconds spent in each stage of a grid's last step (mirrors UpfStepTimings).
+    /// </summary>
+    [StructLayout(LayoutKind.Sequential)]
+    public struct StepTimings
+    {
+        public float emitMs;
+        public float advectMs;      // fused steps also include buoyancy and clamping here
+        public float buoyancyMs;
+        public float clampMs;
+        public float projectMs;
+        public float publishMs;     // also NanoVDB encode when recording, decode when playing back
+        public float tracerMs;
+        public float totalMs;
+    }
+
+    /// <summary>
+    /// A playback grid's cache and position (mirrors UpfPlaybackInfo).
+    /// </summary>
+    [StructLayout(LayoutKind.Sequential)]
+    public struct PlaybackInfo
+    {
+        public int sizeX, sizeY, sizeZ;
+        public float cellSize;
+        public int frameCount;
+        public int frame;           // frame currently published
+        public float duration;      // seconds
+        public float time;          // playback position in seconds
+    }
+
+    /// <summary>
+    /// A grid's level of detail (mirrors UpfGridLod).
+    /// </summary>
+    [StructLayout(LayoutKind.Sequential)]
+    public struct GridLod
+    {
+        public int level;           // 0 = resolution at creation; each level halves it
+        public int maxLevel;        // coarsest level SetGridLod accepts
+        public int sizeX, sizeY, sizeZ;
+        public float cellSize;
+    }
+
+    /// <summary>
+    /// One pass of a Flow profiler capture (mirrors UpfProfilerEntry).
+    /// </summary>
+    [StructLayout(LayoutKind.Sequential)]
+    public struct ProfilerEntry
+    {
+        public ulong captureId;
+        public int labelId;         // see GetProfilerLabel
+        public float cpuMs;
+        public float gpuMs;
+    }
+
+    /// <summary>
+    /// Types of queued bridge events (mirrors UpfEventType).
+    /// </summary>
+    public enum FlowEventType
+    {
+        FrameFlushed = 0,       // frame = flushed Flow frame, value = dt
+        Error = 1,              // Text = message
+        GridCreated = 2,        // handle = grid, value = cell size
+        GridDestroyed = 3,      // handle = grid
+        BudgetExceeded = 4,     // handle = grid, value = ms spent, limit = ms budget, Text = stage
+        Test = 5,               // Text = message
+    }
+
+    /// <summary>
+    /// One queued bridge event (mirrors UpfEvent, 128 bytes).
+    /// </summary>
+    [StructLayout(LayoutKind.Sequential)]
+    public unsafe struct FlowEvent
+    {
+        public FlowEventType type;
+        public int handle;
+        public long frame;
+        public float value;
+        public float limit;
+        private fixed byte text[104];
+
+        /// <summary>Event text as a string (allocates; only read it for events you keep).</summary>
+        public string Text
+        {
+            get
+            {
+                fixed (byte* p = text) return Marshal.PtrToStringAnsi((IntPtr)p);
+            }
+        }
+    }
+
     public static class UnityPhysXFlow
     {
 #if UNITY_STANDALONE_WIN || UNITY_EDITOR_WIN
@@ -17,10 +294,11 @@ public static class UnityPhysXFlow
         public delegate void EventCallback(int eventType, string jsonPayload, IntPtr userData);
 
         [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
-        private static extern int Upf_Init();
+        private static extern int Upf_InitWithApi(int contextApi, int cpuThreads);
 
         [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
-        private static extern void Upf_RegisterCallback(EventCallback cb, IntPtr userData);
+        private static extern int Upf_GetContextApi();
+
 
         [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
         private static extern void Upf_Step(float dt);
@@ -31,6 +309,24 @@ public static class UnityPhysXFlow
         [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
         private static extern void Upf_Shutdown();
 
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int Upf_ReadProfilerEntries([Out] ProfilerEntry[] dst, int maxEntries);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern IntPtr Upf_GetProfilerLabel(int labelId);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern long Upf_GetProfilerDroppedCount();
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int Upf_DrainEvents([Out] FlowEvent[] dst, int capacity);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern uint Upf_SetEventMask(uint mask);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern long Upf_GetDroppedEventCount();
+
         private static bool _isInitialized = false;
 
 #if UNITY_STANDALONE_WIN || UNITY_EDITOR_WIN
@@ -48,29 +344,227 @@ public static class UnityPhysXFlow
         [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
         private static extern void Upf_SetEmitterParams(int emitterHandle, float x, float y, float z, float radius, float density);
 
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern void Upf_SetEmitterChannels(int emitterHandle, float temperature, float fuel, float smoke);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int Upf_SetEmittersBatch([In] EmitterDesc[] emitters, int count);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int Upf_CreateObstacle(ref ObstacleDesc desc);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int Upf_CreateMeshObstacle(ref ObstacleDesc desc, [In] Vector3[] vertices, int vertexCount, [In] int[] indices, int indexCount);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern void Upf_SetObstacleTransform(int obstacleHandle, float px, float py, float pz, float qx, float qy, float qz, float qw);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern void Upf_DestroyObstacle(int obstacleHandle);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int Upf_GetGridObstacleStats(int gridHandle, out ObstacleStats outStats);
+
         [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
         private static extern int Upf_CreateGrid(int sizeX, int sizeY, int sizeZ, float cellSize);
 
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int Upf_CreateGridWithChannels(int sizeX, int sizeY, int sizeZ, float cellSize, uint channelMask);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int Upf_GetGridChannels(int gridHandle);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int Upf_GetGridBackend(int gridHandle);
+
         [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
         private static extern void Upf_DestroyGrid(int gridHandle);
 
         [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
         private static extern void Upf_StepGrid(int gridHandle, float dt);
 
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern void Upf_StepGrids(int[] gridHandles, int count, float dt);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern long Upf_StepGridAsync(int gridHandle, float dt);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int Upf_IsGridReady(int gridHandle, long fence);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern void Upf_WaitGrid(int gridHandle, long fence);
+
         [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
         private static extern IntPtr Upf_ExportGridDensity(int gridHandle, out int outSizeX, out int outSizeY, out int outSizeZ, out int outFormat);
 
         [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
         private static extern IntPtr Upf_ExportGridVelocity(int gridHandle, out int outSizeX, out int outSizeY, out int outSizeZ, out int outFormat);
 
-        private static EventCallback _cb;
-        private static GCHandle _gcThis;
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern void Upf_SetGridFusedStep(int gridHandle, int enabled);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern void Upf_SetGridSparse(int gridHandle, int enabled);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int Upf_GetGridActiveBrickCount(int gridHandle);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern void Upf_SetGridAdvection(int gridHandle, int mode);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int Upf_SetGridCombustion(int gridHandle, ref CombustionParams combustion);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int Upf_GetGridCombustion(int gridHandle, out CombustionParams combustion);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern void Upf_SetGridProjection(int gridHandle, int enabled, int maxCycles, float budgetMs, float tolerance);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int Upf_GetGridProjectionStats(int gridHandle, out ProjectionStats outStats);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern void Upf_SetGridSubstepping(int gridHandle, int enabled, float maxCfl, int maxSubsteps, float budgetMs);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int Upf_GetGridSubstepStats(int gridHandle, out SubstepStats outStats);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int Upf_SetThreadCount(int threads);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int Upf_GetGridStepTimings(int gridHandle, out StepTimings outTimings);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern long Upf_ExportGridDensityInto(int gridHandle, IntPtr dst, UIntPtr dstBytes, int format);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern long Upf_ExportGridVelocityInto(int gridHandle, IntPtr dst, UIntPtr dstBytes, int format);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern long Upf_ExportGridDensityIntoScaled(int gridHandle, IntPtr dst, UIntPtr dstBytes, int format, out float outMin, out float outMax);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern long Upf_ExportGridChannelInto(int gridHandle, int channel, IntPtr dst, UIntPtr dstBytes, int format, out float outMin, out float outMax);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int Upf_AcquireGridSnapshot(int gridHandle, out GridSnapshot outSnapshot);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern void Upf_ReleaseGridSnapshot(int gridHandle, ref GridSnapshot snapshot);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern long Upf_GetGridSnapshotVersion(int gridHandle);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int Upf_GetDirtyRegion(int gridHandle, long sinceVersion, out DirtyRegion outRegion);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern long Upf_ExportGridRegionInto(int gridHandle, ref DirtyRegion region, IntPtr dst, UIntPtr dstBytes, int format);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int Upf_ExportDirtyBricks(int gridHandle, long sinceVersion, IntPtr outBricks, int maxBricks, IntPtr dst, UIntPtr dstBytes, int format);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int Upf_SampleGrid(int gridHandle, IntPtr points, int count, IntPtr results);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern long Upf_SaveGridState(int gridHandle, [MarshalAs(UnmanagedType.LPUTF8Str)] string path);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int Upf_LoadGridState(int gridHandle, [MarshalAs(UnmanagedType.LPUTF8Str)] string path, int[] outEmitterHandles, int maxEmitters);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int Upf_StartGridRecording(int gridHandle, [MarshalAs(UnmanagedType.LPUTF8Str)] string path);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int Upf_StopGridRecording(int gridHandle);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int Upf_CreatePlaybackGrid([MarshalAs(UnmanagedType.LPUTF8Str)] string path, int loop);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int Upf_SeekGridPlayback(int gridHandle, float seconds);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int Upf_GetGridPlaybackInfo(int gridHandle, out PlaybackInfo outInfo);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int Upf_SetGridLod(int gridHandle, int level);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int Upf_GetGridLod(int gridHandle, out GridLod outLod);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int Upf_SetGridOrigin(int gridHandle, float x, float y, float z);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int Upf_GetGridOrigin(int gridHandle, out Vector3 outOrigin);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int Upf_SetTracerCapacity(int gridHandle, int capacity);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int Upf_SpawnTracers(int gridHandle, Vector3[] positions, int count, float lifetime);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int Upf_ClearTracers(int gridHandle);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int Upf_GetTracerCount(int gridHandle);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        private static extern int Upf_ExportTracers(int gridHandle, IntPtr outPacked, int maxCount);
+
+        private static Action<int, string> _onEvent;
+        private static readonly FlowEvent[] _eventBuffer = new FlowEvent[64];
+
+        private static uint _eventMask = ~(1u << (int)FlowEventType.FrameFlushed);
+
+        /// <summary>
+        /// Event types the bridge queues, bit 1 &lt;&lt; type (all but FrameFlushed by default).
+        /// Init applies it; setting it afterwards takes effect immediately.
+        /// </summary>
+        public static uint EventMask
+        {
+            get => _eventMask;
+            set
+            {
+                _eventMask = value;
+                if (_isInitialized) Upf_SetEventMask(value);
+            }
+        }
 
         /// <summary>
         /// Check if Flow system is initialized
         /// </summary>
         public static bool IsInitialized => _isInitialized;
 
+        /// <summary>
+        /// Device used by Init/EnsureInitialized. Set before the first initialization
+        /// (e.g. CPU on headless servers and build agents).
+        /// </summary>
+        public static ContextApi PreferredContextApi = ContextApi.Vulkan;
+
+        /// <summary>
+        /// Thread count for the CPU device (0 = one per core).
+        /// </summary>
+        public static int CpuThreads = 0;
+
+        /// <summary>
+        /// Device the bridge was initialized on, or null if it is not initialized.
+        /// </summary>
+        public static ContextApi? ActiveContextApi
+        {
+            get
+            {
+                int api = Upf_GetContextApi();
+                return api < 0 ? (ContextApi?)null : (ContextApi)api;
+            }
+        }
+
         /// <summary>
         /// Auto-initialize on application start
         /// </summary>
@@ -92,6 +586,11 @@ public static void SetDllDirectory(string path)
         }
 
         public static int Init(Action<int, string> onEvent)
+        {
+            return Init(onEvent, PreferredContextApi, CpuThreads);
+        }
+
+        public static int Init(Action<int, string> onEvent, ContextApi contextApi, int cpuThreads = 0)
         {
             if (_isInitialized)
             {
@@ -99,19 +598,15 @@ public static int Init(Action<int, string> onEvent)
                 return 0;
             }
 
-            _cb = (evt, payload, ud) =>
-            {
-                // Unity main thread dispatch if needed
-                UnityMainThreadDispatcher.Enqueue(() => onEvent?.Invoke(evt, payload));
-            };
-            _gcThis = GCHandle.Alloc(_cb);
-            Upf_RegisterCallback(_cb, IntPtr.Zero);
-            
-            int result = Upf_Init();
+            // Events are queued natively and drained once per frame on the main thread
+            _onEvent = onEvent;
+            Upf_SetEventMask(_eventMask);
+
+            int result = Upf_InitWithApi((int)contextApi, cpuThreads);
             if (result == 0)
             {
                 _isInitialized = true;
-                Debug.Log("[UnityPhysXFlow] Initialized successfully");
+                Debug.Log($"[UnityPhysXFlow] Initialized successfully ({contextApi})");
             }
             else
             {
@@ -137,64 +632,582 @@ public static void EnsureInitialized()
         public static void Shutdown()
         {
             Upf_Shutdown();
-            if (_gcThis.IsAllocated) _gcThis.Free();
-            _cb = null;
+            PumpEvents();
+            _onEvent = null;
             _isInitialized = false;
             Debug.Log("[UnityPhysXFlow] Shutdown complete");
         }
 
-        // --- Simulation API ---
-        public static int CreateEmitter(Vector3 position, float radius, float density)
+        /// <summary>
+        /// Pop queued bridge events, oldest first, into a reusable array. Returns the
+        /// number written: one native call, no allocation. Use this instead of the Init
+        /// callback for allocation-free handling; both read the same queue.
+        /// </summary>
+        public static int DrainEvents(FlowEvent[] dst)
         {
-            return Upf_CreateEmitter(position.x, position.y, position.z, radius, density);
+            if (dst == null || dst.Length == 0) return 0;
+            return Upf_DrainEvents(dst, dst.Length);
         }
 
-        public static void DestroyEmitter(int emitterHandle)
-        {
-            Upf_DestroyEmitter(emitterHandle);
-        }
+        /// <summary>
+        /// Events dropped since the last call because the queue was full.
+        /// </summary>
+        public static long GetDroppedEventCount() => Upf_GetDroppedEventCount();
 
-        public static void SetEmitterParams(int emitterHandle, Vector3 position, float radius, float density)
+        // Drains the queue into the Init callback; called by UnityMainThreadDispatcher each frame.
+        internal static void PumpEvents()
         {
-            Upf_SetEmitterParams(emitterHandle, position.x, position.y, position.z, radius, density);
+            if (_onEvent == null) return;
+            int count;
+            do
+            {
+                count = Upf_DrainEvents(_eventBuffer, _eventBuffer.Length);
+                for (int i = 0; i < count; i++)
+                {
+                    try { _onEvent(_eventBuffer[i].type == FlowEventType.Test ? 99 : (int)_eventBuffer[i].type, FormatEvent(ref _eventBuffer[i])); }
+                    catch (Exception e) { Debug.LogException(e); }
+                }
+            } while (count == _eventBuffer.Length);
         }
 
-        public static int CreateGrid(int sizeX, int sizeY, int sizeZ, float cellSize)
+        private static string FormatEvent(ref FlowEvent e)
         {
-            return Upf_CreateGrid(sizeX, sizeY, sizeZ, cellSize);
+            switch (e.type)
+            {
+                case FlowEventType.FrameFlushed: return $"flushedFrame={e.frame}, dt={e.value}";
+                case FlowEventType.GridCreated: return $"grid={e.handle}, cellSize={e.value}";
+                case FlowEventType.GridDestroyed: return $"grid={e.handle}";
+                case FlowEventType.BudgetExceeded: return $"grid={e.handle}, {e.Text}: {e.value:F2} ms of {e.limit:F2} ms";
+                default: return e.Text;
+            }
         }
 
-        public static void DestroyGrid(int gridHandle)
-        {
-            Upf_DestroyGrid(gridHandle);
-        }
+        private static string[] _profilerLabels = new string[0];
 
-        public static void StepGrid(int gridHandle, float dt)
+        /// <summary>
+        /// Pop queued Flow profiler records, oldest first, into a reusable array.
+        /// Returns the number written. Allocates nothing; call once per frame.
+        /// </summary>
+        public static int ReadProfilerEntries(ProfilerEntry[] dst)
         {
-            Upf_StepGrid(gridHandle, dt);
+            if (dst == null || dst.Length == 0) return 0;
+            return Upf_ReadProfilerEntries(dst, dst.Length);
         }
 
         /// <summary>
-        /// Export density data as raw float array
+        /// Label text of a profiler record. Each label is converted once and cached.
         /// </summary>
-        public static float[] ExportGridDensity(int gridHandle)
+        public static string GetProfilerLabel(int labelId)
         {
-            IntPtr dataPtr = Upf_ExportGridDensity(gridHandle, out int sizeX, out int sizeY, out int sizeZ, out int format);
-            if (dataPtr == IntPtr.Zero) return null;
+            if (labelId < 0) return null;
+            if (labelId < _profilerLabels.Length && _profilerLabels[labelId] != null) return _profilerLabels[labelId];
 
-            int totalCells = sizeX * sizeY * sizeZ;
-            float[] densityData = new float[totalCells];
-            Marshal.Copy(dataPtr, densityData, 0, totalCells);
-            return densityData;
+            IntPtr text = Upf_GetProfilerLabel(labelId);
+            if (text == IntPtr.Zero) return null;
+            if (labelId >= _profilerLabels.Length)
+            {
+                Array.Resize(ref _profilerLabels, Math.Max(labelId + 1, _profilerLabels.Length * 2));
+            }
+            return _profilerLabels[labelId] = Marshal.PtrToStringAnsi(text);
         }
 
         /// <summary>
-        /// Export velocity data as raw float array (3 floats per cell: vx, vy, vz)
+        /// Profiler records dropped since the last call because nobody read them in time.
         /// </summary>
-        public static float[] ExportGridVelocity(int gridHandle)
-        {
-            IntPtr dataPtr = Upf_ExportGridVelocity(gridHandle, out int sizeX, out int sizeY, out int sizeZ, out int format);
-            if (dataPtr == IntPtr.Zero) return null;
+        public static long GetProfilerDroppedCount() => Upf_GetProfilerDroppedCount();
+
+        // --- Simulation API ---
+        public static int CreateEmitter(Vector3 position, float radius, float density)
+        {
+            return Upf_CreateEmitter(position.x, position.y, position.z, radius, density);
+        }
+
+        public static void DestroyEmitter(int emitterHandle)
+        {
+            Upf_DestroyEmitter(emitterHandle);
+        }
+
+        public static void SetEmitterParams(int emitterHandle, Vector3 position, float radius, float density)
+        {
+            Upf_SetEmitterParams(emitterHandle, position.x, position.y, position.z, radius, density);
+        }
+
+        /// <summary>
+        /// What the emitter adds per second to grids with optional channels: fuel and smoke are
+        /// added, temperature pulls cells toward the given value. All 0 by default.
+        /// </summary>
+        public static void SetEmitterChannels(int emitterHandle, float temperature, float fuel, float smoke)
+        {
+            Upf_SetEmitterChannels(emitterHandle, temperature, fuel, smoke);
+        }
+
+        /// <summary>
+        /// Update the first count emitters in one native call. Returns the number updated.
+        /// </summary>
+        public static int SetEmittersBatch(EmitterDesc[] emitters, int count)
+        {
+            if (emitters == null || count <= 0) return 0;
+            return Upf_SetEmittersBatch(emitters, Math.Min(count, emitters.Length));
+        }
+
+        /// <summary>
+        /// Create a box, sphere or capsule obstacle. Grids it overlaps voxelize it once into a
+        /// cached distance field; moving it only re-rasterizes the bricks it swept.
+        /// Returns a handle, or -1 on failure.
+        /// </summary>
+        public static int CreateObstacle(ObstacleDesc desc)
+        {
+            return Upf_CreateObstacle(ref desc);
+        }
+
+        /// <summary>
+        /// Create a closed triangle mesh obstacle from vertices in its local space (scale applied).
+        /// The mesh is baked into a distance volume once, so moving it stays cheap.
+        /// </summary>
+        public static int CreateMeshObstacle(ObstacleDesc desc, Vector3[] vertices, int[] indices)
+        {
+            if (vertices == null || indices == null) return -1;
+            return Upf_CreateMeshObstacle(ref desc, vertices, vertices.Length, indices, indices.Length);
+        }
+
+        public static void SetObstacleTransform(int obstacleHandle, Vector3 position, Quaternion rotation)
+        {
+            Upf_SetObstacleTransform(obstacleHandle, position.x, position.y, position.z, rotation.x, rotation.y, rotation.z, rotation.w);
+        }
+
+        public static void DestroyObstacle(int obstacleHandle)
+        {
+            Upf_DestroyObstacle(obstacleHandle);
+        }
+
+        public static bool GetGridObstacleStats(int gridHandle, out ObstacleStats stats)
+        {
+            return Upf_GetGridObstacleStats(gridHandle, out stats) == 0;
+        }
+
+        public static int CreateGrid(int sizeX, int sizeY, int sizeZ, float cellSize)
+        {
+            return Upf_CreateGrid(sizeX, sizeY, sizeZ, cellSize);
+        }
+
+        /// <summary>
+        /// As CreateGrid, also simulating the given optional channels. Combustion needs
+        /// Temperature and Fuel. Returns -2 for channels on the CPU device, whose
+        /// Flow-backed grids simulate density only.
+        /// </summary>
+        public static int CreateGrid(int sizeX, int sizeY, int sizeZ, float cellSize, GridChannels channels)
+        {
+            return Upf_CreateGridWithChannels(sizeX, sizeY, sizeZ, cellSize, (uint)channels);
+        }
+
+        /// <summary>
+        /// Optional channels the grid simulates (None also for an unknown grid).
+        /// </summary>
+        public static GridChannels GetGridChannels(int gridHandle)
+        {
+            int channels = Upf_GetGridChannels(gridHandle);
+            return channels > 0 ? (GridChannels)channels : GridChannels.None;
+        }
+
+        /// <summary>
+        /// Solver stepping a grid: Flow's on the CPU device, otherwise the built-in one;
+        /// Playback for grids created with CreatePlaybackGrid.
+        /// </summary>
+        public static GridBackend GetGridBackend(int gridHandle)
+        {
+            int backend = Upf_GetGridBackend(gridHandle);
+            if (backend == (int)GridBackend.Flow || backend == (int)GridBackend.Playback) return (GridBackend)backend;
+            return GridBackend.Builtin;
+        }
+
+        public static void DestroyGrid(int gridHandle)
+        {
+            Upf_DestroyGrid(gridHandle);
+        }
+
+        public static void StepGrid(int gridHandle, float dt)
+        {
+            Upf_StepGrid(gridHandle, dt);
+        }
+
+        /// <summary>
+        /// Step several grids in one call; the native side steps them concurrently.
+        /// </summary>
+        public static void StepGrids(int[] gridHandles, int count, float dt)
+        {
+            if (gridHandles == null || count <= 0) return;
+            Upf_StepGrids(gridHandles, Mathf.Min(count, gridHandles.Length), dt);
+        }
+
+        /// <summary>
+        /// Queue a grid step on the native worker thread. Returns a fence for
+        /// IsGridReady/WaitGrid, or -1 if the grid does not exist or the bridge
+        /// is not initialized.
+        /// </summary>
+        public static long StepGridAsync(int gridHandle, float dt)
+        {
+            return Upf_StepGridAsync(gridHandle, dt);
+        }
+
+        /// <summary>
+        /// True once the step identified by fence has finished (fence &lt;= 0: latest queued step).
+        /// </summary>
+        public static bool IsGridReady(int gridHandle, long fence = 0)
+        {
+            return Upf_IsGridReady(gridHandle, fence) != 0;
+        }
+
+        /// <summary>
+        /// Block until the step identified by fence has finished (fence &lt;= 0: latest queued step).
+        /// </summary>
+        public static void WaitGrid(int gridHandle, long fence = 0)
+        {
+            Upf_WaitGrid(gridHandle, fence);
+        }
+
+        /// <summary>
+        /// Fused stepping (default) runs advection, buoyancy and clamping in one sweep.
+        /// Disable to run them as separate passes, e.g. for per-stage profiling.
+        /// </summary>
+        public static void SetGridFusedStep(int gridHandle, bool enabled)
+        {
+            Upf_SetGridFusedStep(gridHandle, enabled ? 1 : 0);
+        }
+
+        /// <summary>
+        /// Sparse stepping (default) only updates the 8x8x8 bricks that hold smoke or
+        /// motion, plus emitter bricks and a one-brick margin. Applies to fused steps.
+        /// </summary>
+        public static void SetGridSparse(int gridHandle, bool enabled)
+        {
+            Upf_SetGridSparse(gridHandle, enabled ? 1 : 0);
+        }
+
+        /// <summary>
+        /// Advection scheme for the grid's fused steps. MacCormack and BFECC keep plume detail
+        /// sharp (limited to the neighbouring values) at 2x / 3x the advection cost, so grids can
+        /// run at lower resolution for the same look.
+        /// </summary>
+        public static void SetGridAdvection(int gridHandle, AdvectionMode mode)
+        {
+            Upf_SetGridAdvection(gridHandle, (int)mode);
+        }
+
+        /// <summary>
+        /// Combustion, temperature buoyancy and channel decay of a grid with optional channels.
+        /// False for an unknown grid, or if a value is NaN/infinite or a rate is negative.
+        /// </summary>
+        public static bool SetGridCombustion(int gridHandle, CombustionParams combustion)
+        {
+            return Upf_SetGridCombustion(gridHandle, ref combustion) == 0;
+        }
+
+        public static bool GetGridCombustion(int gridHandle, out CombustionParams combustion)
+        {
+            return Upf_GetGridCombustion(gridHandle, out combustion) == 0;
+        }
+
+        /// <summary>
+        /// Number of bricks updated by the grid's last step (-1 for an unknown grid).
+        /// </summary>
+        public static int GetGridActiveBrickCount(int gridHandle)
+        {
+            return Upf_GetGridActiveBrickCount(gridHandle);
+        }
+
+        /// <summary>
+        /// Enable multigrid pressure projection so the velocity stays divergence free.
+        /// Runs up to maxCycles V-cycles per step, stopping early below tolerance (relative
+        /// to the divergence) or before exceeding budgetMs (0 = no time budget).
+        /// </summary>
+        public static void SetGridProjection(int gridHandle, bool enabled, int maxCycles = 4, float budgetMs = 0f, float tolerance = 1e-3f)
+        {
+            Upf_SetGridProjection(gridHandle, enabled ? 1 : 0, maxCycles, budgetMs, tolerance);
+        }
+
+        public static bool GetGridProjectionStats(int gridHandle, out ProjectionStats stats)
+        {
+            return Upf_GetGridProjectionStats(gridHandle, out stats) == 0;
+        }
+
+        /// <summary>
+        /// Enable adaptive substepping: each step's dt is accumulated and simulated in the
+        /// fewest substeps that keep velocity * substep / cellSize &lt;= maxCfl. At most
+        /// maxSubsteps run, within budgetMs (0 = no budget); time left over carries to the
+        /// next step and is reported as the deficit.
+        /// </summary>
+        public static void SetGridSubstepping(int gridHandle, bool enabled, float maxCfl = 1f, int maxSubsteps = 8, float budgetMs = 0f)
+        {
+            Upf_SetGridSubstepping(gridHandle, enabled ? 1 : 0, maxCfl, maxSubsteps, budgetMs);
+        }
+
+        public static bool GetGridSubstepStats(int gridHandle, out SubstepStats stats)
+        {
+            return Upf_GetGridSubstepStats(gridHandle, out stats) == 0;
+        }
+
+        /// <summary>
+        /// Limit the solver's worker threads (0 = OpenMP default). Returns the count in effect.
+        /// </summary>
+        public static int SetThreadCount(int threads)
+        {
+            return Upf_SetThreadCount(threads);
+        }
+
+        public static bool GetGridStepTimings(int gridHandle, out StepTimings timings)
+        {
+            return Upf_GetGridStepTimings(gridHandle, out timings) == 0;
+        }
+
+        /// <summary>
+        /// Pin the latest published snapshot of a grid. The solver keeps stepping
+        /// into other buffers until the snapshot is released.
+        /// </summary>
+        public static bool AcquireGridSnapshot(int gridHandle, out GridSnapshot snapshot)
+        {
+            return Upf_AcquireGridSnapshot(gridHandle, out snapshot) == 0;
+        }
+
+        public static void ReleaseGridSnapshot(int gridHandle, ref GridSnapshot snapshot)
+        {
+            Upf_ReleaseGridSnapshot(gridHandle, ref snapshot);
+            snapshot = default;
+        }
+
+        /// <summary>
+        /// Version of the latest published snapshot (+1 per step), or -1 for an unknown grid.
+        /// </summary>
+        public static long GetGridSnapshotVersion(int gridHandle)
+        {
+            return Upf_GetGridSnapshotVersion(gridHandle);
+        }
+
+        /// <summary>
+        /// Box around the bricks of the latest snapshot changed since sinceVersion (-1 = everything).
+        /// </summary>
+        public static bool GetDirtyRegion(int gridHandle, long sinceVersion, out DirtyRegion region)
+        {
+            return Upf_GetDirtyRegion(gridHandle, sinceVersion, out region) == 0;
+        }
+
+        /// <summary>
+        /// Copy a box of the latest snapshot into caller-owned memory. R32F/R16F export density,
+        /// RGB32F/RGBA32F/RGBA16F velocity. Returns the bytes written, or a negative Upf error code.
+        /// </summary>
+        public static unsafe long ExportGridRegionInto<T>(int gridHandle, DirtyRegion region, NativeArray<T> dst, ExportFormat format) where T : struct
+        {
+            IntPtr ptr = (IntPtr)NativeArrayUnsafeUtility.GetUnsafePtr(dst);
+            return Upf_ExportGridRegionInto(gridHandle, ref region, ptr, (UIntPtr)(ulong)((long)dst.Length * UnsafeUtility.SizeOf<T>()), (int)format);
+        }
+
+        /// <summary>
+        /// Pack the 8x8x8 bricks changed since sinceVersion: indices into bricks, cells into dst
+        /// (formats as ExportGridRegionInto). Returns the brick count, or a negative Upf error code
+        /// (-3 if the arrays are too small).
+        /// </summary>
+        public static unsafe int ExportDirtyBricks<T>(int gridHandle, long sinceVersion, NativeArray<int> bricks, NativeArray<T> dst, ExportFormat format) where T : struct
+        {
+            IntPtr bricksPtr = (IntPtr)NativeArrayUnsafeUtility.GetUnsafePtr(bricks);
+            IntPtr ptr = (IntPtr)NativeArrayUnsafeUtility.GetUnsafePtr(dst);
+            return Upf_ExportDirtyBricks(gridHandle, sinceVersion, bricksPtr, bricks.Length, ptr, (UIntPtr)(ulong)((long)dst.Length * UnsafeUtility.SizeOf<T>()), (int)format);
+        }
+
+        /// <summary>
+        /// Sample the latest snapshot at world positions: each result is (vx, vy, vz, density),
+        /// trilinear between cell centers and zero outside the grid. Never waits for a step.
+        /// Returns the number of points sampled, or a negative Upf error code.
+        /// </summary>
+        public static unsafe int SampleGrid(int gridHandle, Vector3[] points, Vector4[] results, int count)
+        {
+            if (points == null || results == null) return -1;
+            count = Math.Min(count, Math.Min(points.Length, results.Length));
+            fixed (Vector3* p = points)
+            fixed (Vector4* r = results)
+            {
+                return Upf_SampleGrid(gridHandle, (IntPtr)p, count, (IntPtr)r);
+            }
+        }
+
+        /// <summary>
+        /// As SampleGrid, for NativeArrays (e.g. from a job gathering query points).
+        /// </summary>
+        public static unsafe int SampleGrid(int gridHandle, NativeArray<Vector3> points, NativeArray<Vector4> results)
+        {
+            IntPtr p = (IntPtr)NativeArrayUnsafeUtility.GetUnsafeReadOnlyPtr(points);
+            IntPtr r = (IntPtr)NativeArrayUnsafeUtility.GetUnsafePtr(results);
+            return Upf_SampleGrid(gridHandle, p, Math.Min(points.Length, results.Length), r);
+        }
+
+        /// <summary>
+        /// Save a grid's density, velocity, optional channels and overlapping emitters to a state file.
+        /// Returns the file size in bytes, or a negative error.
+        /// </summary>
+        public static long SaveGridState(int gridHandle, string path)
+        {
+            return Upf_SaveGridState(gridHandle, path);
+        }
+
+        /// <summary>
+        /// Load a saved state into a grid of the same resolution; the file is memory-mapped
+        /// and copied in place. If emitterHandles is given, the saved emitters are recreated
+        /// and their handles written into it. Returns the number of saved emitters, or a
+        /// negative error (-2 unreadable, -3 not a state file, -4 other version, -5 other size,
+        /// -6 Flow-backed or playback grid, -7 other cell size, -8 ring storage unavailable).
+        /// A scrolling grid's window is restored to where it was saved.
+        /// </summary>
+        public static int LoadGridState(int gridHandle, string path, int[] emitterHandles = null)
+        {
+            return Upf_LoadGridState(gridHandle, path, emitterHandles, emitterHandles != null ? emitterHandles.Length : 0);
+        }
+
+        /// <summary>
+        /// Record every step of a grid to a NanoVDB cache file (density and velocity
+        /// grids per frame). Returns 0, or a negative error (-2 file not writable, -3 scrolling
+        /// grid: frames carry no origin, so moving windows can't be recorded).
+        /// </summary>
+        public static int StartGridRecording(int gridHandle, string path)
+        {
+            return Upf_StartGridRecording(gridHandle, path);
+        }
+
+        /// <summary>
+        /// Finish a recording. Returns the number of frames written, or a negative error.
+        /// </summary>
+        public static int StopGridRecording(int gridHandle)
+        {
+            return Upf_StopGridRecording(gridHandle);
+        }
+
+        /// <summary>
+        /// Create a grid that plays a recorded cache back instead of simulating; stepping
+        /// it advances playback time. Returns a handle, or -1 if the bridge is not
+        /// initialized or the cache can't be read.
+        /// </summary>
+        public static int CreatePlaybackGrid(string path, bool loop)
+        {
+            return Upf_CreatePlaybackGrid(path, loop ? 1 : 0);
+        }
+
+        /// <summary>
+        /// Jump a playback grid to a time in seconds. Returns the frame shown, or a negative error.
+        /// </summary>
+        public static int SeekGridPlayback(int gridHandle, float seconds)
+        {
+            return Upf_SeekGridPlayback(gridHandle, seconds);
+        }
+
+        /// <summary>
+        /// Frame count, duration and position of a playback grid. Returns false for other grids.
+        /// </summary>
+        public static bool GetGridPlaybackInfo(int gridHandle, out PlaybackInfo info)
+        {
+            return Upf_GetGridPlaybackInfo(gridHandle, out info) == 0;
+        }
+
+        /// <summary>
+        /// Resample a grid to a level of detail (level n halves its resolution n times)
+        /// keeping its smoke. Returns the level in effect, or a negative error for
+        /// Flow-backed, playback and recording grids.
+        /// </summary>
+        public static int SetGridLod(int gridHandle, int level)
+        {
+            return Upf_SetGridLod(gridHandle, level);
+        }
+
+        /// <summary>
+        /// Current level, size and cell size of a grid. Returns false if the grid is unknown.
+        /// </summary>
+        public static bool GetGridLod(int gridHandle, out GridLod lod)
+        {
+            return Upf_GetGridLod(gridHandle, out lod) == 0;
+        }
+
+        /// <summary>
+        /// Turn a grid into a moving window centered on a world position (snapped to whole
+        /// cells); each step scrolls it there, clearing only the cells it moves onto.
+        /// Returns 0, or a negative error for Flow-backed, playback and recording grids.
+        /// </summary>
+        public static int SetGridOrigin(int gridHandle, Vector3 origin)
+        {
+            return Upf_SetGridOrigin(gridHandle, origin.x, origin.y, origin.z);
+        }
+
+        /// <summary>
+        /// World-space center of the grid's latest snapshot. Returns false if the grid is unknown.
+        /// </summary>
+        public static bool GetGridOrigin(int gridHandle, out Vector3 origin)
+        {
+            return Upf_GetGridOrigin(gridHandle, out origin) == 0;
+        }
+
+        /// <summary>
+        /// Most live plus queued tracers the grid keeps; spawns past it are dropped.
+        /// Returns the capacity in effect, or -1 for an unknown grid.
+        /// </summary>
+        public static int SetTracerCapacity(int gridHandle, int capacity)
+        {
+            return Upf_SetTracerCapacity(gridHandle, capacity);
+        }
+
+        /// <summary>
+        /// Queue tracers at world positions; they start riding the grid's velocity on the next
+        /// step and die after lifetime seconds or on leaving the grid. Returns how many fit.
+        /// </summary>
+        public static int SpawnTracers(int gridHandle, Vector3[] positions, int count, float lifetime)
+        {
+            if (positions == null) return 0;
+            return Upf_SpawnTracers(gridHandle, positions, Math.Min(count, positions.Length), lifetime);
+        }
+
+        /// <summary>
+        /// Drop all live and queued tracers of a grid.
+        /// </summary>
+        public static bool ClearTracers(int gridHandle)
+        {
+            return Upf_ClearTracers(gridHandle) == 0;
+        }
+
+        /// <summary>
+        /// Tracers published by the grid's last step, or -1 for an unknown grid.
+        /// </summary>
+        public static int GetTracerCount(int gridHandle)
+        {
+            return Upf_GetTracerCount(gridHandle);
+        }
+
+        /// <summary>
+        /// Copy the last step's tracers into caller-owned memory (e.g. a NativeArray&lt;Vector4&gt;
+        /// for ComputeBuffer.SetData), one float4 each: world position and age / lifetime.
+        /// Returns the number copied, or -1.
+        /// </summary>
+        public static unsafe int ExportTracersInto<T>(int gridHandle, NativeArray<T> dst) where T : struct
+        {
+            IntPtr ptr = (IntPtr)NativeArrayUnsafeUtility.GetUnsafePtr(dst);
+            long maxCount = (long)dst.Length * UnsafeUtility.SizeOf<T>() / (4 * sizeof(float));
+            return Upf_ExportTracers(gridHandle, ptr, (int)Math.Min(maxCount, int.MaxValue));
+        }
+
+        /// <summary>
+        /// Export density data as raw float array
+        /// </summary>
+        public static float[] ExportGridDensity(int gridHandle)
+        {
+            IntPtr dataPtr = Upf_ExportGridDensity(gridHandle, out int sizeX, out int sizeY, out int sizeZ, out int format);
+            if (dataPtr == IntPtr.Zero) return null;
+
+            int totalCells = sizeX * sizeY * sizeZ;
+            float[] densityData = new float[totalCells];
+            Marshal.Copy(dataPtr, densityData, 0, totalCells);
+            return densityData;
+        }
+
+        /// <summary>
+        /// Export velocity data as raw float array (3 floats per cell: vx, vy, vz)
+        /// </summary>
+        public static float[] ExportGridVelocity(int gridHandle)
+        {
+            IntPtr dataPtr = Upf_ExportGridVelocity(gridHandle, out int sizeX, out int sizeY, out int sizeZ, out int format);
+            if (dataPtr == IntPtr.Zero) return null;
 
             int totalCells = sizeX * sizeY * sizeZ;
             float[] velocityData = new float[totalCells * 3]; // 3 components per cell
@@ -202,54 +1215,182 @@ public static float[] ExportGridVelocity(int gridHandle)
             return velocityData;
         }
 
+        /// <summary>
+        /// Copy the latest density into caller-owned memory (e.g. a NativeArray) without allocating.
+        /// Returns the bytes written, or a negative Upf error code.
+        /// </summary>
+        public static unsafe long ExportGridDensityInto<T>(int gridHandle, NativeArray<T> dst, ExportFormat format = ExportFormat.R32F) where T : struct
+        {
+            IntPtr ptr = (IntPtr)NativeArrayUnsafeUtility.GetUnsafePtr(dst);
+            return Upf_ExportGridDensityInto(gridHandle, ptr, (UIntPtr)(ulong)((long)dst.Length * UnsafeUtility.SizeOf<T>()), (int)format);
+        }
+
+        /// <summary>
+        /// Copy the latest velocity into caller-owned memory without allocating.
+        /// Returns the bytes written, or a negative Upf error code.
+        /// </summary>
+        public static unsafe long ExportGridVelocityInto<T>(int gridHandle, NativeArray<T> dst, ExportFormat format = ExportFormat.RGBA32F) where T : struct
+        {
+            IntPtr ptr = (IntPtr)NativeArrayUnsafeUtility.GetUnsafePtr(dst);
+            return Upf_ExportGridVelocityInto(gridHandle, ptr, (UIntPtr)(ulong)((long)dst.Length * UnsafeUtility.SizeOf<T>()), (int)format);
+        }
+
+        /// <summary>
+        /// Copy the latest density into caller-owned memory, quantized over the density range for the
+        /// UNORM formats. outMin/outMax receive that range (decode: min + v * (max - min)).
+        /// Returns the bytes written, or a negative Upf error code.
+        /// </summary>
+        public static unsafe long ExportGridDensityIntoScaled<T>(int gridHandle, NativeArray<T> dst, ExportFormat format, out float outMin, out float outMax) where T : struct
+        {
+            IntPtr ptr = (IntPtr)NativeArrayUnsafeUtility.GetUnsafePtr(dst);
+            return Upf_ExportGridDensityIntoScaled(gridHandle, ptr, (UIntPtr)(ulong)((long)dst.Length * UnsafeUtility.SizeOf<T>()), (int)format, out outMin, out outMax);
+        }
+
+        /// <summary>
+        /// As ExportGridDensityIntoScaled for one optional channel (a single GridChannels flag).
+        /// Returns -1 also if the grid does not have the channel.
+        /// </summary>
+        public static unsafe long ExportGridChannelInto<T>(int gridHandle, GridChannels channel, NativeArray<T> dst, ExportFormat format, out float outMin, out float outMax) where T : struct
+        {
+            IntPtr ptr = (IntPtr)NativeArrayUnsafeUtility.GetUnsafePtr(dst);
+            return Upf_ExportGridChannelInto(gridHandle, (int)channel, ptr, (UIntPtr)(ulong)((long)dst.Length * UnsafeUtility.SizeOf<T>()), (int)format, out outMin, out outMax);
+        }
+
+        /// <summary>
+        /// Export format matching a density texture, or -1 if the texture format is not supported.
+        /// </summary>
+        private static int DensityExportFormat(TextureFormat textureFormat)
+        {
+            switch (textureFormat)
+            {
+                case TextureFormat.RFloat: return (int)ExportFormat.R32F;
+                case TextureFormat.RHalf: return (int)ExportFormat.R16F;
+                case TextureFormat.R8: return (int)ExportFormat.R8_UNORM;
+                case TextureFormat.BC4: return (int)ExportFormat.BC4_UNORM;
+                default: return -1;
+            }
+        }
+
+        /// <summary>
+        /// Export format matching a velocity texture, or -1 if the texture format is not supported.
+        /// </summary>
+        private static int VelocityExportFormat(TextureFormat textureFormat)
+        {
+            switch (textureFormat)
+            {
+                case TextureFormat.RGBAFloat: return (int)ExportFormat.RGBA32F;
+                case TextureFormat.RGBAHalf: return (int)ExportFormat.RGBA16F;
+                default: return -1;
+            }
+        }
+
+        /// <summary>
+        /// Write the latest density straight into a persistent texture's pixel data (one native
+        /// pass, no managed allocations) and upload it. RFloat, RHalf, R8 and BC4 textures are supported.
+        /// </summary>
+        public static bool ExportGridDensityInto(int gridHandle, Texture3D texture)
+        {
+            return ExportGridDensityInto(gridHandle, texture, out _, out _);
+        }
+
+        /// <summary>
+        /// As ExportGridDensityInto; min/max receive the range R8 and BC4 textures are quantized over
+        /// ((0, 1) for float formats). Shaders decode with min + tex * (max - min).
+        /// </summary>
+        public static bool ExportGridDensityInto(int gridHandle, Texture3D texture, out float min, out float max)
+        {
+            min = 0f;
+            max = 1f;
+            if (texture == null) return false;
+            int format = DensityExportFormat(texture.format);
+            if (format < 0) return false;
+
+            NativeArray<byte> pixels = texture.GetPixelData<byte>(0);
+            if (format == (int)ExportFormat.R8_UNORM || format == (int)ExportFormat.BC4_UNORM)
+            {
+                if (ExportGridDensityIntoScaled(gridHandle, pixels, (ExportFormat)format, out min, out max) <= 0) return false;
+            }
+            else if (ExportGridDensityInto(gridHandle, pixels, (ExportFormat)format) <= 0)
+            {
+                return false;
+            }
+            texture.Apply(false);
+            return true;
+        }
+
+        /// <summary>
+        /// Write the latest velocity straight into a persistent RGBAFloat or RGBAHalf texture's
+        /// pixel data (one native pass, no managed allocations) and upload it.
+        /// </summary>
+        public static bool ExportGridVelocityInto(int gridHandle, Texture3D texture)
+        {
+            if (texture == null) return false;
+            int format = VelocityExportFormat(texture.format);
+            if (format < 0) return false;
+            if (ExportGridVelocityInto(gridHandle, texture.GetPixelData<byte>(0), (ExportFormat)format) <= 0) return false;
+            texture.Apply(false);
+            return true;
+        }
+
+        /// <summary>
+        /// Update only a region of a persistent density (RFloat, RHalf) or velocity (RGBAFloat,
+        /// RGBAHalf) texture: the region is exported into staging (created or resized to fit), uploaded,
+        /// and copied into the texture on the GPU one slice at a time. Needs Copy3D support.
+        /// </summary>
+        public static bool ExportGridRegionInto(int gridHandle, DirtyRegion region, Texture3D texture, ref Texture3D staging)
+        {
+            if (texture == null) return false;
+            int format = DensityExportFormat(texture.format);
+            if (format != (int)ExportFormat.R32F && format != (int)ExportFormat.R16F) format = VelocityExportFormat(texture.format);
+            if (format < 0) return false;
+            if (region.sizeX <= 0 || region.sizeY <= 0 || region.sizeZ <= 0) return true;
+
+            if (staging == null || staging.format != texture.format ||
+                staging.width != region.sizeX || staging.height != region.sizeY || staging.depth != region.sizeZ)
+            {
+                if (staging != null) UnityEngine.Object.Destroy(staging);
+                staging = new Texture3D(region.sizeX, region.sizeY, region.sizeZ, texture.format, false);
+            }
+            if (ExportGridRegionInto(gridHandle, region, staging.GetPixelData<byte>(0), (ExportFormat)format) <= 0) return false;
+            staging.Apply(false);
+            for (int z = 0; z < region.sizeZ; z++)
+            {
+                Graphics.CopyTexture(staging, z, 0, 0, 0, region.sizeX, region.sizeY, texture, region.z + z, 0, region.x, region.y);
+            }
+            return true;
+        }
+
+        /// <summary>
+        /// Export density as a new Texture3D. Allocates a texture per call; prefer
+        /// ExportGridDensityInto with a persistent texture for per-frame updates.
+        /// </summary>
         public static Texture3D ExportGridDensityAsTexture3D(int gridHandle)
         {
-            IntPtr dataPtr = Upf_ExportGridDensity(gridHandle, out int sizeX, out int sizeY, out int sizeZ, out int format);
-            if (dataPtr == IntPtr.Zero) return null;
+            if (Upf_ExportGridDensity(gridHandle, out int sizeX, out int sizeY, out int sizeZ, out int format) == IntPtr.Zero) return null;
 
-            // Format 0 = float32
             Texture3D tex = new Texture3D(sizeX, sizeY, sizeZ, TextureFormat.RFloat, false);
-            int dataSize = sizeX * sizeY * sizeZ * sizeof(float);
-            byte[] data = new byte[dataSize];
-            Marshal.Copy(dataPtr, data, 0, dataSize);
-
-            // Convert byte[] to float[] and load into texture
-            float[] floatData = new float[sizeX * sizeY * sizeZ];
-            Buffer.BlockCopy(data, 0, floatData, 0, dataSize);
-            
-            // Unity Texture3D expects color data; we'll pack float into RFloat format
-            Color[] colors = new Color[floatData.Length];
-            for (int i = 0; i < floatData.Length; i++)
+            if (!ExportGridDensityInto(gridHandle, tex))
             {
-                colors[i] = new Color(floatData[i], 0, 0, 0);
+                UnityEngine.Object.Destroy(tex);
+                return null;
             }
-            tex.SetPixels(colors);
-            tex.Apply();
             return tex;
         }
 
+        /// <summary>
+        /// Export velocity as a new RGBAFloat Texture3D. Allocates a texture per call; prefer
+        /// ExportGridVelocityInto with a persistent texture for per-frame updates.
+        /// </summary>
         public static Texture3D ExportGridVelocityAsTexture3D(int gridHandle)
         {
-            IntPtr dataPtr = Upf_ExportGridVelocity(gridHandle, out int sizeX, out int sizeY, out int sizeZ, out int format);
-            if (dataPtr == IntPtr.Zero) return null;
+            if (Upf_ExportGridVelocity(gridHandle, out int sizeX, out int sizeY, out int sizeZ, out int format) == IntPtr.Zero) return null;
 
-            // Format 1 = float32x3 (vec3)
             Texture3D tex = new Texture3D(sizeX, sizeY, sizeZ, TextureFormat.RGBAFloat, false);
-            int dataSize = sizeX * sizeY * sizeZ * 3 * sizeof(float);
-            byte[] data = new byte[dataSize];
-            Marshal.Copy(dataPtr, data, 0, dataSize);
-
-            float[] floatData = new float[sizeX * sizeY * sizeZ * 3];
-            Buffer.BlockCopy(data, 0, floatData, 0, dataSize);
-
-            Color[] colors = new Color[sizeX * sizeY * sizeZ];
-            for (int i = 0; i < colors.Length; i++)
+            if (!ExportGridVelocityInto(gridHandle, tex))
             {
-                int idx = i * 3;
-                colors[i] = new Color(floatData[idx], floatData[idx + 1], floatData[idx + 2], 0);
+                UnityEngine.Object.Destroy(tex);
+                return null;
             }
-            tex.SetPixels(colors);
-            tex.Apply();
             return tex;
         }
     }
@@ -278,6 +1419,7 @@ public static void Enqueue(Action a)
 
         private void Update()
         {
+            UnityPhysXFlow.PumpEvents();
             while (_queue.TryDequeue(out var a))
             {
                 try { a(); } catch (Exception e) { Debug.LogException(e); }
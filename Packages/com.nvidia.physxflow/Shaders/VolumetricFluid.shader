@@ -5,6 +5,7 @@ Shader "PhysXFlow/VolumetricFluid"
         _DensityTex ("Density Texture", 3D) = "white" {}
         _VelocityTex ("Velocity Texture", 3D) = "white" {}
         _DensityScale ("Density Scale", Float) = 1.0
+        _DensityDecode ("Density Decode (min, range)", Vector) = (0, 1, 0, 0)
         _Color ("Fluid Color", Color) = (0.2, 0.5, 1.0, 1.0)
         _StepSize ("Ray Step Size", Float) = 0.01
         _MaxSteps ("Max Ray Steps", Int) = 128
@@ -42,6 +43,7 @@ Shader "PhysXFlow/VolumetricFluid"
             sampler3D _DensityTex;
             sampler3D _VelocityTex;
             float _DensityScale;
+            float4 _DensityDecode; // quantized textures: density = x + tex * y
             float4 _Color;
             float _StepSize;
             int _MaxSteps;
@@ -81,7 +83,7 @@ Shader "PhysXFlow/VolumetricFluid"
                         break;
 
                     // Sample density
-                    float density = tex3D(_DensityTex, rayPos).r * _DensityScale;
+                    float density = (_DensityDecode.x + tex3D(_DensityTex, rayPos).r * _DensityDecode.y) * _DensityScale;
 
                     if (density > 0.001)
                     {
@@ -5,6 +5,7 @@ Shader "PhysXFlow/VolumetricFluidNVIDIA"
         _DensityTex ("Density Texture", 3D) = "white" {}
         _VelocityTex ("Velocity Texture", 3D) = "white" {}
         _DensityScale ("Density Scale", Float) = 1.0
+        _DensityDecode ("Density Decode (min, range)", Vector) = (0, 1, 0, 0)
         _Color ("Fluid Color", Color) = (0.2, 0.5, 1.0, 1.0)
         _StepSize ("Ray Step Size", Float) = 0.01
         _MaxSteps ("Max Ray Steps", Int) = 128
@@ -55,6 +56,7 @@ Shader "PhysXFlow/VolumetricFluidNVIDIA"
             sampler3D _DensityTex;
             sampler3D _VelocityTex;
             float _DensityScale;
+            float4 _DensityDecode; // quantized textures: density = x + tex * y
             float4 _Color;
             float _StepSize;
             int _MaxSteps;
@@ -124,6 +126,7 @@ Shader "PhysXFlow/VolumetricFluidNVIDIA"
                     _StepSize,
                     _MaxSteps,
                     _DensityScale,
+                    _DensityDecode.xy,
                     _Color,
                     _AbsorptionScale
                 );
@@ -0,0 +1,384 @@
+// Headless benchmark for the bridge solver: steps grids of several sizes with
+// N emitters for K steps across a sweep of thread counts, and reports ms/step,
+// cells/s, per-stage times and peak RSS as JSON or CSV. Before timing, it checks
+// that Upf_SampleGrid reads an emitter's density back at the emitter.
+//
+//   bench_unity_physx_flow [--sizes 32,64,128,256] [--emitters 8] [--steps 100]
+//                          [--warmup 10] [--threads 1,2,4] [--dt 0.016]
+//                          [--api none|cpu|vulkan] [--simd 0|1|2] [--staged]
+//                          [--dense] [--projection] [--advection sl|maccormack|bfecc]
+//                          [--obstacles 0] [--tracers 0] [--fire] [--format json|csv] [--out file]
+
+#include "UnityPhysXFlow.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+struct BenchOptions {
+    std::vector<int> sizes = { 32, 64, 128, 256 };
+    std::vector<int> threads;       // empty: 1, 2, 4, ... up to the core count
+    int emitters = 8;
+    int steps = 100;
+    int warmup = 10;
+    float dt = 0.016f;
+    int api = UpfContextApi_None;
+    int simd = -1;                  // -1: best the CPU supports
+    bool staged = false;            // unfused passes, for the buoyancy/clamp breakdown
+    bool dense = false;
+    bool projection = false;
+    int advection = UpfAdvection_SemiLagrangian;
+    int obstacles = 0;
+    int tracers = 0;                // kept topped up, spawned over the grid's lower half
+    bool fire = false;              // all optional channels, emitters hot and fueled
+    bool csv = false;
+    std::string out;
+};
+
+struct BenchResult {
+    int size = 0;
+    int threads = 0;
+    int simd = 0;
+    double msPerStep = 0.0, msMin = 0.0, msMedian = 0.0, msMax = 0.0;
+    double cellsPerSecond = 0.0;
+    UpfStepTimings stages = {};     // mean over the measured steps
+    int activeBricks = 0;
+    double peakRssMb = 0.0;
+};
+
+static double peakRssMb()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return pmc.PeakWorkingSetSize / (1024.0 * 1024.0);
+    return 0.0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0.0;
+#ifdef __APPLE__
+    return usage.ru_maxrss / (1024.0 * 1024.0);   // bytes
+#else
+    return usage.ru_maxrss / 1024.0;              // kilobytes
+#endif
+#endif
+}
+
+static std::vector<int> parseList(const char* s)
+{
+    std::vector<int> values;
+    while (*s) {
+        char* end = nullptr;
+        const long v = std::strtol(s, &end, 10);
+        if (end == s) break;
+        if (v > 0) values.push_back((int)v);
+        s = (*end == ',') ? end + 1 : end;
+    }
+    return values;
+}
+
+static int parseApi(const char* s)
+{
+    if (!std::strcmp(s, "cpu")) return UpfContextApi_CPU;
+    if (!std::strcmp(s, "vulkan")) return UpfContextApi_Vulkan;
+    if (!std::strcmp(s, "d3d12")) return UpfContextApi_D3D12;
+    return UpfContextApi_None;
+}
+
+static int parseAdvection(const char* v)
+{
+    if (!std::strcmp(v, "maccormack")) return UpfAdvection_MacCormack;
+    if (!std::strcmp(v, "bfecc")) return UpfAdvection_BFECC;
+    return UpfAdvection_SemiLagrangian;
+}
+
+static bool parseArgs(int argc, char** argv, BenchOptions& o)
+{
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        const char* v = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        bool usedValue = true;
+        if (!std::strcmp(a, "--sizes") && v) o.sizes = parseList(v);
+        else if (!std::strcmp(a, "--threads") && v) o.threads = parseList(v);
+        else if (!std::strcmp(a, "--emitters") && v) o.emitters = std::max(0, std::atoi(v));
+        else if (!std::strcmp(a, "--steps") && v) o.steps = std::max(1, std::atoi(v));
+        else if (!std::strcmp(a, "--warmup") && v) o.warmup = std::max(0, std::atoi(v));
+        else if (!std::strcmp(a, "--dt") && v) o.dt = (float)std::atof(v);
+        else if (!std::strcmp(a, "--api") && v) o.api = parseApi(v);
+        else if (!std::strcmp(a, "--simd") && v) o.simd = std::atoi(v);
+        else if (!std::strcmp(a, "--advection") && v) o.advection = parseAdvection(v);
+        else if (!std::strcmp(a, "--obstacles") && v) o.obstacles = std::atoi(v);
+        else if (!std::strcmp(a, "--tracers") && v) o.tracers = std::max(0, std::atoi(v));
+        else if (!std::strcmp(a, "--format") && v) o.csv = !std::strcmp(v, "csv");
+        else if (!std::strcmp(a, "--out") && v) o.out = v;
+        else {
+            usedValue = false;
+            if (!std::strcmp(a, "--staged")) o.staged = true;
+            else if (!std::strcmp(a, "--dense")) o.dense = true;
+            else if (!std::strcmp(a, "--projection")) o.projection = true;
+            else if (!std::strcmp(a, "--fire")) o.fire = true;
+            else {
+                std::fprintf(stderr, "unknown or incomplete option: %s\n", a);
+                return false;
+            }
+        }
+        if (usedValue) i++;
+    }
+    if (o.threads.empty()) {
+        const int cores = (int)std::max(1u, std::thread::hardware_concurrency());
+        for (int t = 1; t < cores; t *= 2) o.threads.push_back(t);
+        o.threads.push_back(cores);
+    }
+    return !o.sizes.empty();
+}
+
+// Deterministic emitter layout: spheres scattered over the lower half of the
+// grid, so the plume rises through most of it.
+static std::vector<int32_t> createEmitters(int count, int size, float cellSize, bool fire)
+{
+    std::vector<int32_t> handles;
+    const float half = size * cellSize * 0.5f;
+    const float radius = std::max(2.0f * cellSize, half * 0.08f);
+    uint32_t seed = 12345u;
+    auto next = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) * (1.0f / 16777216.0f);
+    };
+    for (int i = 0; i < count; i++) {
+        const float x = (next() * 1.6f - 0.8f) * half;
+        const float y = (next() * 0.6f - 0.8f) * half;
+        const float z = (next() * 1.6f - 0.8f) * half;
+        const int32_t h = Upf_CreateEmitter(x, y, z, radius, 1.0f);
+        if (h < 0) continue;
+        if (fire) Upf_SetEmitterChannels(h, 1.0f, 2.0f, 0.0f);
+        handles.push_back(h);
+    }
+    return handles;
+}
+
+// Box and sphere obstacles alternating in the upper half, in the plume's way.
+static std::vector<int32_t> createObstacles(int count, int size, float cellSize)
+{
+    std::vector<int32_t> handles;
+    const float half = size * cellSize * 0.5f;
+    uint32_t seed = 54321u;
+    auto next = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) * (1.0f / 16777216.0f);
+    };
+    for (int i = 0; i < count; i++) {
+        UpfObstacleDesc d = {};
+        d.type = (i & 1) ? UpfObstacle_Sphere : UpfObstacle_Box;
+        d.px = (next() * 1.6f - 0.8f) * half;
+        d.py = (next() * 0.6f + 0.1f) * half;
+        d.pz = (next() * 1.6f - 0.8f) * half;
+        d.qw = 1.0f;
+        d.sx = half * 0.15f; d.sy = half * 0.04f; d.sz = half * 0.15f;
+        const int32_t h = Upf_CreateObstacle(&d);
+        if (h >= 0) handles.push_back(h);
+    }
+    return handles;
+}
+
+// Refill the grid's tracers up to count at random points in its lower half.
+static void topUpTracers(int32_t grid, int count, int size, float cellSize, uint32_t& seed)
+{
+    const int missing = count - std::max(0, Upf_GetTracerCount(grid));
+    if (missing <= 0) return;
+    const float half = size * cellSize * 0.5f;
+    auto next = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) * (1.0f / 16777216.0f);
+    };
+    std::vector<float> positions((size_t)missing * 3);
+    for (int i = 0; i < missing; i++) {
+        positions[i * 3 + 0] = (next() * 1.8f - 0.9f) * half;
+        positions[i * 3 + 1] = (next() * 0.9f - 0.9f) * half;
+        positions[i * 3 + 2] = (next() * 1.8f - 0.9f) * half;
+    }
+    Upf_SpawnTracers(grid, positions.data(), missing, 2.0f);
+}
+
+// Emit one step from a single emitter centered on a cell and sample around it:
+// the density must peak at the emitter and fall off evenly on either side, or
+// emission and sampling disagree on where cells are.
+static bool checkEmitterSampling()
+{
+    const float cellSize = 0.1f;
+    const int32_t grid = Upf_CreateGrid(32, 32, 32, cellSize);
+    if (grid < 0) return false;
+    if (Upf_GetGridBackend(grid) != UpfGridBackend_Builtin) {
+        Upf_DestroyGrid(grid);
+        return true;
+    }
+    const float e[3] = { 0.5f * cellSize, -7.5f * cellSize, 0.5f * cellSize };
+    const int32_t emitter = Upf_CreateEmitter(e[0], e[1], e[2], 3.0f * cellSize, 1.0f);
+    Upf_StepGrid(grid, 0.016f);
+
+    const float h = 0.5f * cellSize;
+    const float points[5 * 3] = { e[0], e[1], e[2],
+                                  e[0] - h, e[1], e[2],  e[0] + h, e[1], e[2],
+                                  e[0], e[1], e[2] - h,  e[0], e[1], e[2] + h };
+    float out[5 * 4] = {};
+    const bool sampled = Upf_SampleGrid(grid, points, 5, out) == 5;
+    Upf_DestroyEmitter(emitter);
+    Upf_DestroyGrid(grid);
+
+    const float at = out[3], xLo = out[7], xHi = out[11], zLo = out[15], zHi = out[19];
+    const float tolerance = at * 1e-3f;
+    return sampled && at > 0.0f && at >= std::max(std::max(xLo, xHi), std::max(zLo, zHi)) &&
+           std::abs(xLo - xHi) <= tolerance && std::abs(zLo - zHi) <= tolerance;
+}
+
+static bool runCase(const BenchOptions& o, int size, int threads, BenchResult& r)
+{
+    const float cellSize = 0.1f;
+    r.size = size;
+    r.threads = Upf_SetThreadCount(threads);
+    r.simd = Upf_SetSimdLevel(o.simd >= 0 ? o.simd : 2);
+
+    const uint32_t channels = o.fire ? (UpfChannel_Temperature | UpfChannel_Fuel | UpfChannel_Burn | UpfChannel_Smoke) : 0u;
+    const int32_t grid = Upf_CreateGridWithChannels(size, size, size, cellSize, channels);
+    if (grid < 0) return false;
+    Upf_SetGridFusedStep(grid, o.staged ? 0 : 1);
+    Upf_SetGridSparse(grid, o.dense ? 0 : 1);
+    Upf_SetGridProjection(grid, o.projection ? 1 : 0, 4, 0.0f, 1e-3f);
+    Upf_SetGridAdvection(grid, o.advection);
+    std::vector<int32_t> emitters = createEmitters(o.emitters, size, cellSize, o.fire);
+    std::vector<int32_t> obstacles = createObstacles(o.obstacles, size, cellSize);
+    Upf_SetTracerCapacity(grid, o.tracers);
+    uint32_t tracerSeed = 777u;
+
+    for (int i = 0; i < o.warmup; i++) {
+        topUpTracers(grid, o.tracers, size, cellSize, tracerSeed);
+        Upf_StepGrid(grid, o.dt);
+    }
+
+    std::vector<double> ms;
+    ms.reserve(o.steps);
+    UpfStepTimings sum = {};
+    for (int i = 0; i < o.steps; i++) {
+        topUpTracers(grid, o.tracers, size, cellSize, tracerSeed);
+        const auto t0 = std::chrono::steady_clock::now();
+        Upf_StepGrid(grid, o.dt);
+        const auto t1 = std::chrono::steady_clock::now();
+        ms.push_back(std::chrono::duration<double, std::milli>(t1 - t0).count());
+
+        UpfStepTimings t;
+        if (Upf_GetGridStepTimings(grid, &t) == 0) {
+            sum.emitMs += t.emitMs; sum.advectMs += t.advectMs; sum.buoyancyMs += t.buoyancyMs;
+            sum.clampMs += t.clampMs; sum.projectMs += t.projectMs; sum.publishMs += t.publishMs;
+            sum.tracerMs += t.tracerMs; sum.totalMs += t.totalMs;
+        }
+    }
+    r.activeBricks = Upf_GetGridActiveBrickCount(grid);
+
+    const float inv = 1.0f / o.steps;
+    r.stages = { sum.emitMs * inv, sum.advectMs * inv, sum.buoyancyMs * inv, sum.clampMs * inv,
+                 sum.projectMs * inv, sum.publishMs * inv, sum.tracerMs * inv, sum.totalMs * inv };
+    double total = 0.0;
+    for (double v : ms) total += v;
+    std::sort(ms.begin(), ms.end());
+    r.msPerStep = total / ms.size();
+    r.msMin = ms.front();
+    r.msMedian = ms[ms.size() / 2];
+    r.msMax = ms.back();
+    r.cellsPerSecond = r.msPerStep > 0.0 ? (double)size * size * size / (r.msPerStep * 1e-3) : 0.0;
+    r.peakRssMb = peakRssMb();
+
+    for (int32_t h : emitters) Upf_DestroyEmitter(h);
+    for (int32_t h : obstacles) Upf_DestroyObstacle(h);
+    Upf_DestroyGrid(grid);
+    return true;
+}
+
+static void writeCsv(FILE* f, const std::vector<BenchResult>& results)
+{
+    std::fprintf(f, "size,threads,simd,ms_per_step,ms_min,ms_median,ms_max,cells_per_s,"
+                    "emit_ms,advect_ms,buoyancy_ms,clamp_ms,project_ms,publish_ms,tracer_ms,active_bricks,peak_rss_mb\n");
+    for (const BenchResult& r : results) {
+        std::fprintf(f, "%d,%d,%d,%.4f,%.4f,%.4f,%.4f,%.0f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%d,%.1f\n",
+                     r.size, r.threads, r.simd, r.msPerStep, r.msMin, r.msMedian, r.msMax, r.cellsPerSecond,
+                     r.stages.emitMs, r.stages.advectMs, r.stages.buoyancyMs, r.stages.clampMs,
+                     r.stages.projectMs, r.stages.publishMs, r.stages.tracerMs, r.activeBricks, r.peakRssMb);
+    }
+}
+
+static void writeJson(FILE* f, const BenchOptions& o, const std::vector<BenchResult>& results)
+{
+    std::fprintf(f, "{\n  \"emitters\": %d, \"steps\": %d, \"warmup\": %d, \"dt\": %g, \"api\": %d,\n"
+                    "  \"staged\": %s, \"sparse\": %s, \"projection\": %s, \"advection\": %d, \"obstacles\": %d, \"tracers\": %d,\n"
+                    "  \"fire\": %s,\n  \"results\": [\n",
+                 o.emitters, o.steps, o.warmup, o.dt, o.api,
+                 o.staged ? "true" : "false", o.dense ? "false" : "true", o.projection ? "true" : "false", o.advection, o.obstacles,
+                 o.tracers, o.fire ? "true" : "false");
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        std::fprintf(f, "    { \"size\": %d, \"threads\": %d, \"simd\": %d, \"msPerStep\": %.4f, \"msMin\": %.4f, "
+                        "\"msMedian\": %.4f, \"msMax\": %.4f, \"cellsPerSecond\": %.0f,\n"
+                        "      \"stages\": { \"emitMs\": %.4f, \"advectMs\": %.4f, \"buoyancyMs\": %.4f, "
+                        "\"clampMs\": %.4f, \"projectMs\": %.4f, \"publishMs\": %.4f, \"tracerMs\": %.4f },\n"
+                        "      \"activeBricks\": %d, \"peakRssMb\": %.1f }%s\n",
+                     r.size, r.threads, r.simd, r.msPerStep, r.msMin, r.msMedian, r.msMax, r.cellsPerSecond,
+                     r.stages.emitMs, r.stages.advectMs, r.stages.buoyancyMs, r.stages.clampMs,
+                     r.stages.projectMs, r.stages.publishMs, r.stages.tracerMs, r.activeBricks, r.peakRssMb,
+                     i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(f, "  ]\n}\n");
+}
+
+int main(int argc, char** argv)
+{
+    BenchOptions o;
+    if (!parseArgs(argc, argv, o)) return 2;
+
+    const int32_t init = Upf_InitWithApi(o.api, 0);
+    if (init != 0) {
+        std::fprintf(stderr, "Upf_InitWithApi(%d) failed: %d\n", o.api, init);
+        return 1;
+    }
+    if (!checkEmitterSampling()) {
+        std::fprintf(stderr, "sampling at an emitter does not return its density\n");
+        Upf_Shutdown();
+        return 1;
+    }
+
+    std::vector<BenchResult> results;
+    for (int size : o.sizes) {
+        for (int threads : o.threads) {
+            BenchResult r;
+            if (!runCase(o, size, threads, r)) {
+                std::fprintf(stderr, "grid %d^3 failed\n", size);
+                continue;
+            }
+            std::fprintf(stderr, "%4d^3  %2d threads  %9.3f ms/step  %8.1f Mcells/s\n",
+                         size, r.threads, r.msPerStep, r.cellsPerSecond * 1e-6);
+            results.push_back(r);
+        }
+    }
+    Upf_Shutdown();
+
+    FILE* f = o.out.empty() ? stdout : std::fopen(o.out.c_str(), "w");
+    if (!f) {
+        std::fprintf(stderr, "cannot write %s\n", o.out.c_str());
+        return 1;
+    }
+    if (o.csv) writeCsv(f, results);
+    else writeJson(f, o, results);
+    if (f != stdout) std::fclose(f);
+    return 0;
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef _WIN32
@@ -16,13 +17,221 @@
 extern "C" {
 #endif
 
+// Immutable, versioned copy of a grid's fields published after each step.
+typedef struct UpfGridSnapshot {
+    const float* density;   // sizeX*sizeY*sizeZ floats
+    const float* velocity;  // sizeX*sizeY*sizeZ*3 floats (vx, vy, vz)
+    int32_t sizeX, sizeY, sizeZ;
+    int32_t slot;           // ring slot, used by Upf_ReleaseGridSnapshot
+    int64_t version;        // 0 at grid creation, +1 per step
+} UpfGridSnapshot;
+
+// Cells of a snapshot that changed since an earlier one (Upf_GetDirtyRegion):
+// the box around the changed 8^3 bricks, brick aligned and clipped to the grid.
+typedef struct UpfDirtyRegion {
+    int64_t version;        // snapshot the region was computed for
+    int32_t x, y, z;        // first cell
+    int32_t sizeX, sizeY, sizeZ; // cells; all 0 when nothing changed
+    int32_t brickCount;     // changed bricks (the box may hold unchanged ones too)
+} UpfDirtyRegion;
+
+// Flow device for Upf_InitWithApi (values match NvFlowContextApi).
+typedef enum UpfContextApi {
+    UpfContextApi_None = 0,     // no Flow device: the Flow libraries are not loaded, grids use the built-in solver
+    UpfContextApi_Vulkan = 1,   // Vulkan device (Upf_Init's default); grids use the built-in solver
+    UpfContextApi_D3D12 = 2,
+    UpfContextApi_CPU = 3,      // Flow's multithreaded CPU device; grids run Flow's sparse solver
+} UpfContextApi;
+
+// Solver stepping a grid, from Upf_GetGridBackend.
+typedef enum UpfGridBackend {
+    UpfGridBackend_Builtin = 0, // the bridge's dense CPU solver
+    UpfGridBackend_Flow = 1,    // NvFlowGridInterface, resampled into the grid after each step
+    UpfGridBackend_Playback = 2, // frames of a recorded NanoVDB cache, not simulated
+} UpfGridBackend;
+
+// Advection schemes for Upf_SetGridAdvection.
+typedef enum UpfAdvectionMode {
+    UpfAdvection_SemiLagrangian = 0,  // first order, one sweep (default)
+    UpfAdvection_MacCormack = 1,      // second order, two sweeps
+    UpfAdvection_BFECC = 2,           // second order, three sweeps
+} UpfAdvectionMode;
+
+// Cell formats for Upf_ExportGrid*Into.
+typedef enum UpfExportFormat {
+    UpfExport_R32F = 0,     // density: 1 float per cell
+    UpfExport_RGB32F = 1,   // velocity: 3 floats per cell (vx, vy, vz)
+    UpfExport_RGBA32F = 2,  // velocity: 4 floats per cell (vx, vy, vz, 0), matches RGBAFloat textures
+    UpfExport_R16F = 3,     // density: 1 half per cell (RHalf)
+    UpfExport_RGBA16F = 4,  // velocity: 4 halves per cell (vx, vy, vz, 0) (RGBAHalf)
+    UpfExport_R8_UNORM = 5, // density: 1 byte per cell, [min, max] of the snapshot mapped to [0, 255] (R8)
+    UpfExport_BC4_UNORM = 6,// density: BC4 blocks (4x4 per z-slice, 8 bytes each) over [min, max] (BC4)
+} UpfExportFormat;
+
+// Optional simulation channels of a built-in grid, as bits of the mask given to
+// Upf_CreateGridWithChannels. Density (smoke from the emitters) is always
+// simulated; each channel here costs its own planes and advection work, so
+// grids only carry the ones they ask for.
+typedef enum UpfGridChannel {
+    UpfChannel_Temperature = 1 << 0,  // drives buoyancy and ignites fuel; cools over time, kept in [-1, 1]
+    UpfChannel_Fuel = 1 << 1,         // burns where hot enough, releasing heat and smoke
+    UpfChannel_Burn = 1 << 2,         // fuel burned in the last step (flame intensity); not advected
+    UpfChannel_Smoke = 1 << 3,        // combustion smoke, separate from the emitted density
+} UpfGridChannel;
+
+// Combustion of grids with temperature and fuel (Upf_SetGridCombustion), after
+// Flow's NvFlowGridParams combustion. Each step, where temperature is at least
+// ignitionTemp, fuel burns at burnPerTemp * (temperature - ignitionTemp) per
+// second, limited by the fuel left; each unit burned consumes fuelPerBurn fuel
+// and adds tempPerBurn temperature and smokePerBurn smoke.
+typedef struct UpfCombustionParams {
+    float ignitionTemp;     // 0.05
+    float burnPerTemp;      // 4
+    float fuelPerBurn;      // 0.25
+    float tempPerBurn;      // 5
+    float smokePerBurn;     // 3
+    float buoyancyPerTemp;  // upward acceleration per unit temperature (10)
+    float coolingRate;      // fraction of temperature lost per second (1.5)
+    float fuelFade;         // fraction of fuel lost per second (0)
+    float smokeFade;        // fraction of smoke lost per second (0.65)
+} UpfCombustionParams;
+
+// Emitter parameters for Upf_SetEmittersBatch.
+typedef struct UpfEmitterDesc {
+    int32_t handle;
+    float x, y, z;
+    float radius;
+    float density;
+} UpfEmitterDesc;
+
+// Obstacle shapes for Upf_CreateObstacle.
+typedef enum UpfObstacleType {
+    UpfObstacle_Box = 0,
+    UpfObstacle_Sphere = 1,
+    UpfObstacle_Capsule = 2,
+    UpfObstacle_Mesh = 3,      // Upf_CreateMeshObstacle only
+} UpfObstacleType;
+
+// Obstacle placement and size, in world units. Box: half extents (sx, sy, sz);
+// sphere: radius (sx); capsule: radius (sx) and half length of its segment
+// along local Y (sy); mesh: unused (scale goes into the vertices).
+typedef struct UpfObstacleDesc {
+    int32_t type;          // UpfObstacleType
+    float px, py, pz;      // position
+    float qx, qy, qz, qw;  // rotation, unit quaternion
+    float sx, sy, sz;
+} UpfObstacleDesc;
+
+// Obstacle state of a grid.
+typedef struct UpfObstacleStats {
+    int32_t obstacles;         // obstacles overlapping the grid
+    int32_t obstacleBricks;    // bricks with cells within one cell of an obstacle
+    int32_t rasterizedBricks;  // bricks re-rasterized by the last step
+    float milliseconds;        // time the last step spent re-rasterizing
+} UpfObstacleStats;
+
+// Pressure projection results of a grid's last step.
+typedef struct UpfProjectionStats {
+    int32_t cycles;        // multigrid V-cycles run
+    float divergence;      // RMS velocity divergence per cell before projection
+    float residual;        // RMS pressure residual after the last cycle
+    float milliseconds;    // time spent in the projection
+} UpfProjectionStats;
+
+// Adaptive substepping results of a grid's last step.
+typedef struct UpfSubstepStats {
+    int32_t substeps;      // substeps run this frame
+    float substepDt;       // seconds per substep
+    float cfl;             // largest velocity component * substepDt / cellSize
+    float deficit;         // simulated seconds carried to the next frame
+    float dropped;         // seconds discarded because the backlog exceeded 0.25 s
+    float milliseconds;    // time spent in the substeps
+} UpfSubstepStats;
+
+// Stage times of a grid's last step, in milliseconds. The fused sweep advects,
+// applies buoyancy and clamps in one pass, reported as advectMs; with fused
+// stepping off each pass is timed separately. Flow-backed grids report their
+// whole simulate + readback as advectMs.
+typedef struct UpfStepTimings {
+    float emitMs;
+    float advectMs;
+    float buoyancyMs;
+    float clampMs;
+    float projectMs;
+    float publishMs;    // snapshot copy, plus NanoVDB encode when recording (decode when playing back)
+    float tracerMs;     // tracer advection and packing (Upf_SpawnTracers)
+    float totalMs;
+} UpfStepTimings;
+
+// A playback grid's cache and position (Upf_GetGridPlaybackInfo).
+typedef struct UpfPlaybackInfo {
+    int32_t sizeX, sizeY, sizeZ;
+    float cellSize;
+    int32_t frameCount;    // frames in the cache
+    int32_t frame;         // frame currently published
+    float duration;        // seconds, last frame time plus one frame interval
+    float time;            // playback position in seconds
+} UpfPlaybackInfo;
+
+// A grid's level of detail (Upf_GetGridLod).
+typedef struct UpfGridLod {
+    int32_t level;         // 0 = resolution at creation; each level halves it
+    int32_t maxLevel;      // coarsest level Upf_SetGridLod accepts (0 for Flow-backed and playback grids)
+    int32_t sizeX, sizeY, sizeZ; // cells at the current level
+    float cellSize;        // world units, doubling with each level
+} UpfGridLod;
+
+// One pass of a Flow profiler capture.
+typedef struct UpfProfilerEntry {
+    uint64_t captureId;    // Flow frame the pass belongs to
+    int32_t labelId;       // see Upf_GetProfilerLabel
+    float cpuMs;
+    float gpuMs;
+} UpfProfilerEntry;
+
+// Types of queued bridge events (see Upf_DrainEvents). Bit (1 << type) of
+// the event mask enables a type.
+typedef enum UpfEventType {
+    UpfEvent_FrameFlushed = 0,     // frame = flushed Flow frame, value = dt
+    UpfEvent_Error = 1,            // text = message
+    UpfEvent_GridCreated = 2,      // handle = grid, value = cell size
+    UpfEvent_GridDestroyed = 3,    // handle = grid
+    UpfEvent_BudgetExceeded = 4,   // handle = grid, value = ms spent, limit = ms budget, text = stage
+    UpfEvent_Test = 5,             // text = message
+} UpfEventType;
+
+#define UPF_EVENT_TEXT_CHARS 104
+
+// One queued event; 128 bytes, fields not listed for its type are zero.
+typedef struct UpfEvent {
+    int32_t type;          // UpfEventType
+    int32_t handle;
+    int64_t frame;
+    float value;
+    float limit;
+    char text[UPF_EVENT_TEXT_CHARS];   // null terminated, truncated
+} UpfEvent;
+
 // Callback signature for events from Flow side into Unity.
 typedef void(*UpfEventCallback)(int32_t event_type, const char* json_payload, void* user_data);
 
-// Initialize the bridge. Returns 0 on success.
+// Initialize the bridge on the Vulkan device. Returns 0 on success.
 UPF_API int32_t Upf_Init();
 
-// Register or replace the global event callback.
+// Initialize the bridge on a chosen UpfContextApi. cpuThreads sizes the CPU
+// device's thread pool (0 = one per core; ignored for other devices).
+// Returns 0 on success (or if already initialized), -6 for an unknown API, or
+// -1..-5 if the Flow libraries or the device could not be set up; a failed
+// init releases everything it created, so it can be retried (e.g. with
+// UpfContextApi_CPU or UpfContextApi_None).
+UPF_API int32_t Upf_InitWithApi(int32_t contextApi, int32_t cpuThreads);
+
+// UpfContextApi the bridge was initialized with, or -1 if it is not initialized.
+UPF_API int32_t Upf_GetContextApi();
+
+// Deprecated: drain the event queue with Upf_DrainEvents instead. Registers or
+// replaces the global event callback, which runs synchronously on whichever
+// thread raised the event. Flushed-frame calls follow Upf_SetEventMask.
 UPF_API void Upf_RegisterCallback(UpfEventCallback cb, void* user_data);
 
 // Advance/pump events.
@@ -34,6 +243,353 @@ UPF_API void Upf_EmitTestEvent(const char* message);
 // Shutdown and cleanup resources.
 UPF_API void Upf_Shutdown();
 
+// Pop up to maxEntries queued profiler records, oldest first, into dst.
+// Returns the number written. Flow captures are queued in a fixed-size
+// ring; records arriving while it is full are dropped.
+UPF_API int32_t Upf_ReadProfilerEntries(UpfProfilerEntry* dst, int32_t maxEntries);
+
+// Text of an interned profiler label, or null for an unknown id. The
+// pointer stays valid for the life of the process.
+UPF_API const char* Upf_GetProfilerLabel(int32_t labelId);
+
+// Profiler records dropped since the last call because the ring was full.
+UPF_API int64_t Upf_GetProfilerDroppedCount();
+
+// Pop up to capacity queued events, oldest first, into dst. Returns the
+// number written. Events are queued from any thread without locking;
+// events raised while the queue is full are dropped.
+UPF_API int32_t Upf_DrainEvents(UpfEvent* dst, int32_t capacity);
+
+// Choose which UpfEventTypes are queued (bit 1 << type; all by default).
+// Returns the previous mask.
+UPF_API uint32_t Upf_SetEventMask(uint32_t mask);
+
+// Events dropped since the last call because the queue was full.
+UPF_API int64_t Upf_GetDroppedEventCount();
+
+// --- Simulation API ---
+
+// Create/destroy a sphere emitter. Returns a handle, or -1 if the bridge is not initialized.
+UPF_API int32_t Upf_CreateEmitter(float x, float y, float z, float radius, float density);
+UPF_API void Upf_DestroyEmitter(int32_t emitterHandle);
+UPF_API void Upf_SetEmitterParams(int32_t emitterHandle, float x, float y, float z, float radius, float density);
+
+// What an emitter adds to the optional channels of the grids that have them,
+// per second at its center like density: fuel and smoke are added, temperature
+// pulls cells toward the given value (hot sources for fire). All 0 by default.
+UPF_API void Upf_SetEmitterChannels(int32_t emitterHandle, float temperature, float fuel, float smoke);
+
+// Update many emitters in one call, as Upf_SetEmitterParams would. Unknown
+// handles are skipped. Returns the number of emitters updated.
+// Each grid only rasterizes the emitters whose bounds overlap its own.
+UPF_API int32_t Upf_SetEmittersBatch(const UpfEmitterDesc* emitters, int32_t count);
+
+// Solid obstacles (built-in solver). Each grid an obstacle overlaps voxelizes
+// it into a cached signed distance field and solid mask; after a move only the
+// bricks covering its old and new bounds are re-rasterized. The fused sweep
+// clears solid cells and removes velocity into surfaces as it writes them, and
+// the pressure projection treats solid cells as walls. Returns a handle, or -1
+// if the bridge is not initialized or the desc is invalid.
+UPF_API int32_t Upf_CreateObstacle(const UpfObstacleDesc* desc);
+
+// Create a triangle mesh obstacle: vertexCount vertices (3 floats each, in the
+// obstacle's local space with its scale applied) and indexCount / 3 triangles.
+// The mesh should be closed; it is baked once into a distance volume, so moving
+// it later costs no more than a primitive. desc->type is ignored.
+UPF_API int32_t Upf_CreateMeshObstacle(const UpfObstacleDesc* desc, const float* vertices, int32_t vertexCount,
+                                       const int32_t* indices, int32_t indexCount);
+
+// Move an obstacle (kinematic colliders).
+UPF_API void Upf_SetObstacleTransform(int32_t obstacleHandle, float px, float py, float pz,
+                                      float qx, float qy, float qz, float qw);
+UPF_API void Upf_DestroyObstacle(int32_t obstacleHandle);
+
+// Obstacle state of a grid. Returns 0 on success, -1 for an unknown grid.
+UPF_API int32_t Upf_GetGridObstacleStats(int32_t gridHandle, UpfObstacleStats* outStats);
+
+// Create/destroy a simulation grid. Returns a handle, or -1 if the bridge is not initialized.
+// On UpfContextApi_CPU the grid runs Flow's solver (falling back to the built-in
+// one if Flow can't create it); the sparse, fused and projection settings only
+// apply to built-in grids.
+UPF_API int32_t Upf_CreateGrid(int sizeX, int sizeY, int sizeZ, float cellSize);
+UPF_API void Upf_DestroyGrid(int32_t gridHandle);
+
+// As Upf_CreateGrid, also simulating the optional channels in channelMask (a
+// combination of UpfGridChannel bits). Combustion needs both temperature and
+// fuel; burn stays zero without them. Flow-backed grids simulate density only.
+// Returns -1 as Upf_CreateGrid or for unknown bits, -2 (and an UpfEvent_Error)
+// for a non-zero mask on the CPU device, whose grids are Flow-backed.
+UPF_API int32_t Upf_CreateGridWithChannels(int sizeX, int sizeY, int sizeZ, float cellSize, uint32_t channelMask);
+
+// UpfGridChannel bits the grid simulates, or -1 for an unknown grid.
+UPF_API int32_t Upf_GetGridChannels(int32_t gridHandle);
+
+// UpfGridBackend stepping the grid, or -1 for an unknown grid.
+UPF_API int32_t Upf_GetGridBackend(int32_t gridHandle);
+
+// Advance one grid by dt seconds. Grids have their own locks, so steps of
+// different grids (and emitter updates) do not block each other.
+UPF_API void Upf_StepGrid(int32_t gridHandle, float dt);
+
+// Advance several grids by dt seconds, stepping them concurrently on the
+// worker threads. Unknown handles are skipped.
+UPF_API void Upf_StepGrids(const int32_t* gridHandles, int32_t count, float dt);
+
+// Queue a step of one grid on the bridge's persistent worker thread and return
+// immediately. Returns a fence (> 0) identifying the step, or -1 for an unknown grid
+// or when the bridge is not initialized.
+// Queued steps of the same grid run in submission order.
+UPF_API int64_t Upf_StepGridAsync(int32_t gridHandle, float dt);
+
+// Returns 1 once the step identified by fence has finished (fence <= 0: the
+// latest step queued for the grid), otherwise 0. Fences above the grid's latest
+// step wait for that step instead.
+UPF_API int32_t Upf_IsGridReady(int32_t gridHandle, int64_t fence);
+
+// Block until the step identified by fence has finished (fence <= 0, or above
+// the grid's latest step: the latest step queued for the grid).
+UPF_API void Upf_WaitGrid(int32_t gridHandle, int64_t fence);
+
+// Export grid data. Returns a pointer to sizeX*sizeY*sizeZ cells of the latest
+// published snapshot, which stays valid until the next export call for the grid.
+// outFormat: 0 = float32, 1 = float32x3 (vx, vy, vz).
+UPF_API const void* Upf_ExportGridDensity(int32_t gridHandle, int* outSizeX, int* outSizeY, int* outSizeZ, int* outFormat);
+UPF_API const void* Upf_ExportGridVelocity(int32_t gridHandle, int* outSizeX, int* outSizeY, int* outSizeZ, int* outFormat);
+
+// Copy the latest published snapshot into a caller-provided buffer (e.g. a
+// texture's pixel data) in one pass, without allocating. format is an
+// UpfExportFormat valid for the field. Returns the bytes written, or the bytes
+// required if dst is null; -1 for an unknown grid or format, -2 if nothing has
+// been published, -3 if dstBytes is too small.
+UPF_API int64_t Upf_ExportGridDensityInto(int32_t gridHandle, void* dst, size_t dstBytes, int32_t format);
+UPF_API int64_t Upf_ExportGridVelocityInto(int32_t gridHandle, void* dst, size_t dstBytes, int32_t format);
+
+// As Upf_ExportGridDensityInto, also returning the snapshot's density range.
+// The UNORM formats decode as density = min + unorm * (max - min).
+UPF_API int64_t Upf_ExportGridDensityIntoScaled(int32_t gridHandle, void* dst, size_t dstBytes, int32_t format, float* outMin, float* outMax);
+
+// As Upf_ExportGridDensityIntoScaled for one optional channel (a single
+// UpfGridChannel bit), in the density formats; outMin and outMax may be null.
+// Returns -1 also if the grid does not have the channel.
+UPF_API int64_t Upf_ExportGridChannelInto(int32_t gridHandle, int32_t channel, void* dst, size_t dstBytes, int32_t format,
+                                          float* outMin, float* outMax);
+
+// Pin the latest published snapshot of a grid. The data stays valid and unchanged
+// while further steps run, until Upf_ReleaseGridSnapshot. Release every snapshot
+// before destroying its grid. Returns 0 on success, -1 for an unknown grid,
+// -2 if nothing has been published.
+UPF_API int32_t Upf_AcquireGridSnapshot(int32_t gridHandle, UpfGridSnapshot* outSnapshot);
+UPF_API void Upf_ReleaseGridSnapshot(int32_t gridHandle, const UpfGridSnapshot* snapshot);
+
+// Version of the latest published snapshot, or -1 for an unknown grid.
+UPF_API int64_t Upf_GetGridSnapshotVersion(int32_t gridHandle);
+
+// Bricks of the latest snapshot that may differ from snapshot sinceVersion
+// (-1: everything). Each publish records, per brick, the version that last
+// wrote or cleared it; bricks neither simulated nor cleared since
+// sinceVersion are unchanged. Returns 0 and fills outRegion, -1 for an
+// unknown grid, -2 if nothing has been published.
+UPF_API int32_t Upf_GetDirtyRegion(int32_t gridHandle, int64_t sinceVersion, UpfDirtyRegion* outRegion);
+
+// Copy a box of the latest snapshot (e.g. a UpfDirtyRegion) into dst, rows x
+// fastest, then y, then z. The format picks the field: R32F and R16F export
+// density, RGB32F, RGBA32F and RGBA16F velocity (the UNORM formats depend on
+// the whole grid's range and are not supported). Returns the bytes written,
+// the bytes required if dst is null, -1 for an unknown grid, unsupported
+// format or a box outside the grid, -2 if nothing has been published, -3 if
+// dstBytes is too small.
+UPF_API int64_t Upf_ExportGridRegionInto(int32_t gridHandle, const UpfDirtyRegion* region, void* dst, size_t dstBytes, int32_t format);
+
+// Pack the bricks changed since sinceVersion: their indices (x fastest, then
+// y, then z, in bricks) go to outBricks and their 8^3 cells, in the same order
+// and laid out as Upf_ExportGridRegionInto (cells past the grid edge zero), to
+// dst. Formats as for Upf_ExportGridRegionInto. Returns the number of bricks
+// (only counted if dst or outBricks is null), -1 for an unknown grid or
+// unsupported format, -2 if nothing has been published, -3 if more than
+// maxBricks changed or dstBytes is too small.
+UPF_API int32_t Upf_ExportDirtyBricks(int32_t gridHandle, int64_t sinceVersion, int32_t* outBricks, int32_t maxBricks,
+                                      void* dst, size_t dstBytes, int32_t format);
+
+// Sample the latest snapshot at count world positions (3 floats each) into out
+// (4 floats each: vx, vy, vz, density), interpolating trilinearly between
+// cell centers. Points outside the grid read zero. Large batches run on the
+// worker threads. Like the exports, this never waits for a step. Returns
+// count, -1 for an unknown grid or null buffers, -2 if nothing has been
+// published.
+UPF_API int32_t Upf_SampleGrid(int32_t gridHandle, const float* points, int32_t count, float* out);
+
+// Write a grid's density, velocity, optional channels, brick occupancy, window
+// position and the emitters overlapping it to a versioned binary file (UTF-8 path). Fields are stored as page-aligned
+// planes in the solver's own layout. Returns the file size in bytes, -1 for an
+// unknown grid or null path, -2 if the file could not be written.
+UPF_API int64_t Upf_SaveGridState(int32_t gridHandle, const char* path);
+
+// Replace a grid's fields with a saved state. The file is memory-mapped and its
+// planes copied in place, without parsing; the grid keeps its settings and the
+// state is published as a new snapshot right away. If outEmitterHandles is not
+// null, up to maxEmitters of the saved emitters are created as new emitters and
+// their handles written there. Channels the file lacks start from zero. The
+// window of a scrolling grid is restored to where it was saved (a grid saved
+// away from the origin becomes a scrolling grid). Returns the number of saved
+// emitters, or -1 for an unknown grid or null path, -2 if the file cannot be
+// mapped, -3 if it is not a grid state, -4 for an unsupported format version,
+// -5 if its size differs from the grid's, -6 for Flow-backed and playback grids
+// (and grids being recorded when the window would move), -7 if its cell size
+// differs from the grid's, -8 if the ring storage could not be mapped.
+UPF_API int32_t Upf_LoadGridState(int32_t gridHandle, const char* path, int32_t* outEmitterHandles, int32_t maxEmitters);
+
+// Record every snapshot a grid publishes from now on to a NanoVDB cache file
+// (UTF-8 path): one frame per step, holding a Float "density" and a Vec3f
+// "velocity" grid with a leaf per non-empty 8^3 brick. Compression and writes
+// run on a background thread; the step only pays for the encode. Replaces a
+// recording already in progress. Frames are stored relative to the grid's
+// center, so scrolling grids (Upf_SetGridOrigin) can't be recorded. Returns 0,
+// -1 for an unknown grid or null path, -2 if the file cannot be created, -3
+// (and an UpfEvent_Error) for a scrolling grid.
+UPF_API int32_t Upf_StartGridRecording(int32_t gridHandle, const char* path);
+
+// Finish a recording and write the cache's frame index. Returns the number of
+// frames recorded, -1 if the grid is unknown or not recording, -2 if a write failed.
+UPF_API int32_t Upf_StopGridRecording(int32_t gridHandle);
+
+// Create a grid that plays a NanoVDB cache back instead of simulating
+// (UpfGridBackend_Playback), sized from the cache. Stepping advances the
+// playback time and, when the frame changes, decodes it into the fields and
+// publishes it; frames after the current one are read ahead on a background
+// thread. Emitters, obstacles and solver settings don't affect it. Returns a
+// handle, or -1 if the bridge is not initialized or the file is missing or not
+// a cache (or holds no frames).
+UPF_API int32_t Upf_CreatePlaybackGrid(const char* path, int32_t loop);
+
+// Jump a playback grid to a time in seconds (wrapped when looping, clamped
+// otherwise) and publish that frame. Returns the frame, or -1 if the grid is
+// unknown or not a playback grid, -2 if the frame could not be read.
+UPF_API int32_t Upf_SeekGridPlayback(int32_t gridHandle, float seconds);
+
+// Returns 0 and fills outInfo, or -1 if the grid is unknown or not a playback grid.
+UPF_API int32_t Upf_GetGridPlaybackInfo(int32_t gridHandle, UpfPlaybackInfo* outInfo);
+
+// Change a grid's resolution without losing its contents: level n has
+// ceil(size / 2^n) cells per axis, 2^n times the cell size of creation, over
+// the same bounds (centered on the grid's origin). Density and velocity are resampled in
+// place, box filtered when coarsening and trilinearly when refining, and
+// published right away; obstacles are re-rasterized on the next step. Levels
+// are clamped to [0, 3] and to keeping at least 8 cells per axis. Snapshots
+// carry the size they were taken at, so readers must re-query after a change.
+// Returns the level now in effect, -1 for an unknown grid, -2 for Flow-backed
+// and playback grids and grids being recorded.
+UPF_API int32_t Upf_SetGridLod(int32_t gridHandle, int32_t level);
+
+// Returns 0 and fills outLod, or -1 for an unknown grid.
+UPF_API int32_t Upf_GetGridLod(int32_t gridHandle, UpfGridLod* outLod);
+
+// Turn a grid into a moving window centered on (x, y, z), e.g. to follow a
+// vehicle with a small grid. The center snaps to whole cells; each step first
+// scrolls the window onto the latest origin, keeping the contents at their
+// world positions and clearing only the cells it moves onto, so following
+// costs the same wherever the anchor goes. Emitters and obstacles are bound
+// against the moved bounds. The first call moves the grid's planes into ring
+// storage. Returns 0, -1 for an unknown grid, -2 for Flow-backed and playback
+// grids and grids being recorded (also posting an UpfEvent_Error for those),
+// -3 if the ring storage could not be mapped.
+UPF_API int32_t Upf_SetGridOrigin(int32_t gridHandle, float x, float y, float z);
+
+// World position (3 floats) of the latest snapshot's center: the origin for
+// grids that do not scroll. Renderers place the volume here, so it stays in
+// step with the exported fields. Returns 0, or -1 for an unknown grid.
+UPF_API int32_t Upf_GetGridOrigin(int32_t gridHandle, float* outOrigin);
+
+// Tracers: massless particles (sparks, embers) that ride a grid's velocity.
+// Each step moves them with a midpoint (RK2) step through the trilinear
+// velocity, ages them, and drops those past their lifetime or outside the
+// grid. The survivors are published packed, 4 floats each (x, y, z in world
+// space, age / lifetime in [0, 1)), ready to upload as instance data.
+// Spawning and exporting never wait for a step in progress.
+
+// Most live plus queued tracers a grid keeps (default 65536, at most 4M);
+// spawns past it are dropped. Returns the capacity in effect, or -1.
+UPF_API int32_t Upf_SetTracerCapacity(int32_t gridHandle, int32_t capacity);
+
+// Queue count tracers at world positions (3 floats each), to start moving on
+// the next step. Returns how many fit under the capacity, or -1.
+UPF_API int32_t Upf_SpawnTracers(int32_t gridHandle, const float* positions, int32_t count, float lifetime);
+
+// Drop all live and queued tracers. Returns 0, or -1 for an unknown grid.
+UPF_API int32_t Upf_ClearTracers(int32_t gridHandle);
+
+// Tracers published by the last step, or -1 for an unknown grid.
+UPF_API int32_t Upf_GetTracerCount(int32_t gridHandle);
+
+// Copy up to maxCount packed tracers (4 floats each) from the last step.
+// Returns the number copied, or -1.
+UPF_API int32_t Upf_ExportTracers(int32_t gridHandle, float* outPacked, int32_t maxCount);
+
+// Fused stepping (default on) advects, applies buoyancy and clamps in a single
+// sweep into ping-pong buffers. Disabling it runs the stages as separate passes
+// (same results), which is useful for per-stage profiling.
+UPF_API void Upf_SetGridFusedStep(int32_t gridHandle, int32_t enabled);
+
+// Sparse stepping (default on, fused step only): the grid is tiled into 8^3
+// bricks and each step only visits bricks holding density or non-negligible
+// velocity, bricks overlapped by emitters, and a one-brick margin around them.
+UPF_API void Upf_SetGridSparse(int32_t gridHandle, int32_t enabled);
+
+// Advection scheme of fused steps (UpfAdvectionMode, default semi-Lagrangian).
+// MacCormack and BFECC correct the first-order estimate with a backward trace
+// and limit the result to the neighbouring source values, so detail survives
+// far longer at the same resolution for 2x / 3x the advection cost.
+UPF_API void Upf_SetGridAdvection(int32_t gridHandle, int32_t mode);
+
+// Combustion and channel decay of a grid with optional channels (defaults in
+// UpfCombustionParams). Set copies params; Get fills them. Both return 0, or
+// -1 for an unknown grid or null params. Set returns -2 (posting an
+// UpfEvent_Error) and keeps the current params if any value is not finite or
+// a rate or per-burn amount is negative; ignitionTemp and buoyancyPerTemp may
+// be negative.
+UPF_API int32_t Upf_SetGridCombustion(int32_t gridHandle, const UpfCombustionParams* params);
+UPF_API int32_t Upf_GetGridCombustion(int32_t gridHandle, UpfCombustionParams* outParams);
+
+// Number of bricks visited by the grid's last step, or -1 for an unknown grid.
+UPF_API int32_t Upf_GetGridActiveBrickCount(int32_t gridHandle);
+
+// Pressure projection (default off): after advection, solve for pressure with
+// multigrid V-cycles (red-black Gauss-Seidel smoothing) and subtract its
+// gradient so the velocity is divergence free. Runs at most maxCycles cycles,
+// stops early once the residual falls below tolerance * divergence, and does
+// not start a cycle that would overrun budgetMs (<= 0: no time budget; at
+// least one cycle always runs).
+UPF_API void Upf_SetGridProjection(int32_t gridHandle, int32_t enabled, int32_t maxCycles, float budgetMs, float tolerance);
+
+// Projection results of the grid's last step (zeroed if projection is off).
+// Returns 0 on success, -1 for an unknown grid.
+UPF_API int32_t Upf_GetGridProjectionStats(int32_t gridHandle, UpfProjectionStats* outStats);
+
+// Adaptive substepping (default off). Each step adds dt to the grid's time
+// accumulator and consumes it in the fewest equal substeps that keep the
+// largest velocity component * substep / cellSize <= maxCfl (and no substep
+// above 0.033 s), so large frame times are simulated in full instead of being
+// clamped. At most maxSubsteps run per step, and none is started that would
+// overrun budgetMs (<= 0: no budget; at least one always runs); the remaining
+// time is carried to the next step and reported as the deficit. Applies to
+// grids on the built-in solver.
+UPF_API void Upf_SetGridSubstepping(int32_t gridHandle, int32_t enabled, float maxCfl, int32_t maxSubsteps, float budgetMs);
+
+// Substepping results of the grid's last step (zeroed if substepping is off).
+// Returns 0 on success, -1 for an unknown grid.
+UPF_API int32_t Upf_GetGridSubstepStats(int32_t gridHandle, UpfSubstepStats* outStats);
+
+// Select the advection kernel: 0 = scalar, 1 = SSE4.1, 2 = AVX2 (default).
+// Clamped to what the CPU supports; returns the level actually used.
+UPF_API int32_t Upf_SetSimdLevel(int32_t level);
+
+// Limit the solver threads used by grid steps (0 = OpenMP default). Returns the
+// thread count steps will use. Only the steps use it; the calling thread's own
+// OpenMP thread count is left as it was.
+UPF_API int32_t Upf_SetThreadCount(int32_t threads);
+
+// Stage timings of the grid's last step. Returns 0 on success, -1 for an unknown grid.
+UPF_API int32_t Upf_GetGridStepTimings(int32_t gridHandle, UpfStepTimings* outTimings);
+
 #ifdef _WIN32
 // Optional: set a folder to search for nvflow.dll and nvflowext.dll at runtime (call before Upf_Init).
 UPF_API void Upf_SetDllDirectoryW(const wchar_t* path);
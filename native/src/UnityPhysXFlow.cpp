@@ -8,11 +8,31 @@
 #endif
 
 #include "../include/UnityPhysXFlow.h"
+#include "UpfAdvection.h"
+#include "UpfExport.h"
+#include "UpfField.h"
+#include "UpfFlowGrid.h"
+#include "UpfGridState.h"
+#include "UpfObstacle.h"
+#include "UpfPressure.h"
+#include "UpfProfiler.h"
+#include "UpfResample.h"
+#include "UpfRing.h"
+#include "UpfSample.h"
+#include "UpfTracers.h"
+#include "UpfVdbCache.h"
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <cstdio>
 #include <cmath>
+#include <cfloat>
+#include <cstring>
 #include <algorithm>
 
 #ifdef _OPENMP
@@ -28,6 +48,7 @@
 #include <windows.h>
 #endif
 
+#include <memory>
 #include <unordered_map>
 #include <vector>
 
@@ -36,22 +57,219 @@ struct EmitterState {
     float x, y, z;
     float radius;
     float density;
+    // Added to the optional channels of grids that have them (Upf_SetEmitterChannels)
+    float temperature = 0.0f, fuel = 0.0f, smoke = 0.0f;
     // Flow-specific emitter data would go here
 };
 
+struct ObstacleState {
+    int32_t handle;
+    int64_t revision;   // obstacleGeneration of its last change
+    UpfObstacleShape shape;
+};
+
+// Immutable copy of a grid's fields, published after each step. Readers pin
+// a slot through `readers`; the solver only rewrites slots nobody holds.
+struct GridSnapshot {
+    std::vector<float> density;
+    std::vector<float> velocity; // 3 floats per cell (vx, vy, vz)
+    std::vector<float> channels[kUpfChannelCount]; // the grid's optional channels, empty if absent
+    std::vector<uint8_t> brickWritten; // bricks that may be non-zero in this slot
+    std::vector<int64_t> brickVersion; // version that last wrote or cleared each brick
+    int sizeX = 0, sizeY = 0, sizeZ = 0; // of the grid when published; changes with its LOD
+    float origin[3] = { 0.0f, 0.0f, 0.0f }; // world position of the grid's center when published
+    float cellSize = 0.0f;
+    int64_t version = 0;
+    std::atomic<int32_t> readers{0};
+};
+
+static constexpr int kSnapshotRing = 3;
+
+// Sparse stepping tiles grids into bricks of kBrickSize^3 cells. A brick whose
+// activity (largest velocity component, or density) stays at or below
+// kActivityEpsilon counts as empty and is dropped from the sweep.
+static constexpr int kBrickSize = 8;
+static constexpr float kActivityEpsilon = 1e-3f;
+
+// Flow's combustion defaults, with buoyancyPerTemp in the units of the
+// solver's density buoyancy (5 per unit density).
+static UpfCombustionParams defaultCombustion()
+{
+    UpfCombustionParams c;
+    c.ignitionTemp = 0.05f;
+    c.burnPerTemp = 4.0f;
+    c.fuelPerBurn = 0.25f;
+    c.tempPerBurn = 5.0f;
+    c.smokePerBurn = 3.0f;
+    c.buoyancyPerTemp = 10.0f;
+    c.coolingRate = 1.5f;
+    c.fuelFade = 0.0f;
+    c.smokeFade = 0.65f;
+    return c;
+}
+
 struct GridState {
     int32_t handle;
     int sizeX, sizeY, sizeZ;
     float cellSize;
-    std::vector<float> densityData;
-    std::vector<float> velocityData; // 3 floats per cell (vx, vy, vz)
+    // Size at creation; LOD level n has ceil(base / 2^n) cells of baseCellSize * 2^n
+    int baseSizeX, baseSizeY, baseSizeZ;
+    float baseCellSize;
+    int32_t lodLevel = 0;
+    // Scrolling grids (Upf_SetGridOrigin) keep their planes in UpfField rings
+    // and are centered on originCell * cellSize rather than the world origin.
+    // Each step first moves the window to the cell nearest targetOrigin.
+    bool scrolling = false;
+    int originCell[3] = { 0, 0, 0 };
+    float targetOrigin[3] = { 0.0f, 0.0f, 0.0f };
+    UpfField densityData;
+    // Velocity components stored as separate planes (structure-of-arrays)
+    UpfField velX, velY, velZ;
     // Temp buffers for multi-threaded simulation
-    std::vector<float> densityTemp;
-    std::vector<float> velocityTemp;
-    // Flow-specific grid data would go here
+    UpfField densityTemp;
+    UpfField velXTemp, velYTemp, velZTemp;
+    // Advect, apply forces and clamp in one sweep into the temp buffers, then swap
+    bool fusedStep = true;
+
+    // Sparse stepping: the fused sweep only visits bricks with content (plus a
+    // one-brick margin). Cells outside visited bricks are zero in both buffers.
+    bool sparse = true;
+    int bricksX = 0, bricksY = 0, bricksZ = 0;
+    std::vector<float> brickActivity;   // per brick, from the last sweep
+    std::vector<uint8_t> brickVisited;  // brick was written by the last sweep
+    std::vector<int32_t> activeBricks;  // bricks visited by the last sweep
+
+    // Advection scheme of fused steps (UpfAdvectionMode). Higher-order modes keep
+    // the forward estimate in mid* and, for BFECC, the compensated field in bar*;
+    // allocated on first use and, like the fields, zero outside visited bricks.
+    int32_t advection = UpfAdvection_SemiLagrangian;
+    UpfField midDensity, midVx, midVy, midVz;
+    UpfField barDensity, barVx, barVy, barVz;
+
+    // Optional channels (UpfGridChannel bits), indexed by UpfChannelSlot. Only
+    // the channels asked for at creation have planes; burn has no mid/bar
+    // since it is not advected.
+    uint32_t channels = 0;
+    UpfField channelData[kUpfChannelCount];
+    UpfField channelTemp[kUpfChannelCount];
+    UpfField channelMid[kUpfChannelCount], channelBar[kUpfChannelCount];
+    UpfCombustionParams combustion = defaultCombustion();
+
+    // Emitters whose bounds overlap the grid, as of emitterGeneration boundGeneration
+    std::vector<EmitterState> boundEmitters;
+    int64_t boundGeneration = -1;
+
+    // Obstacles overlapping the grid, as of obstacleGeneration boundObstacleGeneration,
+    // rasterized into obstacleSdf (in cells) and solid. Allocated while any obstacle
+    // is bound; brickObstacle flags the bricks (listed in obstacleBricks) with cells
+    // within one cell of a surface, the only ones the solver has to mask.
+    std::vector<ObstacleState> boundObstacles;
+    int64_t boundObstacleGeneration = 0;
+    std::vector<float> obstacleSdf;
+    std::vector<uint8_t> solid;
+    std::vector<uint8_t> brickObstacle;
+    std::vector<int32_t> obstacleBricks;
+    int64_t solidVersion = 0;
+    UpfObstacleStats lastObstacles = {};
+
+    // Pressure projection after the sweep (off by default)
+    bool projection = false;
+    int projectionMaxCycles = 4;
+    float projectionBudgetMs = 0.0f;
+    float projectionTolerance = 1e-3f;
+    UpfMultigrid pressure;
+    UpfProjectResult lastProjection = {};
+    UpfStepTimings lastTimings = {};
+
+    // Adaptive substepping (off by default): unsimulated time carries over in timeAccumulator
+    bool substepping = false;
+    float substepMaxCfl = 1.0f;
+    int substepMax = 8;
+    float substepBudgetMs = 0.0f;
+    float timeAccumulator = 0.0f;
+    UpfSubstepStats lastSubsteps = {};
+
+    // Set when Flow's own solver steps this grid (UpfContextApi_CPU); the
+    // fields above then just hold its resampled output.
+    UpfFlowGrid* flowGrid = nullptr;
+
+    // NanoVDB recording: each published step is encoded and queued to the
+    // recorder, stamped with the simulated time since recording started.
+    UpfVdbRecorder* recorder = nullptr;
+    double recordTime = 0.0;
+
+    // Set on playback grids (Upf_CreatePlaybackGrid), which step by decoding
+    // the cache's frame at playbackTime instead of simulating.
+    UpfVdbPlayer* player = nullptr;
+    double playbackTime = 0.0;
+    int32_t playbackFrame = -1;
+
+    // Tracer particles, advanced through the velocity after each step
+    UpfTracerPool tracers;
+    std::vector<float> tracerOut;
+
+    // Guards the simulation data above. Held for the duration of a step, so
+    // grids step independently of each other and of the global bridge lock.
+    std::mutex mtx;
+
+    // Published snapshots. latestSnapshot is the slot readers acquire (-1 = none);
+    // legacyHold is the slot pinned by the Upf_ExportGrid* pointers.
+    GridSnapshot snapshots[kSnapshotRing];
+    std::atomic<int32_t> latestSnapshot{-1};
+    std::atomic<int32_t> legacyHold{-1};
+
+    int64_t nextVersion = 0;
+    // Dirty tracking: the version that last wrote or cleared each brick, and
+    // the bricks the previous publish held (those it held and this one doesn't
+    // were cleared)
+    std::vector<int64_t> brickChanged;
+    std::vector<uint8_t> publishedBricks;
+
+    // Async step fences: the last fence queued for this grid and the last one finished.
+    std::atomic<int64_t> submittedFence{0};
+    std::atomic<int64_t> completedFence{0};
+    std::mutex fenceMtx;
+    std::condition_variable fenceCv;
+
+    // Tracer spawns queue here and each step's packed tracers (x, y, z,
+    // age / life) are published here, so neither waits for a step.
+    std::mutex tracerMtx;
+    std::vector<float> tracerPending;   // x, y, z, life per queued tracer
+    std::vector<float> tracerPacked;
+    bool tracerClear = false;           // drop the live tracers on the next step
+    int32_t tracerCapacity = 65536;
+};
+
+struct StepJob {
+    std::shared_ptr<GridState> grid;
+    float dt;
+    int64_t fence;
+};
+
+// Persistent thread that runs Upf_StepGridAsync jobs off Unity's main thread.
+struct StepWorker {
+    std::thread thread;
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<StepJob> jobs;
+    bool stop = false;
+    int64_t nextFence = 1;
+
+    ~StepWorker()
+    {
+        // Upf_Shutdown normally joins. If it never ran, finish the queue here so
+        // the thread doesn't outlive the bridge state it steps.
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stop = true;
+            cv.notify_all();
+        }
+        if (thread.joinable()) thread.join();
+    }
 };
 
 struct BridgeState {
+    int32_t contextApi = UpfContextApi_None;
     NvFlowLoader loader{};
     NvFlowDeviceManager* deviceManager = nullptr;
     NvFlowDevice* device = nullptr;
@@ -62,6 +280,12 @@ struct BridgeState {
     UpfEventCallback callback = nullptr;
     void* callbackUser = nullptr;
 
+    // Queued events, drained by Upf_DrainEvents. Posting never locks.
+    UpfRing<UpfEvent, 1024> events;
+    std::atomic<uint32_t> eventMask{~0u};
+
+    // Guards bridge state and the emitter/grid tables. Never held while a
+    // grid is stepping; grid data is guarded by GridState::mtx.
     std::mutex mtx;
     bool initialized = false;
 
@@ -72,429 +296,3299 @@ struct BridgeState {
     // Simulation state
     int32_t nextEmitterHandle = 1;
     int32_t nextGridHandle = 1;
+    int32_t nextObstacleHandle = 1;
     std::unordered_map<int32_t, EmitterState> emitters;
-    std::unordered_map<int32_t, GridState> grids;
+    // Bumped (under mtx) whenever an emitter is created, changed or destroyed,
+    // so grids know when to rebuild their emitter binding.
+    std::atomic<int64_t> emitterGeneration{0};
+    // Same for obstacles; an obstacle's revision is the generation it last changed at.
+    std::unordered_map<int32_t, ObstacleState> obstacles;
+    std::atomic<int64_t> obstacleGeneration{0};
+    // Grids are shared so a step in flight keeps its grid alive across Upf_DestroyGrid.
+    std::unordered_map<int32_t, std::shared_ptr<GridState>> grids;
+
+    StepWorker worker;
+
+    // Flow's context is single threaded: Flow-backed grid steps and grid
+    // creation/destruction take this (after grid.mtx, never with mtx held).
+    std::mutex flowMtx;
+
+    // Requested advection kernel level; clamped to what the CPU supports
+    std::atomic<int32_t> simdLevel{UpfSimd_AVX2};
+    // Solver threads per step (0 = OpenMP default)
+    std::atomic<int32_t> threadCount{0};
+    // Concurrent grid batches running, and OpenMP's max active levels before
+    // the first of them raised it
+    std::mutex nestedMtx;
+    int32_t nestedBatches = 0;
+    int32_t savedActiveLevels = 1;
 };
 
 static BridgeState g_state;
 
+static void postEvent(int32_t type, int32_t handle, int64_t frame, float value, float limit, const char* text)
+{
+    if (!(g_state.eventMask.load(std::memory_order_relaxed) & (1u << type))) return;
+    UpfEvent e = {};
+    e.type = type;
+    e.handle = handle;
+    e.frame = frame;
+    e.value = value;
+    e.limit = limit;
+    if (text) std::strncpy(e.text, text, UPF_EVENT_TEXT_CHARS - 1);
+    g_state.events.push(e);
+}
+
 static void flowPrintError(const char* str, void* /*userdata*/)
 {
+    postEvent(UpfEvent_Error, -1, 0, 0.0f, 0.0f, str);
     if (g_state.callback) {
         g_state.callback(1, str, g_state.callbackUser);
     }
 }
 
+// Called by Flow on the flushing thread. Flow reports seconds; the ring holds ms.
 static void NV_FLOW_ABI flowProfilerReport(void* /*userdata*/, NvFlowUint64 captureID, NvFlowUint numEntries, NvFlowProfilerEntry* entries)
 {
-    if (!g_state.callback) return;
-    std::string json = "{\"captureId\":" + std::to_string((unsigned long long)captureID) + ",\"entries\":[";
     for (NvFlowUint i = 0; i < numEntries; i++) {
-        const NvFlowProfilerEntry& e = entries[i];
-        json += "{\"label\":\"";
-        if (e.label) {
-            const char* p = e.label;
-            while (*p) { if (*p == '"') json += '\\'; json += *p++; }
-        } else { json += ""; }
-        json += "\",\"cpuMs\":" + std::to_string((double)e.cpuDeltaTime) + ",\"gpuMs\":" + std::to_string((double)e.gpuDeltaTime) + "}";
-        if (i + 1u < numEntries) json += ",";
+        UpfProfilerEntry e;
+        e.captureId = (uint64_t)captureID;
+        e.labelId = upfProfilerInternLabel(entries[i].label);
+        e.cpuMs = entries[i].cpuDeltaTime * 1000.0f;
+        e.gpuMs = entries[i].gpuDeltaTime * 1000.0f;
+        upfProfilerPush(e);
     }
-    json += "]}";
-    g_state.callback(2, json.c_str(), g_state.callbackUser);
 }
 
-extern "C" {
-
-UPF_API int32_t Upf_Init()
+static std::shared_ptr<GridState> findGrid(int32_t gridHandle)
 {
     std::lock_guard<std::mutex> lock(g_state.mtx);
-    if (g_state.initialized) return 0;
-
-    NvFlowLoaderInitDeviceAPI(&g_state.loader, flowPrintError, nullptr, eNvFlowContextApi_vulkan);
-    if (!g_state.loader.deviceInterface.getContext) {
-        flowPrintError("NvFlow device interface not available", nullptr);
-        return -1;
-    }
+    auto it = g_state.grids.find(gridHandle);
+    if (it == g_state.grids.end()) return nullptr;
+    return it->second;
+}
 
-    NvFlowThreadPoolInterface* threadPool = nullptr;
-    g_state.deviceManager = g_state.loader.deviceInterface.createDeviceManager(0, threadPool, 0);
-    if (!g_state.deviceManager) { flowPrintError("Failed to create NvFlowDeviceManager", nullptr); return -2; }
+// Flow objects for Flow-backed grids. Only valid between Upf_InitWithApi and Upf_Shutdown.
+static UpfFlowDevice flowDevice()
+{
+    UpfFlowDevice d;
+    d.gridInterface = &g_state.loader.gridInterface;
+    d.deviceInterface = &g_state.loader.deviceInterface;
+    d.contextInterface = g_state.ctxIface;
+    d.context = g_state.context;
+    d.queue = g_state.queue;
+    d.opList = g_state.loader.opList_orig;
+    d.extOpList = g_state.loader.extOpList_orig;
+    return d;
+}
 
-    NvFlowDeviceDesc devDesc{};
-    devDesc.deviceIndex = 0;
-    devDesc.enableExternalUsage = NV_FLOW_FALSE;
-    devDesc.logPrint = nullptr;
+// World position of the grid's center: the origin, or for scrolling grids
+// the center of the current window.
+static void gridCenter(const GridState& grid, float center[3])
+{
+    for (int k = 0; k < 3; k++) center[k] = grid.originCell[k] * grid.cellSize;
+}
 
-    g_state.device = g_state.loader.deviceInterface.createDevice(g_state.deviceManager, &devDesc);
-    if (!g_state.device) { flowPrintError("Failed to create NvFlowDevice", nullptr); return -3; }
+// Rebuild the grid's emitter binding if emitters changed since the last one:
+// copy the emitters whose bounding box overlaps the grid's world bounds.
+// Caller must hold grid.mtx; the global lock is only taken for the rebuild,
+// so steady-state steps read the copy without it.
+static void bindEmittersLocked(GridState& grid)
+{
+    if (grid.boundGeneration == g_state.emitterGeneration.load()) return;
 
-    g_state.queue = g_state.loader.deviceInterface.getDeviceQueue(g_state.device);
-    if (!g_state.queue) { flowPrintError("Failed to get NvFlowDeviceQueue", nullptr); return -4; }
+    const float halfX = grid.sizeX * grid.cellSize * 0.5f;
+    const float halfY = grid.sizeY * grid.cellSize * 0.5f;
+    const float halfZ = grid.sizeZ * grid.cellSize * 0.5f;
+    float c[3];
+    gridCenter(grid, c);
 
-    g_state.ctxIface = g_state.loader.deviceInterface.getContextInterface(g_state.queue);
-    g_state.context = g_state.loader.deviceInterface.getContext(g_state.queue);
-    if (!g_state.ctxIface || !g_state.context) { flowPrintError("Failed to get NvFlow Context", nullptr); return -5; }
+    std::lock_guard<std::mutex> lock(g_state.mtx);
+    grid.boundEmitters.clear();
+    for (const auto& pair : g_state.emitters) {
+        const EmitterState& e = pair.second;
+        if (e.x + e.radius < c[0] - halfX || e.x - e.radius > c[0] + halfX ||
+            e.y + e.radius < c[1] - halfY || e.y - e.radius > c[1] + halfY ||
+            e.z + e.radius < c[2] - halfZ || e.z - e.radius > c[2] + halfZ) {
+            continue;
+        }
+        grid.boundEmitters.push_back(e);
+    }
+    grid.boundGeneration = g_state.emitterGeneration.load();
+}
 
-    g_state.loader.deviceInterface.enableProfiler(g_state.context, nullptr, &flowProfilerReport);
+// Cell bounds [x0, x1) x [y0, y1) x [z0, z1) of brick b.
+struct BrickBounds {
+    int x0, x1, y0, y1, z0, z1;
+};
 
-    g_state.initialized = true;
-    return 0;
+static BrickBounds brickBounds(const GridState& grid, int32_t b)
+{
+    const int bx = b % grid.bricksX;
+    const int by = (b / grid.bricksX) % grid.bricksY;
+    const int bz = b / (grid.bricksX * grid.bricksY);
+    BrickBounds r;
+    r.x0 = bx * kBrickSize; r.x1 = std::min(r.x0 + kBrickSize, grid.sizeX);
+    r.y0 = by * kBrickSize; r.y1 = std::min(r.y0 + kBrickSize, grid.sizeY);
+    r.z0 = bz * kBrickSize; r.z1 = std::min(r.z0 + kBrickSize, grid.sizeZ);
+    return r;
 }
 
-UPF_API void Upf_RegisterCallback(UpfEventCallback cb, void* user_data)
+// Same for a snapshot, which keeps the size it was published at.
+static BrickBounds brickBounds(const GridSnapshot& snap, int32_t b)
 {
-    std::lock_guard<std::mutex> lock(g_state.mtx);
-    g_state.callback = cb;
-    g_state.callbackUser = user_data;
+    const int bricksX = (snap.sizeX + kBrickSize - 1) / kBrickSize;
+    const int bricksY = (snap.sizeY + kBrickSize - 1) / kBrickSize;
+    const int bx = b % bricksX;
+    const int by = (b / bricksX) % bricksY;
+    const int bz = b / (bricksX * bricksY);
+    BrickBounds r;
+    r.x0 = bx * kBrickSize; r.x1 = std::min(r.x0 + kBrickSize, snap.sizeX);
+    r.y0 = by * kBrickSize; r.y1 = std::min(r.y0 + kBrickSize, snap.sizeY);
+    r.z0 = bz * kBrickSize; r.z1 = std::min(r.z0 + kBrickSize, snap.sizeZ);
+    return r;
 }
 
-UPF_API void Upf_Step(float dt)
+static void clearBrick(const GridState& grid, int32_t b, UpfField& field)
 {
-    if (!g_state.initialized) return;
-    if (dt < 0.f) dt = 0.f;
-
-    uint64_t flushedFrame = 0;
-    g_state.loader.deviceInterface.flush(g_state.queue, &flushedFrame, nullptr, nullptr);
-
-    if (g_state.callback) {
-        char msg[128];
-        snprintf(msg, sizeof(msg), "flushedFrame=%llu, dt=%f", (unsigned long long)flushedFrame, dt);
-        g_state.callback(0, msg, g_state.callbackUser);
+    const BrickBounds r = brickBounds(grid, b);
+    for (int z = r.z0; z < r.z1; z++) {
+        for (int y = r.y0; y < r.y1; y++) {
+            const size_t row = (size_t)y * grid.sizeX + (size_t)z * grid.sizeX * grid.sizeY;
+            std::fill(field.begin() + row + r.x0, field.begin() + row + r.x1, 0.0f);
+        }
     }
 }
 
-UPF_API void Upf_EmitTestEvent(const char* message)
+static void copyBrickToSnapshot(const GridState& grid, int32_t b, GridSnapshot& snap)
 {
-    if (g_state.callback) {
-        g_state.callback(99, message ? message : "", g_state.callbackUser);
+    const BrickBounds r = brickBounds(grid, b);
+    for (int z = r.z0; z < r.z1; z++) {
+        for (int y = r.y0; y < r.y1; y++) {
+            const size_t row = (size_t)y * grid.sizeX + (size_t)z * grid.sizeX * grid.sizeY;
+            for (size_t i = row + r.x0; i < row + r.x1; i++) {
+                snap.density[i] = grid.densityData[i];
+                snap.velocity[i * 3 + 0] = grid.velX[i];
+                snap.velocity[i * 3 + 1] = grid.velY[i];
+                snap.velocity[i * 3 + 2] = grid.velZ[i];
+            }
+            for (int c = 0; c < kUpfChannelCount; c++) {
+                if (grid.channelData[c].empty()) continue;
+                const float* plane = grid.channelData[c].data();
+                std::copy(plane + row + r.x0, plane + row + r.x1, snap.channels[c].begin() + row + r.x0);
+            }
+        }
     }
 }
 
-UPF_API void Upf_Shutdown()
+static void clearSnapshotBrick(const GridState& grid, int32_t b, GridSnapshot& snap)
 {
-    std::lock_guard<std::mutex> lock(g_state.mtx);
-    if (!g_state.initialized) return;
+    const BrickBounds r = brickBounds(grid, b);
+    for (int z = r.z0; z < r.z1; z++) {
+        for (int y = r.y0; y < r.y1; y++) {
+            const size_t row = (size_t)y * grid.sizeX + (size_t)z * grid.sizeX * grid.sizeY;
+            std::fill(snap.density.begin() + row + r.x0, snap.density.begin() + row + r.x1, 0.0f);
+            std::fill(snap.velocity.begin() + (row + r.x0) * 3, snap.velocity.begin() + (row + r.x1) * 3, 0.0f);
+            for (std::vector<float>& plane : snap.channels) {
+                if (!plane.empty()) std::fill(plane.begin() + row + r.x0, plane.begin() + row + r.x1, 0.0f);
+            }
+        }
+    }
+}
 
-    if (g_state.deviceManager && g_state.device) {
-        g_state.loader.deviceInterface.waitIdle(g_state.queue);
-        g_state.loader.deviceInterface.destroyDevice(g_state.deviceManager, g_state.device);
-        g_state.device = nullptr;
-        g_state.queue = nullptr;
+// Copy the grid's current fields into a free snapshot slot and make it the
+// latest. Caller must hold grid.mtx. If every other slot is pinned by a
+// reader the publish is skipped and readers keep seeing the previous version.
+static void publishSnapshotLocked(GridState& grid)
+{
+    const int32_t latest = grid.latestSnapshot.load();
+    int32_t slot = -1;
+    for (int32_t i = 0; i < kSnapshotRing; i++) {
+        if (i != latest && grid.snapshots[i].readers.load() == 0) { slot = i; break; }
     }
-    if (g_state.deviceManager) {
-        g_state.loader.deviceInterface.destroyDeviceManager(g_state.deviceManager);
-        g_state.deviceManager = nullptr;
+    const int64_t version = grid.nextVersion++;
+    const int32_t numBricks = (int32_t)grid.brickVisited.size();
+    // Recorded even if the publish is skipped, so the next one reports it
+    grid.brickChanged.resize(numBricks, version);
+    grid.publishedBricks.resize(numBricks, 1);
+    for (int32_t b = 0; b < numBricks; b++) {
+        if (grid.brickVisited[b] || grid.publishedBricks[b]) grid.brickChanged[b] = version;
     }
-    NvFlowLoaderDestroy(&g_state.loader);
+    grid.publishedBricks = grid.brickVisited;
+    if (slot < 0) return;
 
-    g_state.ctxIface = nullptr;
-    g_state.context = nullptr;
-    g_state.callback = nullptr;
-    g_state.callbackUser = nullptr;
-    g_state.initialized = false;
+    GridSnapshot& snap = grid.snapshots[slot];
+    const size_t numCells = grid.densityData.size();
+    bool channelsMatch = true;
+    for (int c = 0; c < kUpfChannelCount; c++) {
+        channelsMatch &= snap.channels[c].size() == grid.channelData[c].size();
+    }
+
+    if (snap.sizeX == grid.sizeX && snap.sizeY == grid.sizeY && snap.sizeZ == grid.sizeZ &&
+        snap.density.size() == numCells && snap.brickWritten.size() == (size_t)numBricks && channelsMatch) {
+        // Only bricks the last sweep wrote can be non-zero; bricks this slot
+        // held from an older publish are cleared.
+        #pragma omp parallel for schedule(dynamic, 16) if(numBricks > 64)
+        for (int32_t b = 0; b < numBricks; b++) {
+            if (grid.brickVisited[b]) copyBrickToSnapshot(grid, b, snap);
+            else if (snap.brickWritten[b]) clearSnapshotBrick(grid, b, snap);
+        }
+    } else {
+        snap.density.assign(grid.densityData.begin(), grid.densityData.end());
+        // Snapshots keep the interleaved (vx, vy, vz) export layout
+        snap.velocity.resize(numCells * 3);
+        for (size_t i = 0; i < numCells; i++) {
+            snap.velocity[i * 3 + 0] = grid.velX[i];
+            snap.velocity[i * 3 + 1] = grid.velY[i];
+            snap.velocity[i * 3 + 2] = grid.velZ[i];
+        }
+        for (int c = 0; c < kUpfChannelCount; c++) {
+            snap.channels[c].assign(grid.channelData[c].begin(), grid.channelData[c].end());
+        }
+    }
+    snap.brickWritten = grid.brickVisited;
+    snap.brickVersion = grid.brickChanged;
+    snap.sizeX = grid.sizeX; snap.sizeY = grid.sizeY; snap.sizeZ = grid.sizeZ;
+    gridCenter(grid, snap.origin);
+    snap.cellSize = grid.cellSize;
+    snap.version = version;
+    grid.latestSnapshot.store(slot);
 }
 
-#ifdef _WIN32
-UPF_API void Upf_SetDllDirectoryW(const wchar_t* path)
+// Pin the latest snapshot. Returns its slot, or -1 if nothing was published.
+static int32_t acquireSnapshot(GridState& grid)
 {
-    std::lock_guard<std::mutex> lock(g_state.mtx);
-    if (!path) return;
-    g_state.dllDirW = path;
-    ::SetDefaultDllDirectories(LOAD_LIBRARY_SEARCH_DEFAULT_DIRS | LOAD_LIBRARY_SEARCH_USER_DIRS);
-    ::AddDllDirectory(g_state.dllDirW.c_str());
+    for (;;) {
+        const int32_t slot = grid.latestSnapshot.load();
+        if (slot < 0) return -1;
+        grid.snapshots[slot].readers.fetch_add(1);
+        // The solver never writes the latest slot, so once pinned while still
+        // latest it stays intact until released.
+        if (grid.latestSnapshot.load() == slot) return slot;
+        grid.snapshots[slot].readers.fetch_sub(1);
+    }
 }
-#endif
 
-// --- Simulation API Implementation ---
+static void releaseSnapshot(GridState& grid, int32_t slot)
+{
+    if (slot < 0 || slot >= kSnapshotRing) return;
+    if (grid.snapshots[slot].readers.load() > 0) grid.snapshots[slot].readers.fetch_sub(1);
+}
 
-UPF_API int32_t Upf_CreateEmitter(float x, float y, float z, float radius, float density)
+// Move the legacy export pin to the latest snapshot and return it.
+static const GridSnapshot* acquireLegacySnapshot(GridState& grid)
 {
-    std::lock_guard<std::mutex> lock(g_state.mtx);
-    if (!g_state.initialized) return -1;
+    const int32_t slot = acquireSnapshot(grid);
+    releaseSnapshot(grid, grid.legacyHold.exchange(slot));
+    return slot >= 0 ? &grid.snapshots[slot] : nullptr;
+}
 
-    int32_t handle = g_state.nextEmitterHandle++;
-    EmitterState& e = g_state.emitters[handle];
-    e.handle = handle;
-    e.x = x; e.y = y; e.z = z;
-    e.radius = radius;
-    e.density = density;
+// Milliseconds since construction (total) or since the previous lap.
+struct StageTimer {
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point start = Clock::now();
+    Clock::time_point last = start;
 
-    // TODO: Create actual Flow emitter using NvFlowExt or Context API
+    float lap()
+    {
+        const Clock::time_point now = Clock::now();
+        const float ms = std::chrono::duration<float, std::milli>(now - last).count();
+        last = now;
+        return ms;
+    }
+    float total() const { return std::chrono::duration<float, std::milli>(Clock::now() - start).count(); }
+};
 
-    return handle;
-}
+// Bricks [lo, hi] covered by an obstacle's bounds grown by the SDF band;
+// false if they miss the grid.
+struct BrickRange {
+    int lo[3], hi[3];
+};
 
-UPF_API void Upf_DestroyEmitter(int32_t emitterHandle)
+static bool obstacleBrickRange(const GridState& grid, const UpfObstacleShape& shape, BrickRange& r)
 {
-    std::lock_guard<std::mutex> lock(g_state.mtx);
-    auto it = g_state.emitters.find(emitterHandle);
-    if (it == g_state.emitters.end()) return;
+    float wlo[3], whi[3];
+    upfObstacleBounds(shape, wlo, whi);
+    const int size[3] = { grid.sizeX, grid.sizeY, grid.sizeZ };
+    const float margin = kUpfObstacleBand * grid.cellSize;
+    float c[3];
+    gridCenter(grid, c);
+    for (int k = 0; k < 3; k++) {
+        const float half = size[k] * grid.cellSize * 0.5f - c[k];
+        const float c0 = std::floor((wlo[k] - margin + half) / grid.cellSize);
+        const float c1 = std::floor((whi[k] + margin + half) / grid.cellSize);
+        if (!(c1 >= 0.0f && c0 < (float)size[k])) return false;
+        r.lo[k] = std::max((int)c0, 0) / kBrickSize;
+        r.hi[k] = std::min((int)c1, size[k] - 1) / kBrickSize;
+    }
+    return true;
+}
 
-    // TODO: Destroy Flow emitter
+static UpfObstacleField obstacleField(GridState& grid)
+{
+    UpfObstacleField f;
+    f.sizeX = grid.sizeX; f.sizeY = grid.sizeY; f.sizeZ = grid.sizeZ;
+    f.cellSize = grid.cellSize;
+    float c[3];
+    gridCenter(grid, c);
+    f.centerX = c[0]; f.centerY = c[1]; f.centerZ = c[2];
+    f.sdf = grid.obstacleSdf.data();
+    f.solid = grid.solid.data();
+    return f;
+}
 
-    g_state.emitters.erase(it);
+static void markBrickRange(const GridState& grid, const BrickRange& r, std::vector<uint8_t>& mask)
+{
+    const int bX = grid.bricksX, bY = grid.bricksY;
+    for (int bz = r.lo[2]; bz <= r.hi[2]; bz++)
+        for (int by = r.lo[1]; by <= r.hi[1]; by++)
+            for (int bx = r.lo[0]; bx <= r.hi[0]; bx++) mask[bx + by * bX + bz * bX * bY] = 1;
 }
 
-UPF_API void Upf_SetEmitterParams(int32_t emitterHandle, float x, float y, float z, float radius, float density)
+// Re-rasterize the dirty bricks from the bound obstacles, whose brick ranges
+// are given (empty ranges for obstacles off the grid), and relist the bricks
+// near a surface.
+static void rasterizeObstacleBricks(GridState& grid, const std::vector<BrickRange>& ranges,
+                                    const std::vector<uint8_t>& dirty)
 {
-    std::lock_guard<std::mutex> lock(g_state.mtx);
-    auto it = g_state.emitters.find(emitterHandle);
-    if (it == g_state.emitters.end()) return;
+    const int bX = grid.bricksX, bY = grid.bricksY;
+    const int32_t numBricks = (int32_t)dirty.size();
+    std::vector<int32_t> dirtyBricks;
+    for (int32_t b = 0; b < numBricks; b++) {
+        if (dirty[b]) dirtyBricks.push_back(b);
+    }
 
-    EmitterState& e = it->second;
-    e.x = x; e.y = y; e.z = z;
-    e.radius = radius;
-    e.density = density;
+    const UpfObstacleField field = obstacleField(grid);
+    const int numDirty = (int)dirtyBricks.size();
+    #pragma omp parallel for schedule(dynamic, 4) if(numDirty > 8)
+    for (int i = 0; i < numDirty; i++) {
+        const int32_t b = dirtyBricks[i];
+        const int bx = b % bX, by = (b / bX) % bY, bz = b / (bX * bY);
+        std::vector<const UpfObstacleShape*> shapes;
+        for (size_t k = 0; k < grid.boundObstacles.size(); k++) {
+            const BrickRange& r = ranges[k];
+            if (bx < r.lo[0] || bx > r.hi[0] || by < r.lo[1] || by > r.hi[1] || bz < r.lo[2] || bz > r.hi[2]) continue;
+            shapes.push_back(&grid.boundObstacles[k].shape);
+        }
+        const BrickBounds r = brickBounds(grid, b);
+        grid.brickObstacle[b] = upfRasterizeObstacles(field, shapes.data(), (int32_t)shapes.size(),
+                                                      r.x0, r.x1, r.y0, r.y1, r.z0, r.z1) ? 1 : 0;
+    }
 
-    // TODO: Update Flow emitter parameters
+    grid.obstacleBricks.clear();
+    for (int32_t b = 0; b < numBricks; b++) {
+        if (grid.brickObstacle[b]) grid.obstacleBricks.push_back(b);
+    }
+    grid.lastObstacles.rasterizedBricks += numDirty;
 }
 
-UPF_API int32_t Upf_CreateGrid(int sizeX, int sizeY, int sizeZ, float cellSize)
+// Rebind the grid's obstacles if any changed since the last binding, and
+// re-rasterize the bricks covering the old and new bounds of those that were
+// added, moved or removed. Caller must hold grid.mtx.
+static void bindObstaclesLocked(GridState& grid)
 {
-    std::lock_guard<std::mutex> lock(g_state.mtx);
-    if (!g_state.initialized) return -1;
+    if (grid.boundObstacleGeneration == g_state.obstacleGeneration.load()) return;
+    StageTimer timer;
 
-    int32_t handle = g_state.nextGridHandle++;
-    GridState& g = g_state.grids[handle];
-    g.handle = handle;
-    g.sizeX = sizeX; g.sizeY = sizeY; g.sizeZ = sizeZ;
-    g.cellSize = cellSize;
-    size_t numCells = sizeX * sizeY * sizeZ;
-    g.densityData.resize(numCells, 0.0f);
-    g.velocityData.resize(numCells * 3, 0.0f); // 3 components per cell
-    g.densityTemp.resize(numCells, 0.0f);
-    g.velocityTemp.resize(numCells * 3, 0.0f);
+    std::vector<ObstacleState> bound;
+    std::vector<BrickRange> ranges;
+    {
+        std::lock_guard<std::mutex> lock(g_state.mtx);
+        for (const auto& pair : g_state.obstacles) {
+            BrickRange r;
+            if (!obstacleBrickRange(grid, pair.second.shape, r)) continue;
+            bound.push_back(pair.second);
+            ranges.push_back(r);
+        }
+        grid.boundObstacleGeneration = g_state.obstacleGeneration.load();
+    }
+    if (bound.empty() && grid.boundObstacles.empty()) return;
 
-    // TODO: Create actual Flow grid using NvFlowExt or Context API
+    const int32_t numBricks = (int32_t)grid.brickVisited.size();
+    std::vector<uint8_t> dirty(numBricks, 0);
+    auto markRange = [&](const BrickRange& r) { markBrickRange(grid, r, dirty); };
+    std::unordered_map<int32_t, int64_t> previous, current;
+    for (const ObstacleState& o : grid.boundObstacles) previous[o.handle] = o.revision;
+    for (const ObstacleState& o : bound) current[o.handle] = o.revision;
+    for (const ObstacleState& o : grid.boundObstacles) {
+        auto it = current.find(o.handle);
+        BrickRange r;
+        if ((it == current.end() || it->second != o.revision) && obstacleBrickRange(grid, o.shape, r)) markRange(r);
+    }
+    for (size_t i = 0; i < bound.size(); i++) {
+        auto it = previous.find(bound[i].handle);
+        if (it == previous.end() || it->second != bound[i].revision) markRange(ranges[i]);
+    }
+    grid.boundObstacles.swap(bound);
 
-    return handle;
+    if (grid.obstacleSdf.empty()) {
+        grid.obstacleSdf.assign(grid.densityData.size(), kUpfObstacleBand);
+        grid.solid.assign(grid.densityData.size(), 0);
+        grid.brickObstacle.assign(numBricks, 0);
+    }
+    rasterizeObstacleBricks(grid, ranges, dirty);
+    if (grid.boundObstacles.empty()) {
+        std::vector<float>().swap(grid.obstacleSdf);
+        std::vector<uint8_t>().swap(grid.solid);
+        std::vector<uint8_t>().swap(grid.brickObstacle);
+    }
+    grid.solidVersion++;
+    grid.lastObstacles.milliseconds += timer.total();
 }
 
-UPF_API void Upf_DestroyGrid(int32_t gridHandle)
+// Plane of an optional channel, or null if the grid does not have it
+static float* planeOrNull(UpfField& f)
 {
-    std::lock_guard<std::mutex> lock(g_state.mtx);
-    auto it = g_state.grids.find(gridHandle);
-    if (it == g_state.grids.end()) return;
+    return f.empty() ? nullptr : f.data();
+}
 
-    // TODO: Destroy Flow grid
+// Current planes of a grid's optional channels, null where absent
+struct ChannelPlanes {
+    float* planes[kUpfChannelCount];
+};
 
-    g_state.grids.erase(it);
+static ChannelPlanes channelPlanes(GridState& grid)
+{
+    ChannelPlanes c;
+    for (int i = 0; i < kUpfChannelCount; i++) c.planes[i] = planeOrNull(grid.channelData[i]);
+    return c;
 }
 
-UPF_API void Upf_StepGrid(int32_t gridHandle, float dt)
+// Enforce the obstacles on cells [x0, x1) of row (y, z) of the given fields,
+// in the bricks near a surface.
+static void applyObstaclesRow(const GridState& grid, const UpfObstacleField& field, float* density,
+                              float* vx, float* vy, float* vz, float* const* channels, int y, int z, int x0, int x1)
+{
+    const int32_t rowBrick = (y / kBrickSize) * grid.bricksX + (z / kBrickSize) * grid.bricksX * grid.bricksY;
+    for (int bx = x0 / kBrickSize; bx * kBrickSize < x1; bx++) {
+        if (!grid.brickObstacle[rowBrick + bx]) continue;
+        upfApplyObstacleRow(field, density, vx, vy, vz, channels, kUpfChannelCount, y, z,
+                            std::max(x0, bx * kBrickSize), std::min(x1, (bx + 1) * kBrickSize));
+    }
+}
+
+// Enforce the obstacles on the current fields, visiting only the bricks near one.
+static void applyObstacleBricks(GridState& grid)
+{
+    if (grid.obstacleBricks.empty()) return;
+    const UpfObstacleField field = obstacleField(grid);
+    const ChannelPlanes channels = channelPlanes(grid);
+    const int numBricks = (int)grid.obstacleBricks.size();
+    #pragma omp parallel for schedule(dynamic, 4) if(numBricks > 8)
+    for (int i = 0; i < numBricks; i++) {
+        const BrickBounds r = brickBounds(grid, grid.obstacleBricks[i]);
+        for (int z = r.z0; z < r.z1; z++) {
+            for (int y = r.y0; y < r.y1; y++) {
+                upfApplyObstacleRow(field, grid.densityData.data(), grid.velX.data(), grid.velY.data(), grid.velZ.data(),
+                                    channels.planes, kUpfChannelCount, y, z, r.x0, r.x1);
+            }
+        }
+    }
+}
+
+// Per-step solver settings shared by the stages below.
+struct StepParams {
+    float dt;
+    float buoyancy;
+    float dissipation;
+    float velocityDamping;
+    float emitterStrength;
+    float emitterVelocity;
+    float densityThreshold;
+    float maxDensity;
+    float maxVelocity;
+};
+
+static StepParams makeStepParams(float dt)
 {
-    std::lock_guard<std::mutex> lock(g_state.mtx);
-    auto it = g_state.grids.find(gridHandle);
-    if (it == g_state.grids.end()) return;
     if (dt <= 0.f) dt = 0.016f;
 
-    GridState& grid = it->second;
+    // Improved simulation parameters for continuous motion
+    StepParams sp;
+    sp.dt = std::min(dt, 0.033f);
+    sp.buoyancy = 5.0f;           // Stronger upward force (increased)
+    sp.dissipation = 0.99f;       // Slower dissipation to maintain density
+    sp.velocityDamping = 0.995f;  // Minimal damping for continuous flow
+    sp.emitterStrength = 5.0f;    // Stronger continuous emission
+    sp.emitterVelocity = 8.0f;    // Strong initial velocity impulse
+    sp.densityThreshold = 0.001f; // Clear very low density
+    sp.maxDensity = 10.0f;
+    sp.maxVelocity = 20.0f;
+    return sp;
+}
+
+// Emitter sphere in grid cells, clipped to the grid
+struct EmitterFootprint {
+    float gx, gy, gz;
+    float radiusInCells, radiusSq;
+    float density;
+    float temperature, fuel, smoke;
+    int minX, maxX, minY, maxY, minZ, maxZ;
+};
+
+// Step 1: Add emitter sources from the grid's bound emitters.
+// Each z-slice is owned by one thread, which applies every emitter crossing
+// it in binding order, so cells are written without atomics.
+// Bricks overlapped by an emitter are flagged in emittedBricks.
+static void emitSources(GridState& grid, const StepParams& sp, std::vector<uint8_t>& emittedBricks)
+{
     const int sX = grid.sizeX, sY = grid.sizeY, sZ = grid.sizeZ;
     const float cs = grid.cellSize;
-    
-    const float halfX = sX * cs * 0.5f;
-    const float halfY = sY * cs * 0.5f;
-    const float halfZ = sZ * cs * 0.5f;
-    
-    // Improved simulation parameters for continuous motion
-    const float buoyancy = 5.0f;           // Stronger upward force (increased)
-    const float dissipation = 0.99f;       // Slower dissipation to maintain density
-    const float velocityDamping = 0.995f;  // Minimal damping for continuous flow
-    const float emitterStrength = 5.0f;    // Stronger continuous emission
-    const float emitterVelocity = 8.0f;    // Strong initial velocity impulse
-    const float densityThreshold = 0.001f; // Clear very low density
-    
-    dt = std::min(dt, 0.033f);
-    
-    // Step 1: Add emitter sources (PARALLELIZED)
-    for (const auto& pair : g_state.emitters) {
-        const EmitterState& emitter = pair.second;
-        
-        float emitterGridX = (emitter.x + halfX) / cs;
-        float emitterGridY = (emitter.y + halfY) / cs;
-        float emitterGridZ = (emitter.z + halfZ) / cs;
-        float radiusInCells = emitter.radius / cs;
-        
-        int minX = std::max(0, (int)(emitterGridX - radiusInCells) - 1);
-        int maxX = std::min(sX - 1, (int)(emitterGridX + radiusInCells) + 1);
-        int minY = std::max(0, (int)(emitterGridY - radiusInCells) - 1);
-        int maxY = std::min(sY - 1, (int)(emitterGridY + radiusInCells) + 1);
-        int minZ = std::max(0, (int)(emitterGridZ - radiusInCells) - 1);
-        int maxZ = std::min(sZ - 1, (int)(emitterGridZ + radiusInCells) + 1);
-        
-        const float radiusSq = radiusInCells * radiusInCells;
-        
-        // Parallelize the emitter loop
-        #pragma omp parallel for collapse(3) if(maxZ - minZ > 4)
-        for (int z = minZ; z <= maxZ; z++) {
-            for (int y = minY; y <= maxY; y++) {
-                for (int x = minX; x <= maxX; x++) {
-                    float dx = x - emitterGridX;
-                    float dy = y - emitterGridY;
-                    float dz = z - emitterGridZ;
-                    float distSq = dx*dx + dy*dy + dz*dz;
-                    
-                    if (distSq < radiusSq) {
-                        int idx = x + y * sX + z * sX * sY;
-                        float dist = std::sqrt(distSq);
-                        float falloff = 1.0f - (dist / radiusInCells);
-                        falloff = falloff * falloff * falloff;
-                        
-                        // Add density (use emitterStrength to control rate)
-                        #pragma omp atomic
-                        grid.densityData[idx] += emitter.density * falloff * dt * emitterStrength;
-                        
-                        // Add upward velocity impulse (stronger for continuous motion)
-                        #pragma omp atomic
-                        grid.velocityData[idx * 3 + 1] += falloff * emitterVelocity * dt;
+    const float dt = sp.dt;
+    const float emitterStrength = sp.emitterStrength;
+    const float emitterVelocity = sp.emitterVelocity;
+
+    float c[3];
+    gridCenter(grid, c);
+    const float halfX = sX * cs * 0.5f - c[0];
+    const float halfY = sY * cs * 0.5f - c[1];
+    const float halfZ = sZ * cs * 0.5f - c[2];
+
+    std::vector<EmitterFootprint> footprints;
+    footprints.reserve(grid.boundEmitters.size());
+    int zLo = sZ, zHi = -1;
+    for (const EmitterState& emitter : grid.boundEmitters) {
+        // In cells from the center of cell 0, as Upf_SampleGrid and the tracers measure
+        EmitterFootprint f;
+        f.gx = (emitter.x + halfX) / cs - 0.5f;
+        f.gy = (emitter.y + halfY) / cs - 0.5f;
+        f.gz = (emitter.z + halfZ) / cs - 0.5f;
+        f.radiusInCells = emitter.radius / cs;
+        f.radiusSq = f.radiusInCells * f.radiusInCells;
+        f.density = emitter.density;
+        f.temperature = emitter.temperature;
+        f.fuel = emitter.fuel;
+        f.smoke = emitter.smoke;
+
+        f.minX = std::max(0, (int)(f.gx - f.radiusInCells) - 1);
+        f.maxX = std::min(sX - 1, (int)(f.gx + f.radiusInCells) + 1);
+        f.minY = std::max(0, (int)(f.gy - f.radiusInCells) - 1);
+        f.maxY = std::min(sY - 1, (int)(f.gy + f.radiusInCells) + 1);
+        f.minZ = std::max(0, (int)(f.gz - f.radiusInCells) - 1);
+        f.maxZ = std::min(sZ - 1, (int)(f.gz + f.radiusInCells) + 1);
+        if (f.minX > f.maxX || f.minY > f.maxY || f.minZ > f.maxZ) continue;
+
+        for (int bz = f.minZ / kBrickSize; bz <= f.maxZ / kBrickSize; bz++)
+            for (int by = f.minY / kBrickSize; by <= f.maxY / kBrickSize; by++)
+                for (int bx = f.minX / kBrickSize; bx <= f.maxX / kBrickSize; bx++)
+                    emittedBricks[bx + by * grid.bricksX + bz * grid.bricksX * grid.bricksY] = 1;
+
+        zLo = std::min(zLo, f.minZ);
+        zHi = std::max(zHi, f.maxZ);
+        footprints.push_back(f);
+    }
+    if (footprints.empty()) return;
+
+    float* density = grid.densityData.data();
+    float* velY = grid.velY.data();
+    const uint8_t* solid = grid.solid.empty() ? nullptr : grid.solid.data();
+    float* temperature = planeOrNull(grid.channelData[UpfSlot_Temperature]);
+    float* fuel = planeOrNull(grid.channelData[UpfSlot_Fuel]);
+    float* smoke = planeOrNull(grid.channelData[UpfSlot_Smoke]);
+
+    #pragma omp parallel for schedule(dynamic, 1) if(zHi - zLo > 4)
+    for (int z = zLo; z <= zHi; z++) {
+        for (const EmitterFootprint& f : footprints) {
+            if (z < f.minZ || z > f.maxZ) continue;
+            const float dz = z - f.gz;
+            for (int y = f.minY; y <= f.maxY; y++) {
+                const float dy = y - f.gy;
+                for (int x = f.minX; x <= f.maxX; x++) {
+                    const float dx = x - f.gx;
+                    const float distSq = dx*dx + dy*dy + dz*dz;
+                    if (distSq >= f.radiusSq) continue;
+
+                    const int idx = x + y * sX + z * sX * sY;
+                    if (solid && solid[idx]) continue;
+                    float falloff = 1.0f - (std::sqrt(distSq) / f.radiusInCells);
+                    falloff = falloff * falloff * falloff;
+
+                    // Add density (use emitterStrength to control rate)
+                    density[idx] += f.density * falloff * dt * emitterStrength;
+                    // Add upward velocity impulse (stronger for continuous motion)
+                    velY[idx] += falloff * emitterVelocity * dt;
+
+                    // Optional channels: temperature relaxes toward the emitter's,
+                    // fuel and smoke accumulate like density
+                    const float rate = falloff * dt * emitterStrength;
+                    if (temperature && f.temperature != 0.0f) {
+                        temperature[idx] += (f.temperature - temperature[idx]) * std::min(rate, 1.0f);
                     }
+                    if (fuel) fuel[idx] += f.fuel * rate;
+                    if (smoke) smoke[idx] += f.smoke * rate;
                 }
             }
         }
     }
-    
-    // Step 2: Advection (PARALLELIZED)
+}
+
+static UpfAdvectParams makeAdvectParams(GridState& grid, const StepParams& sp, bool toTemp)
+{
+    UpfAdvectParams adv;
+    adv.sizeX = grid.sizeX; adv.sizeY = grid.sizeY; adv.sizeZ = grid.sizeZ;
+    adv.dtOverCs = sp.dt / grid.cellSize;
+    adv.dissipation = sp.dissipation;
+    adv.velocityDamping = sp.velocityDamping;
+    adv.buoyancyDt = sp.buoyancy * sp.dt;
+    adv.buoyancyThreshold = 0.001f;
+    adv.densityThreshold = sp.densityThreshold;
+    adv.maxDensity = sp.maxDensity;
+    adv.maxVelocity = sp.maxVelocity;
+    adv.densityActivity = 2.0f * kActivityEpsilon;
+    adv.midDensity = adv.midVx = adv.midVy = adv.midVz = nullptr;
+
+    const UpfCombustionParams& cp = grid.combustion;
+    adv.channels = grid.channels;
+    adv.channelDissipation[UpfSlot_Temperature] = std::max(0.0f, 1.0f - cp.coolingRate * sp.dt);
+    adv.channelDissipation[UpfSlot_Fuel] = std::max(0.0f, 1.0f - cp.fuelFade * sp.dt);
+    adv.channelDissipation[UpfSlot_Burn] = 1.0f;
+    adv.channelDissipation[UpfSlot_Smoke] = std::max(0.0f, 1.0f - cp.smokeFade * sp.dt);
+    adv.temperatureBuoyancyDt = cp.buoyancyPerTemp * sp.dt;
+    adv.ignitionTemp = cp.ignitionTemp;
+    adv.burnPerTempDt = cp.burnPerTemp * sp.dt;
+    adv.fuelPerBurn = cp.fuelPerBurn;
+    adv.burnPerFuel = cp.fuelPerBurn > 0.0f ? 1.0f / cp.fuelPerBurn : FLT_MAX;
+    adv.tempPerBurn = cp.tempPerBurn;
+    adv.smokePerBurn = cp.smokePerBurn;
+
+    // toTemp: current fields -> temp buffers (fused, swapped afterwards);
+    // otherwise temp copies -> current fields.
+    UpfField& srcD = toTemp ? grid.densityData : grid.densityTemp;
+    UpfField& srcX = toTemp ? grid.velX : grid.velXTemp;
+    UpfField& srcY = toTemp ? grid.velY : grid.velYTemp;
+    UpfField& srcZ = toTemp ? grid.velZ : grid.velZTemp;
+    UpfField& dstD = toTemp ? grid.densityTemp : grid.densityData;
+    UpfField& dstX = toTemp ? grid.velXTemp : grid.velX;
+    UpfField& dstY = toTemp ? grid.velYTemp : grid.velY;
+    UpfField& dstZ = toTemp ? grid.velZTemp : grid.velZ;
+    adv.srcDensity = srcD.data();
+    adv.srcVx = srcX.data();
+    adv.srcVy = srcY.data();
+    adv.srcVz = srcZ.data();
+    adv.dstDensity = dstD.data();
+    adv.dstVx = dstX.data();
+    adv.dstVy = dstY.data();
+    adv.dstVz = dstZ.data();
+    for (int c = 0; c < kUpfChannelCount; c++) {
+        adv.midChannel[c] = nullptr;
+        adv.srcChannel[c] = planeOrNull(toTemp ? grid.channelData[c] : grid.channelTemp[c]);
+        adv.dstChannel[c] = planeOrNull(toTemp ? grid.channelTemp[c] : grid.channelData[c]);
+    }
+    return adv;
+}
+
+// Step 2: Advection (PARALLELIZED)
+static void advectFields(GridState& grid, const StepParams& sp)
+{
+    const int sX = grid.sizeX, sY = grid.sizeY, sZ = grid.sizeZ;
+
     std::copy(grid.densityData.begin(), grid.densityData.end(), grid.densityTemp.begin());
-    std::copy(grid.velocityData.begin(), grid.velocityData.end(), grid.velocityTemp.begin());
-    
-    const float dtOverCs = dt / cs;
-    
-    #pragma omp parallel for collapse(3) if(sZ > 8)
+    std::copy(grid.velX.begin(), grid.velX.end(), grid.velXTemp.begin());
+    std::copy(grid.velY.begin(), grid.velY.end(), grid.velYTemp.begin());
+    std::copy(grid.velZ.begin(), grid.velZ.end(), grid.velZTemp.begin());
+    for (int c = 0; c < kUpfChannelCount; c++) {
+        std::copy(grid.channelData[c].begin(), grid.channelData[c].end(), grid.channelTemp[c].begin());
+    }
+
+    const UpfAdvectParams adv = makeAdvectParams(grid, sp, false);
+    const UpfAdvectRowFn advectRow = upfSelectAdvectRow((UpfSimdLevel)g_state.simdLevel.load(), false, grid.channels);
+
+    #pragma omp parallel for collapse(2) if(sZ > 8)
     for (int z = 2; z < sZ - 2; z++) {
         for (int y = 2; y < sY - 2; y++) {
-            for (int x = 2; x < sX - 2; x++) {
-                int idx = x + y * sX + z * sX * sY;
-                int vidx = idx * 3;
-                
-                float px = x - grid.velocityTemp[vidx + 0] * dtOverCs;
-                float py = y - grid.velocityTemp[vidx + 1] * dtOverCs;
-                float pz = z - grid.velocityTemp[vidx + 2] * dtOverCs;
-                
-                px = std::max(1.5f, std::min(px, (float)(sX - 2.5f)));
-                py = std::max(1.5f, std::min(py, (float)(sY - 2.5f)));
-                pz = std::max(1.5f, std::min(pz, (float)(sZ - 2.5f)));
-                
-                int x0 = (int)px, y0 = (int)py, z0 = (int)pz;
-                float fx = px - x0, fy = py - y0, fz = pz - z0;
-                
-                int i000 = x0 + y0 * sX + z0 * sX * sY;
-                int i100 = i000 + 1;
-                int i010 = i000 + sX;
-                int i110 = i000 + sX + 1;
-                int i001 = i000 + sX * sY;
-                int i101 = i001 + 1;
-                int i011 = i001 + sX;
-                int i111 = i001 + sX + 1;
-                
-                // Trilinear interpolation for density
-                float d000 = grid.densityTemp[i000];
-                float d100 = grid.densityTemp[i100];
-                float d010 = grid.densityTemp[i010];
-                float d110 = grid.densityTemp[i110];
-                float d001 = grid.densityTemp[i001];
-                float d101 = grid.densityTemp[i101];
-                float d011 = grid.densityTemp[i011];
-                float d111 = grid.densityTemp[i111];
-                
-                float d00 = d000 + (d100 - d000) * fx;
-                float d10 = d010 + (d110 - d010) * fx;
-                float d01 = d001 + (d101 - d001) * fx;
-                float d11 = d011 + (d111 - d011) * fx;
-                float d0 = d00 + (d10 - d00) * fy;
-                float d1 = d01 + (d11 - d01) * fy;
-                
-                grid.densityData[idx] = (d0 + (d1 - d0) * fz) * dissipation;
-                
-                // Velocity self-advection
-                for (int c = 0; c < 3; c++) {
-                    float v000 = grid.velocityTemp[i000 * 3 + c];
-                    float v100 = grid.velocityTemp[i100 * 3 + c];
-                    float v010 = grid.velocityTemp[i010 * 3 + c];
-                    float v110 = grid.velocityTemp[i110 * 3 + c];
-                    float v001 = grid.velocityTemp[i001 * 3 + c];
-                    float v101 = grid.velocityTemp[i101 * 3 + c];
-                    float v011 = grid.velocityTemp[i011 * 3 + c];
-                    float v111 = grid.velocityTemp[i111 * 3 + c];
-                    
-                    float v00 = v000 + (v100 - v000) * fx;
-                    float v10 = v010 + (v110 - v010) * fx;
-                    float v01 = v001 + (v101 - v001) * fx;
-                    float v11 = v011 + (v111 - v011) * fx;
-                    float v0 = v00 + (v10 - v00) * fy;
-                    float v1 = v01 + (v11 - v01) * fy;
-                    
-                    grid.velocityData[vidx + c] = (v0 + (v1 - v0) * fz) * velocityDamping;
-                }
-            }
-        }
-    }
-    
-    // Step 3: Buoyancy (PARALLELIZED)
-    #pragma omp parallel for collapse(3) if(sZ > 8)
-    for (int z = 0; z < sZ; z++) {
-        for (int y = 0; y < sY; y++) {
-            for (int x = 0; x < sX; x++) {
-                int idx = x + y * sX + z * sX * sY;
-                float density = grid.densityData[idx];
-                
-                // Apply buoyancy force (lower threshold for better response)
-                if (density > 0.001f) {
-                    grid.velocityData[idx * 3 + 1] += density * buoyancy * dt;
-                }
-            }
+            advectRow(adv, y, z, 2, sX - 2);
         }
     }
-    
-    // Step 4: Clamp and clear low density values (PARALLELIZED)
+}
+
+// Step 3: Buoyancy (PARALLELIZED), after combustion on grids with temperature and fuel
+static void applyBuoyancy(GridState& grid, const StepParams& sp)
+{
     const int numCells = (int)grid.densityData.size();
+    const float buoyancyDt = sp.buoyancy * sp.dt;
+    const UpfAdvectParams adv = makeAdvectParams(grid, sp, false);
+    float* temperature = planeOrNull(grid.channelData[UpfSlot_Temperature]);
+    float* fuel = planeOrNull(grid.channelData[UpfSlot_Fuel]);
+    float* burn = planeOrNull(grid.channelData[UpfSlot_Burn]);
+    float* smoke = planeOrNull(grid.channelData[UpfSlot_Smoke]);
+
     #pragma omp parallel for if(numCells > 1000)
     for (int i = 0; i < numCells; i++) {
-        // Clamp density
-        if (grid.densityData[i] > 10.0f) {
-            grid.densityData[i] = 10.0f;
-        } else if (grid.densityData[i] < densityThreshold) {
-            grid.densityData[i] = 0.0f;  // Clear very low density to prevent accumulation
+        float density = grid.densityData[i];
+
+        // Apply buoyancy force (lower threshold for better response)
+        if (density > 0.001f) {
+            grid.velY[i] += density * buoyancyDt;
         }
-        
-        // Clamp velocity to prevent instability
-        int vidx = i * 3;
-        for (int c = 0; c < 3; c++) {
-            if (grid.velocityData[vidx + c] > 20.0f) grid.velocityData[vidx + c] = 20.0f;
-            else if (grid.velocityData[vidx + c] < -20.0f) grid.velocityData[vidx + c] = -20.0f;
+
+        if (temperature && fuel) {
+            float produced = smoke ? smoke[i] : 0.0f;
+            const float burned = upfCombustCell(adv, temperature[i], fuel[i], produced);
+            if (smoke) smoke[i] = produced;
+            if (burn) burn[i] = burned;
+        }
+        if (temperature) {
+            float t = std::max(-1.0f, std::min(temperature[i], 1.0f));
+            if (std::fabs(t) < sp.densityThreshold) t = 0.0f;
+            grid.velY[i] += t * adv.temperatureBuoyancyDt;
         }
     }
 }
 
-UPF_API const void* Upf_ExportGridDensity(int32_t gridHandle, int* outSizeX, int* outSizeY, int* outSizeZ, int* outFormat)
+// Step 4: Clamp and clear low density values (PARALLELIZED)
+static void clampFields(GridState& grid, const StepParams& sp)
 {
-    std::lock_guard<std::mutex> lock(g_state.mtx);
-    auto it = g_state.grids.find(gridHandle);
-    if (it == g_state.grids.end()) return nullptr;
+    const int numCells = (int)grid.densityData.size();
+    const float maxV = sp.maxVelocity;
+
+    #pragma omp parallel for if(numCells > 1000)
+    for (int i = 0; i < numCells; i++) {
+        // Clamp density
+        if (grid.densityData[i] > sp.maxDensity) {
+            grid.densityData[i] = sp.maxDensity;
+        } else if (grid.densityData[i] < sp.densityThreshold) {
+            grid.densityData[i] = 0.0f;  // Clear very low density to prevent accumulation
+        }
+
+        // Clamp velocity to prevent instability
+        grid.velX[i] = std::max(-maxV, std::min(grid.velX[i], maxV));
+        grid.velY[i] = std::max(-maxV, std::min(grid.velY[i], maxV));
+        grid.velZ[i] = std::max(-maxV, std::min(grid.velZ[i], maxV));
+    }
+
+    if (!grid.channelData[UpfSlot_Temperature].empty()) {
+        float* temperature = grid.channelData[UpfSlot_Temperature].data();
+        #pragma omp parallel for if(numCells > 1000)
+        for (int i = 0; i < numCells; i++) {
+            const float t = std::max(-1.0f, std::min(temperature[i], 1.0f));
+            temperature[i] = std::fabs(t) < sp.densityThreshold ? 0.0f : t;
+        }
+    }
+    for (int c : { UpfSlot_Fuel, UpfSlot_Smoke }) {
+        if (grid.channelData[c].empty()) continue;
+        float* v = grid.channelData[c].data();
+        #pragma omp parallel for if(numCells > 1000)
+        for (int i = 0; i < numCells; i++) {
+            const float clamped = std::min(v[i], sp.maxDensity);
+            v[i] = clamped < sp.densityThreshold ? 0.0f : clamped;
+        }
+    }
+}
+
+// Plain sweep of cells [x0, x1) of row (y, z) for the higher-order passes:
+// the 2-cell border is copied.
+static void sweepRowPlain(const UpfAdvectParams& adv, UpfAdvectRowFn advectRow, int y, int z, int x0, int x1)
+{
+    const int sX = adv.sizeX, sY = adv.sizeY, sZ = adv.sizeZ;
+    const int ax0 = std::max(x0, 2), ax1 = std::min(x1, sX - 2);
+    if (z < 2 || z >= sZ - 2 || y < 2 || y >= sY - 2 || ax0 >= ax1) {
+        upfCopyRow(adv, y, z, x0, x1);
+        return;
+    }
+    advectRow(adv, y, z, ax0, ax1);
+    if (x0 < ax0) upfCopyRow(adv, y, z, x0, ax0);
+    if (ax1 < x1) upfCopyRow(adv, y, z, ax1, x1);
+}
+
+// Fused sweep of cells [x0, x1) of row (y, z): the 2-cell border is not
+// advected, only carried over. Returns the row activity.
+static float sweepRowFused(const UpfAdvectParams& adv, UpfAdvectRowFn advectRow, int y, int z, int x0, int x1)
+{
+    const int sX = adv.sizeX, sY = adv.sizeY, sZ = adv.sizeZ;
+    const int ax0 = std::max(x0, 2), ax1 = std::min(x1, sX - 2);
+    if (z < 2 || z >= sZ - 2 || y < 2 || y >= sY - 2 || ax0 >= ax1) {
+        return upfPassThroughRow(adv, y, z, x0, x1);
+    }
+    float activity = advectRow(adv, y, z, ax0, ax1);
+    if (x0 < ax0) activity = std::max(activity, upfPassThroughRow(adv, y, z, x0, ax0));
+    if (ax1 < x1) activity = std::max(activity, upfPassThroughRow(adv, y, z, ax1, x1));
+    return activity;
+}
+
+static void swapFieldBuffers(GridState& grid)
+{
+    grid.densityData.swap(grid.densityTemp);
+    grid.velX.swap(grid.velXTemp);
+    grid.velY.swap(grid.velYTemp);
+    grid.velZ.swap(grid.velZTemp);
+    for (int c = 0; c < kUpfChannelCount; c++) grid.channelData[c].swap(grid.channelTemp[c]);
+}
+
+// Mark every brick visited and active, after a pass that wrote the whole grid.
+static void markAllBricks(GridState& grid)
+{
+    std::fill(grid.brickVisited.begin(), grid.brickVisited.end(), (uint8_t)1);
+    std::fill(grid.brickActivity.begin(), grid.brickActivity.end(), 1.0f);
+    grid.activeBricks.resize(grid.brickVisited.size());
+    for (size_t b = 0; b < grid.activeBricks.size(); b++) grid.activeBricks[b] = (int32_t)b;
+}
+
+static void releaseAdvectScratch(GridState& grid)
+{
+    for (UpfField* v : { &grid.midDensity, &grid.midVx, &grid.midVy, &grid.midVz,
+                         &grid.barDensity, &grid.barVx, &grid.barVy, &grid.barVz }) {
+        v->clear();
+    }
+    for (int c = 0; c < kUpfChannelCount; c++) {
+        grid.channelMid[c].clear();
+        grid.channelBar[c].clear();
+    }
+}
+
+// One plain pass of a higher-order scheme over the rows the sweep covers:
+// every row, or the rows of the active bricks.
+static void runPlainPass(const GridState& grid, bool sparse, const UpfAdvectParams& adv, UpfAdvectRowFn advectRow)
+{
+    if (!sparse) {
+        const int sY = grid.sizeY, sZ = grid.sizeZ;
+        #pragma omp parallel for collapse(2) if(sZ > 8)
+        for (int z = 0; z < sZ; z++) {
+            for (int y = 0; y < sY; y++) {
+                sweepRowPlain(adv, advectRow, y, z, 0, grid.sizeX);
+            }
+        }
+        return;
+    }
+
+    const int numActive = (int)grid.activeBricks.size();
+    #pragma omp parallel for schedule(dynamic, 4) if(numActive > 8)
+    for (int i = 0; i < numActive; i++) {
+        const BrickBounds r = brickBounds(grid, grid.activeBricks[i]);
+        for (int z = r.z0; z < r.z1; z++) {
+            for (int y = r.y0; y < r.y1; y++) {
+                sweepRowPlain(adv, advectRow, y, z, r.x0, r.x1);
+            }
+        }
+    }
+}
+
+// Params and row kernel for the fused sweep. For MacCormack and BFECC this
+// first runs the plain passes (see UpfAdvection.h): the forward estimate,
+// without dissipation, into mid*, and for BFECC the compensated field into bar*.
+static UpfAdvectParams prepareFusedAdvect(GridState& grid, const StepParams& sp, bool sparse, UpfAdvectRowFn& fusedRow)
+{
+    const UpfSimdLevel level = (UpfSimdLevel)g_state.simdLevel.load();
+    UpfAdvectParams adv = makeAdvectParams(grid, sp, true);
+    if (grid.advection == UpfAdvection_SemiLagrangian) {
+        fusedRow = upfSelectAdvectRow(level, true, grid.channels);
+        return adv;
+    }
+
+    const size_t numCells = grid.densityData.size();
+    const bool bfecc = grid.advection == UpfAdvection_BFECC;
+    for (UpfField* v : { &grid.midDensity, &grid.midVx, &grid.midVy, &grid.midVz }) v->resize(numCells, 0.0f);
+    if (bfecc) {
+        for (UpfField* v : { &grid.barDensity, &grid.barVx, &grid.barVy, &grid.barVz }) v->resize(numCells, 0.0f);
+    }
+    for (int c = 0; c < kUpfChannelCount; c++) {
+        if (c == UpfSlot_Burn || grid.channelData[c].empty()) continue;
+        grid.channelMid[c].resize(numCells, 0.0f);
+        if (bfecc) grid.channelBar[c].resize(numCells, 0.0f);
+    }
+
+    UpfAdvectParams forward = adv;
+    forward.dissipation = 1.0f;
+    forward.velocityDamping = 1.0f;
+    forward.dstDensity = grid.midDensity.data();
+    forward.dstVx = grid.midVx.data();
+    forward.dstVy = grid.midVy.data();
+    forward.dstVz = grid.midVz.data();
+    for (int c = 0; c < kUpfChannelCount; c++) {
+        forward.channelDissipation[c] = 1.0f;
+        forward.dstChannel[c] = planeOrNull(grid.channelMid[c]);
+    }
+    runPlainPass(grid, sparse, forward, upfSelectAdvectRow(level, false, grid.channels));
+
+    adv.midDensity = grid.midDensity.data();
+    adv.midVx = grid.midVx.data();
+    adv.midVy = grid.midVy.data();
+    adv.midVz = grid.midVz.data();
+    for (int c = 0; c < kUpfChannelCount; c++) adv.midChannel[c] = planeOrNull(grid.channelMid[c]);
+    if (!bfecc) {
+        fusedRow = upfSelectCorrectionRow(level, UpfCorrect_MacCormack, grid.channels);
+        return adv;
+    }
+
+    UpfAdvectParams backward = adv;
+    backward.dstDensity = grid.barDensity.data();
+    backward.dstVx = grid.barVx.data();
+    backward.dstVy = grid.barVy.data();
+    backward.dstVz = grid.barVz.data();
+    for (int c = 0; c < kUpfChannelCount; c++) backward.dstChannel[c] = planeOrNull(grid.channelBar[c]);
+    runPlainPass(grid, sparse, backward, upfSelectCorrectionRow(level, UpfCorrect_BfeccBackward, grid.channels));
+
+    adv.midDensity = grid.barDensity.data();
+    adv.midVx = grid.barVx.data();
+    adv.midVy = grid.barVy.data();
+    adv.midVz = grid.barVz.data();
+    for (int c = 0; c < kUpfChannelCount; c++) adv.midChannel[c] = planeOrNull(grid.channelBar[c]);
+    fusedRow = upfSelectCorrectionRow(level, UpfCorrect_BfeccForward, grid.channels);
+    return adv;
+}
+
+// Steps 2-4 in one sweep: each cell is advected from the current fields into
+// the temp buffers with buoyancy and limits applied, then the buffers swap.
+static void sweepFused(GridState& grid, const StepParams& sp)
+{
+    const int sX = grid.sizeX, sY = grid.sizeY, sZ = grid.sizeZ;
+    UpfAdvectRowFn advectRow;
+    const UpfAdvectParams adv = prepareFusedAdvect(grid, sp, false, advectRow);
+    const bool obstacles = !grid.obstacleBricks.empty();
+    const UpfObstacleField field = obstacleField(grid);
+
+    #pragma omp parallel for collapse(2) if(sZ > 8)
+    for (int z = 0; z < sZ; z++) {
+        for (int y = 0; y < sY; y++) {
+            sweepRowFused(adv, advectRow, y, z, 0, sX);
+            if (obstacles) applyObstaclesRow(grid, field, adv.dstDensity, adv.dstVx, adv.dstVy, adv.dstVz, adv.dstChannel, y, z, 0, sX);
+        }
+    }
+
+    swapFieldBuffers(grid);
+    markAllBricks(grid);
+}
+
+// Sparse variant of sweepFused: only bricks with content, bricks emitted into
+// and a one-brick margin around them are visited.
+static void sweepFusedSparse(GridState& grid, const StepParams& sp, const std::vector<uint8_t>& emittedBricks)
+{
+    const int bX = grid.bricksX, bY = grid.bricksY, bZ = grid.bricksZ;
+    const int32_t numBricks = bX * bY * bZ;
+
+    std::vector<uint8_t> visit(numBricks, 0);
+    for (int bz = 0; bz < bZ; bz++) {
+        for (int by = 0; by < bY; by++) {
+            for (int bx = 0; bx < bX; bx++) {
+                const int32_t b = bx + by * bX + bz * bX * bY;
+                if (grid.brickActivity[b] <= kActivityEpsilon && !emittedBricks[b]) continue;
+                for (int z = std::max(0, bz - 1); z <= std::min(bZ - 1, bz + 1); z++)
+                    for (int y = std::max(0, by - 1); y <= std::min(bY - 1, by + 1); y++)
+                        for (int x = std::max(0, bx - 1); x <= std::min(bX - 1, bx + 1); x++)
+                            visit[x + y * bX + z * bX * bY] = 1;
+            }
+        }
+    }
+
+    grid.activeBricks.clear();
+    for (int32_t b = 0; b < numBricks; b++) {
+        if (visit[b]) grid.activeBricks.push_back(b);
+    }
+
+    // Bricks leaving the sweep hold only sub-epsilon velocity: zero them in
+    // both buffers so everything outside the visited set stays zero.
+    #pragma omp parallel for schedule(dynamic, 16) if(numBricks > 64)
+    for (int32_t b = 0; b < numBricks; b++) {
+        if (!grid.brickVisited[b] || visit[b]) continue;
+        clearBrick(grid, b, grid.densityData); clearBrick(grid, b, grid.densityTemp);
+        clearBrick(grid, b, grid.velX); clearBrick(grid, b, grid.velXTemp);
+        clearBrick(grid, b, grid.velY); clearBrick(grid, b, grid.velYTemp);
+        clearBrick(grid, b, grid.velZ); clearBrick(grid, b, grid.velZTemp);
+        for (UpfField* v : { &grid.midDensity, &grid.midVx, &grid.midVy, &grid.midVz,
+                             &grid.barDensity, &grid.barVx, &grid.barVy, &grid.barVz }) {
+            if (!v->empty()) clearBrick(grid, b, *v);
+        }
+        for (int c = 0; c < kUpfChannelCount; c++) {
+            for (UpfField* v : { &grid.channelData[c], &grid.channelTemp[c], &grid.channelMid[c], &grid.channelBar[c] }) {
+                if (!v->empty()) clearBrick(grid, b, *v);
+            }
+        }
+        grid.brickActivity[b] = 0.0f;
+    }
+
+    UpfAdvectRowFn advectRow;
+    const UpfAdvectParams adv = prepareFusedAdvect(grid, sp, true, advectRow);
+    const int numActive = (int)grid.activeBricks.size();
+    const UpfObstacleField field = obstacleField(grid);
+
+    #pragma omp parallel for schedule(dynamic, 4) if(numActive > 8)
+    for (int i = 0; i < numActive; i++) {
+        const int32_t b = grid.activeBricks[i];
+        const BrickBounds r = brickBounds(grid, b);
+        const bool obstacle = !grid.brickObstacle.empty() && grid.brickObstacle[b];
+        float activity = 0.0f;
+        for (int z = r.z0; z < r.z1; z++) {
+            for (int y = r.y0; y < r.y1; y++) {
+                activity = std::max(activity, sweepRowFused(adv, advectRow, y, z, r.x0, r.x1));
+                if (obstacle) {
+                    upfApplyObstacleRow(field, adv.dstDensity, adv.dstVx, adv.dstVy, adv.dstVz, adv.dstChannel, kUpfChannelCount,
+                                        y, z, r.x0, r.x1);
+                }
+            }
+        }
+        grid.brickActivity[b] = activity;
+    }
+
+    grid.brickVisited.swap(visit);
+    swapFieldBuffers(grid);
+}
+
+// Step 5 (optional): make the velocity divergence free. The pressure solve is
+// global, so afterwards brick activity is refreshed over the whole grid; bricks
+// that only picked up sub-epsilon velocity outside the visited set are cleared
+// so sparse stepping keeps its zero-outside-visited invariant.
+static void projectVelocity(GridState& grid)
+{
+    UpfProjectParams pp;
+    pp.sizeX = grid.sizeX; pp.sizeY = grid.sizeY; pp.sizeZ = grid.sizeZ;
+    pp.vx = grid.velX.data();
+    pp.vy = grid.velY.data();
+    pp.vz = grid.velZ.data();
+    pp.solid = grid.solid.empty() ? nullptr : grid.solid.data();
+    pp.solidVersion = grid.solidVersion;
+    pp.maxCycles = grid.projectionMaxCycles;
+    pp.budgetMs = grid.projectionBudgetMs;
+    pp.tolerance = grid.projectionTolerance;
+    grid.lastProjection = upfProject(grid.pressure, pp);
+    // The first cycle always runs, so a tight budget can be overrun, or run out before convergence
+    const UpfProjectResult& pr = grid.lastProjection;
+    if (pp.budgetMs > 0.0f && (pr.milliseconds > pp.budgetMs ||
+        (pr.cycles < pp.maxCycles && pr.residual > pp.tolerance * pr.divergence))) {
+        postEvent(UpfEvent_BudgetExceeded, grid.handle, 0, pr.milliseconds, pp.budgetMs, "projection");
+    }
+
+    // The gradient can point into walls again; the obstacle bricks are masked
+    // in the same pass.
+    const int32_t numBricks = (int32_t)grid.brickVisited.size();
+    const UpfObstacleField field = obstacleField(grid);
+    const ChannelPlanes channels = channelPlanes(grid);
+    #pragma omp parallel for schedule(dynamic, 16) if(numBricks > 64)
+    for (int32_t b = 0; b < numBricks; b++) {
+        const BrickBounds r = brickBounds(grid, b);
+        const bool obstacle = !grid.brickObstacle.empty() && grid.brickObstacle[b];
+        float activity = 0.0f;
+        for (int z = r.z0; z < r.z1; z++) {
+            for (int y = r.y0; y < r.y1; y++) {
+                if (obstacle) {
+                    upfApplyObstacleRow(field, grid.densityData.data(), grid.velX.data(), grid.velY.data(), grid.velZ.data(),
+                                        channels.planes, kUpfChannelCount, y, z, r.x0, r.x1);
+                }
+                const size_t row = (size_t)y * grid.sizeX + (size_t)z * grid.sizeX * grid.sizeY;
+                for (size_t i = row + r.x0; i < row + r.x1; i++) {
+                    activity = std::max(activity, std::max(std::fabs(grid.velX[i]), std::max(std::fabs(grid.velY[i]), std::fabs(grid.velZ[i]))));
+                    if (grid.densityData[i] > 0.0f) activity = std::max(activity, 2.0f * kActivityEpsilon);
+                    for (const float* c : channels.planes) {
+                        if (c && c[i] != 0.0f) activity = std::max(activity, 2.0f * kActivityEpsilon);
+                    }
+                }
+            }
+        }
+        if (activity > kActivityEpsilon) {
+            grid.brickVisited[b] = 1;
+        } else if (!grid.brickVisited[b]) {
+            clearBrick(grid, b, grid.velX);
+            clearBrick(grid, b, grid.velY);
+            clearBrick(grid, b, grid.velZ);
+            activity = 0.0f;
+        }
+        grid.brickActivity[b] = activity;
+    }
+}
+
+#ifdef _OPENMP
+// OpenMP's thread count before the bridge first changed it (OMP_NUM_THREADS or one per core).
+static int defaultThreadCount()
+{
+    static const int threads = omp_get_max_threads();
+    return threads;
+}
+#endif
+
+// Thread count for grid steps (Upf_SetThreadCount, or OpenMP's default).
+static int stepThreadCount()
+{
+#ifdef _OPENMP
+    const int32_t threads = g_state.threadCount.load();
+    return threads > 0 ? threads : defaultThreadCount();
+#else
+    return 1;
+#endif
+}
+
+// Run the calling thread's OpenMP regions on a thread count for the scope's
+// lifetime, then restore the caller's own setting.
+struct ScopedThreadCount {
+#ifdef _OPENMP
+    const int saved = omp_get_max_threads();
+    explicit ScopedThreadCount(int threads) { omp_set_num_threads(threads); }
+    ~ScopedThreadCount() { omp_set_num_threads(saved); }
+#else
+    explicit ScopedThreadCount(int) {}
+#endif
+    ScopedThreadCount(const ScopedThreadCount&) = delete;
+    ScopedThreadCount& operator=(const ScopedThreadCount&) = delete;
+};
+
+#ifdef _OPENMP
+// Allow one level of nested regions while any concurrent grid batch runs. The
+// setting is process-wide, so the last batch out restores the host's value.
+struct ScopedNestedRegions {
+    ScopedNestedRegions()
+    {
+        std::lock_guard<std::mutex> lock(g_state.nestedMtx);
+        if (g_state.nestedBatches++ == 0) {
+            g_state.savedActiveLevels = omp_get_max_active_levels();
+            if (g_state.savedActiveLevels < 2) omp_set_max_active_levels(2);
+        }
+    }
+    ~ScopedNestedRegions()
+    {
+        std::lock_guard<std::mutex> lock(g_state.nestedMtx);
+        if (--g_state.nestedBatches == 0) omp_set_max_active_levels(g_state.savedActiveLevels);
+    }
+    ScopedNestedRegions(const ScopedNestedRegions&) = delete;
+    ScopedNestedRegions& operator=(const ScopedNestedRegions&) = delete;
+};
+#endif
+
+// Step a grid on Flow's solver: bound emitters go in as sphere emitters and
+// the readback replaces the dense fields. Caller must hold grid.mtx.
+static void stepFlowGridLocked(GridState& grid, float dt)
+{
+    bindEmittersLocked(grid);
+    std::vector<UpfEmitterDesc> emitters;
+    emitters.reserve(grid.boundEmitters.size());
+    for (const EmitterState& e : grid.boundEmitters) {
+        emitters.push_back({ e.handle, e.x, e.y, e.z, e.radius, e.density });
+    }
+
+    UpfStepTimings& t = grid.lastTimings;
+    t = {};
+    StageTimer timer;
+    bool stepped;
+    {
+        std::lock_guard<std::mutex> lock(g_state.flowMtx);
+        stepped = upfFlowGridSimulate(flowDevice(), grid.flowGrid, dt, emitters.data(), (int)emitters.size());
+    }
+    // The readback is the grid's own copy; other Flow grids can step meanwhile
+    if (stepped) {
+        upfFlowGridResample(grid.flowGrid, grid.densityData.data(), grid.velX.data(), grid.velY.data(),
+                            grid.velZ.data());
+    }
+    t.advectMs = timer.lap();
+    if (stepped) {
+        // Flow's sparsity doesn't line up with bricks; treat the whole grid as written
+        markAllBricks(grid);
+        publishSnapshotLocked(grid);
+        t.publishMs = timer.lap();
+    }
+    t.totalMs = timer.total();
+}
+
+// Zero cells [x0, x1) x [y0, y1) x [z0, z1) of the given planes.
+static void clearCellBox(const GridState& grid, const std::vector<UpfField*>& planes,
+                         int x0, int x1, int y0, int y1, int z0, int z1)
+{
+    const size_t sX = (size_t)grid.sizeX, sXY = (size_t)grid.sizeX * grid.sizeY;
+    const int depth = z1 - z0;
+    #pragma omp parallel for schedule(static) if(depth * (y1 - y0) * (x1 - x0) > 65536)
+    for (int z = z0; z < z1; z++) {
+        for (UpfField* plane : planes) {
+            for (int y = y0; y < y1; y++) {
+                float* row = plane->data() + (size_t)y * sX + (size_t)z * sXY;
+                std::fill(row + x0, row + x1, 0.0f);
+            }
+        }
+    }
+}
+
+// Move a scrolling grid's window by (dx, dy, dz) cells. Rotating the planes'
+// rings keeps every cell at its world position without copying it; only the
+// slab the window moved into is cleared, and the brick lists follow the
+// content. Obstacles are re-rasterized over their old and new bricks, since
+// the SDF does not scroll. Caller must hold grid.mtx.
+static void scrollGridLocked(GridState& grid, int dx, int dy, int dz)
+{
+    StageTimer timer;
+    const int size[3] = { grid.sizeX, grid.sizeY, grid.sizeZ };
+    const int d[3] = { dx, dy, dz };
+    const int bX = grid.bricksX, bY = grid.bricksY;
+    const int32_t numBricks = (int32_t)grid.brickVisited.size();
+
+    std::vector<UpfField*> planes = { &grid.densityData, &grid.velX, &grid.velY, &grid.velZ,
+                                      &grid.densityTemp, &grid.velXTemp, &grid.velYTemp, &grid.velZTemp };
+    for (UpfField* v : { &grid.midDensity, &grid.midVx, &grid.midVy, &grid.midVz,
+                         &grid.barDensity, &grid.barVx, &grid.barVy, &grid.barVz }) {
+        if (!v->empty()) planes.push_back(v);
+    }
+    for (int c = 0; c < kUpfChannelCount; c++) {
+        for (UpfField* v : { &grid.channelData[c], &grid.channelTemp[c], &grid.channelMid[c], &grid.channelBar[c] }) {
+            if (!v->empty()) planes.push_back(v);
+        }
+    }
+    // Cell (x, y, z) now holds what was cell (x + dx, y + dy, z + dz)
+    const ptrdiff_t delta = dx + (ptrdiff_t)dy * size[0] + (ptrdiff_t)dz * size[0] * size[1];
+    for (UpfField* v : planes) v->scroll(delta);
+
+    bool jump = false;
+    for (int k = 0; k < 3; k++) jump |= std::abs(d[k]) >= size[k];
+    if (jump) {
+        clearCellBox(grid, planes, 0, size[0], 0, size[1], 0, size[2]);
+    } else {
+        for (int k = 0; k < 3; k++) {
+            if (d[k] == 0) continue;
+            int lo[3] = { 0, 0, 0 }, hi[3] = { size[0], size[1], size[2] };
+            lo[k] = d[k] > 0 ? size[k] - d[k] : 0;
+            hi[k] = d[k] > 0 ? size[k] : -d[k];
+            clearCellBox(grid, planes, lo[0], hi[0], lo[1], hi[1], lo[2], hi[2]);
+        }
+    }
+
+    // A new brick is visited if the content of a visited brick moved into it
+    std::vector<uint8_t> visited(numBricks, 0);
+    std::vector<float> activity(numBricks, 0.0f);
+    for (size_t i = 0; i < (jump ? 0 : grid.activeBricks.size()); i++) {
+        const int32_t b = grid.activeBricks[i];
+        const BrickBounds r = brickBounds(grid, b);
+        const int lo[3] = { std::max(r.x0 - dx, 0), std::max(r.y0 - dy, 0), std::max(r.z0 - dz, 0) };
+        const int hi[3] = { std::min(r.x1 - dx, size[0]), std::min(r.y1 - dy, size[1]), std::min(r.z1 - dz, size[2]) };
+        if (lo[0] >= hi[0] || lo[1] >= hi[1] || lo[2] >= hi[2]) continue;
+        for (int bz = lo[2] / kBrickSize; bz * kBrickSize < hi[2]; bz++) {
+            for (int by = lo[1] / kBrickSize; by * kBrickSize < hi[1]; by++) {
+                for (int bx = lo[0] / kBrickSize; bx * kBrickSize < hi[0]; bx++) {
+                    const int32_t nb = bx + by * bX + bz * bX * bY;
+                    visited[nb] = 1;
+                    activity[nb] = std::max(activity[nb], grid.brickActivity[b]);
+                }
+            }
+        }
+    }
+    grid.brickVisited.swap(visited);
+    grid.brickActivity.swap(activity);
+    grid.activeBricks.clear();
+    for (int32_t b = 0; b < numBricks; b++) {
+        if (grid.brickVisited[b]) grid.activeBricks.push_back(b);
+    }
+
+    std::vector<uint8_t> dirty;
+    if (!grid.boundObstacles.empty()) {
+        dirty.assign(numBricks, 0);
+        for (const ObstacleState& o : grid.boundObstacles) {
+            BrickRange r;
+            if (obstacleBrickRange(grid, o.shape, r)) markBrickRange(grid, r, dirty);
+        }
+    }
+    for (int k = 0; k < 3; k++) grid.originCell[k] += d[k];
+    if (!dirty.empty()) {
+        std::vector<BrickRange> ranges(grid.boundObstacles.size());
+        for (size_t k = 0; k < ranges.size(); k++) {
+            if (obstacleBrickRange(grid, grid.boundObstacles[k].shape, ranges[k])) {
+                markBrickRange(grid, ranges[k], dirty);
+            } else {
+                ranges[k] = { { 0, 0, 0 }, { -1, -1, -1 } };
+            }
+        }
+        rasterizeObstacleBricks(grid, ranges, dirty);
+        grid.solidVersion++;
+        grid.lastObstacles.milliseconds += timer.total();
+    }
+    // Rebind what the window moved onto or away from
+    grid.boundGeneration = -1;
+    grid.boundObstacleGeneration = -1;
+}
+
+// Move a grid's planes into ring storage so it can scroll. Returns false,
+// leaving the grid as it was, if a ring could not be mapped. Caller must hold
+// grid.mtx.
+static bool enableScrollingLocked(GridState& grid)
+{
+    if (grid.scrolling) return true;
+    std::vector<UpfField*> planes = { &grid.densityData, &grid.velX, &grid.velY, &grid.velZ,
+                                      &grid.densityTemp, &grid.velXTemp, &grid.velYTemp, &grid.velZTemp,
+                                      &grid.midDensity, &grid.midVx, &grid.midVy, &grid.midVz,
+                                      &grid.barDensity, &grid.barVx, &grid.barVy, &grid.barVz };
+    for (int c = 0; c < kUpfChannelCount; c++) {
+        for (UpfField* v : { &grid.channelData[c], &grid.channelTemp[c], &grid.channelMid[c], &grid.channelBar[c] }) {
+            planes.push_back(v);
+        }
+    }
+    for (UpfField* v : planes) {
+        if (v->setRing(true)) continue;
+        for (UpfField* w : planes) w->setRing(false);
+        return false;
+    }
+    grid.scrolling = true;
+    return true;
+}
+
+// Scroll the window to the cell nearest the requested origin, if it moved
+// off it. Caller must hold grid.mtx.
+static void followOriginLocked(GridState& grid)
+{
+    int d[3];
+    for (int k = 0; k < 3; k++) {
+        d[k] = (int)std::lround(grid.targetOrigin[k] / grid.cellSize) - grid.originCell[k];
+    }
+    if (d[0] != 0 || d[1] != 0 || d[2] != 0) scrollGridLocked(grid, d[0], d[1], d[2]);
+}
+
+// One built-in solver step of dt, without publishing. Stage times are added
+// to t so substeps accumulate. Caller must hold grid.mtx.
+static void simulateLocked(GridState& grid, float dt, UpfStepTimings& t)
+{
+    const StepParams sp = makeStepParams(dt);
+    StageTimer timer;
+
+    bindEmittersLocked(grid);
+    bindObstaclesLocked(grid);
+    std::vector<uint8_t> emittedBricks(grid.brickVisited.size(), 0);
+    emitSources(grid, sp, emittedBricks);
+    t.emitMs += timer.lap();
+    if (grid.fusedStep && grid.sparse) {
+        sweepFusedSparse(grid, sp, emittedBricks);
+        t.advectMs += timer.lap();
+    } else if (grid.fusedStep) {
+        sweepFused(grid, sp);
+        t.advectMs += timer.lap();
+    } else {
+        advectFields(grid, sp);
+        t.advectMs += timer.lap();
+        applyBuoyancy(grid, sp);
+        t.buoyancyMs += timer.lap();
+        clampFields(grid, sp);
+        applyObstacleBricks(grid);
+        markAllBricks(grid);
+        t.clampMs += timer.lap();
+    }
+    if (grid.projection) {
+        projectVelocity(grid);
+        t.projectMs += timer.lap();
+    }
+}
+
+// Largest velocity component in the grid. Sparse sweeps leave it in the
+// brick activities; otherwise the velocity planes are scanned.
+static float maxVelocityComponent(const GridState& grid)
+{
+    float maxV = 0.0f;
+    if (grid.fusedStep && grid.sparse) {
+        for (int32_t b : grid.activeBricks) maxV = std::max(maxV, grid.brickActivity[b]);
+        return maxV;
+    }
+
+    const int numCells = (int)grid.velX.size();
+    const float* vx = grid.velX.data();
+    const float* vy = grid.velY.data();
+    const float* vz = grid.velZ.data();
+    #pragma omp parallel if(numCells > 65536)
+    {
+        float localMax = 0.0f;
+        #pragma omp for nowait
+        for (int i = 0; i < numCells; i++) {
+            localMax = std::max(localMax, std::max(std::fabs(vx[i]), std::max(std::fabs(vy[i]), std::fabs(vz[i]))));
+        }
+        #pragma omp critical
+        maxV = std::max(maxV, localMax);
+    }
+    return maxV;
+}
+
+// Longest substep, and the most unsimulated time a grid may fall behind
+static constexpr float kMaxSubstepDt = 0.033f;
+static constexpr float kMaxTimeLag = 0.25f;
+
+// Adaptive substepping: add dt to the accumulator and consume it in equal
+// substeps short enough for the CFL limit, within the substep count and ms
+// budget. Returns the number of substeps run. Caller must hold grid.mtx.
+static int substepLocked(GridState& grid, float dt, UpfStepTimings& t)
+{
+    UpfSubstepStats& s = grid.lastSubsteps;
+    s = {};
+    if (dt > 0.0f) grid.timeAccumulator += dt;
+    if (grid.timeAccumulator > kMaxTimeLag) {
+        s.dropped = grid.timeAccumulator - kMaxTimeLag;
+        grid.timeAccumulator = kMaxTimeLag;
+    }
+    if (grid.timeAccumulator <= 0.0f) return 0;
+
+    // The limit comes from the velocity at the start of the frame; the
+    // solver's velocity clamp bounds how far it can grow within it.
+    const float maxSpeed = maxVelocityComponent(grid);
+    float limitDt = kMaxSubstepDt;
+    if (maxSpeed > 0.0f) limitDt = std::min(limitDt, grid.substepMaxCfl * grid.cellSize / maxSpeed);
+    const int needed = std::max(1, (int)std::ceil(grid.timeAccumulator / limitDt - 1e-4f));
+    const int count = std::min(needed, grid.substepMax);
+    const float subDt = grid.timeAccumulator / needed;
+
+    StageTimer timer;
+    float lastMs = 0.0f;
+    for (int i = 0; i < count; i++) {
+        const float startMs = timer.total();
+        if (grid.substepBudgetMs > 0.0f && i > 0 && startMs + lastMs > grid.substepBudgetMs) break;
+        simulateLocked(grid, subDt, t);
+        s.substeps++;
+        lastMs = timer.total() - startMs;
+    }
+    grid.timeAccumulator = s.substeps == needed ? 0.0f : (needed - s.substeps) * subDt;
+
+    s.substepDt = subDt;
+    s.cfl = maxSpeed * subDt / grid.cellSize;
+    s.deficit = grid.timeAccumulator;
+    s.milliseconds = timer.total();
+    if (s.substeps < count) {
+        postEvent(UpfEvent_BudgetExceeded, grid.handle, 0, s.milliseconds, grid.substepBudgetMs, "substeps");
+    }
+    return s.substeps;
+}
+
+// Publish a playback grid's frame: its leaves are decoded into the fields,
+// bricks visited before but not written now are cleared. Returns false if
+// the frame could not be read. Caller must hold grid.mtx.
+static bool showPlaybackFrameLocked(GridState& grid, int32_t frame)
+{
+    std::shared_ptr<const std::vector<uint32_t>> words = upfVdbPlayerFetch(grid.player, frame);
+    const int32_t numBricks = (int32_t)grid.brickVisited.size();
+    std::vector<uint8_t> written(numBricks, 0);
+    if (!words || !upfVdbDecodeFrame(*words, grid.sizeX, grid.sizeY, grid.sizeZ, grid.densityData.data(),
+                                     grid.velX.data(), grid.velY.data(), grid.velZ.data(), written.data())) {
+        return false;
+    }
+
+    grid.activeBricks.clear();
+    for (int32_t b = 0; b < numBricks; b++) {
+        if (grid.brickVisited[b] && !written[b]) {
+            clearBrick(grid, b, grid.densityData);
+            clearBrick(grid, b, grid.velX);
+            clearBrick(grid, b, grid.velY);
+            clearBrick(grid, b, grid.velZ);
+        }
+        grid.brickVisited[b] = written[b];
+        grid.brickActivity[b] = written[b] ? 1.0f : 0.0f;
+        if (written[b]) grid.activeBricks.push_back(b);
+    }
+    grid.playbackFrame = frame;
+    publishSnapshotLocked(grid);
+    return true;
+}
+
+// Advance a playback grid's time, publishing only when the frame changes.
+// Caller must hold grid.mtx.
+static void stepPlaybackLocked(GridState& grid, float dt)
+{
+    UpfStepTimings& t = grid.lastTimings;
+    t = {};
+    StageTimer timer;
+    grid.playbackTime += dt;
+    const int32_t frame = upfVdbPlayerFrameAt(grid.player, grid.playbackTime);
+    if (frame != grid.playbackFrame && !showPlaybackFrameLocked(grid, frame)) {
+        postEvent(UpfEvent_Error, grid.handle, frame, 0.0f, 0.0f, "Failed to read NanoVDB cache frame");
+    }
+    t.publishMs = timer.lap();
+    t.totalMs = timer.total();
+}
+
+// Advance a simulated grid by dt. Caller must hold grid.mtx.
+static void simulateAndPublishLocked(GridState& grid, float dt)
+{
+    if (grid.flowGrid) {
+        stepFlowGridLocked(grid, dt);
+        return;
+    }
+
+    UpfStepTimings& t = grid.lastTimings;
+    t = {};
+    grid.lastObstacles.rasterizedBricks = 0;
+    grid.lastObstacles.milliseconds = 0.0f;
+    StageTimer timer;
+    if (grid.scrolling) followOriginLocked(grid);
+    if (!grid.substepping) {
+        simulateLocked(grid, dt, t);
+    } else if (substepLocked(grid, dt, t) == 0) {
+        t.totalMs = timer.total();
+        return;
+    }
+
+    StageTimer publishTimer;
+    publishSnapshotLocked(grid);
+    t.publishMs = publishTimer.lap();
+    t.totalMs = timer.total();
+}
+
+// Take in the queued tracer spawns, move the tracers dt through the current
+// velocity and publish them packed. Caller must hold grid.mtx.
+static void advanceTracersLocked(GridState& grid, float dt)
+{
+    StageTimer timer;
+    {
+        std::lock_guard<std::mutex> lock(grid.tracerMtx);
+        if (grid.tracerClear) grid.tracers.resize(0);
+        grid.tracerClear = false;
+        const size_t queued = grid.tracerPending.size() / 4;
+        if (queued == 0 && grid.tracers.size() == 0 && grid.tracerPacked.empty()) return;
+        const size_t first = grid.tracers.size();
+        grid.tracers.resize(first + queued);
+        for (size_t i = 0; i < queued; i++) {
+            const float* q = &grid.tracerPending[i * 4];
+            grid.tracers.x[first + i] = q[0];
+            grid.tracers.y[first + i] = q[1];
+            grid.tracers.z[first + i] = q[2];
+            grid.tracers.age[first + i] = 0.0f;
+            grid.tracers.life[first + i] = q[3];
+        }
+        grid.tracerPending.clear();
+    }
+
+    if (grid.tracers.size() > 0) {
+        UpfTracerField f;
+        f.sizeX = grid.sizeX; f.sizeY = grid.sizeY; f.sizeZ = grid.sizeZ;
+        f.invCellSize = 1.0f / grid.cellSize;
+        float c[3];
+        gridCenter(grid, c);
+        const int size[3] = { grid.sizeX, grid.sizeY, grid.sizeZ };
+        for (int k = 0; k < 3; k++) f.cell0[k] = c[k] - (size[k] - 1) * grid.cellSize * 0.5f;
+        f.vx = grid.velX.data(); f.vy = grid.velY.data(); f.vz = grid.velZ.data();
+        upfAdvanceTracers(grid.tracers, f, dt, (UpfSimdLevel)g_state.simdLevel.load(), grid.tracerOut);
+    } else {
+        grid.tracerOut.clear();
+    }
+    {
+        std::lock_guard<std::mutex> lock(grid.tracerMtx);
+        grid.tracerPacked.swap(grid.tracerOut);
+    }
+    const float ms = timer.total();
+    grid.lastTimings.tracerMs = ms;
+    grid.lastTimings.totalMs += ms;
+}
+
+// Advance one grid by dt. Caller must hold grid.mtx.
+static void stepGridLocked(GridState& grid, float dt)
+{
+    if (grid.player) {
+        stepPlaybackLocked(grid, dt);
+        advanceTracersLocked(grid, dt);
+        return;
+    }
+
+    const int64_t version = grid.nextVersion;
+    simulateAndPublishLocked(grid, dt);
+    advanceTracersLocked(grid, dt);
+    if (!grid.recorder) return;
+
+    // Record the step if it published; the encode counts as publishing
+    grid.recordTime += dt;
+    if (grid.nextVersion == version) return;
+    StageTimer timer;
+    std::vector<uint32_t> frame;
+    upfVdbEncodeFrame(grid.sizeX, grid.sizeY, grid.sizeZ, grid.cellSize, grid.densityData.data(), grid.velX.data(),
+                      grid.velY.data(), grid.velZ.data(), grid.brickVisited.data(), frame);
+    upfVdbRecorderAppend(grid.recorder, (float)grid.recordTime, std::move(frame));
+    const float ms = timer.total();
+    grid.lastTimings.publishMs += ms;
+    grid.lastTimings.totalMs += ms;
+}
+
+// Finish a grid's recording and close its playback cache. Caller must hold grid.mtx.
+static void closeCachesLocked(GridState& grid)
+{
+    if (grid.recorder) upfVdbRecorderClose(grid.recorder);
+    grid.recorder = nullptr;
+    if (grid.player) upfVdbPlayerClose(grid.player);
+    grid.player = nullptr;
+}
+
+// Step a batch of jobs, running distinct grids concurrently. Fenced jobs
+// signal their grid's completedFence when done.
+static void stepGridsConcurrently(const std::vector<StepJob>& jobs)
+{
+    if (jobs.empty()) return;
+    const int numJobs = (int)jobs.size();
+    ScopedThreadCount stepThreads(stepThreadCount());
+
+#ifdef _OPENMP
+    // Split the thread budget between grids; each grid's own sweeps then run
+    // as nested regions on its share of the threads.
+    const int maxThreads = omp_get_max_threads();
+    const int outerThreads = std::max(1, std::min(numJobs, maxThreads));
+    const int innerThreads = std::max(1, maxThreads / outerThreads);
+    ScopedNestedRegions nested;
+#else
+    const int innerThreads = 1;
+#endif
+
+    #pragma omp parallel for num_threads(outerThreads) schedule(dynamic, 1) if(numJobs > 1)
+    for (int i = 0; i < numJobs; i++) {
+        ScopedThreadCount gridThreads(innerThreads);
+        const StepJob& job = jobs[i];
+        {
+            // Duplicate handles simply serialize on the grid lock
+            std::lock_guard<std::mutex> lock(job.grid->mtx);
+            stepGridLocked(*job.grid, job.dt);
+        }
+        if (job.fence > 0) {
+            std::lock_guard<std::mutex> lock(job.grid->fenceMtx);
+            if (job.fence > job.grid->completedFence.load()) job.grid->completedFence.store(job.fence);
+            job.grid->fenceCv.notify_all();
+        }
+    }
+}
+
+static void stepWorkerMain()
+{
+    StepWorker& w = g_state.worker;
+    std::vector<StepJob> batch;
+    for (;;) {
+        batch.clear();
+        {
+            std::unique_lock<std::mutex> lock(w.mtx);
+            w.cv.wait(lock, [&] { return w.stop || !w.jobs.empty(); });
+            if (w.stop && w.jobs.empty()) return;
+
+            // Take queued jobs for distinct grids; a second job for the same
+            // grid waits for the next batch so per-grid order is preserved.
+            while (!w.jobs.empty()) {
+                const StepJob& next = w.jobs.front();
+                bool duplicate = false;
+                for (const StepJob& j : batch) duplicate |= (j.grid == next.grid);
+                if (duplicate) break;
+                batch.push_back(std::move(w.jobs.front()));
+                w.jobs.pop_front();
+            }
+        }
+        stepGridsConcurrently(batch);
+    }
+}
+
+static void stopStepWorker()
+{
+    StepWorker& w = g_state.worker;
+    {
+        std::lock_guard<std::mutex> lock(w.mtx);
+        w.stop = true;
+        w.cv.notify_all();
+    }
+    if (w.thread.joinable()) w.thread.join();
+}
+
+// Stopped workers refuse new jobs until the bridge is initialized again.
+static void resumeStepWorker()
+{
+    StepWorker& w = g_state.worker;
+    std::lock_guard<std::mutex> lock(w.mtx);
+    w.stop = false;
+}
+
+extern "C" {
+
+UPF_API int32_t Upf_Init()
+{
+    return Upf_InitWithApi(UpfContextApi_Vulkan, 0);
+}
+
+// Tear down whatever part of the Flow device is up, in reverse order of
+// creation, and forget it: used by Upf_Shutdown and by failed inits, so a
+// later init starts from a clean loader. Caller must hold g_state.mtx.
+static void releaseFlowDeviceLocked()
+{
+    if (g_state.deviceManager && g_state.device) {
+        if (g_state.queue) g_state.loader.deviceInterface.waitIdle(g_state.queue);
+        g_state.loader.deviceInterface.destroyDevice(g_state.deviceManager, g_state.device);
+    }
+    if (g_state.deviceManager) g_state.loader.deviceInterface.destroyDeviceManager(g_state.deviceManager);
+    if (g_state.contextApi != UpfContextApi_None) {
+        // As NvFlowLoaderDestroy, but a failed load may have opened only one library
+        if (g_state.loader.module_nvflow) NvFlowFreeLibrary(g_state.loader.module_nvflow);
+        if (g_state.loader.module_nvflowext) NvFlowFreeLibrary(g_state.loader.module_nvflowext);
+        g_state.loader = {};
+    }
+
+    g_state.device = nullptr;
+    g_state.queue = nullptr;
+    g_state.deviceManager = nullptr;
+    g_state.contextApi = UpfContextApi_None;
+    g_state.ctxIface = nullptr;
+    g_state.context = nullptr;
+}
+
+UPF_API int32_t Upf_InitWithApi(int32_t contextApi, int32_t cpuThreads)
+{
+    std::lock_guard<std::mutex> lock(g_state.mtx);
+    if (g_state.initialized) return 0;
+    if (contextApi < UpfContextApi_None || contextApi > UpfContextApi_CPU) return -6;
+
+    // Solver-only: no Flow libraries, every grid runs on the bridge's CPU solver
+    if (contextApi == UpfContextApi_None) {
+        g_state.contextApi = UpfContextApi_None;
+        g_state.initialized = true;
+        resumeStepWorker();
+        return 0;
+    }
+
+    // Recorded as soon as the loader is open, so a failed init releases it
+    NvFlowLoaderInitDeviceAPI(&g_state.loader, flowPrintError, nullptr, (NvFlowContextApi)contextApi);
+    g_state.contextApi = contextApi;
+    auto fail = [](const char* message, int32_t code) {
+        flowPrintError(message, nullptr);
+        releaseFlowDeviceLocked();
+        return code;
+    };
+    if (!g_state.loader.deviceInterface.getContext) return fail("NvFlow device interface not available", -1);
+
+    NvFlowThreadPoolInterface* threadPool = nullptr;
+    const NvFlowUint threadCount = contextApi == UpfContextApi_CPU ? (NvFlowUint)std::max(0, cpuThreads) : 0u;
+    g_state.deviceManager = g_state.loader.deviceInterface.createDeviceManager(0, threadPool, threadCount);
+    if (!g_state.deviceManager) return fail("Failed to create NvFlowDeviceManager", -2);
+
+    NvFlowDeviceDesc devDesc{};
+    devDesc.deviceIndex = 0;
+    devDesc.enableExternalUsage = NV_FLOW_FALSE;
+    devDesc.logPrint = nullptr;
+
+    g_state.device = g_state.loader.deviceInterface.createDevice(g_state.deviceManager, &devDesc);
+    if (!g_state.device) return fail("Failed to create NvFlowDevice", -3);
+
+    g_state.queue = g_state.loader.deviceInterface.getDeviceQueue(g_state.device);
+    if (!g_state.queue) return fail("Failed to get NvFlowDeviceQueue", -4);
+
+    g_state.ctxIface = g_state.loader.deviceInterface.getContextInterface(g_state.queue);
+    g_state.context = g_state.loader.deviceInterface.getContext(g_state.queue);
+    if (!g_state.ctxIface || !g_state.context) return fail("Failed to get NvFlow Context", -5);
+
+    g_state.loader.deviceInterface.enableProfiler(g_state.context, nullptr, &flowProfilerReport);
+
+    g_state.initialized = true;
+    resumeStepWorker();
+    return 0;
+}
+
+UPF_API int32_t Upf_GetContextApi()
+{
+    std::lock_guard<std::mutex> lock(g_state.mtx);
+    return g_state.initialized ? g_state.contextApi : -1;
+}
+
+UPF_API void Upf_RegisterCallback(UpfEventCallback cb, void* user_data)
+{
+    std::lock_guard<std::mutex> lock(g_state.mtx);
+    g_state.callback = cb;
+    g_state.callbackUser = user_data;
+}
+
+UPF_API void Upf_Step(float dt)
+{
+    if (!g_state.initialized || !g_state.queue) return;
+    if (dt < 0.f) dt = 0.f;
+
+    NvFlowUint64 flushedFrame = 0;
+    g_state.loader.deviceInterface.flush(g_state.queue, &flushedFrame, nullptr, nullptr);
+
+    // The legacy callback shares the event mask; skip formatting unless it will run
+    if (!(g_state.eventMask.load(std::memory_order_relaxed) & (1u << UpfEvent_FrameFlushed))) return;
+    postEvent(UpfEvent_FrameFlushed, -1, (int64_t)flushedFrame, dt, 0.0f, nullptr);
+
+    UpfEventCallback callback;
+    void* callbackUser;
+    {
+        std::lock_guard<std::mutex> lock(g_state.mtx);
+        callback = g_state.callback;
+        callbackUser = g_state.callbackUser;
+    }
+    if (!callback) return;
+    char msg[128];
+    snprintf(msg, sizeof(msg), "flushedFrame=%llu, dt=%f", (unsigned long long)flushedFrame, dt);
+    callback(0, msg, callbackUser);
+}
+
+UPF_API void Upf_EmitTestEvent(const char* message)
+{
+    postEvent(UpfEvent_Test, -1, 0, 0.0f, 0.0f, message);
+    if (g_state.callback) {
+        g_state.callback(99, message ? message : "", g_state.callbackUser);
+    }
+}
+
+UPF_API void Upf_Shutdown()
+{
+    // Drain pending async steps before tearing down
+    stopStepWorker();
+
+    // Flow grids must go before the device. Grid locks come before the bridge lock.
+    std::vector<std::shared_ptr<GridState>> grids;
+    {
+        std::lock_guard<std::mutex> lock(g_state.mtx);
+        for (const auto& pair : g_state.grids) grids.push_back(pair.second);
+    }
+    for (const auto& grid : grids) {
+        std::lock_guard<std::mutex> gridLock(grid->mtx);
+        closeCachesLocked(*grid);
+        if (!grid->flowGrid) continue;
+        std::lock_guard<std::mutex> flowLock(g_state.flowMtx);
+        upfFlowGridDestroy(flowDevice(), grid->flowGrid);
+        grid->flowGrid = nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(g_state.mtx);
+    if (!g_state.initialized) return;
+
+    releaseFlowDeviceLocked();
+    g_state.callback = nullptr;
+    g_state.callbackUser = nullptr;
+    g_state.initialized = false;
+    upfProfilerClear();
+}
+
+UPF_API int32_t Upf_ReadProfilerEntries(UpfProfilerEntry* dst, int32_t maxEntries)
+{
+    return upfProfilerRead(dst, maxEntries);
+}
+
+UPF_API const char* Upf_GetProfilerLabel(int32_t labelId)
+{
+    return upfProfilerLabel(labelId);
+}
+
+UPF_API int64_t Upf_GetProfilerDroppedCount()
+{
+    return upfProfilerTakeDropped();
+}
+
+UPF_API int32_t Upf_DrainEvents(UpfEvent* dst, int32_t capacity)
+{
+    if (!dst || capacity <= 0) return 0;
+    return g_state.events.popMany(dst, capacity);
+}
+
+UPF_API uint32_t Upf_SetEventMask(uint32_t mask)
+{
+    return g_state.eventMask.exchange(mask);
+}
+
+UPF_API int64_t Upf_GetDroppedEventCount()
+{
+    return g_state.events.takeDropped();
+}
+
+#ifdef _WIN32
+UPF_API void Upf_SetDllDirectoryW(const wchar_t* path)
+{
+    std::lock_guard<std::mutex> lock(g_state.mtx);
+    if (!path) return;
+    g_state.dllDirW = path;
+    ::SetDefaultDllDirectories(LOAD_LIBRARY_SEARCH_DEFAULT_DIRS | LOAD_LIBRARY_SEARCH_USER_DIRS);
+    ::AddDllDirectory(g_state.dllDirW.c_str());
+}
+#endif
+
+// --- Simulation API Implementation ---
+
+UPF_API int32_t Upf_CreateEmitter(float x, float y, float z, float radius, float density)
+{
+    std::lock_guard<std::mutex> lock(g_state.mtx);
+    if (!g_state.initialized) return -1;
+
+    int32_t handle = g_state.nextEmitterHandle++;
+    EmitterState& e = g_state.emitters[handle];
+    e.handle = handle;
+    e.x = x; e.y = y; e.z = z;
+    e.radius = radius;
+    e.density = density;
+    // Flow-backed grids pick the emitter up as a sphere emitter when they rebind
+    g_state.emitterGeneration++;
+
+    return handle;
+}
+
+UPF_API void Upf_DestroyEmitter(int32_t emitterHandle)
+{
+    std::lock_guard<std::mutex> lock(g_state.mtx);
+    auto it = g_state.emitters.find(emitterHandle);
+    if (it == g_state.emitters.end()) return;
+
+    g_state.emitters.erase(it);
+    g_state.emitterGeneration++;
+}
+
+UPF_API void Upf_SetEmitterParams(int32_t emitterHandle, float x, float y, float z, float radius, float density)
+{
+    std::lock_guard<std::mutex> lock(g_state.mtx);
+    auto it = g_state.emitters.find(emitterHandle);
+    if (it == g_state.emitters.end()) return;
+
+    EmitterState& e = it->second;
+    e.x = x; e.y = y; e.z = z;
+    e.radius = radius;
+    e.density = density;
+    g_state.emitterGeneration++;
+}
+
+UPF_API void Upf_SetEmitterChannels(int32_t emitterHandle, float temperature, float fuel, float smoke)
+{
+    std::lock_guard<std::mutex> lock(g_state.mtx);
+    auto it = g_state.emitters.find(emitterHandle);
+    if (it == g_state.emitters.end()) return;
+
+    EmitterState& e = it->second;
+    e.temperature = temperature;
+    e.fuel = fuel;
+    e.smoke = smoke;
+    g_state.emitterGeneration++;
+}
+
+UPF_API int32_t Upf_SetEmittersBatch(const UpfEmitterDesc* emitters, int32_t count)
+{
+    if (!emitters || count <= 0) return 0;
+
+    std::lock_guard<std::mutex> lock(g_state.mtx);
+    int32_t updated = 0;
+    for (int32_t i = 0; i < count; i++) {
+        const UpfEmitterDesc& d = emitters[i];
+        auto it = g_state.emitters.find(d.handle);
+        if (it == g_state.emitters.end()) continue;
+
+        EmitterState& e = it->second;
+        e.x = d.x; e.y = d.y; e.z = d.z;
+        e.radius = d.radius;
+        e.density = d.density;
+        updated++;
+    }
+    if (updated > 0) g_state.emitterGeneration++;
+    return updated;
+}
+
+// Normalized rotation; identity if q is degenerate.
+static void setObstacleTransform(UpfObstacleShape& s, float px, float py, float pz, float qx, float qy, float qz, float qw)
+{
+    s.position[0] = px; s.position[1] = py; s.position[2] = pz;
+    const float len = std::sqrt(qx * qx + qy * qy + qz * qz + qw * qw);
+    if (!(len > 0.0f) || !std::isfinite(len)) {
+        qx = qy = qz = 0.0f; qw = 1.0f;
+    } else {
+        qx /= len; qy /= len; qz /= len; qw /= len;
+    }
+    s.rotation[0] = qx; s.rotation[1] = qy; s.rotation[2] = qz; s.rotation[3] = qw;
+}
+
+static int32_t addObstacle(const UpfObstacleDesc& desc, int32_t type, std::shared_ptr<const UpfMeshSdf> mesh)
+{
+    std::lock_guard<std::mutex> lock(g_state.mtx);
+    if (!g_state.initialized) return -1;
+
+    const int32_t handle = g_state.nextObstacleHandle++;
+    ObstacleState& o = g_state.obstacles[handle];
+    o.handle = handle;
+    o.shape.type = type;
+    setObstacleTransform(o.shape, desc.px, desc.py, desc.pz, desc.qx, desc.qy, desc.qz, desc.qw);
+    o.shape.size[0] = std::fabs(desc.sx);
+    o.shape.size[1] = std::fabs(desc.sy);
+    o.shape.size[2] = std::fabs(desc.sz);
+    o.shape.mesh = std::move(mesh);
+    o.revision = ++g_state.obstacleGeneration;
+    return handle;
+}
+
+UPF_API int32_t Upf_CreateObstacle(const UpfObstacleDesc* desc)
+{
+    if (!desc || desc->type < UpfObstacle_Box || desc->type > UpfObstacle_Capsule) return -1;
+    return addObstacle(*desc, desc->type, nullptr);
+}
+
+UPF_API int32_t Upf_CreateMeshObstacle(const UpfObstacleDesc* desc, const float* vertices, int32_t vertexCount,
+                                       const int32_t* indices, int32_t indexCount)
+{
+    if (!desc || Upf_GetContextApi() < 0) return -1;
+    // Baked before taking the bridge lock; this is the expensive part
+    std::shared_ptr<const UpfMeshSdf> mesh = upfBakeMeshSdf(vertices, vertexCount, indices, indexCount);
+    if (!mesh) return -1;
+    return addObstacle(*desc, UpfObstacle_Mesh, std::move(mesh));
+}
+
+UPF_API void Upf_SetObstacleTransform(int32_t obstacleHandle, float px, float py, float pz,
+                                      float qx, float qy, float qz, float qw)
+{
+    std::lock_guard<std::mutex> lock(g_state.mtx);
+    auto it = g_state.obstacles.find(obstacleHandle);
+    if (it == g_state.obstacles.end()) return;
+
+    setObstacleTransform(it->second.shape, px, py, pz, qx, qy, qz, qw);
+    it->second.revision = ++g_state.obstacleGeneration;
+}
+
+UPF_API void Upf_DestroyObstacle(int32_t obstacleHandle)
+{
+    std::lock_guard<std::mutex> lock(g_state.mtx);
+    if (g_state.obstacles.erase(obstacleHandle) == 0) return;
+    g_state.obstacleGeneration++;
+}
+
+// Allocate a grid's fields, the optional channels in channels (UpfGridChannel
+// bits) and brick state, all zero. Playback grids never run the solver and
+// skip its temp buffers.
+static std::shared_ptr<GridState> makeGrid(int32_t handle, int sizeX, int sizeY, int sizeZ, float cellSize, bool solver,
+                                           uint32_t channels)
+{
+    std::shared_ptr<GridState> grid = std::make_shared<GridState>();
+    GridState& g = *grid;
+    g.handle = handle;
+    g.sizeX = sizeX; g.sizeY = sizeY; g.sizeZ = sizeZ;
+    g.cellSize = cellSize;
+    g.baseSizeX = sizeX; g.baseSizeY = sizeY; g.baseSizeZ = sizeZ;
+    g.baseCellSize = cellSize;
+    size_t numCells = (size_t)sizeX * sizeY * sizeZ;
+    g.densityData.resize(numCells, 0.0f);
+    g.velX.resize(numCells, 0.0f);
+    g.velY.resize(numCells, 0.0f);
+    g.velZ.resize(numCells, 0.0f);
+    if (solver) {
+        g.densityTemp.resize(numCells, 0.0f);
+        g.velXTemp.resize(numCells, 0.0f);
+        g.velYTemp.resize(numCells, 0.0f);
+        g.velZTemp.resize(numCells, 0.0f);
+    }
+    g.channels = channels;
+    for (int c = 0; c < kUpfChannelCount; c++) {
+        if (!(channels & (1u << c))) continue;
+        g.channelData[c].resize(numCells, 0.0f);
+        if (solver) g.channelTemp[c].resize(numCells, 0.0f);
+    }
+    g.bricksX = (sizeX + kBrickSize - 1) / kBrickSize;
+    g.bricksY = (sizeY + kBrickSize - 1) / kBrickSize;
+    g.bricksZ = (sizeZ + kBrickSize - 1) / kBrickSize;
+    const size_t numBricks = (size_t)g.bricksX * g.bricksY * g.bricksZ;
+    g.brickActivity.resize(numBricks, 0.0f);
+    g.brickVisited.resize(numBricks, 0);
+    return grid;
+}
+
+UPF_API int32_t Upf_CreateGrid(int sizeX, int sizeY, int sizeZ, float cellSize)
+{
+    return Upf_CreateGridWithChannels(sizeX, sizeY, sizeZ, cellSize, 0);
+}
+
+UPF_API int32_t Upf_CreateGridWithChannels(int sizeX, int sizeY, int sizeZ, float cellSize, uint32_t channelMask)
+{
+    const int32_t contextApi = Upf_GetContextApi();
+    if (contextApi < 0) return -1;
+    if (channelMask >= (1u << kUpfChannelCount)) return -1;
+    // Flow's solver only carries density
+    if (channelMask != 0 && contextApi == UpfContextApi_CPU) {
+        postEvent(UpfEvent_Error, -1, 0, 0.0f, 0.0f, "Flow-backed grids have no optional channels");
+        return -2;
+    }
+
+    // On the CPU device, Flow's sparse solver steps the grid
+    UpfFlowGrid* flowGrid = nullptr;
+    if (contextApi == UpfContextApi_CPU) {
+        std::lock_guard<std::mutex> flowLock(g_state.flowMtx);
+        flowGrid = upfFlowGridCreate(flowDevice(), sizeX, sizeY, sizeZ, cellSize);
+        if (!flowGrid) flowPrintError("Failed to create NvFlowGrid, using the built-in solver", nullptr);
+    }
+
+    std::lock_guard<std::mutex> lock(g_state.mtx);
+
+    int32_t handle = g_state.nextGridHandle++;
+    std::shared_ptr<GridState> grid = makeGrid(handle, sizeX, sizeY, sizeZ, cellSize, true, channelMask);
+    grid->flowGrid = flowGrid;
+
+    publishSnapshotLocked(*grid);
+    g_state.grids[handle] = std::move(grid);
+    postEvent(UpfEvent_GridCreated, handle, 0, cellSize, 0.0f, nullptr);
+    return handle;
+}
+
+UPF_API void Upf_DestroyGrid(int32_t gridHandle)
+{
+    std::shared_ptr<GridState> grid;
+    {
+        std::lock_guard<std::mutex> lock(g_state.mtx);
+        auto it = g_state.grids.find(gridHandle);
+        if (it == g_state.grids.end()) return;
+        grid = std::move(it->second);
+        g_state.grids.erase(it);
+    }
+    postEvent(UpfEvent_GridDestroyed, gridHandle, 0, 0.0f, 0.0f, nullptr);
+
+    // A step in flight keeps the grid alive; the Flow grid goes once it finishes
+    std::lock_guard<std::mutex> gridLock(grid->mtx);
+    closeCachesLocked(*grid);
+    if (grid->flowGrid) {
+        std::lock_guard<std::mutex> flowLock(g_state.flowMtx);
+        upfFlowGridDestroy(flowDevice(), grid->flowGrid);
+        grid->flowGrid = nullptr;
+    }
+}
+
+UPF_API int32_t Upf_GetGridChannels(int32_t gridHandle)
+{
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid) return -1;
+
+    std::lock_guard<std::mutex> lock(grid->mtx);
+    return (int32_t)grid->channels;
+}
+
+UPF_API int32_t Upf_GetGridBackend(int32_t gridHandle)
+{
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid) return -1;
+
+    std::lock_guard<std::mutex> lock(grid->mtx);
+    if (grid->player) return UpfGridBackend_Playback;
+    return grid->flowGrid ? UpfGridBackend_Flow : UpfGridBackend_Builtin;
+}
+
+UPF_API void Upf_StepGrid(int32_t gridHandle, float dt)
+{
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid) return;
+
+    ScopedThreadCount stepThreads(stepThreadCount());
+    std::lock_guard<std::mutex> lock(grid->mtx);
+    stepGridLocked(*grid, dt);
+}
+
+UPF_API void Upf_StepGrids(const int32_t* gridHandles, int32_t count, float dt)
+{
+    if (!gridHandles || count <= 0) return;
+
+    std::vector<StepJob> jobs;
+    jobs.reserve(count);
+    {
+        std::lock_guard<std::mutex> lock(g_state.mtx);
+        for (int32_t i = 0; i < count; i++) {
+            auto it = g_state.grids.find(gridHandles[i]);
+            if (it != g_state.grids.end()) jobs.push_back({ it->second, dt, 0 });
+        }
+    }
+    stepGridsConcurrently(jobs);
+}
+
+UPF_API int64_t Upf_StepGridAsync(int32_t gridHandle, float dt)
+{
+    if (Upf_GetContextApi() < 0) return -1;
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid) return -1;
+
+    StepWorker& w = g_state.worker;
+    std::lock_guard<std::mutex> lock(w.mtx);
+    // Upf_Shutdown may have stopped the worker since the check above
+    if (w.stop) return -1;
+    if (!w.thread.joinable()) w.thread = std::thread(stepWorkerMain);
+    const int64_t fence = w.nextFence++;
+    grid->submittedFence.store(fence);
+    w.jobs.push_back({ std::move(grid), dt, fence });
+    w.cv.notify_one();
+    return fence;
+}
+
+UPF_API int32_t Upf_IsGridReady(int32_t gridHandle, int64_t fence)
+{
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid) return 1;
+    // Fences past the grid's last submission (or from another grid) can never complete
+    const int64_t submitted = grid->submittedFence.load();
+    if (fence <= 0 || fence > submitted) fence = submitted;
+    return grid->completedFence.load() >= fence ? 1 : 0;
+}
+
+UPF_API void Upf_WaitGrid(int32_t gridHandle, int64_t fence)
+{
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid) return;
+    const int64_t submitted = grid->submittedFence.load();
+    if (fence <= 0 || fence > submitted) fence = submitted;
+
+    std::unique_lock<std::mutex> lock(grid->fenceMtx);
+    grid->fenceCv.wait(lock, [&] { return grid->completedFence.load() >= fence; });
+}
+
+UPF_API const void* Upf_ExportGridDensity(int32_t gridHandle, int* outSizeX, int* outSizeY, int* outSizeZ, int* outFormat)
+{
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid) return nullptr;
+
+    // Pinned until the next export of this grid, so the solver never writes under the caller
+    const GridSnapshot* snap = acquireLegacySnapshot(*grid);
+    if (!snap) return nullptr;
+
+    if (outSizeX) *outSizeX = snap->sizeX;
+    if (outSizeY) *outSizeY = snap->sizeY;
+    if (outSizeZ) *outSizeZ = snap->sizeZ;
+    if (outFormat) *outFormat = 0; // 0 = float32
+
+    return snap->density.data();
+}
+
+UPF_API const void* Upf_ExportGridVelocity(int32_t gridHandle, int* outSizeX, int* outSizeY, int* outSizeZ, int* outFormat)
+{
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid) return nullptr;
+
+    // Pinned until the next export of this grid, so the solver never writes under the caller
+    const GridSnapshot* snap = acquireLegacySnapshot(*grid);
+    if (!snap) return nullptr;
+
+    if (outSizeX) *outSizeX = snap->sizeX;
+    if (outSizeY) *outSizeY = snap->sizeY;
+    if (outSizeZ) *outSizeZ = snap->sizeZ;
+    if (outFormat) *outFormat = 1; // 1 = float32x3 (vec3)
+
+    return snap->velocity.data();
+}
+
+// Size of a field exported in a format, or 0 if the field has no such format.
+static size_t exportBytes(const GridSnapshot& snap, bool velocity, int32_t format)
+{
+    const size_t numCells = (size_t)snap.sizeX * snap.sizeY * snap.sizeZ;
+    switch (format) {
+    case UpfExport_R32F: return velocity ? 0 : numCells * sizeof(float);
+    case UpfExport_RGB32F: return velocity ? numCells * 3 * sizeof(float) : 0;
+    case UpfExport_RGBA32F: return velocity ? numCells * 4 * sizeof(float) : 0;
+    case UpfExport_R16F: return velocity ? 0 : numCells * sizeof(uint16_t);
+    case UpfExport_RGBA16F: return velocity ? numCells * 4 * sizeof(uint16_t) : 0;
+    case UpfExport_R8_UNORM: return velocity ? 0 : numCells;
+    case UpfExport_BC4_UNORM: return velocity ? 0 : upfBC4Bytes(snap.sizeX, snap.sizeY, snap.sizeZ);
+    default: return 0;
+    }
+}
+
+// Min and max of a snapshot's scalar plane (density or a channel), reduced per z-slice.
+static void scalarRange(const GridSnapshot& snap, const float* plane, UpfSimdLevel level, float& outMin, float& outMax)
+{
+    const int sZ = snap.sizeZ;
+    const size_t slice = (size_t)snap.sizeX * snap.sizeY;
+    std::vector<float> sliceMin(sZ), sliceMax(sZ);
+
+    #pragma omp parallel for if(sZ > 8)
+    for (int z = 0; z < sZ; z++) {
+        upfMinMax(plane + z * slice, slice, sliceMin[z], sliceMax[z], level);
+    }
+    outMin = *std::min_element(sliceMin.begin(), sliceMin.end());
+    outMax = *std::max_element(sliceMax.begin(), sliceMax.end());
+}
+
+// Copy the latest snapshot's density, velocity or optional channel (slot
+// channel, -1 for density) into dst, converting to format. Conversions are
+// split across threads by z-slice. outMin/outMax (optional, scalar fields
+// only) receive the range the UNORM formats map to [0, 1].
+static int64_t exportGridInto(int32_t gridHandle, bool velocity, int channel, void* dst, size_t dstBytes, int32_t format,
+                              float* outMin, float* outMax)
+{
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid) return -1;
+
+    // Sized from the snapshot: a LOD change may resize the grid meanwhile
+    const int32_t slot = acquireSnapshot(*grid);
+    if (slot < 0) return -2;
+    const GridSnapshot& snap = grid->snapshots[slot];
+    if (channel >= 0 && snap.channels[channel].empty()) {
+        releaseSnapshot(*grid, slot);
+        return -1;
+    }
+    const float* scalar = channel >= 0 ? snap.channels[channel].data() : snap.density.data();
+    const size_t required = exportBytes(snap, velocity, format);
+    if (required == 0 || !dst || dstBytes < required) {
+        releaseSnapshot(*grid, slot);
+        if (required == 0) return -1;
+        return dst ? -3 : (int64_t)required;
+    }
+
+    const UpfSimdLevel level = (UpfSimdLevel)g_state.simdLevel.load();
+    const int sZ = snap.sizeZ;
+    const size_t slice = (size_t)snap.sizeX * snap.sizeY;
+
+    float rangeMin = 0.0f, rangeMax = 0.0f;
+    const bool quantized = format == UpfExport_R8_UNORM || format == UpfExport_BC4_UNORM;
+    if (!velocity && (quantized || outMin || outMax)) {
+        scalarRange(snap, scalar, level, rangeMin, rangeMax);
+    }
+
+    switch (format) {
+    case UpfExport_RGBA32F: {
+        const float* src = snap.velocity.data();
+        float* out = static_cast<float*>(dst);
+        const int64_t n = (int64_t)(slice * sZ);
+        #pragma omp parallel for if(n > 65536)
+        for (int64_t i = 0; i < n; i++) {
+            out[i * 4 + 0] = src[i * 3 + 0];
+            out[i * 4 + 1] = src[i * 3 + 1];
+            out[i * 4 + 2] = src[i * 3 + 2];
+            out[i * 4 + 3] = 0.0f;
+        }
+        break;
+    }
+    case UpfExport_R16F: {
+        uint16_t* out = static_cast<uint16_t*>(dst);
+        #pragma omp parallel for if(sZ > 8)
+        for (int z = 0; z < sZ; z++) {
+            upfFloatToHalf(scalar + z * slice, out + z * slice, slice, level);
+        }
+        break;
+    }
+    case UpfExport_RGBA16F: {
+        uint16_t* out = static_cast<uint16_t*>(dst);
+        #pragma omp parallel for if(sZ > 8)
+        for (int z = 0; z < sZ; z++) {
+            upfVec3ToHalf4(snap.velocity.data() + z * slice * 3, out + z * slice * 4, slice, level);
+        }
+        break;
+    }
+    case UpfExport_R8_UNORM: {
+        uint8_t* out = static_cast<uint8_t*>(dst);
+        #pragma omp parallel for if(sZ > 8)
+        for (int z = 0; z < sZ; z++) {
+            upfQuantizeUnorm8(scalar + z * slice, out + z * slice, slice, rangeMin, rangeMax, level);
+        }
+        break;
+    }
+    case UpfExport_BC4_UNORM: {
+        uint8_t* out = static_cast<uint8_t*>(dst);
+        const size_t sliceBytes = upfBC4Bytes(snap.sizeX, snap.sizeY, 1);
+        #pragma omp parallel for if(sZ > 8)
+        for (int z = 0; z < sZ; z++) {
+            upfEncodeBC4Slice(scalar + z * slice, snap.sizeX, snap.sizeY, rangeMin, rangeMax, out + z * sliceBytes);
+        }
+        break;
+    }
+    default:
+        std::memcpy(dst, velocity ? (const void*)snap.velocity.data() : (const void*)scalar, required);
+        break;
+    }
+
+    releaseSnapshot(*grid, slot);
+    if (outMin) *outMin = rangeMin;
+    if (outMax) *outMax = rangeMax;
+    return (int64_t)required;
+}
+
+UPF_API int64_t Upf_ExportGridDensityInto(int32_t gridHandle, void* dst, size_t dstBytes, int32_t format)
+{
+    return exportGridInto(gridHandle, false, -1, dst, dstBytes, format, nullptr, nullptr);
+}
+
+UPF_API int64_t Upf_ExportGridDensityIntoScaled(int32_t gridHandle, void* dst, size_t dstBytes, int32_t format, float* outMin, float* outMax)
+{
+    return exportGridInto(gridHandle, false, -1, dst, dstBytes, format, outMin, outMax);
+}
+
+UPF_API int64_t Upf_ExportGridVelocityInto(int32_t gridHandle, void* dst, size_t dstBytes, int32_t format)
+{
+    return exportGridInto(gridHandle, true, -1, dst, dstBytes, format, nullptr, nullptr);
+}
+
+UPF_API int64_t Upf_ExportGridChannelInto(int32_t gridHandle, int32_t channel, void* dst, size_t dstBytes, int32_t format,
+                                          float* outMin, float* outMax)
+{
+    for (int c = 0; c < kUpfChannelCount; c++) {
+        if (channel == (int32_t)(1u << c)) return exportGridInto(gridHandle, false, c, dst, dstBytes, format, outMin, outMax);
+    }
+    return -1;
+}
+
+UPF_API int32_t Upf_AcquireGridSnapshot(int32_t gridHandle, UpfGridSnapshot* outSnapshot)
+{
+    if (!outSnapshot) return -1;
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid) return -1;
 
-    GridState& g = it->second;
-    if (outSizeX) *outSizeX = g.sizeX;
-    if (outSizeY) *outSizeY = g.sizeY;
-    if (outSizeZ) *outSizeZ = g.sizeZ;
-    if (outFormat) *outFormat = 0; // 0 = float32
+    const int32_t slot = acquireSnapshot(*grid);
+    if (slot < 0) return -2;
 
-    // TODO: Export actual Flow grid density data
-    return g.densityData.data();
+    const GridSnapshot& snap = grid->snapshots[slot];
+    outSnapshot->density = snap.density.data();
+    outSnapshot->velocity = snap.velocity.data();
+    outSnapshot->sizeX = snap.sizeX;
+    outSnapshot->sizeY = snap.sizeY;
+    outSnapshot->sizeZ = snap.sizeZ;
+    outSnapshot->slot = slot;
+    outSnapshot->version = snap.version;
+    return 0;
 }
 
-UPF_API const void* Upf_ExportGridVelocity(int32_t gridHandle, int* outSizeX, int* outSizeY, int* outSizeZ, int* outFormat)
+UPF_API void Upf_ReleaseGridSnapshot(int32_t gridHandle, const UpfGridSnapshot* snapshot)
 {
-    std::lock_guard<std::mutex> lock(g_state.mtx);
-    auto it = g_state.grids.find(gridHandle);
-    if (it == g_state.grids.end()) return nullptr;
+    if (!snapshot) return;
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid) return;
+    releaseSnapshot(*grid, snapshot->slot);
+}
 
-    GridState& g = it->second;
-    if (outSizeX) *outSizeX = g.sizeX;
-    if (outSizeY) *outSizeY = g.sizeY;
-    if (outSizeZ) *outSizeZ = g.sizeZ;
-    if (outFormat) *outFormat = 1; // 1 = float32x3 (vec3)
+UPF_API int64_t Upf_GetGridSnapshotVersion(int32_t gridHandle)
+{
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid) return -1;
+    const int32_t slot = grid->latestSnapshot.load();
+    return slot >= 0 ? grid->snapshots[slot].version : -1;
+}
+
+// Bricks of a snapshot changed after sinceVersion, in index order.
+static void dirtyBricks(const GridSnapshot& snap, int64_t sinceVersion, std::vector<int32_t>& out)
+{
+    out.clear();
+    for (int32_t b = 0; b < (int32_t)snap.brickVersion.size(); b++) {
+        if (snap.brickVersion[b] > sinceVersion) out.push_back(b);
+    }
+}
+
+UPF_API int32_t Upf_GetDirtyRegion(int32_t gridHandle, int64_t sinceVersion, UpfDirtyRegion* outRegion)
+{
+    if (!outRegion) return -1;
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid) return -1;
+
+    const int32_t slot = acquireSnapshot(*grid);
+    if (slot < 0) return -2;
+    const GridSnapshot& snap = grid->snapshots[slot];
+
+    int32_t count = 0;
+    int lo[3] = { INT32_MAX, INT32_MAX, INT32_MAX }, hi[3] = { 0, 0, 0 };
+    for (int32_t b = 0; b < (int32_t)snap.brickVersion.size(); b++) {
+        if (snap.brickVersion[b] <= sinceVersion) continue;
+        const BrickBounds r = brickBounds(snap, b);
+        lo[0] = std::min(lo[0], r.x0); hi[0] = std::max(hi[0], r.x1);
+        lo[1] = std::min(lo[1], r.y0); hi[1] = std::max(hi[1], r.y1);
+        lo[2] = std::min(lo[2], r.z0); hi[2] = std::max(hi[2], r.z1);
+        count++;
+    }
+    *outRegion = {};
+    outRegion->version = snap.version;
+    outRegion->brickCount = count;
+    if (count > 0) {
+        outRegion->x = lo[0]; outRegion->sizeX = hi[0] - lo[0];
+        outRegion->y = lo[1]; outRegion->sizeY = hi[1] - lo[1];
+        outRegion->z = lo[2]; outRegion->sizeZ = hi[2] - lo[2];
+    }
+    releaseSnapshot(*grid, slot);
+    return 0;
+}
+
+// Bytes per cell of the formats a box or brick can be exported in, 0 if unsupported.
+static size_t regionCellBytes(int32_t format)
+{
+    switch (format) {
+    case UpfExport_R32F: return sizeof(float);
+    case UpfExport_R16F: return sizeof(uint16_t);
+    case UpfExport_RGB32F: return 3 * sizeof(float);
+    case UpfExport_RGBA32F: return 4 * sizeof(float);
+    case UpfExport_RGBA16F: return 4 * sizeof(uint16_t);
+    default: return 0;
+    }
+}
+
+// Convert count cells of a snapshot row, starting at cell, into out.
+static void exportRow(const GridSnapshot& snap, size_t cell, size_t count, int32_t format, uint8_t* out, UpfSimdLevel level)
+{
+    switch (format) {
+    case UpfExport_R32F:
+        std::memcpy(out, snap.density.data() + cell, count * sizeof(float));
+        break;
+    case UpfExport_R16F:
+        upfFloatToHalf(snap.density.data() + cell, reinterpret_cast<uint16_t*>(out), count, level);
+        break;
+    case UpfExport_RGB32F:
+        std::memcpy(out, snap.velocity.data() + cell * 3, count * 3 * sizeof(float));
+        break;
+    case UpfExport_RGBA32F: {
+        const float* src = snap.velocity.data() + cell * 3;
+        float* dst = reinterpret_cast<float*>(out);
+        for (size_t i = 0; i < count; i++) {
+            dst[i * 4 + 0] = src[i * 3 + 0];
+            dst[i * 4 + 1] = src[i * 3 + 1];
+            dst[i * 4 + 2] = src[i * 3 + 2];
+            dst[i * 4 + 3] = 0.0f;
+        }
+        break;
+    }
+    case UpfExport_RGBA16F:
+        upfVec3ToHalf4(snap.velocity.data() + cell * 3, reinterpret_cast<uint16_t*>(out), count, level);
+        break;
+    }
+}
+
+UPF_API int64_t Upf_ExportGridRegionInto(int32_t gridHandle, const UpfDirtyRegion* region, void* dst, size_t dstBytes, int32_t format)
+{
+    if (!region) return -1;
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid) return -1;
+    const size_t cellBytes = regionCellBytes(format);
+    const UpfDirtyRegion& r = *region;
+    if (cellBytes == 0) return -1;
+
+    const int32_t slot = acquireSnapshot(*grid);
+    if (slot < 0) return -2;
+    const GridSnapshot& snap = grid->snapshots[slot];
+    if (r.x < 0 || r.y < 0 || r.z < 0 || r.sizeX < 0 || r.sizeY < 0 || r.sizeZ < 0 ||
+        r.sizeX > snap.sizeX - r.x || r.sizeY > snap.sizeY - r.y || r.sizeZ > snap.sizeZ - r.z) {
+        releaseSnapshot(*grid, slot);
+        return -1;
+    }
+    const size_t rowBytes = (size_t)r.sizeX * cellBytes;
+    const size_t required = rowBytes * r.sizeY * r.sizeZ;
+    if (!dst || dstBytes < required) {
+        releaseSnapshot(*grid, slot);
+        return dst ? -3 : (int64_t)required;
+    }
+    const UpfSimdLevel level = (UpfSimdLevel)g_state.simdLevel.load();
+    uint8_t* out = static_cast<uint8_t*>(dst);
+
+    #pragma omp parallel for if(r.sizeZ > 8)
+    for (int z = 0; z < r.sizeZ; z++) {
+        for (int y = 0; y < r.sizeY; y++) {
+            const size_t cell = (size_t)r.x + (size_t)(r.y + y) * snap.sizeX + (size_t)(r.z + z) * snap.sizeX * snap.sizeY;
+            exportRow(snap, cell, r.sizeX, format, out + ((size_t)z * r.sizeY + y) * rowBytes, level);
+        }
+    }
+
+    releaseSnapshot(*grid, slot);
+    return (int64_t)required;
+}
+
+UPF_API int32_t Upf_ExportDirtyBricks(int32_t gridHandle, int64_t sinceVersion, int32_t* outBricks, int32_t maxBricks,
+                                      void* dst, size_t dstBytes, int32_t format)
+{
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid) return -1;
+    const size_t cellBytes = regionCellBytes(format);
+    if (cellBytes == 0) return -1;
+
+    const int32_t slot = acquireSnapshot(*grid);
+    if (slot < 0) return -2;
+    const GridSnapshot& snap = grid->snapshots[slot];
+    std::vector<int32_t> bricks;
+    dirtyBricks(snap, sinceVersion, bricks);
+    const int32_t count = (int32_t)bricks.size();
+    const size_t rowBytes = kBrickSize * cellBytes;
+    const size_t brickBytes = rowBytes * kBrickSize * kBrickSize;
+    if (!dst || !outBricks) {
+        releaseSnapshot(*grid, slot);
+        return count;
+    }
+    if (count > maxBricks || dstBytes < brickBytes * count) {
+        releaseSnapshot(*grid, slot);
+        return -3;
+    }
+
+    const UpfSimdLevel level = (UpfSimdLevel)g_state.simdLevel.load();
+    uint8_t* out = static_cast<uint8_t*>(dst);
+    #pragma omp parallel for schedule(dynamic, 16) if(count > 64)
+    for (int32_t i = 0; i < count; i++) {
+        const BrickBounds r = brickBounds(snap, bricks[i]);
+        uint8_t* brick = out + brickBytes * i;
+        // Edge bricks: cells past the grid stay zero
+        if (r.x1 - r.x0 < kBrickSize || r.y1 - r.y0 < kBrickSize || r.z1 - r.z0 < kBrickSize) {
+            std::memset(brick, 0, brickBytes);
+        }
+        for (int z = r.z0; z < r.z1; z++) {
+            for (int y = r.y0; y < r.y1; y++) {
+                const size_t cell = (size_t)r.x0 + (size_t)y * snap.sizeX + (size_t)z * snap.sizeX * snap.sizeY;
+                exportRow(snap, cell, r.x1 - r.x0, format, brick + ((size_t)(z - r.z0) * kBrickSize + (y - r.y0)) * rowBytes, level);
+            }
+        }
+    }
+    std::memcpy(outBricks, bricks.data(), bricks.size() * sizeof(int32_t));
+
+    releaseSnapshot(*grid, slot);
+    return count;
+}
+
+UPF_API int32_t Upf_SampleGrid(int32_t gridHandle, const float* points, int32_t count, float* out)
+{
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid || count < 0 || (count > 0 && (!points || !out))) return -1;
+
+    // Pinning the snapshot takes no lock, so queries never wait for a step
+    const int32_t slot = acquireSnapshot(*grid);
+    if (slot < 0) return -2;
+    const GridSnapshot& snap = grid->snapshots[slot];
+
+    UpfSampleSource src;
+    src.sizeX = snap.sizeX; src.sizeY = snap.sizeY; src.sizeZ = snap.sizeZ;
+    src.invCellSize = 1.0f / snap.cellSize;
+    const int size[3] = { snap.sizeX, snap.sizeY, snap.sizeZ };
+    for (int k = 0; k < 3; k++) src.cell0[k] = snap.origin[k] - (size[k] - 1) * snap.cellSize * 0.5f;
+    src.density = snap.density.data();
+    src.velocity = snap.velocity.data();
+    upfSampleGrid(src, points, out, count, (UpfSimdLevel)g_state.simdLevel.load());
+
+    releaseSnapshot(*grid, slot);
+    return count;
+}
+
+UPF_API int64_t Upf_SaveGridState(int32_t gridHandle, const char* path)
+{
+    if (!path) return -1;
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid) return -1;
+
+    std::lock_guard<std::mutex> lock(grid->mtx);
+    GridState& g = *grid;
+    bindEmittersLocked(g);
+    std::vector<UpfEmitterDesc> emitters;
+    std::vector<float> emitterChannels;
+    emitters.reserve(g.boundEmitters.size());
+    for (const EmitterState& e : g.boundEmitters) {
+        emitters.push_back({ e.handle, e.x, e.y, e.z, e.radius, e.density });
+        emitterChannels.insert(emitterChannels.end(), { e.temperature, e.fuel, e.smoke });
+    }
+
+    UpfGridStateHeader header = {};
+    header.sizeX = g.sizeX; header.sizeY = g.sizeY; header.sizeZ = g.sizeZ;
+    header.cellSize = g.cellSize;
+    header.brickSize = kBrickSize;
+    header.emitterCount = (int32_t)emitters.size();
+    header.channels = g.channels;
+    for (int k = 0; k < 3; k++) header.originCell[k] = g.originCell[k];
+    const size_t planeBytes = g.densityData.size() * sizeof(float);
+    const void* sections[UpfGridStateSection_Count];
+    sections[UpfGridStateSection_Density] = g.densityData.data();
+    sections[UpfGridStateSection_VelocityX] = g.velX.data();
+    sections[UpfGridStateSection_VelocityY] = g.velY.data();
+    sections[UpfGridStateSection_VelocityZ] = g.velZ.data();
+    sections[UpfGridStateSection_BrickActivity] = g.brickActivity.data();
+    sections[UpfGridStateSection_BrickVisited] = g.brickVisited.data();
+    sections[UpfGridStateSection_Emitters] = emitters.data();
+    sections[UpfGridStateSection_EmitterChannels] = emitterChannels.data();
+    for (int c = 0; c < kUpfChannelCount; c++) {
+        sections[UpfGridStateSection_Temperature + c] = g.channelData[c].data();
+        header.bytes[UpfGridStateSection_Temperature + c] = g.channelData[c].size() * sizeof(float);
+    }
+    header.bytes[UpfGridStateSection_Density] = planeBytes;
+    header.bytes[UpfGridStateSection_VelocityX] = planeBytes;
+    header.bytes[UpfGridStateSection_VelocityY] = planeBytes;
+    header.bytes[UpfGridStateSection_VelocityZ] = planeBytes;
+    header.bytes[UpfGridStateSection_BrickActivity] = g.brickActivity.size() * sizeof(float);
+    header.bytes[UpfGridStateSection_BrickVisited] = g.brickVisited.size();
+    header.bytes[UpfGridStateSection_Emitters] = emitters.size() * sizeof(UpfEmitterDesc);
+    header.bytes[UpfGridStateSection_EmitterChannels] = emitterChannels.size() * sizeof(float);
+    return upfWriteGridState(path, header, sections);
+}
+
+static void copyBrickFromPlane(const GridState& grid, int32_t b, const float* src, UpfField& field)
+{
+    const BrickBounds r = brickBounds(grid, b);
+    for (int z = r.z0; z < r.z1; z++) {
+        for (int y = r.y0; y < r.y1; y++) {
+            const size_t row = (size_t)y * grid.sizeX + (size_t)z * grid.sizeX * grid.sizeY;
+            std::memcpy(field.data() + row + r.x0, src + row + r.x0, (size_t)(r.x1 - r.x0) * sizeof(float));
+        }
+    }
+}
+
+// Adopt a mapped state: the bricks it marks visited are copied, every other
+// brick cleared, so cells outside visited bricks stay zero in both buffers
+// whatever the file holds there. Channels of the grid the file lacks start
+// from zero; channels only the file has are ignored. A window saved elsewhere
+// is scrolled back to first (the grid must already scroll). Caller must hold
+// grid.mtx.
+static void loadGridStateLocked(GridState& grid, const UpfGridStateView& view)
+{
+    const int32_t* origin = view.header->originCell;
+    if (origin[0] != grid.originCell[0] || origin[1] != grid.originCell[1] || origin[2] != grid.originCell[2]) {
+        scrollGridLocked(grid, origin[0] - grid.originCell[0], origin[1] - grid.originCell[1], origin[2] - grid.originCell[2]);
+    }
+    if (grid.scrolling) {
+        for (int k = 0; k < 3; k++) grid.targetOrigin[k] = grid.originCell[k] * grid.cellSize;
+    }
+    const int32_t numBricks = (int32_t)grid.brickVisited.size();
+
+    #pragma omp parallel for schedule(dynamic, 16) if(numBricks > 64)
+    for (int32_t b = 0; b < numBricks; b++) {
+        if (view.brickVisited[b]) {
+            copyBrickFromPlane(grid, b, view.density, grid.densityData);
+            copyBrickFromPlane(grid, b, view.velX, grid.velX);
+            copyBrickFromPlane(grid, b, view.velY, grid.velY);
+            copyBrickFromPlane(grid, b, view.velZ, grid.velZ);
+            for (int c = 0; c < kUpfChannelCount; c++) {
+                if (grid.channelData[c].empty()) continue;
+                if (view.channels[c]) copyBrickFromPlane(grid, b, view.channels[c], grid.channelData[c]);
+                else clearBrick(grid, b, grid.channelData[c]);
+            }
+        } else if (grid.brickVisited[b]) {
+            clearBrick(grid, b, grid.densityData); clearBrick(grid, b, grid.densityTemp);
+            clearBrick(grid, b, grid.velX); clearBrick(grid, b, grid.velXTemp);
+            clearBrick(grid, b, grid.velY); clearBrick(grid, b, grid.velYTemp);
+            clearBrick(grid, b, grid.velZ); clearBrick(grid, b, grid.velZTemp);
+            for (int c = 0; c < kUpfChannelCount; c++) {
+                if (grid.channelData[c].empty()) continue;
+                clearBrick(grid, b, grid.channelData[c]);
+                clearBrick(grid, b, grid.channelTemp[c]);
+            }
+        }
+    }
+
+    grid.activeBricks.clear();
+    for (int32_t b = 0; b < numBricks; b++) {
+        grid.brickVisited[b] = view.brickVisited[b] ? 1 : 0;
+        const float activity = view.brickActivity[b];
+        grid.brickActivity[b] = grid.brickVisited[b] && std::isfinite(activity) ? activity : 0.0f;
+        if (grid.brickVisited[b]) grid.activeBricks.push_back(b);
+    }
+    releaseAdvectScratch(grid);
+    grid.timeAccumulator = 0.0f;
+    publishSnapshotLocked(grid);
+}
+
+UPF_API int32_t Upf_LoadGridState(int32_t gridHandle, const char* path, int32_t* outEmitterHandles, int32_t maxEmitters)
+{
+    if (!path) return -1;
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid) return -1;
+
+    UpfMappedFile file;
+    if (!file.open(path)) return -2;
+    UpfGridStateView view;
+    const int32_t result = upfGridStateView(file.data, file.size, view);
+    if (result != 0) return result;
+    const UpfGridStateHeader& header = *view.header;
+    {
+        std::lock_guard<std::mutex> lock(grid->mtx);
+        if (grid->flowGrid || grid->player) return -6;
+        if (header.sizeX != grid->sizeX || header.sizeY != grid->sizeY || header.sizeZ != grid->sizeZ ||
+            header.brickSize != kBrickSize) {
+            return -5;
+        }
+        if (std::fabs(header.cellSize - grid->cellSize) > grid->cellSize * 1e-5f) return -7;
+        const int32_t* origin = header.originCell;
+        if (origin[0] != grid->originCell[0] || origin[1] != grid->originCell[1] || origin[2] != grid->originCell[2]) {
+            // Restoring a moved window makes the grid scroll, which recordings can't follow
+            if (grid->recorder) return -6;
+            if (!enableScrollingLocked(*grid)) return -8;
+        }
+        loadGridStateLocked(*grid, view);
+    }
+
+    if (outEmitterHandles) {
+        const int32_t count = std::min(header.emitterCount, std::max(maxEmitters, 0));
+        for (int32_t i = 0; i < count; i++) {
+            const UpfEmitterDesc& e = view.emitters[i];
+            outEmitterHandles[i] = Upf_CreateEmitter(e.x, e.y, e.z, e.radius, e.density);
+            const float* c = view.emitterChannels + (size_t)i * 3;
+            if (c[0] != 0.0f || c[1] != 0.0f || c[2] != 0.0f) Upf_SetEmitterChannels(outEmitterHandles[i], c[0], c[1], c[2]);
+        }
+    }
+    return header.emitterCount;
+}
+
+UPF_API int32_t Upf_StartGridRecording(int32_t gridHandle, const char* path)
+{
+    if (!path) return -1;
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid) return -1;
+
+    std::lock_guard<std::mutex> lock(grid->mtx);
+    // Cache frames carry no origin, so a moving window would play back in place
+    if (grid->scrolling) {
+        postEvent(UpfEvent_Error, grid->handle, 0, 0.0f, 0.0f, "Scrolling grids can't be recorded");
+        return -3;
+    }
+    if (grid->recorder) upfVdbRecorderClose(grid->recorder);
+    grid->recorder = upfVdbRecorderOpen(path, grid->sizeX, grid->sizeY, grid->sizeZ, grid->cellSize);
+    grid->recordTime = 0.0;
+    return grid->recorder ? 0 : -2;
+}
+
+UPF_API int32_t Upf_StopGridRecording(int32_t gridHandle)
+{
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid) return -1;
+
+    std::lock_guard<std::mutex> lock(grid->mtx);
+    if (!grid->recorder) return -1;
+    const int32_t frames = upfVdbRecorderClose(grid->recorder);
+    grid->recorder = nullptr;
+    return frames;
+}
+
+// Frames read ahead of the one playing
+static constexpr int32_t kPlaybackReadAhead = 4;
+
+UPF_API int32_t Upf_CreatePlaybackGrid(const char* path, int32_t loop)
+{
+    if (!path || Upf_GetContextApi() < 0) return -1;
+    UpfVdbPlayer* player = upfVdbPlayerOpen(path, kPlaybackReadAhead, loop != 0);
+    if (!player) return -1;
+    const UpfVdbPlayerInfo info = upfVdbPlayerInfo(player);
+
+    int32_t handle;
+    {
+        std::lock_guard<std::mutex> lock(g_state.mtx);
+        handle = g_state.nextGridHandle++;
+    }
+    std::shared_ptr<GridState> grid = makeGrid(handle, info.sizeX, info.sizeY, info.sizeZ, info.cellSize, false, 0);
+    grid->player = player;
+    if (!showPlaybackFrameLocked(*grid, 0)) {
+        upfVdbPlayerClose(player);
+        return -1;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(g_state.mtx);
+        g_state.grids[handle] = std::move(grid);
+    }
+    postEvent(UpfEvent_GridCreated, handle, 0, info.cellSize, 0.0f, nullptr);
+    return handle;
+}
+
+UPF_API int32_t Upf_SeekGridPlayback(int32_t gridHandle, float seconds)
+{
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid) return -1;
+
+    std::lock_guard<std::mutex> lock(grid->mtx);
+    if (!grid->player) return -1;
+    grid->playbackTime = seconds;
+    const int32_t frame = upfVdbPlayerFrameAt(grid->player, seconds);
+    if (frame != grid->playbackFrame && !showPlaybackFrameLocked(*grid, frame)) return -2;
+    return frame;
+}
+
+UPF_API int32_t Upf_GetGridPlaybackInfo(int32_t gridHandle, UpfPlaybackInfo* outInfo)
+{
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid || !outInfo) return -1;
+
+    std::lock_guard<std::mutex> lock(grid->mtx);
+    if (!grid->player) return -1;
+    const UpfVdbPlayerInfo info = upfVdbPlayerInfo(grid->player);
+    outInfo->sizeX = info.sizeX;
+    outInfo->sizeY = info.sizeY;
+    outInfo->sizeZ = info.sizeZ;
+    outInfo->cellSize = info.cellSize;
+    outInfo->frameCount = info.frameCount;
+    outInfo->frame = grid->playbackFrame;
+    outInfo->duration = info.duration;
+    outInfo->time = (float)grid->playbackTime;
+    return 0;
+}
+
+// Coarsest LOD level: 1/512 of the cells at creation
+static constexpr int32_t kMaxGridLod = 3;
+
+static int lodSize(int baseSize, int32_t level)
+{
+    return (baseSize + (1 << level) - 1) >> level;
+}
+
+// Coarsest level at which every axis still spans a brick.
+static int32_t maxGridLod(const GridState& grid)
+{
+    int32_t level = kMaxGridLod;
+    while (level > 0 && std::min({ lodSize(grid.baseSizeX, level), lodSize(grid.baseSizeY, level),
+                                   lodSize(grid.baseSizeZ, level) }) < kBrickSize) {
+        level--;
+    }
+    return level;
+}
+
+// Resample the fields to a LOD level and reallocate everything sized by the
+// grid. Obstacles and emitters are rebound on the next step and every brick
+// counts as changed at the next publish. Caller must hold grid.mtx.
+static void resampleGridLocked(GridState& grid, int32_t level)
+{
+    const int sX = lodSize(grid.baseSizeX, level);
+    const int sY = lodSize(grid.baseSizeY, level);
+    const int sZ = lodSize(grid.baseSizeZ, level);
+    const float cellSize = grid.baseCellSize * (float)(1 << level);
+    const UpfResampler resampler = upfMakeResampler(grid.sizeX, grid.sizeY, grid.sizeZ, grid.cellSize, sX, sY, sZ, cellSize);
+    const int bX = (sX + kBrickSize - 1) / kBrickSize;
+    const int bY = (sY + kBrickSize - 1) / kBrickSize;
+    const int bZ = (sZ + kBrickSize - 1) / kBrickSize;
+    const int32_t numBricks = bX * bY * bZ;
+
+    // Only bricks reading from visited bricks can be non-zero; the rest stay zero
+    std::vector<uint8_t> covered(numBricks, 0);
+    for (int32_t b = 0; b < (int32_t)grid.brickVisited.size(); b++) {
+        if (!grid.brickVisited[b]) continue;
+        const BrickBounds r = brickBounds(grid, b);
+        int lo[3], hi[3];
+        upfResampleFootprint(resampler.x, r.x0, r.x1, lo[0], hi[0]);
+        upfResampleFootprint(resampler.y, r.y0, r.y1, lo[1], hi[1]);
+        upfResampleFootprint(resampler.z, r.z0, r.z1, lo[2], hi[2]);
+        for (int z = lo[2] / kBrickSize; z * kBrickSize < hi[2]; z++)
+            for (int y = lo[1] / kBrickSize; y * kBrickSize < hi[1]; y++)
+                for (int x = lo[0] / kBrickSize; x * kBrickSize < hi[0]; x++) covered[x + y * bX + z * bX * bY] = 1;
+    }
+    std::vector<int32_t> bricks;
+    for (int32_t b = 0; b < numBricks; b++) {
+        if (covered[b]) bricks.push_back(b);
+    }
+
+    const size_t numCells = (size_t)sX * sY * sZ;
+    UpfField density, vx, vy, vz;
+    UpfField channels[kUpfChannelCount];
+    for (UpfField* v : { &density, &vx, &vy, &vz }) {
+        v->setRing(grid.scrolling);
+        v->resize(numCells, 0.0f);
+    }
+    for (int c = 0; c < kUpfChannelCount; c++) {
+        if (grid.channelData[c].empty()) continue;
+        channels[c].setRing(grid.scrolling);
+        channels[c].resize(numCells, 0.0f);
+    }
+    const int numCovered = (int)bricks.size();
+    #pragma omp parallel for schedule(dynamic, 4) if(numCovered > 8)
+    for (int i = 0; i < numCovered; i++) {
+        const int32_t b = bricks[i];
+        const int x0 = (b % bX) * kBrickSize, y0 = (b / bX % bY) * kBrickSize, z0 = b / (bX * bY) * kBrickSize;
+        const int x1 = std::min(x0 + kBrickSize, sX), y1 = std::min(y0 + kBrickSize, sY), z1 = std::min(z0 + kBrickSize, sZ);
+        // Velocity is in world units, so it resamples like density
+        upfResampleBox(resampler, grid.densityData.data(), density.data(), x0, x1, y0, y1, z0, z1);
+        upfResampleBox(resampler, grid.velX.data(), vx.data(), x0, x1, y0, y1, z0, z1);
+        upfResampleBox(resampler, grid.velY.data(), vy.data(), x0, x1, y0, y1, z0, z1);
+        upfResampleBox(resampler, grid.velZ.data(), vz.data(), x0, x1, y0, y1, z0, z1);
+        for (int c = 0; c < kUpfChannelCount; c++) {
+            if (channels[c].empty()) continue;
+            upfResampleBox(resampler, grid.channelData[c].data(), channels[c].data(), x0, x1, y0, y1, z0, z1);
+        }
+    }
+    grid.densityData.swap(density);
+    grid.velX.swap(vx);
+    grid.velY.swap(vy);
+    grid.velZ.swap(vz);
+    for (UpfField* v : { &grid.densityTemp, &grid.velXTemp, &grid.velYTemp, &grid.velZTemp }) {
+        v->assign(numCells, 0.0f);
+    }
+    for (int c = 0; c < kUpfChannelCount; c++) {
+        if (channels[c].empty()) continue;
+        grid.channelData[c].swap(channels[c]);
+        grid.channelTemp[c].assign(numCells, 0.0f);
+    }
+    releaseAdvectScratch(grid);
+
+    grid.sizeX = sX; grid.sizeY = sY; grid.sizeZ = sZ;
+    // A scrolling window stays on the cell nearest its center
+    for (int k = 0; k < 3; k++) grid.originCell[k] = (int)std::lround(grid.originCell[k] * grid.cellSize / cellSize);
+    grid.cellSize = cellSize;
+    grid.lodLevel = level;
+    grid.bricksX = bX; grid.bricksY = bY; grid.bricksZ = bZ;
+    grid.brickActivity.assign(numBricks, 0.0f);
+    grid.brickVisited.assign(numBricks, 0);
+
+    // Bricks the filter left non-zero are visited, with the activity the
+    // sweep would report for them (density counts as twice the threshold)
+    #pragma omp parallel for schedule(dynamic, 4) if(numCovered > 8)
+    for (int i = 0; i < numCovered; i++) {
+        const int32_t b = bricks[i];
+        const BrickBounds r = brickBounds(grid, b);
+        float activity = 0.0f;
+        bool content = false;
+        for (int z = r.z0; z < r.z1; z++) {
+            for (int y = r.y0; y < r.y1; y++) {
+                const size_t row = (size_t)y * sX + (size_t)z * sX * sY;
+                for (size_t c = row + r.x0; c < row + r.x1; c++) {
+                    const float d = grid.densityData[c];
+                    const float speed = std::max({ std::fabs(grid.velX[c]), std::fabs(grid.velY[c]), std::fabs(grid.velZ[c]) });
+                    content |= d != 0.0f || speed != 0.0f;
+                    activity = std::max({ activity, speed, std::min(d, 2.0f * kActivityEpsilon) });
+                    for (const UpfField& plane : grid.channelData) {
+                        if (plane.empty() || plane[c] == 0.0f) continue;
+                        content = true;
+                        activity = std::max(activity, 2.0f * kActivityEpsilon);
+                    }
+                }
+            }
+        }
+        grid.brickVisited[b] = content ? 1 : 0;
+        grid.brickActivity[b] = activity;
+    }
+    grid.activeBricks.clear();
+    for (int32_t b = 0; b < numBricks; b++) {
+        if (grid.brickVisited[b]) grid.activeBricks.push_back(b);
+    }
+
+    grid.boundObstacles.clear();
+    std::vector<float>().swap(grid.obstacleSdf);
+    std::vector<uint8_t>().swap(grid.solid);
+    std::vector<uint8_t>().swap(grid.brickObstacle);
+    grid.obstacleBricks.clear();
+    grid.boundObstacleGeneration = -1;
+    grid.solidVersion++;
+    grid.boundGeneration = -1;
+    grid.pressure.levels.clear();
+    grid.brickChanged.clear();
+    grid.publishedBricks.clear();
+}
+
+UPF_API int32_t Upf_SetGridLod(int32_t gridHandle, int32_t level)
+{
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid) return -1;
+
+    std::lock_guard<std::mutex> lock(grid->mtx);
+    if (grid->flowGrid || grid->player || grid->recorder) return -2;
+    level = std::max(0, std::min(level, maxGridLod(*grid)));
+    if (level == grid->lodLevel) return level;
+    resampleGridLocked(*grid, level);
+    publishSnapshotLocked(*grid);
+    return level;
+}
+
+UPF_API int32_t Upf_GetGridLod(int32_t gridHandle, UpfGridLod* outLod)
+{
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid || !outLod) return -1;
+
+    std::lock_guard<std::mutex> lock(grid->mtx);
+    outLod->level = grid->lodLevel;
+    outLod->maxLevel = grid->flowGrid || grid->player ? 0 : maxGridLod(*grid);
+    outLod->sizeX = grid->sizeX;
+    outLod->sizeY = grid->sizeY;
+    outLod->sizeZ = grid->sizeZ;
+    outLod->cellSize = grid->cellSize;
+    return 0;
+}
+
+UPF_API int32_t Upf_SetGridOrigin(int32_t gridHandle, float x, float y, float z)
+{
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid) return -1;
+
+    std::lock_guard<std::mutex> lock(grid->mtx);
+    if (grid->flowGrid || grid->player) return -2;
+    if (grid->recorder) {
+        postEvent(UpfEvent_Error, grid->handle, 0, 0.0f, 0.0f, "Grids being recorded can't scroll");
+        return -2;
+    }
+    if (!enableScrollingLocked(*grid)) return -3;
+    grid->targetOrigin[0] = x;
+    grid->targetOrigin[1] = y;
+    grid->targetOrigin[2] = z;
+    return 0;
+}
+
+UPF_API int32_t Upf_GetGridOrigin(int32_t gridHandle, float* outOrigin)
+{
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid || !outOrigin) return -1;
+
+    const int32_t slot = acquireSnapshot(*grid);
+    if (slot >= 0) {
+        for (int k = 0; k < 3; k++) outOrigin[k] = grid->snapshots[slot].origin[k];
+        releaseSnapshot(*grid, slot);
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(grid->mtx);
+    gridCenter(*grid, outOrigin);
+    return 0;
+}
+
+// Largest tracer pool of a grid
+static constexpr int32_t kMaxTracers = 1 << 22;
+
+UPF_API int32_t Upf_SetTracerCapacity(int32_t gridHandle, int32_t capacity)
+{
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid) return -1;
+
+    std::lock_guard<std::mutex> lock(grid->tracerMtx);
+    grid->tracerCapacity = std::max(0, std::min(capacity, kMaxTracers));
+    return grid->tracerCapacity;
+}
+
+UPF_API int32_t Upf_SpawnTracers(int32_t gridHandle, const float* positions, int32_t count, float lifetime)
+{
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid || (!positions && count > 0)) return -1;
+    if (count <= 0 || !(lifetime > 0.0f)) return 0;
+
+    std::lock_guard<std::mutex> lock(grid->tracerMtx);
+    // Live tracers as of the last step; those dying since free up room on the next call
+    const int32_t live = grid->tracerClear ? 0 : (int32_t)(grid->tracerPacked.size() / 4);
+    const int32_t room = grid->tracerCapacity - live - (int32_t)(grid->tracerPending.size() / 4);
+    const int32_t accepted = std::max(0, std::min(count, room));
+    const size_t first = grid->tracerPending.size();
+    grid->tracerPending.resize(first + (size_t)accepted * 4);
+    for (int32_t i = 0; i < accepted; i++) {
+        float* q = &grid->tracerPending[first + (size_t)i * 4];
+        q[0] = positions[i * 3 + 0];
+        q[1] = positions[i * 3 + 1];
+        q[2] = positions[i * 3 + 2];
+        q[3] = lifetime;
+    }
+    return accepted;
+}
+
+UPF_API int32_t Upf_ClearTracers(int32_t gridHandle)
+{
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid) return -1;
+
+    std::lock_guard<std::mutex> lock(grid->tracerMtx);
+    grid->tracerPending.clear();
+    grid->tracerPacked.clear();
+    grid->tracerClear = true;
+    return 0;
+}
 
-    // TODO: Export actual Flow grid velocity data
-    return g.velocityData.data();
+UPF_API int32_t Upf_GetTracerCount(int32_t gridHandle)
+{
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid) return -1;
+
+    std::lock_guard<std::mutex> lock(grid->tracerMtx);
+    return (int32_t)(grid->tracerPacked.size() / 4);
+}
+
+UPF_API int32_t Upf_ExportTracers(int32_t gridHandle, float* outPacked, int32_t maxCount)
+{
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid || (!outPacked && maxCount > 0)) return -1;
+
+    std::lock_guard<std::mutex> lock(grid->tracerMtx);
+    const int32_t count = std::max(0, std::min(maxCount, (int32_t)(grid->tracerPacked.size() / 4)));
+    if (count > 0) std::memcpy(outPacked, grid->tracerPacked.data(), (size_t)count * 4 * sizeof(float));
+    return count;
+}
+
+UPF_API int32_t Upf_SetSimdLevel(int32_t level)
+{
+    level = std::max(0, std::min(level, (int32_t)upfDetectSimdLevel()));
+    g_state.simdLevel.store(level);
+    return level;
+}
+
+UPF_API int32_t Upf_SetThreadCount(int32_t threads)
+{
+    threads = std::max(0, threads);
+#ifdef _OPENMP
+    const int defaults = defaultThreadCount();
+    g_state.threadCount.store(threads);
+    return threads > 0 ? threads : defaults;
+#else
+    g_state.threadCount.store(threads);
+    return 1;
+#endif
+}
+
+UPF_API int32_t Upf_GetGridStepTimings(int32_t gridHandle, UpfStepTimings* outTimings)
+{
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid || !outTimings) return -1;
+    std::lock_guard<std::mutex> lock(grid->mtx);
+    *outTimings = grid->lastTimings;
+    return 0;
+}
+
+UPF_API void Upf_SetGridFusedStep(int32_t gridHandle, int32_t enabled)
+{
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid) return;
+    std::lock_guard<std::mutex> lock(grid->mtx);
+    grid->fusedStep = enabled != 0;
+}
+
+UPF_API void Upf_SetGridSparse(int32_t gridHandle, int32_t enabled)
+{
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid) return;
+    std::lock_guard<std::mutex> lock(grid->mtx);
+    grid->sparse = enabled != 0;
+    // Dense sweeps leave scratch values everywhere; sparse ones need zeros outside visited bricks
+    releaseAdvectScratch(*grid);
+}
+
+UPF_API void Upf_SetGridAdvection(int32_t gridHandle, int32_t mode)
+{
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid) return;
+    std::lock_guard<std::mutex> lock(grid->mtx);
+    if (mode < UpfAdvection_SemiLagrangian || mode > UpfAdvection_BFECC) mode = UpfAdvection_SemiLagrangian;
+    grid->advection = mode;
+    releaseAdvectScratch(*grid);
+}
+
+// All finite, and the rates and per-burn amounts non-negative: anything else
+// turns into NaNs or runaway values across the grid.
+static bool validCombustion(const UpfCombustionParams& p)
+{
+    const float values[] = { p.ignitionTemp, p.burnPerTemp, p.fuelPerBurn, p.tempPerBurn, p.smokePerBurn,
+                             p.buoyancyPerTemp, p.coolingRate, p.fuelFade, p.smokeFade };
+    for (float v : values) {
+        if (!std::isfinite(v)) return false;
+    }
+    const float rates[] = { p.burnPerTemp, p.fuelPerBurn, p.tempPerBurn, p.smokePerBurn, p.coolingRate, p.fuelFade, p.smokeFade };
+    for (float v : rates) {
+        if (v < 0.0f) return false;
+    }
+    return true;
+}
+
+UPF_API int32_t Upf_SetGridCombustion(int32_t gridHandle, const UpfCombustionParams* params)
+{
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid || !params) return -1;
+    if (!validCombustion(*params)) {
+        postEvent(UpfEvent_Error, gridHandle, 0, 0.0f, 0.0f, "Combustion rates must be finite and non-negative");
+        return -2;
+    }
+    std::lock_guard<std::mutex> lock(grid->mtx);
+    grid->combustion = *params;
+    return 0;
+}
+
+UPF_API int32_t Upf_GetGridCombustion(int32_t gridHandle, UpfCombustionParams* outParams)
+{
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid || !outParams) return -1;
+    std::lock_guard<std::mutex> lock(grid->mtx);
+    *outParams = grid->combustion;
+    return 0;
+}
+
+UPF_API int32_t Upf_GetGridActiveBrickCount(int32_t gridHandle)
+{
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid) return -1;
+    std::lock_guard<std::mutex> lock(grid->mtx);
+    return (int32_t)grid->activeBricks.size();
+}
+
+UPF_API void Upf_SetGridProjection(int32_t gridHandle, int32_t enabled, int32_t maxCycles, float budgetMs, float tolerance)
+{
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid) return;
+    std::lock_guard<std::mutex> lock(grid->mtx);
+    grid->projection = enabled != 0;
+    grid->projectionMaxCycles = std::max(1, maxCycles);
+    grid->projectionBudgetMs = budgetMs;
+    grid->projectionTolerance = std::max(0.0f, tolerance);
+    if (!grid->projection) {
+        grid->pressure.levels.clear();
+        grid->lastProjection = UpfProjectResult{};
+    }
+}
+
+UPF_API int32_t Upf_GetGridProjectionStats(int32_t gridHandle, UpfProjectionStats* outStats)
+{
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid || !outStats) return -1;
+    std::lock_guard<std::mutex> lock(grid->mtx);
+    outStats->cycles = grid->lastProjection.cycles;
+    outStats->divergence = grid->lastProjection.divergence;
+    outStats->residual = grid->lastProjection.residual;
+    outStats->milliseconds = grid->lastProjection.milliseconds;
+    return 0;
+}
+
+UPF_API int32_t Upf_GetGridObstacleStats(int32_t gridHandle, UpfObstacleStats* outStats)
+{
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid || !outStats) return -1;
+
+    std::lock_guard<std::mutex> lock(grid->mtx);
+    *outStats = grid->lastObstacles;
+    outStats->obstacles = (int32_t)grid->boundObstacles.size();
+    outStats->obstacleBricks = (int32_t)grid->obstacleBricks.size();
+    return 0;
+}
+
+UPF_API void Upf_SetGridSubstepping(int32_t gridHandle, int32_t enabled, float maxCfl, int32_t maxSubsteps, float budgetMs)
+{
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid) return;
+    std::lock_guard<std::mutex> lock(grid->mtx);
+    if (grid->substepping != (enabled != 0)) grid->timeAccumulator = 0.0f;
+    grid->substepping = enabled != 0;
+    grid->substepMaxCfl = maxCfl > 0.0f ? maxCfl : 1.0f;
+    grid->substepMax = std::max(1, maxSubsteps);
+    grid->substepBudgetMs = budgetMs;
+    if (!grid->substepping) grid->lastSubsteps = UpfSubstepStats{};
+}
+
+UPF_API int32_t Upf_GetGridSubstepStats(int32_t gridHandle, UpfSubstepStats* outStats)
+{
+    std::shared_ptr<GridState> grid = findGrid(gridHandle);
+    if (!grid || !outStats) return -1;
+    std::lock_guard<std::mutex> lock(grid->mtx);
+    *outStats = grid->lastSubsteps;
+    return 0;
 }
 
 } // extern "C"
@@ -0,0 +1,751 @@
+#include "UpfAdvection.h"
+#include "UpfSimd.h"
+
+#include <algorithm>
+#include <cmath>
+
+static inline float lerp(float a, float b, float t)
+{
+    return a + (b - a) * t;
+}
+
+static inline float trilinear(const float* f, int i000, int sX, int sXY, float fx, float fy, float fz)
+{
+    const float c00 = lerp(f[i000], f[i000 + 1], fx);
+    const float c10 = lerp(f[i000 + sX], f[i000 + sX + 1], fx);
+    const float c01 = lerp(f[i000 + sXY], f[i000 + sXY + 1], fx);
+    const float c11 = lerp(f[i000 + sXY + sX], f[i000 + sXY + sX + 1], fx);
+    return lerp(lerp(c00, c10, fy), lerp(c01, c11, fy), fz);
+}
+
+static constexpr uint32_t kFire = UpfChannel_Temperature | UpfChannel_Fuel;
+
+// Channel set the kernels are instantiated for: burn is only produced by
+// combustion, so it is dropped unless both temperature and fuel are present.
+static uint32_t kernelChannels(uint32_t channels)
+{
+    channels &= kFire | UpfChannel_Burn | UpfChannel_Smoke;
+    if ((channels & kFire) != kFire) channels &= ~(uint32_t)UpfChannel_Burn;
+    return channels;
+}
+
+// Channel slot c is advected by kernels of channel set Ch
+template <uint32_t Ch>
+static constexpr bool advects(int c)
+{
+    return c != UpfSlot_Burn && ((Ch >> c) & 1u) != 0;
+}
+
+// Combustion, temperature buoyancy and channel limits for one cell; ch holds
+// the advected channel values. Returns the channels' activity.
+template <uint32_t Ch>
+static inline float storeChannels(const UpfAdvectParams& p, int idx, float* ch, float& vy)
+{
+    float activity = 0.0f;
+    if ((Ch & kFire) == kFire) {
+        const float burn = upfCombustCell(p, ch[UpfSlot_Temperature], ch[UpfSlot_Fuel], ch[UpfSlot_Smoke]);
+        if (Ch & UpfChannel_Burn) p.dstChannel[UpfSlot_Burn][idx] = burn;
+    }
+    if (Ch & UpfChannel_Temperature) {
+        float t = std::max(-1.0f, std::min(ch[UpfSlot_Temperature], 1.0f));
+        if (std::fabs(t) < p.densityThreshold) t = 0.0f;
+        vy += t * p.temperatureBuoyancyDt;
+        p.dstChannel[UpfSlot_Temperature][idx] = t;
+        activity = std::min(std::fabs(t), p.densityActivity);
+    }
+    for (int c : { UpfSlot_Fuel, UpfSlot_Smoke }) {
+        if (!advects<Ch>(c)) continue;
+        float v = std::min(ch[c], p.maxDensity);
+        if (v < p.densityThreshold) v = 0.0f;
+        p.dstChannel[c][idx] = v;
+        activity = std::max(activity, std::min(v, p.densityActivity));
+    }
+    return activity;
+}
+
+// Buoyancy, density clamp/clear and velocity clamp for one cell, after the
+// channels. Returns its activity.
+template <uint32_t Ch>
+static inline float storeFused(const UpfAdvectParams& p, int idx, float d, float vx, float vy, float vz, float* ch)
+{
+    const float channelActivity = Ch ? storeChannels<Ch>(p, idx, ch, vy) : 0.0f;
+    if (d > p.buoyancyThreshold) vy += d * p.buoyancyDt;
+    if (d > p.maxDensity) d = p.maxDensity;
+    else if (d < p.densityThreshold) d = 0.0f;
+
+    vx = std::max(-p.maxVelocity, std::min(vx, p.maxVelocity));
+    vy = std::max(-p.maxVelocity, std::min(vy, p.maxVelocity));
+    vz = std::max(-p.maxVelocity, std::min(vz, p.maxVelocity));
+    p.dstDensity[idx] = d;
+    p.dstVx[idx] = vx;
+    p.dstVy[idx] = vy;
+    p.dstVz[idx] = vz;
+
+    const float speed = std::max(std::fabs(vx), std::max(std::fabs(vy), std::fabs(vz)));
+    const float activity = std::max(speed, std::min(d, p.densityActivity));
+    return Ch ? std::max(activity, channelActivity) : activity;
+}
+
+template <bool Fused, uint32_t Ch>
+static float advectRowScalar(const UpfAdvectParams& p, int y, int z, int x0, int x1)
+{
+    const int sX = p.sizeX, sY = p.sizeY, sZ = p.sizeZ;
+    const int sXY = sX * sY;
+    const int row = y * sX + z * sXY;
+    float activity = 0.0f;
+
+    for (int x = x0; x < x1; x++) {
+        const int idx = row + x;
+
+        float px = x - p.srcVx[idx] * p.dtOverCs;
+        float py = y - p.srcVy[idx] * p.dtOverCs;
+        float pz = z - p.srcVz[idx] * p.dtOverCs;
+
+        px = std::max(1.5f, std::min(px, (float)(sX - 2.5f)));
+        py = std::max(1.5f, std::min(py, (float)(sY - 2.5f)));
+        pz = std::max(1.5f, std::min(pz, (float)(sZ - 2.5f)));
+
+        const int ix = (int)px, iy = (int)py, iz = (int)pz;
+        const float fx = px - ix, fy = py - iy, fz = pz - iz;
+        const int i000 = ix + iy * sX + iz * sXY;
+
+        const float d = trilinear(p.srcDensity, i000, sX, sXY, fx, fy, fz) * p.dissipation;
+        const float vx = trilinear(p.srcVx, i000, sX, sXY, fx, fy, fz) * p.velocityDamping;
+        const float vy = trilinear(p.srcVy, i000, sX, sXY, fx, fy, fz) * p.velocityDamping;
+        const float vz = trilinear(p.srcVz, i000, sX, sXY, fx, fy, fz) * p.velocityDamping;
+        float ch[kUpfChannelCount] = {};
+        for (int c = 0; c < kUpfChannelCount; c++) {
+            if (advects<Ch>(c)) ch[c] = trilinear(p.srcChannel[c], i000, sX, sXY, fx, fy, fz) * p.channelDissipation[c];
+        }
+        if (Fused) {
+            activity = std::max(activity, storeFused<Ch>(p, idx, d, vx, vy, vz, ch));
+        } else {
+            p.dstDensity[idx] = d;
+            p.dstVx[idx] = vx;
+            p.dstVy[idx] = vy;
+            p.dstVz[idx] = vz;
+            for (int c = 0; c < kUpfChannelCount; c++) {
+                if (advects<Ch>(c)) p.dstChannel[c][idx] = ch[c];
+            }
+        }
+    }
+    return activity;
+}
+
+template <uint32_t Ch>
+static float passThroughRow(const UpfAdvectParams& p, int y, int z, int x0, int x1)
+{
+    const int row = y * p.sizeX + z * p.sizeX * p.sizeY;
+    float activity = 0.0f;
+    for (int x = x0; x < x1; x++) {
+        const int idx = row + x;
+        float ch[kUpfChannelCount] = {};
+        for (int c = 0; c < kUpfChannelCount; c++) {
+            if (advects<Ch>(c)) ch[c] = p.srcChannel[c][idx];
+        }
+        activity = std::max(activity, storeFused<Ch>(p, idx, p.srcDensity[idx], p.srcVx[idx], p.srcVy[idx], p.srcVz[idx], ch));
+    }
+    return activity;
+}
+
+void upfCopyRow(const UpfAdvectParams& p, int y, int z, int x0, int x1)
+{
+    const int idx = y * p.sizeX + z * p.sizeX * p.sizeY + x0;
+    const int n = x1 - x0;
+    std::copy(p.srcDensity + idx, p.srcDensity + idx + n, p.dstDensity + idx);
+    std::copy(p.srcVx + idx, p.srcVx + idx + n, p.dstVx + idx);
+    std::copy(p.srcVy + idx, p.srcVy + idx + n, p.dstVy + idx);
+    std::copy(p.srcVz + idx, p.srcVz + idx + n, p.dstVz + idx);
+    for (int c = 0; c < kUpfChannelCount; c++) {
+        if (c != UpfSlot_Burn && p.srcChannel[c] && p.dstChannel[c]) {
+            std::copy(p.srcChannel[c] + idx, p.srcChannel[c] + idx + n, p.dstChannel[c] + idx);
+        }
+    }
+}
+
+// --- Correction passes (MacCormack / BFECC) ---
+
+// Trace point of a cell, clamped to the interior like the plain kernels.
+struct TracePoint {
+    int i000;
+    float fx, fy, fz;
+};
+
+static inline TracePoint tracePoint(const UpfAdvectParams& p, int x, int y, int z, float dx, float dy, float dz)
+{
+    const int sX = p.sizeX, sY = p.sizeY, sZ = p.sizeZ;
+    const float px = std::max(1.5f, std::min(x + dx, (float)(sX - 2.5f)));
+    const float py = std::max(1.5f, std::min(y + dy, (float)(sY - 2.5f)));
+    const float pz = std::max(1.5f, std::min(z + dz, (float)(sZ - 2.5f)));
+    const int ix = (int)px, iy = (int)py, iz = (int)pz;
+    return { ix + iy * sX + iz * sX * sY, px - ix, py - iy, pz - iz };
+}
+
+// Clamp v to the range of the 8 cells around a trace point.
+static inline float limitToCorners(const float* f, int i000, int sX, int sXY, float v)
+{
+    const float a = f[i000], b = f[i000 + 1], c = f[i000 + sX], d = f[i000 + sX + 1];
+    const float e = f[i000 + sXY], g = f[i000 + sXY + 1], h = f[i000 + sXY + sX], k = f[i000 + sXY + sX + 1];
+    const float lo = std::min(std::min(std::min(a, b), std::min(c, d)), std::min(std::min(e, g), std::min(h, k)));
+    const float hi = std::max(std::max(std::max(a, b), std::max(c, d)), std::max(std::max(e, g), std::max(h, k)));
+    return std::max(lo, std::min(v, hi));
+}
+
+// Fields of the correction passes: density, velocity, then the channels
+static constexpr int kCorrectFields = 4 + kUpfChannelCount;
+
+template <uint32_t Ch>
+static constexpr bool correctsField(int f)
+{
+    return f < 4 || advects<Ch>(f - 4);
+}
+
+struct CorrectionFields {
+    const float* src[kCorrectFields];
+    const float* mid[kCorrectFields];
+    float* dst[kCorrectFields];
+
+    explicit CorrectionFields(const UpfAdvectParams& p)
+        : src{ p.srcDensity, p.srcVx, p.srcVy, p.srcVz,
+               p.srcChannel[0], p.srcChannel[1], p.srcChannel[2], p.srcChannel[3] },
+          mid{ p.midDensity, p.midVx, p.midVy, p.midVz,
+               p.midChannel[0], p.midChannel[1], p.midChannel[2], p.midChannel[3] },
+          dst{ p.dstDensity, p.dstVx, p.dstVy, p.dstVz,
+               p.dstChannel[0], p.dstChannel[1], p.dstChannel[2], p.dstChannel[3] } {}
+};
+
+template <UpfCorrectionPass Pass, uint32_t Ch>
+static float correctRowScalar(const UpfAdvectParams& p, int y, int z, int x0, int x1)
+{
+    const int sX = p.sizeX;
+    const int sXY = sX * p.sizeY;
+    const int row = y * sX + z * sXY;
+    const CorrectionFields f(p);
+    const float* const* src = f.src;
+    const float* const* mid = f.mid;
+    float* const* dst = f.dst;
+    float activity = 0.0f;
+
+    for (int x = x0; x < x1; x++) {
+        const int idx = row + x;
+        const float dx = p.srcVx[idx] * p.dtOverCs, dy = p.srcVy[idx] * p.dtOverCs, dz = p.srcVz[idx] * p.dtOverCs;
+        const TracePoint back = tracePoint(p, x, y, z, -dx, -dy, -dz);
+        const TracePoint ahead = tracePoint(p, x, y, z, dx, dy, dz);
+
+        float out[kCorrectFields] = {};
+        for (int c = 0; c < kCorrectFields; c++) {
+            if (!correctsField<Ch>(c)) continue;
+            float v;
+            if (Pass == UpfCorrect_BfeccForward) {
+                v = trilinear(mid[c], back.i000, sX, sXY, back.fx, back.fy, back.fz);
+            } else {
+                const float base = Pass == UpfCorrect_MacCormack ? mid[c][idx] : src[c][idx];
+                v = base + 0.5f * (src[c][idx] - trilinear(mid[c], ahead.i000, sX, sXY, ahead.fx, ahead.fy, ahead.fz));
+            }
+            if (Pass != UpfCorrect_BfeccBackward) v = limitToCorners(src[c], back.i000, sX, sXY, v);
+            out[c] = v;
+        }
+        if (Pass == UpfCorrect_BfeccBackward) {
+            for (int c = 0; c < kCorrectFields; c++) {
+                if (correctsField<Ch>(c)) dst[c][idx] = out[c];
+            }
+        } else {
+            float* ch = out + 4;
+            for (int c = 0; c < kUpfChannelCount; c++) ch[c] *= p.channelDissipation[c];
+            activity = std::max(activity, storeFused<Ch>(p, idx, out[0] * p.dissipation, out[1] * p.velocityDamping,
+                                                         out[2] * p.velocityDamping, out[3] * p.velocityDamping, ch));
+        }
+    }
+    return activity;
+}
+
+#ifdef UPF_X86
+
+// --- SSE4.1: 4 cells per iteration, corners fetched with scalar loads ---
+
+UPF_TARGET_SSE41 static inline __m128 lerpSse(__m128 a, __m128 b, __m128 t)
+{
+    return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+}
+
+UPF_TARGET_SSE41 static inline __m128 fetchSse(const float* f, const int* i)
+{
+    return _mm_setr_ps(f[i[0]], f[i[1]], f[i[2]], f[i[3]]);
+}
+
+UPF_TARGET_SSE41 static inline __m128 trilinearSse(const float* f, const int* i000, int sX, int sXY, __m128 fx, __m128 fy, __m128 fz)
+{
+    const __m128 c00 = lerpSse(fetchSse(f, i000), fetchSse(f + 1, i000), fx);
+    const __m128 c10 = lerpSse(fetchSse(f + sX, i000), fetchSse(f + sX + 1, i000), fx);
+    const __m128 c01 = lerpSse(fetchSse(f + sXY, i000), fetchSse(f + sXY + 1, i000), fx);
+    const __m128 c11 = lerpSse(fetchSse(f + sXY + sX, i000), fetchSse(f + sXY + sX + 1, i000), fx);
+    return lerpSse(lerpSse(c00, c10, fy), lerpSse(c01, c11, fy), fz);
+}
+
+UPF_TARGET_SSE41 static inline float hmaxSse(__m128 v)
+{
+    v = _mm_max_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_max_ss(v, _mm_shuffle_ps(v, v, 1));
+    return _mm_cvtss_f32(v);
+}
+
+// storeChannels for 4 cells, with combustion masked per lane
+template <uint32_t Ch>
+UPF_TARGET_SSE41 static inline __m128 storeChannelsSse(const UpfAdvectParams& p, int idx, __m128* ch, __m128& vy)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 threshold = _mm_set1_ps(p.densityThreshold);
+    const __m128 cap = _mm_set1_ps(p.densityActivity);
+    __m128 activity = zero;
+    if ((Ch & kFire) == kFire) {
+        __m128& t = ch[UpfSlot_Temperature];
+        __m128& fuel = ch[UpfSlot_Fuel];
+        const __m128 ignition = _mm_set1_ps(p.ignitionTemp);
+        const __m128 burns = _mm_and_ps(_mm_cmpge_ps(t, ignition), _mm_cmpgt_ps(fuel, zero));
+        __m128 burn = _mm_mul_ps(_mm_set1_ps(p.burnPerTempDt), _mm_sub_ps(_mm_min_ps(t, _mm_set1_ps(1.0f)), ignition));
+        burn = _mm_max_ps(zero, _mm_min_ps(burn, _mm_mul_ps(fuel, _mm_set1_ps(p.burnPerFuel))));
+        burn = _mm_and_ps(burn, burns);
+        fuel = _mm_sub_ps(fuel, _mm_mul_ps(burn, _mm_set1_ps(p.fuelPerBurn)));
+        t = _mm_add_ps(t, _mm_mul_ps(burn, _mm_set1_ps(p.tempPerBurn)));
+        if (Ch & UpfChannel_Smoke) {
+            ch[UpfSlot_Smoke] = _mm_add_ps(ch[UpfSlot_Smoke], _mm_mul_ps(burn, _mm_set1_ps(p.smokePerBurn)));
+        }
+        if (Ch & UpfChannel_Burn) _mm_storeu_ps(p.dstChannel[UpfSlot_Burn] + idx, burn);
+    }
+    if (Ch & UpfChannel_Temperature) {
+        __m128 t = _mm_max_ps(_mm_set1_ps(-1.0f), _mm_min_ps(ch[UpfSlot_Temperature], _mm_set1_ps(1.0f)));
+        const __m128 magnitude = _mm_and_ps(t, absMask);
+        t = _mm_and_ps(t, _mm_cmpge_ps(magnitude, threshold));
+        vy = _mm_add_ps(vy, _mm_mul_ps(t, _mm_set1_ps(p.temperatureBuoyancyDt)));
+        _mm_storeu_ps(p.dstChannel[UpfSlot_Temperature] + idx, t);
+        activity = _mm_min_ps(_mm_and_ps(t, absMask), cap);
+    }
+    for (int c : { UpfSlot_Fuel, UpfSlot_Smoke }) {
+        if (!advects<Ch>(c)) continue;
+        __m128 v = _mm_min_ps(ch[c], _mm_set1_ps(p.maxDensity));
+        v = _mm_and_ps(v, _mm_cmpge_ps(v, threshold));
+        _mm_storeu_ps(p.dstChannel[c] + idx, v);
+        activity = _mm_max_ps(activity, _mm_min_ps(v, cap));
+    }
+    return activity;
+}
+
+// Fused epilogue: channels, buoyancy where d > threshold, then density and
+// velocity limits. Returns per-lane activity.
+template <uint32_t Ch>
+UPF_TARGET_SSE41 static inline __m128 storeFusedSse(const UpfAdvectParams& p, int idx, __m128 d, __m128 vx, __m128 vy, __m128 vz, __m128* ch)
+{
+    const __m128 channelActivity = Ch ? storeChannelsSse<Ch>(p, idx, ch, vy) : _mm_setzero_ps();
+    const __m128 lift = _mm_and_ps(_mm_cmpgt_ps(d, _mm_set1_ps(p.buoyancyThreshold)), _mm_mul_ps(d, _mm_set1_ps(p.buoyancyDt)));
+    vy = _mm_add_ps(vy, lift);
+    d = _mm_min_ps(d, _mm_set1_ps(p.maxDensity));
+    d = _mm_and_ps(d, _mm_cmpge_ps(d, _mm_set1_ps(p.densityThreshold)));
+
+    const __m128 hi = _mm_set1_ps(p.maxVelocity);
+    const __m128 lo = _mm_set1_ps(-p.maxVelocity);
+    vx = _mm_max_ps(lo, _mm_min_ps(vx, hi));
+    vy = _mm_max_ps(lo, _mm_min_ps(vy, hi));
+    vz = _mm_max_ps(lo, _mm_min_ps(vz, hi));
+    _mm_storeu_ps(p.dstDensity + idx, d);
+    _mm_storeu_ps(p.dstVx + idx, vx);
+    _mm_storeu_ps(p.dstVy + idx, vy);
+    _mm_storeu_ps(p.dstVz + idx, vz);
+
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 speed = _mm_max_ps(_mm_and_ps(vx, absMask), _mm_max_ps(_mm_and_ps(vy, absMask), _mm_and_ps(vz, absMask)));
+    const __m128 activity = _mm_max_ps(speed, _mm_min_ps(d, _mm_set1_ps(p.densityActivity)));
+    return Ch ? _mm_max_ps(activity, channelActivity) : activity;
+}
+
+template <bool Fused, uint32_t Ch>
+UPF_TARGET_SSE41 static float advectRowSse41(const UpfAdvectParams& p, int y, int z, int x0, int x1)
+{
+    const int sX = p.sizeX, sY = p.sizeY, sZ = p.sizeZ;
+    const int sXY = sX * sY;
+    const int row = y * sX + z * sXY;
+
+    const __m128 lane = _mm_setr_ps(0.f, 1.f, 2.f, 3.f);
+    const __m128 k = _mm_set1_ps(p.dtOverCs);
+    const __m128 lo = _mm_set1_ps(1.5f);
+    const __m128 hiX = _mm_set1_ps(sX - 2.5f);
+    const __m128 hiY = _mm_set1_ps(sY - 2.5f);
+    const __m128 hiZ = _mm_set1_ps(sZ - 2.5f);
+    const __m128i vsX = _mm_set1_epi32(sX);
+    const __m128i vsXY = _mm_set1_epi32(sXY);
+    const __m128 dissipation = _mm_set1_ps(p.dissipation);
+    const __m128 damping = _mm_set1_ps(p.velocityDamping);
+    const __m128 cy = _mm_set1_ps((float)y);
+    const __m128 cz = _mm_set1_ps((float)z);
+
+    alignas(16) int i000[4];
+    __m128 activity = _mm_setzero_ps();
+    int x = x0;
+    for (; x + 4 <= x1; x += 4) {
+        const int idx = row + x;
+        const __m128 cx = _mm_add_ps(_mm_set1_ps((float)x), lane);
+
+        __m128 px = _mm_sub_ps(cx, _mm_mul_ps(_mm_loadu_ps(p.srcVx + idx), k));
+        __m128 py = _mm_sub_ps(cy, _mm_mul_ps(_mm_loadu_ps(p.srcVy + idx), k));
+        __m128 pz = _mm_sub_ps(cz, _mm_mul_ps(_mm_loadu_ps(p.srcVz + idx), k));
+        px = _mm_min_ps(_mm_max_ps(px, lo), hiX);
+        py = _mm_min_ps(_mm_max_ps(py, lo), hiY);
+        pz = _mm_min_ps(_mm_max_ps(pz, lo), hiZ);
+
+        const __m128 flx = _mm_floor_ps(px), fly = _mm_floor_ps(py), flz = _mm_floor_ps(pz);
+        const __m128 fx = _mm_sub_ps(px, flx), fy = _mm_sub_ps(py, fly), fz = _mm_sub_ps(pz, flz);
+        const __m128i base = _mm_add_epi32(_mm_cvttps_epi32(flx),
+            _mm_add_epi32(_mm_mullo_epi32(_mm_cvttps_epi32(fly), vsX), _mm_mullo_epi32(_mm_cvttps_epi32(flz), vsXY)));
+        _mm_store_si128((__m128i*)i000, base);
+
+        const __m128 d = _mm_mul_ps(trilinearSse(p.srcDensity, i000, sX, sXY, fx, fy, fz), dissipation);
+        const __m128 vx = _mm_mul_ps(trilinearSse(p.srcVx, i000, sX, sXY, fx, fy, fz), damping);
+        const __m128 vy = _mm_mul_ps(trilinearSse(p.srcVy, i000, sX, sXY, fx, fy, fz), damping);
+        const __m128 vz = _mm_mul_ps(trilinearSse(p.srcVz, i000, sX, sXY, fx, fy, fz), damping);
+        __m128 ch[kUpfChannelCount] = {};
+        for (int c = 0; c < kUpfChannelCount; c++) {
+            if (!advects<Ch>(c)) continue;
+            ch[c] = _mm_mul_ps(trilinearSse(p.srcChannel[c], i000, sX, sXY, fx, fy, fz), _mm_set1_ps(p.channelDissipation[c]));
+        }
+        if (Fused) {
+            activity = _mm_max_ps(activity, storeFusedSse<Ch>(p, idx, d, vx, vy, vz, ch));
+        } else {
+            _mm_storeu_ps(p.dstDensity + idx, d);
+            _mm_storeu_ps(p.dstVx + idx, vx);
+            _mm_storeu_ps(p.dstVy + idx, vy);
+            _mm_storeu_ps(p.dstVz + idx, vz);
+            for (int c = 0; c < kUpfChannelCount; c++) {
+                if (advects<Ch>(c)) _mm_storeu_ps(p.dstChannel[c] + idx, ch[c]);
+            }
+        }
+    }
+    float rowActivity = hmaxSse(activity);
+    if (x < x1) rowActivity = std::max(rowActivity, advectRowScalar<Fused, Ch>(p, y, z, x, x1));
+    return rowActivity;
+}
+
+// --- AVX2: 8 cells per iteration with hardware gathers ---
+
+UPF_TARGET_AVX2 static inline __m256 lerpAvx2(__m256 a, __m256 b, __m256 t)
+{
+    return _mm256_fmadd_ps(_mm256_sub_ps(b, a), t, a);
+}
+
+UPF_TARGET_AVX2 static inline __m256 trilinearAvx2(const float* f, __m256i i000, int sX, int sXY, __m256 fx, __m256 fy, __m256 fz)
+{
+    const __m256 c00 = lerpAvx2(_mm256_i32gather_ps(f, i000, 4), _mm256_i32gather_ps(f + 1, i000, 4), fx);
+    const __m256 c10 = lerpAvx2(_mm256_i32gather_ps(f + sX, i000, 4), _mm256_i32gather_ps(f + sX + 1, i000, 4), fx);
+    const __m256 c01 = lerpAvx2(_mm256_i32gather_ps(f + sXY, i000, 4), _mm256_i32gather_ps(f + sXY + 1, i000, 4), fx);
+    const __m256 c11 = lerpAvx2(_mm256_i32gather_ps(f + sXY + sX, i000, 4), _mm256_i32gather_ps(f + sXY + sX + 1, i000, 4), fx);
+    return lerpAvx2(lerpAvx2(c00, c10, fy), lerpAvx2(c01, c11, fy), fz);
+}
+
+UPF_TARGET_AVX2 static inline float hmaxAvx2(__m256 v)
+{
+    __m128 m = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+    m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+    return _mm_cvtss_f32(m);
+}
+
+template <uint32_t Ch>
+UPF_TARGET_AVX2 static inline __m256 storeChannelsAvx2(const UpfAdvectParams& p, int idx, __m256* ch, __m256& vy)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    const __m256 threshold = _mm256_set1_ps(p.densityThreshold);
+    const __m256 cap = _mm256_set1_ps(p.densityActivity);
+    __m256 activity = zero;
+    if ((Ch & kFire) == kFire) {
+        __m256& t = ch[UpfSlot_Temperature];
+        __m256& fuel = ch[UpfSlot_Fuel];
+        const __m256 ignition = _mm256_set1_ps(p.ignitionTemp);
+        const __m256 burns = _mm256_and_ps(_mm256_cmp_ps(t, ignition, _CMP_GE_OQ), _mm256_cmp_ps(fuel, zero, _CMP_GT_OQ));
+        __m256 burn = _mm256_mul_ps(_mm256_set1_ps(p.burnPerTempDt), _mm256_sub_ps(_mm256_min_ps(t, _mm256_set1_ps(1.0f)), ignition));
+        burn = _mm256_max_ps(zero, _mm256_min_ps(burn, _mm256_mul_ps(fuel, _mm256_set1_ps(p.burnPerFuel))));
+        burn = _mm256_and_ps(burn, burns);
+        fuel = _mm256_fnmadd_ps(burn, _mm256_set1_ps(p.fuelPerBurn), fuel);
+        t = _mm256_fmadd_ps(burn, _mm256_set1_ps(p.tempPerBurn), t);
+        if (Ch & UpfChannel_Smoke) {
+            ch[UpfSlot_Smoke] = _mm256_fmadd_ps(burn, _mm256_set1_ps(p.smokePerBurn), ch[UpfSlot_Smoke]);
+        }
+        if (Ch & UpfChannel_Burn) _mm256_storeu_ps(p.dstChannel[UpfSlot_Burn] + idx, burn);
+    }
+    if (Ch & UpfChannel_Temperature) {
+        __m256 t = _mm256_max_ps(_mm256_set1_ps(-1.0f), _mm256_min_ps(ch[UpfSlot_Temperature], _mm256_set1_ps(1.0f)));
+        const __m256 magnitude = _mm256_and_ps(t, absMask);
+        t = _mm256_and_ps(t, _mm256_cmp_ps(magnitude, threshold, _CMP_GE_OQ));
+        vy = _mm256_fmadd_ps(t, _mm256_set1_ps(p.temperatureBuoyancyDt), vy);
+        _mm256_storeu_ps(p.dstChannel[UpfSlot_Temperature] + idx, t);
+        activity = _mm256_min_ps(_mm256_and_ps(t, absMask), cap);
+    }
+    for (int c : { UpfSlot_Fuel, UpfSlot_Smoke }) {
+        if (!advects<Ch>(c)) continue;
+        __m256 v = _mm256_min_ps(ch[c], _mm256_set1_ps(p.maxDensity));
+        v = _mm256_and_ps(v, _mm256_cmp_ps(v, threshold, _CMP_GE_OQ));
+        _mm256_storeu_ps(p.dstChannel[c] + idx, v);
+        activity = _mm256_max_ps(activity, _mm256_min_ps(v, cap));
+    }
+    return activity;
+}
+
+template <uint32_t Ch>
+UPF_TARGET_AVX2 static inline __m256 storeFusedAvx2(const UpfAdvectParams& p, int idx, __m256 d, __m256 vx, __m256 vy, __m256 vz, __m256* ch)
+{
+    const __m256 channelActivity = Ch ? storeChannelsAvx2<Ch>(p, idx, ch, vy) : _mm256_setzero_ps();
+    const __m256 lift = _mm256_and_ps(_mm256_cmp_ps(d, _mm256_set1_ps(p.buoyancyThreshold), _CMP_GT_OQ), _mm256_set1_ps(p.buoyancyDt));
+    vy = _mm256_fmadd_ps(d, lift, vy);
+    d = _mm256_min_ps(d, _mm256_set1_ps(p.maxDensity));
+    d = _mm256_and_ps(d, _mm256_cmp_ps(d, _mm256_set1_ps(p.densityThreshold), _CMP_GE_OQ));
+
+    const __m256 hi = _mm256_set1_ps(p.maxVelocity);
+    const __m256 lo = _mm256_set1_ps(-p.maxVelocity);
+    vx = _mm256_max_ps(lo, _mm256_min_ps(vx, hi));
+    vy = _mm256_max_ps(lo, _mm256_min_ps(vy, hi));
+    vz = _mm256_max_ps(lo, _mm256_min_ps(vz, hi));
+    _mm256_storeu_ps(p.dstDensity + idx, d);
+    _mm256_storeu_ps(p.dstVx + idx, vx);
+    _mm256_storeu_ps(p.dstVy + idx, vy);
+    _mm256_storeu_ps(p.dstVz + idx, vz);
+
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    const __m256 speed = _mm256_max_ps(_mm256_and_ps(vx, absMask), _mm256_max_ps(_mm256_and_ps(vy, absMask), _mm256_and_ps(vz, absMask)));
+    const __m256 activity = _mm256_max_ps(speed, _mm256_min_ps(d, _mm256_set1_ps(p.densityActivity)));
+    return Ch ? _mm256_max_ps(activity, channelActivity) : activity;
+}
+
+template <bool Fused, uint32_t Ch>
+UPF_TARGET_AVX2 static float advectRowAvx2(const UpfAdvectParams& p, int y, int z, int x0, int x1)
+{
+    const int sX = p.sizeX, sY = p.sizeY, sZ = p.sizeZ;
+    const int sXY = sX * sY;
+    const int row = y * sX + z * sXY;
+
+    const __m256 lane = _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f);
+    const __m256 k = _mm256_set1_ps(p.dtOverCs);
+    const __m256 lo = _mm256_set1_ps(1.5f);
+    const __m256 hiX = _mm256_set1_ps(sX - 2.5f);
+    const __m256 hiY = _mm256_set1_ps(sY - 2.5f);
+    const __m256 hiZ = _mm256_set1_ps(sZ - 2.5f);
+    const __m256i vsX = _mm256_set1_epi32(sX);
+    const __m256i vsXY = _mm256_set1_epi32(sXY);
+    const __m256 dissipation = _mm256_set1_ps(p.dissipation);
+    const __m256 damping = _mm256_set1_ps(p.velocityDamping);
+    const __m256 cy = _mm256_set1_ps((float)y);
+    const __m256 cz = _mm256_set1_ps((float)z);
+
+    __m256 activity = _mm256_setzero_ps();
+    int x = x0;
+    for (; x + 8 <= x1; x += 8) {
+        const int idx = row + x;
+        const __m256 cx = _mm256_add_ps(_mm256_set1_ps((float)x), lane);
+
+        // Backtrace: p = cell - v * dt / cs, clamped to the interior
+        __m256 px = _mm256_fnmadd_ps(_mm256_loadu_ps(p.srcVx + idx), k, cx);
+        __m256 py = _mm256_fnmadd_ps(_mm256_loadu_ps(p.srcVy + idx), k, cy);
+        __m256 pz = _mm256_fnmadd_ps(_mm256_loadu_ps(p.srcVz + idx), k, cz);
+        px = _mm256_min_ps(_mm256_max_ps(px, lo), hiX);
+        py = _mm256_min_ps(_mm256_max_ps(py, lo), hiY);
+        pz = _mm256_min_ps(_mm256_max_ps(pz, lo), hiZ);
+
+        const __m256 flx = _mm256_floor_ps(px), fly = _mm256_floor_ps(py), flz = _mm256_floor_ps(pz);
+        const __m256 fx = _mm256_sub_ps(px, flx), fy = _mm256_sub_ps(py, fly), fz = _mm256_sub_ps(pz, flz);
+        const __m256i i000 = _mm256_add_epi32(_mm256_cvttps_epi32(flx),
+            _mm256_add_epi32(_mm256_mullo_epi32(_mm256_cvttps_epi32(fly), vsX), _mm256_mullo_epi32(_mm256_cvttps_epi32(flz), vsXY)));
+
+        const __m256 d = _mm256_mul_ps(trilinearAvx2(p.srcDensity, i000, sX, sXY, fx, fy, fz), dissipation);
+        const __m256 vx = _mm256_mul_ps(trilinearAvx2(p.srcVx, i000, sX, sXY, fx, fy, fz), damping);
+        const __m256 vy = _mm256_mul_ps(trilinearAvx2(p.srcVy, i000, sX, sXY, fx, fy, fz), damping);
+        const __m256 vz = _mm256_mul_ps(trilinearAvx2(p.srcVz, i000, sX, sXY, fx, fy, fz), damping);
+        __m256 ch[kUpfChannelCount] = {};
+        for (int c = 0; c < kUpfChannelCount; c++) {
+            if (!advects<Ch>(c)) continue;
+            ch[c] = _mm256_mul_ps(trilinearAvx2(p.srcChannel[c], i000, sX, sXY, fx, fy, fz), _mm256_set1_ps(p.channelDissipation[c]));
+        }
+        if (Fused) {
+            activity = _mm256_max_ps(activity, storeFusedAvx2<Ch>(p, idx, d, vx, vy, vz, ch));
+        } else {
+            _mm256_storeu_ps(p.dstDensity + idx, d);
+            _mm256_storeu_ps(p.dstVx + idx, vx);
+            _mm256_storeu_ps(p.dstVy + idx, vy);
+            _mm256_storeu_ps(p.dstVz + idx, vz);
+            for (int c = 0; c < kUpfChannelCount; c++) {
+                if (advects<Ch>(c)) _mm256_storeu_ps(p.dstChannel[c] + idx, ch[c]);
+            }
+        }
+    }
+    float rowActivity = hmaxAvx2(activity);
+    if (x < x1) rowActivity = std::max(rowActivity, advectRowScalar<Fused, Ch>(p, y, z, x, x1));
+    return rowActivity;
+}
+
+struct TracePointAvx2 {
+    __m256i i000;
+    __m256 fx, fy, fz;
+};
+
+UPF_TARGET_AVX2 static inline TracePointAvx2 traceAvx2(__m256 px, __m256 py, __m256 pz, __m256 lo, __m256 hiX, __m256 hiY, __m256 hiZ,
+                                                      __m256i vsX, __m256i vsXY)
+{
+    px = _mm256_min_ps(_mm256_max_ps(px, lo), hiX);
+    py = _mm256_min_ps(_mm256_max_ps(py, lo), hiY);
+    pz = _mm256_min_ps(_mm256_max_ps(pz, lo), hiZ);
+    const __m256 flx = _mm256_floor_ps(px), fly = _mm256_floor_ps(py), flz = _mm256_floor_ps(pz);
+    TracePointAvx2 t;
+    t.i000 = _mm256_add_epi32(_mm256_cvttps_epi32(flx),
+        _mm256_add_epi32(_mm256_mullo_epi32(_mm256_cvttps_epi32(fly), vsX), _mm256_mullo_epi32(_mm256_cvttps_epi32(flz), vsXY)));
+    t.fx = _mm256_sub_ps(px, flx);
+    t.fy = _mm256_sub_ps(py, fly);
+    t.fz = _mm256_sub_ps(pz, flz);
+    return t;
+}
+
+UPF_TARGET_AVX2 static inline __m256 limitToCornersAvx2(const float* f, __m256i i000, int sX, int sXY, __m256 v)
+{
+    const __m256 a = _mm256_i32gather_ps(f, i000, 4), b = _mm256_i32gather_ps(f + 1, i000, 4);
+    const __m256 c = _mm256_i32gather_ps(f + sX, i000, 4), d = _mm256_i32gather_ps(f + sX + 1, i000, 4);
+    const __m256 e = _mm256_i32gather_ps(f + sXY, i000, 4), g = _mm256_i32gather_ps(f + sXY + 1, i000, 4);
+    const __m256 h = _mm256_i32gather_ps(f + sXY + sX, i000, 4), k = _mm256_i32gather_ps(f + sXY + sX + 1, i000, 4);
+    const __m256 lo = _mm256_min_ps(_mm256_min_ps(_mm256_min_ps(a, b), _mm256_min_ps(c, d)), _mm256_min_ps(_mm256_min_ps(e, g), _mm256_min_ps(h, k)));
+    const __m256 hi = _mm256_max_ps(_mm256_max_ps(_mm256_max_ps(a, b), _mm256_max_ps(c, d)), _mm256_max_ps(_mm256_max_ps(e, g), _mm256_max_ps(h, k)));
+    return _mm256_max_ps(lo, _mm256_min_ps(v, hi));
+}
+
+template <UpfCorrectionPass Pass, uint32_t Ch>
+UPF_TARGET_AVX2 static float correctRowAvx2(const UpfAdvectParams& p, int y, int z, int x0, int x1)
+{
+    const int sX = p.sizeX, sY = p.sizeY, sZ = p.sizeZ;
+    const int sXY = sX * sY;
+    const int row = y * sX + z * sXY;
+    const CorrectionFields f(p);
+    const float* const* src = f.src;
+    const float* const* mid = f.mid;
+    float* const* dst = f.dst;
+
+    const __m256 lane = _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f);
+    const __m256 k = _mm256_set1_ps(p.dtOverCs);
+    const __m256 lo = _mm256_set1_ps(1.5f);
+    const __m256 hiX = _mm256_set1_ps(sX - 2.5f);
+    const __m256 hiY = _mm256_set1_ps(sY - 2.5f);
+    const __m256 hiZ = _mm256_set1_ps(sZ - 2.5f);
+    const __m256i vsX = _mm256_set1_epi32(sX);
+    const __m256i vsXY = _mm256_set1_epi32(sXY);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 cy = _mm256_set1_ps((float)y);
+    const __m256 cz = _mm256_set1_ps((float)z);
+
+    __m256 activity = _mm256_setzero_ps();
+    int x = x0;
+    for (; x + 8 <= x1; x += 8) {
+        const int idx = row + x;
+        const __m256 cx = _mm256_add_ps(_mm256_set1_ps((float)x), lane);
+        const __m256 dx = _mm256_mul_ps(_mm256_loadu_ps(p.srcVx + idx), k);
+        const __m256 dy = _mm256_mul_ps(_mm256_loadu_ps(p.srcVy + idx), k);
+        const __m256 dz = _mm256_mul_ps(_mm256_loadu_ps(p.srcVz + idx), k);
+
+        const TracePointAvx2 back = traceAvx2(_mm256_sub_ps(cx, dx), _mm256_sub_ps(cy, dy), _mm256_sub_ps(cz, dz), lo, hiX, hiY, hiZ, vsX, vsXY);
+        const TracePointAvx2 ahead = traceAvx2(_mm256_add_ps(cx, dx), _mm256_add_ps(cy, dy), _mm256_add_ps(cz, dz), lo, hiX, hiY, hiZ, vsX, vsXY);
+
+        __m256 out[kCorrectFields] = {};
+        for (int c = 0; c < kCorrectFields; c++) {
+            if (!correctsField<Ch>(c)) continue;
+            __m256 v;
+            if (Pass == UpfCorrect_BfeccForward) {
+                v = trilinearAvx2(mid[c], back.i000, sX, sXY, back.fx, back.fy, back.fz);
+            } else {
+                const __m256 s = _mm256_loadu_ps(src[c] + idx);
+                const __m256 base = Pass == UpfCorrect_MacCormack ? _mm256_loadu_ps(mid[c] + idx) : s;
+                const __m256 a = trilinearAvx2(mid[c], ahead.i000, sX, sXY, ahead.fx, ahead.fy, ahead.fz);
+                v = _mm256_fmadd_ps(_mm256_sub_ps(s, a), half, base);
+            }
+            if (Pass != UpfCorrect_BfeccBackward) v = limitToCornersAvx2(src[c], back.i000, sX, sXY, v);
+            out[c] = v;
+        }
+        if (Pass == UpfCorrect_BfeccBackward) {
+            for (int c = 0; c < kCorrectFields; c++) {
+                if (correctsField<Ch>(c)) _mm256_storeu_ps(dst[c] + idx, out[c]);
+            }
+        } else {
+            __m256* ch = out + 4;
+            for (int c = 0; c < kUpfChannelCount; c++) {
+                if (advects<Ch>(c)) ch[c] = _mm256_mul_ps(ch[c], _mm256_set1_ps(p.channelDissipation[c]));
+            }
+            const __m256 damping = _mm256_set1_ps(p.velocityDamping);
+            activity = _mm256_max_ps(activity, storeFusedAvx2<Ch>(p, idx, _mm256_mul_ps(out[0], _mm256_set1_ps(p.dissipation)),
+                _mm256_mul_ps(out[1], damping), _mm256_mul_ps(out[2], damping), _mm256_mul_ps(out[3], damping), ch));
+        }
+    }
+    float rowActivity = hmaxAvx2(activity);
+    if (x < x1) rowActivity = std::max(rowActivity, correctRowScalar<Pass, Ch>(p, y, z, x, x1));
+    return rowActivity;
+}
+
+#endif // UPF_X86
+
+// Kernels of one channel set
+template <uint32_t Ch>
+struct ChannelKernels {
+    static UpfAdvectRowFn advect(UpfSimdLevel level, bool fused)
+    {
+#ifdef UPF_X86
+        if (level >= UpfSimd_AVX2) return fused ? advectRowAvx2<true, Ch> : advectRowAvx2<false, Ch>;
+        if (level >= UpfSimd_SSE41) return fused ? advectRowSse41<true, Ch> : advectRowSse41<false, Ch>;
+#endif
+        return fused ? advectRowScalar<true, Ch> : advectRowScalar<false, Ch>;
+    }
+
+    static UpfAdvectRowFn correct(UpfSimdLevel level, UpfCorrectionPass pass)
+    {
+#ifdef UPF_X86
+        if (level >= UpfSimd_AVX2) {
+            if (pass == UpfCorrect_MacCormack) return correctRowAvx2<UpfCorrect_MacCormack, Ch>;
+            if (pass == UpfCorrect_BfeccBackward) return correctRowAvx2<UpfCorrect_BfeccBackward, Ch>;
+            return correctRowAvx2<UpfCorrect_BfeccForward, Ch>;
+        }
+#endif
+        if (pass == UpfCorrect_MacCormack) return correctRowScalar<UpfCorrect_MacCormack, Ch>;
+        if (pass == UpfCorrect_BfeccBackward) return correctRowScalar<UpfCorrect_BfeccBackward, Ch>;
+        return correctRowScalar<UpfCorrect_BfeccForward, Ch>;
+    }
+
+    static float passThrough(const UpfAdvectParams& p, int y, int z, int x0, int x1)
+    {
+        return passThroughRow<Ch>(p, y, z, x0, x1);
+    }
+};
+
+// Call Get on the ChannelKernels instantiation for a grid's channels
+template <typename R, typename Get>
+static R withChannelKernels(uint32_t channels, Get get)
+{
+    constexpr uint32_t T = UpfChannel_Temperature, F = UpfChannel_Fuel, B = UpfChannel_Burn, S = UpfChannel_Smoke;
+    switch (kernelChannels(channels)) {
+    case T: return get(ChannelKernels<T>());
+    case F: return get(ChannelKernels<F>());
+    case S: return get(ChannelKernels<S>());
+    case T | F: return get(ChannelKernels<T | F>());
+    case T | S: return get(ChannelKernels<T | S>());
+    case F | S: return get(ChannelKernels<F | S>());
+    case T | F | S: return get(ChannelKernels<T | F | S>());
+    case T | F | B: return get(ChannelKernels<T | F | B>());
+    case T | F | B | S: return get(ChannelKernels<T | F | B | S>());
+    default: return get(ChannelKernels<0>());
+    }
+}
+
+UpfAdvectRowFn upfSelectAdvectRow(UpfSimdLevel level, bool fused, uint32_t channels)
+{
+    level = std::min(level, upfDetectSimdLevel());
+    return withChannelKernels<UpfAdvectRowFn>(channels, [&](auto k) { return k.advect(level, fused); });
+}
+
+UpfAdvectRowFn upfSelectCorrectionRow(UpfSimdLevel level, UpfCorrectionPass pass, uint32_t channels)
+{
+    level = std::min(level, upfDetectSimdLevel());
+    return withChannelKernels<UpfAdvectRowFn>(channels, [&](auto k) { return k.correct(level, pass); });
+}
+
+float upfPassThroughRow(const UpfAdvectParams& p, int y, int z, int x0, int x1)
+{
+    return withChannelKernels<float>(p.channels, [&](auto k) { return k.passThrough(p, y, z, x0, x1); });
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+// Semi-Lagrangian advection kernels for the bridge's CPU solver.
+// Velocity is stored structure-of-arrays (one plane per component) so rows
+// along X can be processed 8 cells at a time with AVX2 gathers.
+//
+// Higher-order modes run extra sweeps around a plain forward estimate:
+//   MacCormack: mid = A(src); dst = mid + (src - A'(mid)) / 2
+//   BFECC:      mid = A(src); bar = src + (src - A'(mid)) / 2; dst = A(bar)
+// where A traces back along -v*dt and A' forward along +v*dt with the source
+// velocity. Corrected values are limited to the min/max of the source cells
+// around the backtrace, so no new extrema appear.
+//
+// Optional channels (temperature, fuel, smoke) are advected with the same
+// backtrace. Kernels are instantiated per channel set, so grids without
+// channels run exactly the density and velocity code.
+
+#include "UpfSimd.h"
+#include "../include/UnityPhysXFlow.h"
+
+#include <algorithm>
+#include <stdint.h>
+
+// Optional channel planes, indexed by the bit position of their UpfGridChannel.
+static constexpr int kUpfChannelCount = 4;
+enum UpfChannelSlot {
+    UpfSlot_Temperature = 0,
+    UpfSlot_Fuel = 1,
+    UpfSlot_Burn = 2,
+    UpfSlot_Smoke = 3,
+};
+
+struct UpfAdvectParams {
+    int sizeX, sizeY, sizeZ;
+    float dtOverCs;         // dt / cellSize, backtrace distance per unit velocity
+    float dissipation;      // density multiplier per step
+    float velocityDamping;  // velocity multiplier per step
+
+    // Forces and limits applied in the same sweep by the fused kernels
+    float buoyancyDt;         // buoyancy * dt, added to vy where density > buoyancyThreshold
+    float buoyancyThreshold;
+    float densityThreshold;   // density below this is cleared
+    float maxDensity;
+    float maxVelocity;        // velocity components are clamped to +-maxVelocity
+    float densityActivity;    // activity reported for cells that still hold density
+
+    // Optional channels (UpfGridChannel bits) and combustion. Channel planes
+    // below are indexed by UpfChannelSlot and null for absent channels. Burn
+    // is not advected: the fused kernels write the fuel burned in the step.
+    uint32_t channels;
+    float channelDissipation[kUpfChannelCount];  // multiplier per step
+    float temperatureBuoyancyDt;  // buoyancyPerTemp * dt, added to vy per unit temperature
+    float ignitionTemp;
+    float burnPerTempDt;          // burnPerTemp * dt
+    float burnPerFuel;            // 1 / fuelPerBurn, caps the burn at the fuel left
+    float fuelPerBurn;
+    float tempPerBurn;
+    float smokePerBurn;
+
+    // Intermediate fields read by the correction passes (mid or bar above)
+    const float* midDensity;
+    const float* midVx;
+    const float* midVy;
+    const float* midVz;
+    const float* midChannel[kUpfChannelCount];
+
+    // Source fields (previous state), read only
+    const float* srcDensity;
+    const float* srcVx;
+    const float* srcVy;
+    const float* srcVz;
+    const float* srcChannel[kUpfChannelCount];
+
+    // Destination fields
+    float* dstDensity;
+    float* dstVx;
+    float* dstVy;
+    float* dstVz;
+    float* dstChannel[kUpfChannelCount];
+};
+
+// Combustion of one cell: where temperature reaches ignitionTemp, fuel burns
+// into heat and smoke. Returns the fuel burned (the burn channel).
+inline float upfCombustCell(const UpfAdvectParams& p, float& temperature, float& fuel, float& smoke)
+{
+    if (temperature < p.ignitionTemp || fuel <= 0.0f) return 0.0f;
+    float burn = p.burnPerTempDt * (std::min(temperature, 1.0f) - p.ignitionTemp);
+    burn = std::max(0.0f, std::min(burn, fuel * p.burnPerFuel));
+    fuel -= burn * p.fuelPerBurn;
+    temperature += burn * p.tempPerBurn;
+    smoke += burn * p.smokePerBurn;
+    return burn;
+}
+
+// Advect cells [x0, x1) of row (y, z). Sample positions are clamped to the
+// interior, so rows must lie at least 2 cells inside the grid.
+// Fused kernels return the row's activity: the largest velocity component
+// magnitude written, and at least densityActivity where density or a channel
+// remains.
+// Plain kernels return 0.
+typedef float (*UpfAdvectRowFn)(const UpfAdvectParams& p, int y, int z, int x0, int x1);
+
+// Row kernel for a SIMD level; levels above what the CPU supports fall back.
+// Fused kernels also apply buoyancy, combustion, clamping and the low-density
+// clear, so a step needs no further passes over the grid. channels is the
+// grid's UpfGridChannel mask.
+UpfAdvectRowFn upfSelectAdvectRow(UpfSimdLevel level, bool fused, uint32_t channels);
+
+enum UpfCorrectionPass {
+    UpfCorrect_MacCormack = 0,      // fused: mid + (src - A'(mid)) / 2, limited
+    UpfCorrect_BfeccBackward = 1,   // plain: src + (src - A'(mid)) / 2, into dst
+    UpfCorrect_BfeccForward = 2,    // fused: A(mid), limited
+};
+
+// Row kernel for a correction pass. Only scalar and AVX2 versions exist;
+// the SSE4.1 level uses the scalar one.
+UpfAdvectRowFn upfSelectCorrectionRow(UpfSimdLevel level, UpfCorrectionPass pass, uint32_t channels);
+
+// Plain counterpart of upfPassThroughRow: copy source to destination.
+void upfCopyRow(const UpfAdvectParams& p, int y, int z, int x0, int x1);
+
+// Fused counterpart for cells that are not advected (the 2-cell border):
+// copy source to destination and apply buoyancy, combustion and limits.
+// Returns activity.
+float upfPassThroughRow(const UpfAdvectParams& p, int y, int z, int x0, int x1);
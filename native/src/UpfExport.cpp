@@ -0,0 +1,252 @@
+#include "UpfExport.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+static inline uint16_t floatToHalf(float value)
+{
+    const uint32_t f32Infinity = 255u << 23;
+    const uint32_t f16Max = (127u + 16u) << 23;
+    const uint32_t denormMagicBits = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+
+    uint32_t u;
+    std::memcpy(&u, &value, sizeof(u));
+    const uint32_t sign = u & 0x80000000u;
+    u ^= sign;
+
+    uint16_t h;
+    if (u >= f16Max) {
+        h = u > f32Infinity ? 0x7e00 : 0x7c00; // NaN stays NaN, overflow goes to infinity
+    } else if (u < (113u << 23)) {
+        // Result is subnormal or zero: let float addition do the rounding
+        float f, magic;
+        std::memcpy(&f, &u, sizeof(f));
+        std::memcpy(&magic, &denormMagicBits, sizeof(magic));
+        f += magic;
+        std::memcpy(&u, &f, sizeof(u));
+        h = (uint16_t)(u - denormMagicBits);
+    } else {
+        const uint32_t mantissaOdd = (u >> 13) & 1;
+        u += ((uint32_t)(15 - 127) << 23) + 0xfff + mantissaOdd;
+        h = (uint16_t)(u >> 13);
+    }
+    return (uint16_t)(h | (sign >> 16));
+}
+
+static inline uint8_t quantizeUnorm8(float v, float minValue, float scale)
+{
+    const float q = std::min(std::max((v - minValue) * scale, 0.0f), 255.0f);
+    return (uint8_t)std::nearbyint(q);
+}
+
+static inline float unorm8Scale(float minValue, float maxValue)
+{
+    return maxValue > minValue ? 255.0f / (maxValue - minValue) : 0.0f;
+}
+
+#ifdef UPF_X86
+
+UPF_TARGET_AVX2 static void floatToHalfAvx2(const float* src, uint16_t* dst, size_t count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), h);
+    }
+    for (; i < count; i++) dst[i] = floatToHalf(src[i]);
+}
+
+UPF_TARGET_AVX2 static void vec3ToHalf4Avx2(const float* src, uint16_t* dst, size_t numCells)
+{
+    // Two cells per iteration: (x0 y0 z0 0 | x1 y1 z1 0) -> 8 halves
+    size_t i = 0;
+    for (; i + 2 <= numCells; i += 2) {
+        const __m128 c0 = _mm_setr_ps(src[i * 3 + 0], src[i * 3 + 1], src[i * 3 + 2], 0.0f);
+        const __m128 c1 = _mm_setr_ps(src[i * 3 + 3], src[i * 3 + 4], src[i * 3 + 5], 0.0f);
+        const __m128i h = _mm256_cvtps_ph(_mm256_set_m128(c1, c0), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), h);
+    }
+    for (; i < numCells; i++) {
+        dst[i * 4 + 0] = floatToHalf(src[i * 3 + 0]);
+        dst[i * 4 + 1] = floatToHalf(src[i * 3 + 1]);
+        dst[i * 4 + 2] = floatToHalf(src[i * 3 + 2]);
+        dst[i * 4 + 3] = 0;
+    }
+}
+
+UPF_TARGET_AVX2 static void minMaxAvx2(const float* src, size_t count, float& outMin, float& outMax)
+{
+    __m256 vmin = _mm256_set1_ps(src[0]), vmax = vmin;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256 v = _mm256_loadu_ps(src + i);
+        vmin = _mm256_min_ps(vmin, v);
+        vmax = _mm256_max_ps(vmax, v);
+    }
+    alignas(32) float lo[8], hi[8];
+    _mm256_store_ps(lo, vmin);
+    _mm256_store_ps(hi, vmax);
+    float mn = lo[0], mx = hi[0];
+    for (int k = 1; k < 8; k++) { mn = std::min(mn, lo[k]); mx = std::max(mx, hi[k]); }
+    for (; i < count; i++) { mn = std::min(mn, src[i]); mx = std::max(mx, src[i]); }
+    outMin = mn;
+    outMax = mx;
+}
+
+UPF_TARGET_AVX2 static inline __m256i quantizeAvx2(const float* src, __m256 vmin, __m256 vscale)
+{
+    const __m256 q = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(src), vmin), vscale);
+    const __m256 c = _mm256_min_ps(_mm256_max_ps(q, _mm256_setzero_ps()), _mm256_set1_ps(255.0f));
+    return _mm256_cvtps_epi32(c); // round to nearest even
+}
+
+UPF_TARGET_AVX2 static void quantizeUnorm8Avx2(const float* src, uint8_t* dst, size_t count, float minValue, float scale)
+{
+    const __m256 vmin = _mm256_set1_ps(minValue), vscale = _mm256_set1_ps(scale);
+    // Packs work per 128-bit lane; the final permute restores cell order
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        const __m256i a = quantizeAvx2(src + i, vmin, vscale);
+        const __m256i b = quantizeAvx2(src + i + 8, vmin, vscale);
+        const __m256i c = quantizeAvx2(src + i + 16, vmin, vscale);
+        const __m256i d = quantizeAvx2(src + i + 24, vmin, vscale);
+        const __m256i bytes = _mm256_packus_epi16(_mm256_packus_epi32(a, b), _mm256_packus_epi32(c, d));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_permutevar8x32_epi32(bytes, order));
+    }
+    for (; i < count; i++) dst[i] = quantizeUnorm8(src[i], minValue, scale);
+}
+
+UPF_TARGET_SSE41 static void minMaxSse41(const float* src, size_t count, float& outMin, float& outMax)
+{
+    __m128 vmin = _mm_set1_ps(src[0]), vmax = vmin;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128 v = _mm_loadu_ps(src + i);
+        vmin = _mm_min_ps(vmin, v);
+        vmax = _mm_max_ps(vmax, v);
+    }
+    alignas(16) float lo[4], hi[4];
+    _mm_store_ps(lo, vmin);
+    _mm_store_ps(hi, vmax);
+    float mn = std::min(std::min(lo[0], lo[1]), std::min(lo[2], lo[3]));
+    float mx = std::max(std::max(hi[0], hi[1]), std::max(hi[2], hi[3]));
+    for (; i < count; i++) { mn = std::min(mn, src[i]); mx = std::max(mx, src[i]); }
+    outMin = mn;
+    outMax = mx;
+}
+
+UPF_TARGET_SSE41 static inline __m128i quantizeSse(const float* src, __m128 vmin, __m128 vscale)
+{
+    const __m128 q = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(src), vmin), vscale);
+    return _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(q, _mm_setzero_ps()), _mm_set1_ps(255.0f)));
+}
+
+UPF_TARGET_SSE41 static void quantizeUnorm8Sse41(const float* src, uint8_t* dst, size_t count, float minValue, float scale)
+{
+    const __m128 vmin = _mm_set1_ps(minValue), vscale = _mm_set1_ps(scale);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m128i ab = _mm_packus_epi32(quantizeSse(src + i, vmin, vscale), quantizeSse(src + i + 4, vmin, vscale));
+        const __m128i cd = _mm_packus_epi32(quantizeSse(src + i + 8, vmin, vscale), quantizeSse(src + i + 12, vmin, vscale));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(ab, cd));
+    }
+    for (; i < count; i++) dst[i] = quantizeUnorm8(src[i], minValue, scale);
+}
+
+#endif // UPF_X86
+
+void upfFloatToHalf(const float* src, uint16_t* dst, size_t count, UpfSimdLevel level)
+{
+    level = std::min(level, upfDetectSimdLevel());
+#ifdef UPF_X86
+    if (level >= UpfSimd_AVX2) { floatToHalfAvx2(src, dst, count); return; }
+#endif
+    for (size_t i = 0; i < count; i++) dst[i] = floatToHalf(src[i]);
+}
+
+void upfVec3ToHalf4(const float* src, uint16_t* dst, size_t numCells, UpfSimdLevel level)
+{
+    level = std::min(level, upfDetectSimdLevel());
+#ifdef UPF_X86
+    if (level >= UpfSimd_AVX2) { vec3ToHalf4Avx2(src, dst, numCells); return; }
+#endif
+    for (size_t i = 0; i < numCells; i++) {
+        dst[i * 4 + 0] = floatToHalf(src[i * 3 + 0]);
+        dst[i * 4 + 1] = floatToHalf(src[i * 3 + 1]);
+        dst[i * 4 + 2] = floatToHalf(src[i * 3 + 2]);
+        dst[i * 4 + 3] = 0;
+    }
+}
+
+void upfMinMax(const float* src, size_t count, float& outMin, float& outMax, UpfSimdLevel level)
+{
+    level = std::min(level, upfDetectSimdLevel());
+#ifdef UPF_X86
+    if (level >= UpfSimd_AVX2) { minMaxAvx2(src, count, outMin, outMax); return; }
+    if (level >= UpfSimd_SSE41) { minMaxSse41(src, count, outMin, outMax); return; }
+#endif
+    float mn = src[0], mx = src[0];
+    for (size_t i = 1; i < count; i++) { mn = std::min(mn, src[i]); mx = std::max(mx, src[i]); }
+    outMin = mn;
+    outMax = mx;
+}
+
+void upfQuantizeUnorm8(const float* src, uint8_t* dst, size_t count, float minValue, float maxValue, UpfSimdLevel level)
+{
+    const float scale = unorm8Scale(minValue, maxValue);
+    level = std::min(level, upfDetectSimdLevel());
+#ifdef UPF_X86
+    if (level >= UpfSimd_AVX2) { quantizeUnorm8Avx2(src, dst, count, minValue, scale); return; }
+    if (level >= UpfSimd_SSE41) { quantizeUnorm8Sse41(src, dst, count, minValue, scale); return; }
+#endif
+    for (size_t i = 0; i < count; i++) dst[i] = quantizeUnorm8(src[i], minValue, scale);
+}
+
+size_t upfBC4Bytes(int sizeX, int sizeY, int sizeZ)
+{
+    return (size_t)((sizeX + 3) / 4) * (size_t)((sizeY + 3) / 4) * (size_t)sizeZ * 8;
+}
+
+void upfEncodeBC4Slice(const float* slice, int sizeX, int sizeY, float minValue, float maxValue, uint8_t* dst)
+{
+    const float scale = unorm8Scale(minValue, maxValue);
+    const int blocksX = (sizeX + 3) / 4, blocksY = (sizeY + 3) / 4;
+
+    for (int by = 0; by < blocksY; by++) {
+        for (int bx = 0; bx < blocksX; bx++) {
+            // Texels in [0, 255], row-major within the block
+            float t[16];
+            float lo = 255.0f, hi = 0.0f;
+            for (int j = 0; j < 4; j++) {
+                const int y = std::min(by * 4 + j, sizeY - 1);
+                for (int i = 0; i < 4; i++) {
+                    const int x = std::min(bx * 4 + i, sizeX - 1);
+                    const float v = std::min(std::max((slice[x + (size_t)y * sizeX] - minValue) * scale, 0.0f), 255.0f);
+                    t[j * 4 + i] = v;
+                    lo = std::min(lo, v);
+                    hi = std::max(hi, v);
+                }
+            }
+
+            // red0 > red1 selects the 8-value mode: index 0 = red0, 1 = red1,
+            // 2..7 step from red0 towards red1 in sevenths
+            const int red0 = (int)std::nearbyint(hi), red1 = (int)std::nearbyint(lo);
+            uint64_t bits = 0;
+            if (red0 > red1) {
+                const float toStep = 7.0f / (float)(red0 - red1);
+                for (int k = 0; k < 16; k++) {
+                    const int s = std::min(std::max((int)std::nearbyint(((float)red0 - t[k]) * toStep), 0), 7);
+                    const uint64_t index = s == 0 ? 0 : (s == 7 ? 1 : (uint64_t)(s + 1));
+                    bits |= index << (3 * k);
+                }
+            }
+
+            uint8_t* block = dst + ((size_t)by * blocksX + bx) * 8;
+            block[0] = (uint8_t)red0;
+            block[1] = (uint8_t)red1;
+            for (int b = 0; b < 6; b++) block[2 + b] = (uint8_t)(bits >> (8 * b));
+        }
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+// Conversions for reduced-precision grid exports: FP16, UNORM8 over a value
+// range, and BC4 blocks. Each works on a span of cells so callers can split
+// an export across threads.
+
+#include "UpfSimd.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// float -> IEEE half, round to nearest even.
+void upfFloatToHalf(const float* src, uint16_t* dst, size_t count, UpfSimdLevel level);
+
+// (x, y, z) float triples -> (x, y, z, 0) halves, 8 bytes per cell.
+void upfVec3ToHalf4(const float* src, uint16_t* dst, size_t numCells, UpfSimdLevel level);
+
+// Smallest and largest of count > 0 floats.
+void upfMinMax(const float* src, size_t count, float& outMin, float& outMax, UpfSimdLevel level);
+
+// round((v - minValue) / (maxValue - minValue) * 255), clamped to [0, 255].
+// An empty range (maxValue <= minValue) writes zeros.
+void upfQuantizeUnorm8(const float* src, uint8_t* dst, size_t count, float minValue, float maxValue, UpfSimdLevel level);
+
+// Size of a BC4 volume: 4x4 blocks per z-slice, 8 bytes per block, slices in order.
+size_t upfBC4Bytes(int sizeX, int sizeY, int sizeZ);
+
+// Encode one z-slice of sizeX*sizeY floats as BC4 UNORM blocks over
+// [minValue, maxValue]. Blocks past the slice edge repeat the edge cells.
+void upfEncodeBC4Slice(const float* slice, int sizeX, int sizeY, float minValue, float maxValue, uint8_t* dst);
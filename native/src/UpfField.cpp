@@ -0,0 +1,191 @@
+#ifdef _WIN32
+#define NOMINMAX  // Prevent Windows min/max macros
+#endif
+
+#include "UpfField.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <new>
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// Both mappings of a ring must start on this boundary
+static size_t mappingGranularity()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (size_t)info.dwAllocationGranularity;
+#else
+    return (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+// Map the same bytes twice back to back; null on failure
+static void* mapMirrored(size_t bytes)
+{
+#ifdef _WIN32
+    HANDLE section = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                        (DWORD)((unsigned long long)bytes >> 32), (DWORD)bytes, nullptr);
+    if (!section) return nullptr;
+    // Another thread can take the address range between the probe and the
+    // mappings, so try a few times
+    for (int attempt = 0; attempt < 8; attempt++) {
+        char* base = (char*)VirtualAlloc(nullptr, 2 * bytes, MEM_RESERVE, PAGE_NOACCESS);
+        if (!base) break;
+        VirtualFree(base, 0, MEM_RELEASE);
+        void* lo = MapViewOfFileEx(section, FILE_MAP_ALL_ACCESS, 0, 0, bytes, base);
+        void* hi = lo ? MapViewOfFileEx(section, FILE_MAP_ALL_ACCESS, 0, 0, bytes, base + bytes) : nullptr;
+        if (lo && hi) {
+            CloseHandle(section);  // the views keep the section alive
+            return base;
+        }
+        if (lo) UnmapViewOfFile(lo);
+    }
+    CloseHandle(section);
+    return nullptr;
+#else
+#ifdef __linux__
+    const int fd = memfd_create("upf_field", MFD_CLOEXEC);
+#else
+    char name[64];
+    std::snprintf(name, sizeof(name), "/upf_field_%ld_%p", (long)getpid(), (void*)&name);
+    const int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd >= 0) shm_unlink(name);
+#endif
+    if (fd < 0) return nullptr;
+    if (ftruncate(fd, (off_t)bytes) != 0) {
+        close(fd);
+        return nullptr;
+    }
+    char* base = (char*)mmap(nullptr, 2 * bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        return nullptr;
+    }
+    const bool ok = mmap(base, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED &&
+                    mmap(base + bytes, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED;
+    close(fd);  // the mappings keep the memory alive
+    if (!ok) {
+        munmap(base, 2 * bytes);
+        return nullptr;
+    }
+    return base;
+#endif
+}
+
+static void unmapMirrored(void* base, size_t bytes)
+{
+#ifdef _WIN32
+    UnmapViewOfFile(base);
+    UnmapViewOfFile((char*)base + bytes);
+#else
+    munmap(base, 2 * bytes);
+#endif
+}
+
+UpfField::~UpfField()
+{
+    unmapRing();
+}
+
+void UpfField::swap(UpfField& other) noexcept
+{
+    heap_.swap(other.heap_);
+    std::swap(ring_, other.ring_);
+    std::swap(ringFloats_, other.ringFloats_);
+    std::swap(offset_, other.offset_);
+    std::swap(size_, other.size_);
+    std::swap(ringMode_, other.ringMode_);
+}
+
+bool UpfField::mapRing(size_t count)
+{
+    const size_t granularity = mappingGranularity();
+    const size_t bytes = std::max<size_t>(1, (count * sizeof(float) + granularity - 1) / granularity) * granularity;
+    void* base = mapMirrored(bytes);
+    if (!base) return false;
+    ring_ = (float*)base;
+    ringFloats_ = bytes / sizeof(float);
+    offset_ = 0;
+    return true;
+}
+
+void UpfField::unmapRing()
+{
+    if (ring_) unmapMirrored(ring_, ringFloats_ * sizeof(float));
+    ring_ = nullptr;
+    ringFloats_ = 0;
+    offset_ = 0;
+}
+
+void UpfField::resize(size_t count, float value)
+{
+    if (!ringMode_) {
+        heap_.resize(count, value);
+        size_ = count;
+        return;
+    }
+    if (count == size_) return;
+    UpfField next;
+    next.ringMode_ = true;
+    if (count > 0 && !next.mapRing(count)) throw std::bad_alloc();
+    next.size_ = count;
+    const size_t kept = std::min(count, size_);
+    std::copy(begin(), begin() + kept, next.begin());
+    std::fill(next.begin() + kept, next.end(), value);
+    swap(next);
+}
+
+void UpfField::assign(size_t count, float value)
+{
+    if (ringMode_ && count != size_) {
+        clear();
+        resize(count, value);
+        return;
+    }
+    if (!ringMode_) heap_.assign(count, value);
+    size_ = count;
+    std::fill(begin(), end(), value);
+}
+
+void UpfField::clear()
+{
+    std::vector<float>().swap(heap_);
+    unmapRing();
+    size_ = 0;
+}
+
+bool UpfField::setRing(bool ring)
+{
+    if (ring == ringMode_) return true;
+    UpfField next;
+    next.ringMode_ = ring;
+    if (ring) {
+        if (size_ > 0 && !next.mapRing(size_)) return false;
+        next.size_ = size_;
+    } else {
+        next.heap_.resize(size_);
+        next.size_ = size_;
+    }
+    std::copy(begin(), end(), next.begin());
+    swap(next);
+    return true;
+}
+
+void UpfField::scroll(ptrdiff_t delta)
+{
+    if (!ring_) return;
+    const ptrdiff_t n = (ptrdiff_t)ringFloats_;
+    ptrdiff_t offset = ((ptrdiff_t)offset_ + delta) % n;
+    if (offset < 0) offset += n;
+    offset_ = (size_t)offset;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+// Storage for one float plane of a grid (x fastest, then y, then z). Planes
+// of static grids live on the heap. Planes of scrolling grids live in a ring
+// that is mapped twice back to back, so the size() floats starting anywhere
+// in the ring are contiguous: scrolling moves where the plane starts instead
+// of moving its cells, and the solver indexes the plane like any other.
+
+#include <stddef.h>
+#include <vector>
+
+class UpfField {
+public:
+    UpfField() = default;
+    UpfField(const UpfField&) = delete;
+    UpfField& operator=(const UpfField&) = delete;
+    ~UpfField();
+
+    void swap(UpfField& other) noexcept;
+
+    float* data() { return ring_ ? ring_ + offset_ : heap_.data(); }
+    const float* data() const { return ring_ ? ring_ + offset_ : heap_.data(); }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    float* begin() { return data(); }
+    float* end() { return data() + size_; }
+    const float* begin() const { return data(); }
+    const float* end() const { return data() + size_; }
+    float& operator[](size_t i) { return data()[i]; }
+    const float& operator[](size_t i) const { return data()[i]; }
+
+    // As for std::vector. A ring plane is reallocated when its size changes.
+    void resize(size_t count, float value);
+    void assign(size_t count, float value);
+    // Free the storage; the plane stays in ring or heap mode
+    void clear();
+
+    // Move the plane into a ring (true) or back onto the heap, keeping its
+    // values; empty planes only remember the choice. Returns false if the
+    // ring could not be mapped.
+    bool setRing(bool ring);
+    bool isRing() const { return ringMode_; }
+
+    // Ring planes: start the plane delta floats further on (or back), so
+    // cell i now reads what was cell i + delta. Cells whose old index falls
+    // outside [0, size()) hold stale values until the caller overwrites them.
+    void scroll(ptrdiff_t delta);
+
+private:
+    bool mapRing(size_t count);
+    void unmapRing();
+
+    std::vector<float> heap_;
+    float* ring_ = nullptr;     // first of the two mappings, null on the heap
+    size_t ringFloats_ = 0;     // floats per mapping, a multiple of the mapping granularity
+    size_t offset_ = 0;         // start of the plane in the ring, < ringFloats_
+    size_t size_ = 0;
+    bool ringMode_ = false;
+};
@@ -0,0 +1,209 @@
+#include "UpfFlowGrid.h"
+
+#define PNANOVDB_C
+#define PNANOVDB_BUF_BOUNDS_CHECK
+#include "nanovdb/PNanoVDB.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Flow's defaults are tuned for 0.5-unit cells and Z up; the bridge is Y up.
+static constexpr float kFlowDefaultCellSize = 0.5f;
+static constexpr float kFlowDefaultGravity = -100.0f;
+// Flow allocates 32x16x16-cell blocks; leave room for blocks straddling the grid.
+static constexpr int kBlockX = 32, kBlockY = 16, kBlockZ = 16;
+
+struct UpfFlowGrid {
+    NvFlowGrid* grid = nullptr;
+    int sizeX = 0, sizeY = 0, sizeZ = 0;
+    float cellSize = 1.0f;
+    double simTime = 0.0;
+    NvFlowUint64 version = 0;
+
+    NvFlowGridSimulateLayerParams layer;
+    std::vector<NvFlowEmitterSphereParams> spheres;
+    std::vector<NvFlowUint8*> sphereDatas;
+
+    // Copy of the last step's NanoVDB readback, resampled without Flow's lock
+    std::vector<NvFlowUint8> smokeReadback;
+    std::vector<NvFlowUint8> velocityReadback;
+};
+
+UpfFlowGrid* upfFlowGridCreate(const UpfFlowDevice& device, int sizeX, int sizeY, int sizeZ, float cellSize)
+{
+    if (!device.gridInterface || !device.gridInterface->createGrid || !device.context) return nullptr;
+
+    NvFlowGridDesc desc = NvFlowGridDesc_default;
+    const NvFlowUint blocks = (NvFlowUint)(((sizeX + kBlockX - 1) / kBlockX + 1) *
+                                           ((sizeY + kBlockY - 1) / kBlockY + 1) *
+                                           ((sizeZ + kBlockZ - 1) / kBlockZ + 1));
+    desc.maxLocations = std::max(desc.maxLocations, blocks);
+
+    NvFlowGrid* flowGrid = device.gridInterface->createGrid(device.contextInterface, device.context,
+                                                            device.opList, device.extOpList, &desc);
+    if (!flowGrid) return nullptr;
+
+    UpfFlowGrid* grid = new UpfFlowGrid();
+    grid->grid = flowGrid;
+    grid->sizeX = sizeX; grid->sizeY = sizeY; grid->sizeZ = sizeZ;
+    grid->cellSize = cellSize;
+
+    NvFlowGridSimulateLayerParams& layer = grid->layer;
+    layer = NvFlowGridSimulateLayerParams_default;
+    layer.luid = 1u;
+    layer.densityCellSize = cellSize;
+    // One Flow step per bridge step, of the bridge's dt
+    layer.enableVariableTimeStep = NV_FLOW_TRUE;
+    layer.maxStepsPerSimulate = 1u;
+    layer.advection.gravity.x = 0.0f;
+    layer.advection.gravity.y = kFlowDefaultGravity * cellSize / kFlowDefaultCellSize;
+    layer.advection.gravity.z = 0.0f;
+    layer.nanoVdbExport.enabled = NV_FLOW_TRUE;
+    layer.nanoVdbExport.readbackEnabled = NV_FLOW_TRUE;
+    layer.nanoVdbExport.statisticsEnabled = NV_FLOW_FALSE;
+    layer.nanoVdbExport.smokeEnabled = NV_FLOW_TRUE;
+    layer.nanoVdbExport.velocityEnabled = NV_FLOW_TRUE;
+    return grid;
+}
+
+void upfFlowGridDestroy(const UpfFlowDevice& device, UpfFlowGrid* grid)
+{
+    if (!grid) return;
+    if (grid->grid && device.gridInterface && device.context) {
+        device.gridInterface->destroyGrid(device.context, grid->grid);
+    }
+    delete grid;
+}
+
+// Sample a NanoVDB float or vec3 grid at every cell center of a dense grid
+// centered on the origin. Cells the readback doesn't cover read the background.
+static void resampleNanoVdb(const std::vector<NvFlowUint8>& data, const UpfFlowGrid& fg,
+                            float* scalar, float* vx, float* vy, float* vz)
+{
+    if (data.size() < PNANOVDB_GRID_SIZE) return;
+
+    pnanovdb_buf_t buf = pnanovdb_make_buf((pnanovdb_uint32_t*)data.data(), data.size() / 4u);
+    pnanovdb_grid_handle_t grid = { pnanovdb_address_null() };
+    if (pnanovdb_grid_get_magic(buf, grid) != PNANOVDB_MAGIC_NUMBER) return;
+
+    const pnanovdb_grid_type_t gridType = pnanovdb_grid_get_grid_type(buf, grid);
+    const bool isScalar = gridType == PNANOVDB_GRID_TYPE_FLOAT;
+    const bool isVec3 = gridType == PNANOVDB_GRID_TYPE_VEC3F;
+    if ((scalar && !isScalar) || (vx && !isVec3)) return;
+
+    pnanovdb_tree_handle_t tree = pnanovdb_grid_get_tree(buf, grid);
+    pnanovdb_root_handle_t root = pnanovdb_tree_get_root(buf, tree);
+
+    const int sX = fg.sizeX, sY = fg.sizeY, sZ = fg.sizeZ;
+    const size_t sXY = (size_t)sX * sY;
+    const float cs = fg.cellSize;
+    const float halfX = sX * cs * 0.5f, halfY = sY * cs * 0.5f, halfZ = sZ * cs * 0.5f;
+
+    #pragma omp parallel for if(sZ > 8)
+    for (int z = 0; z < sZ; z++) {
+        pnanovdb_readaccessor_t acc;
+        pnanovdb_readaccessor_init(&acc, root);
+        for (int y = 0; y < sY; y++) {
+            const size_t row = (size_t)z * sXY + (size_t)y * sX;
+            for (int x = 0; x < sX; x++) {
+                pnanovdb_vec3_t world = { (x + 0.5f) * cs - halfX, (y + 0.5f) * cs - halfY, (z + 0.5f) * cs - halfZ };
+                pnanovdb_vec3_t index = pnanovdb_grid_world_to_indexf(buf, grid, &world);
+                pnanovdb_coord_t ijk = { (pnanovdb_int32_t)std::floor(index.x),
+                                         (pnanovdb_int32_t)std::floor(index.y),
+                                         (pnanovdb_int32_t)std::floor(index.z) };
+                pnanovdb_address_t address = pnanovdb_readaccessor_get_value_address(gridType, buf, &acc, &ijk);
+                const size_t i = row + x;
+                if (isScalar) {
+                    scalar[i] = pnanovdb_read_float(buf, address);
+                } else {
+                    pnanovdb_vec3_t v = pnanovdb_read_vec3(buf, address);
+                    vx[i] = v.x; vy[i] = v.y; vz[i] = v.z;
+                }
+            }
+        }
+    }
+}
+
+static void copyReadback(const NvFlowUint8* data, NvFlowUint64 sizeInBytes, std::vector<NvFlowUint8>& dst)
+{
+    if (data) dst.assign(data, data + sizeInBytes);
+    else dst.clear();
+}
+
+bool upfFlowGridSimulate(const UpfFlowDevice& device, UpfFlowGrid* grid, float dt,
+                         const UpfEmitterDesc* emitters, int count)
+{
+    if (!grid || !grid->grid || !device.context) return false;
+    if (count < 0 || !emitters) count = 0;
+
+    // Bridge emitters only carry density: emit it as smoke, plus matching
+    // temperature so it rises the way the CPU solver's buoyancy does.
+    grid->spheres.resize(count);
+    grid->sphereDatas.resize(count);
+    for (int i = 0; i < count; i++) {
+        const UpfEmitterDesc& e = emitters[i];
+        NvFlowEmitterSphereParams& p = grid->spheres[i];
+        p = NvFlowEmitterSphereParams_default;
+        p.luid = (NvFlowUint64)(uint32_t)e.handle;
+        p.position.x = e.x; p.position.y = e.y; p.position.z = e.z;
+        p.radius = e.radius;
+        p.velocity.x = 0.0f; p.velocity.y = 0.0f; p.velocity.z = 0.0f;
+        p.coupleRateVelocity = 0.0f;
+        p.smoke = e.density;
+        p.coupleRateSmoke = 2.0f;
+        p.temperature = e.density;
+        p.fuel = 0.0f;
+        p.coupleRateFuel = 0.0f;
+        grid->sphereDatas[i] = (NvFlowUint8*)&p;
+    }
+
+    grid->version++;
+    grid->simTime += dt;
+    NvFlowUint8* layerData = (NvFlowUint8*)&grid->layer;
+    NvFlowDatabaseTypeSnapshot typeSnapshots[2] = {
+        { grid->version, &NvFlowGridSimulateLayerParams_NvFlowReflectDataType, &layerData, 1u },
+        { grid->version, &NvFlowGridEmitterSphereParams_NvFlowReflectDataType, grid->sphereDatas.data(), (NvFlowUint64)count },
+    };
+    NvFlowGridParamsDescSnapshot snapshot = {};
+    snapshot.snapshot.version = grid->version;
+    snapshot.snapshot.typeSnapshots = typeSnapshots;
+    snapshot.snapshot.typeSnapshotCount = 2u;
+    snapshot.absoluteSimTime = grid->simTime;
+    snapshot.deltaTime = dt;
+    NvFlowGridParamsDesc params = { &snapshot, 1u };
+
+    device.gridInterface->simulate(device.context, grid->grid, &params, NV_FLOW_FALSE);
+    NvFlowGridRenderData renderData = {};
+    device.gridInterface->getRenderData(device.context, grid->grid, &renderData);
+
+    NvFlowUint64 flushedFrame = 0;
+    device.deviceInterface->flush(device.queue, &flushedFrame, nullptr, nullptr);
+    device.deviceInterface->waitForFrame(device.queue, flushedFrame);
+    const NvFlowUint64 completedFrame = device.deviceInterface->getLastFrameCompleted(device.queue);
+
+    // Latest readback the device has finished writing
+    const NvFlowGridRenderDataNanoVdbReadback* readback = nullptr;
+    for (NvFlowUint64 idx = renderData.nanoVdb.readbackCount; idx > 0u; idx--) {
+        if (renderData.nanoVdb.readbacks[idx - 1u].globalFrameCompleted <= completedFrame) {
+            readback = &renderData.nanoVdb.readbacks[idx - 1u];
+            break;
+        }
+    }
+    if (!readback) return false;
+
+    copyReadback(readback->smokeNanoVdbReadback, readback->smokeNanoVdbReadbackSize, grid->smokeReadback);
+    copyReadback(readback->velocityNanoVdbReadback, readback->velocityNanoVdbReadbackSize, grid->velocityReadback);
+    return true;
+}
+
+void upfFlowGridResample(const UpfFlowGrid* grid, float* density, float* vx, float* vy, float* vz)
+{
+    const size_t numCells = (size_t)grid->sizeX * grid->sizeY * grid->sizeZ;
+    std::fill(density, density + numCells, 0.0f);
+    std::fill(vx, vx + numCells, 0.0f);
+    std::fill(vy, vy + numCells, 0.0f);
+    std::fill(vz, vz + numCells, 0.0f);
+    resampleNanoVdb(grid->smokeReadback, *grid, density, nullptr, nullptr, nullptr);
+    resampleNanoVdb(grid->velocityReadback, *grid, nullptr, vx, vy, vz);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+// Grids simulated by Flow's own sparse solver (NvFlowGridInterface) instead of
+// the bridge's CPU solver. Bridge emitters become Flow sphere emitters, and each
+// step's NanoVDB readback is resampled into the bridge's dense planes, so
+// snapshots and exports work the same for both kinds of grid.
+
+#include "../include/UnityPhysXFlow.h"
+
+#include "NvFlowContext.h"
+#include "NvFlowExt.h"
+
+// The Flow objects a grid needs; all owned by the bridge.
+struct UpfFlowDevice {
+    NvFlowGridInterface* gridInterface;
+    NvFlowDeviceInterface* deviceInterface;
+    NvFlowContextInterface* contextInterface;
+    NvFlowContext* context;
+    NvFlowDeviceQueue* queue;
+    NvFlowOpList* opList;
+    NvFlowExtOpList* extOpList;
+};
+
+struct UpfFlowGrid;
+
+// Create a Flow grid covering sizeX*sizeY*sizeZ cells of cellSize, centered
+// on the origin. Returns null if Flow fails to create it.
+UpfFlowGrid* upfFlowGridCreate(const UpfFlowDevice& device, int sizeX, int sizeY, int sizeZ, float cellSize);
+
+void upfFlowGridDestroy(const UpfFlowDevice& device, UpfFlowGrid* grid);
+
+// Simulate dt with the given emitters (waiting for the device) and keep a copy
+// of the NanoVDB readback. Returns false if no readback was available. Uses
+// Flow's context, so calls must be serialized with other Flow calls.
+bool upfFlowGridSimulate(const UpfFlowDevice& device, UpfFlowGrid* grid, float dt,
+                         const UpfEmitterDesc* emitters, int count);
+
+// Resample the last simulated readback: smoke into density and velocity into
+// vx/vy/vz, each sizeX*sizeY*sizeZ. Touches no Flow objects.
+void upfFlowGridResample(const UpfFlowGrid* grid, float* density, float* vx, float* vy, float* vz);
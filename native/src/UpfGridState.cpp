@@ -0,0 +1,176 @@
+#ifdef _WIN32
+#define NOMINMAX  // Prevent Windows min/max macros
+#endif
+
+#include "UpfGridState.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+static std::wstring widePath(const char* path)
+{
+    const int n = MultiByteToWideChar(CP_UTF8, 0, path, -1, nullptr, 0);
+    if (n <= 0) return std::wstring();
+    std::wstring w((size_t)n, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, path, -1, &w[0], n);
+    w.resize((size_t)n - 1);
+    return w;
+}
+#endif
+
+FILE* upfOpenFile(const char* path, const char* mode)
+{
+    if (!path || !mode) return nullptr;
+#ifdef _WIN32
+    const std::wstring wmode(mode, mode + std::strlen(mode));
+    return _wfopen(widePath(path).c_str(), wmode.c_str());
+#else
+    return std::fopen(path, mode);
+#endif
+}
+
+UpfMappedFile::~UpfMappedFile()
+{
+#ifdef _WIN32
+    if (data) UnmapViewOfFile(data);
+    if (mapping) CloseHandle((HANDLE)mapping);
+    if (file) CloseHandle((HANDLE)file);
+#else
+    if (data) munmap((void*)data, size);
+#endif
+}
+
+bool UpfMappedFile::open(const char* path)
+{
+    if (data || !path) return false;
+#ifdef _WIN32
+    HANDLE f = CreateFileW(widePath(path).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                           FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (f == INVALID_HANDLE_VALUE) return false;
+    file = f;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(f, &fileSize) || fileSize.QuadPart <= 0) return false;
+    HANDLE m = CreateFileMappingW(f, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!m) return false;
+    mapping = m;
+    const void* view = MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0);
+    if (!view) return false;
+    data = (const uint8_t*)view;
+    size = (size_t)fileSize.QuadPart;
+#else
+    const int fd = ::open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+    void* view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) return false;
+    // The whole file is read right after mapping; start paging it in
+    madvise(view, (size_t)st.st_size, MADV_WILLNEED);
+    data = (const uint8_t*)view;
+    size = (size_t)st.st_size;
+#endif
+    return true;
+}
+
+int32_t upfGridStateView(const uint8_t* data, size_t size, UpfGridStateView& view)
+{
+    view = {};
+    if (!data || size < sizeof(UpfGridStateHeader)) return -3;
+    const UpfGridStateHeader& h = *(const UpfGridStateHeader*)data;
+    if (std::memcmp(h.magic, kUpfGridStateMagic, sizeof(h.magic)) != 0) return -3;
+    if (h.version != kUpfGridStateVersion) return -4;
+    if (h.headerBytes != sizeof(UpfGridStateHeader)) return -3;
+    if (h.sizeX <= 0 || h.sizeY <= 0 || h.sizeZ <= 0 || h.brickSize <= 0 || h.emitterCount < 0) return -3;
+    if (h.channels >= (1u << 4)) return -3;
+    for (int k = 0; k < 3; k++) {
+        if (h.originCell[k] < -kUpfGridStateMaxOrigin || h.originCell[k] > kUpfGridStateMaxOrigin) return -3;
+    }
+
+    const uint64_t cells = (uint64_t)h.sizeX * h.sizeY * h.sizeZ;
+    const uint64_t bricks = (uint64_t)((h.sizeX + h.brickSize - 1) / h.brickSize)
+                          * ((h.sizeY + h.brickSize - 1) / h.brickSize)
+                          * ((h.sizeZ + h.brickSize - 1) / h.brickSize);
+    uint64_t expected[UpfGridStateSection_Count];
+    expected[UpfGridStateSection_Density] = cells * sizeof(float);
+    expected[UpfGridStateSection_VelocityX] = cells * sizeof(float);
+    expected[UpfGridStateSection_VelocityY] = cells * sizeof(float);
+    expected[UpfGridStateSection_VelocityZ] = cells * sizeof(float);
+    for (int c = 0; c < 4; c++) {
+        expected[UpfGridStateSection_Temperature + c] = (h.channels & (1u << c)) ? cells * sizeof(float) : 0;
+    }
+    expected[UpfGridStateSection_BrickActivity] = bricks * sizeof(float);
+    expected[UpfGridStateSection_BrickVisited] = bricks;
+    expected[UpfGridStateSection_Emitters] = (uint64_t)h.emitterCount * sizeof(UpfEmitterDesc);
+    expected[UpfGridStateSection_EmitterChannels] = (uint64_t)h.emitterCount * 3 * sizeof(float);
+    for (int s = 0; s < UpfGridStateSection_Count; s++) {
+        if (h.bytes[s] != expected[s] || h.offset[s] % sizeof(float) != 0) return -3;
+        if (h.offset[s] < sizeof(UpfGridStateHeader) || h.offset[s] > size || h.bytes[s] > size - h.offset[s]) return -3;
+    }
+
+    view.header = &h;
+    view.density = (const float*)(data + h.offset[UpfGridStateSection_Density]);
+    view.velX = (const float*)(data + h.offset[UpfGridStateSection_VelocityX]);
+    view.velY = (const float*)(data + h.offset[UpfGridStateSection_VelocityY]);
+    view.velZ = (const float*)(data + h.offset[UpfGridStateSection_VelocityZ]);
+    for (int c = 0; c < 4; c++) {
+        const int section = UpfGridStateSection_Temperature + c;
+        view.channels[c] = h.bytes[section] > 0 ? (const float*)(data + h.offset[section]) : nullptr;
+    }
+    view.brickActivity = (const float*)(data + h.offset[UpfGridStateSection_BrickActivity]);
+    view.brickVisited = data + h.offset[UpfGridStateSection_BrickVisited];
+    view.emitters = (const UpfEmitterDesc*)(data + h.offset[UpfGridStateSection_Emitters]);
+    view.emitterChannels = (const float*)(data + h.offset[UpfGridStateSection_EmitterChannels]);
+    return 0;
+}
+
+int64_t upfWriteGridState(const char* path, UpfGridStateHeader header, const void* const sections[UpfGridStateSection_Count])
+{
+    if (!path) return -2;
+    std::memcpy(header.magic, kUpfGridStateMagic, sizeof(header.magic));
+    header.version = kUpfGridStateVersion;
+    header.headerBytes = sizeof(UpfGridStateHeader);
+    uint64_t end = sizeof(UpfGridStateHeader);
+    for (int s = 0; s < UpfGridStateSection_Count; s++) {
+        end = (end + kUpfGridStateAlign - 1) / kUpfGridStateAlign * kUpfGridStateAlign;
+        header.offset[s] = end;
+        end += header.bytes[s];
+    }
+
+    FILE* f = upfOpenFile(path, "wb");
+    if (!f) return -2;
+
+    static const uint8_t zeros[kUpfGridStateAlign] = {};
+    bool ok = std::fwrite(&header, sizeof(header), 1, f) == 1;
+    uint64_t pos = sizeof(header);
+    for (int s = 0; s < UpfGridStateSection_Count && ok; s++) {
+        const uint64_t pad = header.offset[s] - pos;
+        ok = pad == 0 || std::fwrite(zeros, 1, (size_t)pad, f) == pad;
+        if (ok && header.bytes[s] > 0) ok = std::fwrite(sections[s], 1, (size_t)header.bytes[s], f) == header.bytes[s];
+        pos = header.offset[s] + header.bytes[s];
+    }
+    ok = std::fclose(f) == 0 && ok;
+    if (!ok) {
+#ifdef _WIN32
+        _wremove(widePath(path).c_str());
+#else
+        std::remove(path);
+#endif
+        return -2;
+    }
+    return (int64_t)end;
+}
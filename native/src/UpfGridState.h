@@ -0,0 +1,94 @@
+#pragma once
+
+// Grid state files for Upf_SaveGridState / Upf_LoadGridState. A file is a
+// fixed header followed by page-aligned sections laid out exactly like the
+// solver's buffers (one float plane per field, x fastest, then y, then z), so
+// a load maps the file and copies the sections in place without parsing.
+// Values are little endian; the version changes whenever the layout does.
+
+#include "../include/UnityPhysXFlow.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <cstdio>
+
+static constexpr char kUpfGridStateMagic[8] = { 'U', 'P', 'F', 'G', 'R', 'I', 'D', '\0' };
+static constexpr uint32_t kUpfGridStateVersion = 3;
+// Section alignment, so mapped sections start on a page
+static constexpr uint64_t kUpfGridStateAlign = 4096;
+// Largest saved window offset per axis, in cells; keeps scroll arithmetic in range
+static constexpr int32_t kUpfGridStateMaxOrigin = 1 << 24;
+
+enum UpfGridStateSection {
+    UpfGridStateSection_Density = 0,   // float per cell
+    UpfGridStateSection_VelocityX,     // float per cell
+    UpfGridStateSection_VelocityY,     // float per cell
+    UpfGridStateSection_VelocityZ,     // float per cell
+    UpfGridStateSection_Temperature,   // float per cell if the grid has the channel, else empty;
+    UpfGridStateSection_Fuel,          //   the optional channels follow UpfGridChannel's bit order
+    UpfGridStateSection_Burn,
+    UpfGridStateSection_Smoke,
+    UpfGridStateSection_BrickActivity, // float per brick, from the last sweep
+    UpfGridStateSection_BrickVisited,  // uint8 per brick; cells of other bricks are zero
+    UpfGridStateSection_Emitters,      // UpfEmitterDesc per emitter bound to the grid
+    UpfGridStateSection_EmitterChannels, // 3 floats per emitter: temperature, fuel, smoke
+    UpfGridStateSection_Count
+};
+
+struct UpfGridStateHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerBytes;       // sizeof(UpfGridStateHeader) when written
+    int32_t sizeX, sizeY, sizeZ;
+    float cellSize;
+    int32_t brickSize;          // cells per brick edge
+    int32_t emitterCount;
+    uint32_t channels;          // UpfGridChannel bits of the grid
+    int32_t originCell[3];      // window position of a scrolling grid, in cells (0 otherwise)
+    uint64_t offset[UpfGridStateSection_Count];  // from the start of the file
+    uint64_t bytes[UpfGridStateSection_Count];
+};
+
+// Pointers into a mapped state file.
+struct UpfGridStateView {
+    const UpfGridStateHeader* header;
+    const float* density;
+    const float* velX;
+    const float* velY;
+    const float* velZ;
+    const float* channels[4];       // UpfGridChannel bit order, null if not saved
+    const float* brickActivity;
+    const uint8_t* brickVisited;
+    const UpfEmitterDesc* emitters;
+    const float* emitterChannels;   // 3 floats per emitter
+};
+
+// Read-only mapping of a whole file (UTF-8 path). Unmapped on destruction.
+struct UpfMappedFile {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    void* file = nullptr;
+    void* mapping = nullptr;
+#endif
+
+    UpfMappedFile() = default;
+    UpfMappedFile(const UpfMappedFile&) = delete;
+    UpfMappedFile& operator=(const UpfMappedFile&) = delete;
+    ~UpfMappedFile();
+
+    bool open(const char* path);
+};
+
+// fopen with a UTF-8 path (state files and NanoVDB caches).
+FILE* upfOpenFile(const char* path, const char* mode);
+
+// Check the header and that every section lies inside the file with the size
+// the header implies. Returns 0 and fills view, -3 if this is not a grid state
+// file or it is truncated, -4 for another format version.
+int32_t upfGridStateView(const uint8_t* data, size_t size, UpfGridStateView& view);
+
+// Write a state file: header (magic, version, offsets and bytes are filled in
+// here) and sections[i] of header.bytes[i] bytes each. Returns the file size,
+// or -2 if the file could not be written.
+int64_t upfWriteGridState(const char* path, UpfGridStateHeader header, const void* const sections[UpfGridStateSection_Count]);
@@ -0,0 +1,381 @@
+#include "UpfObstacle.h"
+#include "../include/UnityPhysXFlow.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// Mesh volumes: samples across the longest side of the bounds, samples of
+// margin beyond them, and how far (in samples) from a triangle distances are
+// exact; further out they are propagated with a chamfer transform.
+static constexpr int kMeshSdfCells = 40;
+static constexpr int kMeshSdfMargin = 3;
+static constexpr float kMeshSdfExact = 2.0f;
+
+struct V3 {
+    float x, y, z;
+};
+
+static inline V3 operator+(V3 a, V3 b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+static inline V3 operator-(V3 a, V3 b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+static inline V3 operator*(V3 a, float s) { return { a.x * s, a.y * s, a.z * s }; }
+static inline float dot(V3 a, V3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+static inline V3 cross(V3 a, V3 b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+static inline float length(V3 a) { return std::sqrt(dot(a, a)); }
+
+// Rotate v by the unit quaternion q (x, y, z, w), or by its inverse.
+static inline V3 rotate(const float* q, V3 v, bool inverse)
+{
+    const V3 u = inverse ? V3{ -q[0], -q[1], -q[2] } : V3{ q[0], q[1], q[2] };
+    const V3 t = cross(u, v) * 2.0f;
+    return v + t * q[3] + cross(u, t);
+}
+
+// Squared distance from p to triangle abc (Ericson, Real-Time Collision Detection 5.1.5).
+static float distSqPointTriangle(V3 p, V3 a, V3 b, V3 c)
+{
+    const V3 ab = b - a, ac = c - a, ap = p - a;
+    const float d1 = dot(ab, ap), d2 = dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f) return dot(ap, ap);
+
+    const V3 bp = p - b;
+    const float d3 = dot(ab, bp), d4 = dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3) return dot(bp, bp);
+
+    const float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+        const V3 e = ap - ab * (d1 / (d1 - d3));
+        return dot(e, e);
+    }
+
+    const V3 cp = p - c;
+    const float d5 = dot(ab, cp), d6 = dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6) return dot(cp, cp);
+
+    const float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+        const V3 e = ap - ac * (d2 / (d2 - d6));
+        return dot(e, e);
+    }
+
+    const float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f) {
+        const V3 e = bp - (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+        return dot(e, e);
+    }
+
+    const float denom = 1.0f / (va + vb + vc);
+    const V3 e = ap - ab * (vb * denom) - ac * (vc * denom);
+    return dot(e, e);
+}
+
+// Unsigned distances within kMeshSdfExact samples of each triangle. Threads
+// own z-slices and test every triangle reaching theirs.
+static void meshExactDistances(UpfMeshSdf& m, const std::vector<V3>& tris)
+{
+    const int numTris = (int)tris.size() / 3;
+    const float sp = m.spacing;
+    const V3 origin = { m.origin[0], m.origin[1], m.origin[2] };
+
+    // Sample range of each triangle, grown by the exact band
+    std::vector<int> range((size_t)numTris * 6);
+    for (int t = 0; t < numTris; t++) {
+        const V3 &a = tris[t * 3], &b = tris[t * 3 + 1], &c = tris[t * 3 + 2];
+        const float lo[3] = { std::min(a.x, std::min(b.x, c.x)), std::min(a.y, std::min(b.y, c.y)), std::min(a.z, std::min(b.z, c.z)) };
+        const float hi[3] = { std::max(a.x, std::max(b.x, c.x)), std::max(a.y, std::max(b.y, c.y)), std::max(a.z, std::max(b.z, c.z)) };
+        const int size[3] = { m.sizeX, m.sizeY, m.sizeZ };
+        for (int k = 0; k < 3; k++) {
+            range[t * 6 + k * 2] = std::max(0, (int)std::floor((lo[k] - m.origin[k]) / sp - kMeshSdfExact));
+            range[t * 6 + k * 2 + 1] = std::min(size[k] - 1, (int)std::ceil((hi[k] - m.origin[k]) / sp + kMeshSdfExact));
+        }
+    }
+
+    const int sX = m.sizeX, sY = m.sizeY, sZ = m.sizeZ;
+    float* dist = m.distance.data();
+    #pragma omp parallel for schedule(dynamic, 1) if(sZ > 8)
+    for (int z = 0; z < sZ; z++) {
+        for (int t = 0; t < numTris; t++) {
+            const int* r = &range[t * 6];
+            if (z < r[4] || z > r[5]) continue;
+            const V3 &a = tris[t * 3], &b = tris[t * 3 + 1], &c = tris[t * 3 + 2];
+            for (int y = r[2]; y <= r[3]; y++) {
+                for (int x = r[0]; x <= r[1]; x++) {
+                    const V3 p = origin + V3{ x * sp, y * sp, z * sp };
+                    const size_t i = (size_t)x + (size_t)y * sX + (size_t)z * sX * sY;
+                    dist[i] = std::min(dist[i], distSqPointTriangle(p, a, b, c));
+                }
+            }
+        }
+    }
+    for (float& d : m.distance) {
+        if (d < FLT_MAX) d = std::sqrt(d);
+    }
+}
+
+// Fill the rest of the volume from the exact band: a forward and a backward
+// sweep, each relaxing every sample against its 13 already-swept neighbours.
+static void meshChamfer(UpfMeshSdf& m)
+{
+    const int sX = m.sizeX, sY = m.sizeY, sZ = m.sizeZ;
+    struct Offset { int dx, dy, dz; float w; };
+    Offset offsets[13];
+    int n = 0;
+    for (int dz = -1; dz <= 0; dz++)
+        for (int dy = -1; dy <= 1; dy++)
+            for (int dx = -1; dx <= 1; dx++) {
+                if (dz == 0 && (dy > 0 || (dy == 0 && dx >= 0))) continue;
+                offsets[n++] = { dx, dy, dz, m.spacing * std::sqrt((float)(dx * dx + dy * dy + dz * dz)) };
+            }
+
+    float* dist = m.distance.data();
+    auto relax = [&](int x, int y, int z, int sign) {
+        const size_t i = (size_t)x + (size_t)y * sX + (size_t)z * sX * sY;
+        for (const Offset& o : offsets) {
+            const int nx = x + sign * o.dx, ny = y + sign * o.dy, nz = z + sign * o.dz;
+            if (nx < 0 || nx >= sX || ny < 0 || ny >= sY || nz < 0 || nz >= sZ) continue;
+            const float d = dist[(size_t)nx + (size_t)ny * sX + (size_t)nz * sX * sY] + o.w;
+            if (d < dist[i]) dist[i] = d;
+        }
+    };
+    for (int z = 0; z < sZ; z++)
+        for (int y = 0; y < sY; y++)
+            for (int x = 0; x < sX; x++) relax(x, y, z, 1);
+    for (int z = sZ - 1; z >= 0; z--)
+        for (int y = sY - 1; y >= 0; y--)
+            for (int x = sX - 1; x >= 0; x--) relax(x, y, z, -1);
+}
+
+// Negate the distance of samples inside the mesh: a ray along +X through each
+// row of samples enters or leaves the mesh at every triangle it crosses. The
+// rays are nudged off the lattice so they don't graze edges of axis-aligned meshes.
+static void meshSign(UpfMeshSdf& m, const std::vector<V3>& tris)
+{
+    const int numTris = (int)tris.size() / 3;
+    const int sX = m.sizeX, sY = m.sizeY, sZ = m.sizeZ;
+    const float sp = m.spacing;
+    const float jitterY = 1.37e-4f * sp, jitterZ = 2.91e-4f * sp;
+
+    // Triangles whose YZ bounds cover each row
+    std::vector<std::vector<int>> rows((size_t)sY * sZ);
+    for (int t = 0; t < numTris; t++) {
+        const V3 &a = tris[t * 3], &b = tris[t * 3 + 1], &c = tris[t * 3 + 2];
+        const float loY = std::min(a.y, std::min(b.y, c.y)), hiY = std::max(a.y, std::max(b.y, c.y));
+        const float loZ = std::min(a.z, std::min(b.z, c.z)), hiZ = std::max(a.z, std::max(b.z, c.z));
+        const int y0 = std::max(0, (int)std::ceil((loY - m.origin[1] - jitterY) / sp));
+        const int y1 = std::min(sY - 1, (int)std::floor((hiY - m.origin[1] - jitterY) / sp));
+        const int z0 = std::max(0, (int)std::ceil((loZ - m.origin[2] - jitterZ) / sp));
+        const int z1 = std::min(sZ - 1, (int)std::floor((hiZ - m.origin[2] - jitterZ) / sp));
+        for (int z = z0; z <= z1; z++)
+            for (int y = y0; y <= y1; y++) rows[(size_t)y + (size_t)z * sY].push_back(t);
+    }
+
+    #pragma omp parallel for schedule(dynamic, 16) if(sZ > 8)
+    for (int r = 0; r < sY * sZ; r++) {
+        if (rows[r].empty()) continue;
+        const int y = r % sY, z = r / sY;
+        const double py = m.origin[1] + y * sp + jitterY, pz = m.origin[2] + z * sp + jitterZ;
+
+        std::vector<float> hits;
+        for (int t : rows[r]) {
+            const V3 &a = tris[t * 3], &b = tris[t * 3 + 1], &c = tris[t * 3 + 2];
+            // Barycentric weights of (py, pz) in the triangle projected on YZ
+            const double area = ((double)b.y - a.y) * ((double)c.z - a.z) - ((double)b.z - a.z) * ((double)c.y - a.y);
+            if (area == 0.0) continue;
+            const double wa = (((double)b.y - py) * ((double)c.z - pz) - ((double)b.z - pz) * ((double)c.y - py)) / area;
+            const double wb = (((double)c.y - py) * ((double)a.z - pz) - ((double)c.z - pz) * ((double)a.y - py)) / area;
+            const double wc = 1.0 - wa - wb;
+            if (wa <= 0.0 || wb <= 0.0 || wc <= 0.0) continue;
+            hits.push_back((float)(wa * a.x + wb * b.x + wc * c.x));
+        }
+        std::sort(hits.begin(), hits.end());
+
+        size_t crossed = 0;
+        float* row = &m.distance[(size_t)y * sX + (size_t)z * sX * sY];
+        for (int x = 0; x < sX; x++) {
+            const float px = m.origin[0] + x * sp;
+            while (crossed < hits.size() && hits[crossed] < px) crossed++;
+            if (crossed & 1) row[x] = -row[x];
+        }
+    }
+}
+
+std::shared_ptr<const UpfMeshSdf> upfBakeMeshSdf(const float* vertices, int32_t vertexCount,
+                                                 const int32_t* indices, int32_t indexCount)
+{
+    if (!vertices || !indices || vertexCount <= 0 || indexCount < 3) return nullptr;
+
+    std::vector<V3> tris;
+    tris.reserve((size_t)indexCount);
+    for (int32_t t = 0; t + 2 < indexCount; t += 3) {
+        const int32_t i0 = indices[t], i1 = indices[t + 1], i2 = indices[t + 2];
+        if (i0 < 0 || i1 < 0 || i2 < 0 || i0 >= vertexCount || i1 >= vertexCount || i2 >= vertexCount) continue;
+        for (int32_t i : { i0, i1, i2 }) tris.push_back({ vertices[i * 3], vertices[i * 3 + 1], vertices[i * 3 + 2] });
+    }
+    if (tris.empty()) return nullptr;
+
+    std::shared_ptr<UpfMeshSdf> m = std::make_shared<UpfMeshSdf>();
+    for (int k = 0; k < 3; k++) { m->lo[k] = FLT_MAX; m->hi[k] = -FLT_MAX; }
+    for (const V3& v : tris) {
+        const float c[3] = { v.x, v.y, v.z };
+        for (int k = 0; k < 3; k++) { m->lo[k] = std::min(m->lo[k], c[k]); m->hi[k] = std::max(m->hi[k], c[k]); }
+    }
+    const float extent = std::max(m->hi[0] - m->lo[0], std::max(m->hi[1] - m->lo[1], m->hi[2] - m->lo[2]));
+    if (!(extent > 0.0f)) return nullptr;
+
+    m->spacing = extent / kMeshSdfCells;
+    int* sizes[3] = { &m->sizeX, &m->sizeY, &m->sizeZ };
+    for (int k = 0; k < 3; k++) {
+        *sizes[k] = (int)std::ceil((m->hi[k] - m->lo[k]) / m->spacing) + 1 + 2 * kMeshSdfMargin;
+        m->origin[k] = m->lo[k] - kMeshSdfMargin * m->spacing;
+    }
+    m->distance.assign((size_t)m->sizeX * m->sizeY * m->sizeZ, FLT_MAX);
+
+    meshExactDistances(*m, tris);
+    meshChamfer(*m);
+    meshSign(*m, tris);
+    return m;
+}
+
+// Signed distance (local units) of a baked mesh at local point p. Points past
+// the volume add their distance to it.
+static float sampleMeshSdf(const UpfMeshSdf& m, V3 p)
+{
+    const float g[3] = { (p.x - m.origin[0]) / m.spacing, (p.y - m.origin[1]) / m.spacing, (p.z - m.origin[2]) / m.spacing };
+    const int size[3] = { m.sizeX, m.sizeY, m.sizeZ };
+    int i0[3];
+    float f[3], outside = 0.0f;
+    for (int k = 0; k < 3; k++) {
+        const float c = std::min(std::max(g[k], 0.0f), (float)(size[k] - 1));
+        outside += (g[k] - c) * (g[k] - c);
+        i0[k] = std::min((int)c, size[k] - 2);
+        f[k] = c - i0[k];
+    }
+
+    const size_t sX = m.sizeX, sXY = (size_t)m.sizeX * m.sizeY;
+    const float* d = &m.distance[(size_t)i0[0] + i0[1] * sX + i0[2] * sXY];
+    auto lerp = [](float a, float b, float t) { return a + (b - a) * t; };
+    const float c00 = lerp(d[0], d[1], f[0]);
+    const float c10 = lerp(d[sX], d[sX + 1], f[0]);
+    const float c01 = lerp(d[sXY], d[sXY + 1], f[0]);
+    const float c11 = lerp(d[sXY + sX], d[sXY + sX + 1], f[0]);
+    const float v = lerp(lerp(c00, c10, f[1]), lerp(c01, c11, f[1]), f[2]);
+    return v + std::sqrt(outside) * m.spacing;
+}
+
+// Signed distance (world units) from world point w to a shape.
+static float shapeDistance(const UpfObstacleShape& s, V3 w)
+{
+    const V3 p = rotate(s.rotation, w - V3{ s.position[0], s.position[1], s.position[2] }, true);
+    switch (s.type) {
+    case UpfObstacle_Box: {
+        const V3 q = { std::fabs(p.x) - s.size[0], std::fabs(p.y) - s.size[1], std::fabs(p.z) - s.size[2] };
+        const V3 out = { std::max(q.x, 0.0f), std::max(q.y, 0.0f), std::max(q.z, 0.0f) };
+        return length(out) + std::min(std::max(q.x, std::max(q.y, q.z)), 0.0f);
+    }
+    case UpfObstacle_Sphere:
+        return length(p) - s.size[0];
+    case UpfObstacle_Capsule: {
+        const V3 q = { p.x, p.y - std::min(std::max(p.y, -s.size[1]), s.size[1]), p.z };
+        return length(q) - s.size[0];
+    }
+    case UpfObstacle_Mesh:
+        return s.mesh ? sampleMeshSdf(*s.mesh, p) : FLT_MAX;
+    default:
+        return FLT_MAX;
+    }
+}
+
+void upfObstacleBounds(const UpfObstacleShape& s, float lo[3], float hi[3])
+{
+    // Local box (center, half extents), carried to world space by |R|
+    V3 center = { 0.0f, 0.0f, 0.0f }, half = { 0.0f, 0.0f, 0.0f };
+    switch (s.type) {
+    case UpfObstacle_Box: half = { s.size[0], s.size[1], s.size[2] }; break;
+    case UpfObstacle_Sphere: half = { s.size[0], s.size[0], s.size[0] }; break;
+    case UpfObstacle_Capsule: half = { s.size[0], s.size[1] + s.size[0], s.size[0] }; break;
+    case UpfObstacle_Mesh:
+        if (s.mesh) {
+            center = V3{ s.mesh->lo[0] + s.mesh->hi[0], s.mesh->lo[1] + s.mesh->hi[1], s.mesh->lo[2] + s.mesh->hi[2] } * 0.5f;
+            half = V3{ s.mesh->hi[0] - s.mesh->lo[0], s.mesh->hi[1] - s.mesh->lo[1], s.mesh->hi[2] - s.mesh->lo[2] } * 0.5f;
+        }
+        break;
+    default: break;
+    }
+
+    const V3 axes[3] = { rotate(s.rotation, { 1.0f, 0.0f, 0.0f }, false),
+                         rotate(s.rotation, { 0.0f, 1.0f, 0.0f }, false),
+                         rotate(s.rotation, { 0.0f, 0.0f, 1.0f }, false) };
+    const V3 c = rotate(s.rotation, center, false);
+    const float wc[3] = { s.position[0] + c.x, s.position[1] + c.y, s.position[2] + c.z };
+    for (int k = 0; k < 3; k++) {
+        const float e = std::fabs((&axes[0].x)[k]) * half.x + std::fabs((&axes[1].x)[k]) * half.y + std::fabs((&axes[2].x)[k]) * half.z;
+        lo[k] = wc[k] - e;
+        hi[k] = wc[k] + e;
+    }
+}
+
+bool upfRasterizeObstacles(const UpfObstacleField& field, const UpfObstacleShape* const* shapes, int32_t count,
+                           int x0, int x1, int y0, int y1, int z0, int z1)
+{
+    const float cs = field.cellSize;
+    const float invCs = 1.0f / cs;
+    const float halfX = field.sizeX * cs * 0.5f - field.centerX;
+    const float halfY = field.sizeY * cs * 0.5f - field.centerY;
+    const float halfZ = field.sizeZ * cs * 0.5f - field.centerZ;
+    bool near = false;
+
+    for (int z = z0; z < z1; z++) {
+        for (int y = y0; y < y1; y++) {
+            const size_t row = (size_t)y * field.sizeX + (size_t)z * field.sizeX * field.sizeY;
+            for (int x = x0; x < x1; x++) {
+                const V3 w = { (x + 0.5f) * cs - halfX, (y + 0.5f) * cs - halfY, (z + 0.5f) * cs - halfZ };
+                float d = kUpfObstacleBand;
+                for (int32_t s = 0; s < count; s++) d = std::min(d, shapeDistance(*shapes[s], w) * invCs);
+                d = std::max(d, -kUpfObstacleBand);
+                field.sdf[row + x] = d;
+                field.solid[row + x] = d < 0.0f ? 1 : 0;
+                near |= d < 1.0f;
+            }
+        }
+    }
+    return near;
+}
+
+void upfApplyObstacleRow(const UpfObstacleField& field, float* density, float* vx, float* vy, float* vz,
+                         float* const* channels, int channelCount, int y, int z, int x0, int x1)
+{
+    const int sX = field.sizeX, sY = field.sizeY, sZ = field.sizeZ;
+    const size_t sXY = (size_t)sX * sY;
+    const size_t row = (size_t)y * sX + (size_t)z * sXY;
+    const float* sdf = field.sdf;
+    // Neighbour offsets, one-sided on the grid faces
+    const size_t ym = y > 0 ? sX : 0, yp = y < sY - 1 ? sX : 0;
+    const size_t zm = z > 0 ? sXY : 0, zp = z < sZ - 1 ? sXY : 0;
+
+    for (int x = x0; x < x1; x++) {
+        const size_t i = row + x;
+        const float d = sdf[i];
+        if (d >= 1.0f) continue;
+        if (d < 0.0f) {
+            density[i] = 0.0f;
+            vx[i] = 0.0f; vy[i] = 0.0f; vz[i] = 0.0f;
+            for (int c = 0; c < channelCount; c++) {
+                if (channels[c]) channels[c][i] = 0.0f;
+            }
+            continue;
+        }
+
+        // Outward normal from the SDF gradient
+        const float nx = sdf[x < sX - 1 ? i + 1 : i] - sdf[x > 0 ? i - 1 : i];
+        const float ny = sdf[i + yp] - sdf[i - ym];
+        const float nz = sdf[i + zp] - sdf[i - zm];
+        const float lenSq = nx * nx + ny * ny + nz * nz;
+        if (lenSq <= 0.0f) continue;
+        const float vn = (vx[i] * nx + vy[i] * ny + vz[i] * nz) / lenSq;
+        if (vn < 0.0f) {
+            vx[i] -= vn * nx;
+            vy[i] -= vn * ny;
+            vz[i] -= vn * nz;
+        }
+    }
+}
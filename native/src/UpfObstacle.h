@@ -0,0 +1,67 @@
+#pragma once
+
+// Solid obstacles for the bridge's CPU solver. Shapes are rasterized into a
+// per-grid signed distance field (in cells, negative inside, clamped to
+// +-kUpfObstacleBand) one block of cells at a time, so grids only redo the
+// bricks an obstacle moved through. Triangle meshes are baked once into a
+// local-space distance volume that every grid samples.
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+// Distance band of the grid SDF, in cells. Cells closer than one cell to a
+// surface have the inward normal component of their velocity removed.
+static constexpr float kUpfObstacleBand = 3.0f;
+
+// Signed distances of a closed triangle mesh, sampled on a regular lattice
+// around its bounds in the mesh's local space.
+struct UpfMeshSdf {
+    float origin[3];        // local position of sample (0, 0, 0)
+    float spacing;
+    int sizeX, sizeY, sizeZ;
+    float lo[3], hi[3];     // local bounds of the vertices
+    std::vector<float> distance;
+};
+
+// Shape in world space. rotation is a unit quaternion (x, y, z, w).
+// size: box half extents; sphere radius (x); capsule radius (x) and half
+// length of its segment along local Y (y); unused for meshes.
+struct UpfObstacleShape {
+    int32_t type;           // UpfObstacleType
+    float position[3];
+    float rotation[4];
+    float size[3];
+    std::shared_ptr<const UpfMeshSdf> mesh;
+};
+
+// Bake a mesh (3 floats per vertex, 3 indices per triangle). Returns null for
+// an empty or degenerate mesh. Inside is decided by ray parity, so the mesh
+// should be closed.
+std::shared_ptr<const UpfMeshSdf> upfBakeMeshSdf(const float* vertices, int32_t vertexCount,
+                                                 const int32_t* indices, int32_t indexCount);
+
+// World-space bounding box of a shape.
+void upfObstacleBounds(const UpfObstacleShape& shape, float lo[3], float hi[3]);
+
+// Cells of a grid, and its SDF and solid mask.
+struct UpfObstacleField {
+    int sizeX, sizeY, sizeZ;
+    float cellSize;
+    float centerX, centerY, centerZ;  // world position of the grid's center
+    float* sdf;             // per cell, in cells
+    uint8_t* solid;         // per cell, 1 where sdf < 0
+};
+
+// Rasterize the shapes into cells [x0, x1) x [y0, y1) x [z0, z1). Cells no
+// shape reaches read +kUpfObstacleBand. Returns true if any cell is closer
+// than one cell to a surface (or inside one).
+bool upfRasterizeObstacles(const UpfObstacleField& field, const UpfObstacleShape* const* shapes, int32_t count,
+                           int x0, int x1, int y0, int y1, int z0, int z1);
+
+// Enforce the obstacles on cells [x0, x1) of row (y, z): solid cells lose
+// their density, velocity and the channelCount planes of channels (null
+// entries are skipped), cells within one cell of a surface the velocity
+// component into it.
+void upfApplyObstacleRow(const UpfObstacleField& field, float* density, float* vx, float* vy, float* vz,
+                         float* const* channels, int channelCount, int y, int z, int x0, int x1);
@@ -0,0 +1,398 @@
+#include "UpfPressure.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+static constexpr int kPreSmooth = 2;
+static constexpr int kPostSmooth = 2;
+static constexpr int kCoarsestSmooth = 24;
+static constexpr int kMinLevelSize = 4;
+
+// Pressure is 0 on the grid faces: a neighbour outside the grid mirrors the
+// cell (ghost = -p), which keeps the boundary at the same place on every level.
+// A solid neighbour repeats the cell (ghost = p), so no flow crosses the wall.
+// Returns the sum of the fluid neighbours and sets the diagonal weight.
+static inline float neighborSum(const UpfMultigridLevel& lv, const float* f, const uint8_t* flags,
+                                int x, int y, int z, size_t i, float& diag)
+{
+    const size_t sX = lv.sizeX, sXY = (size_t)lv.sizeX * lv.sizeY;
+    float s = 0.0f;
+    diag = 6.0f;
+    auto add = [&](bool inGrid, size_t n) {
+        if (!inGrid) diag += 1.0f;
+        else if (flags && (flags[n] & kUpfCellSolid)) diag -= 1.0f;
+        else s += f[n];
+    };
+    add(x > 0, i - 1);
+    add(x < lv.sizeX - 1, i + 1);
+    add(y > 0, i - sX);
+    add(y < lv.sizeY - 1, i + sX);
+    add(z > 0, i - sXY);
+    add(z < lv.sizeZ - 1, i + sXY);
+    return s;
+}
+
+static inline const uint8_t* levelFlags(const UpfMultigridLevel& lv)
+{
+    return lv.flags.empty() ? nullptr : lv.flags.data();
+}
+
+static inline bool interiorRow(const UpfMultigridLevel& lv, int y, int z)
+{
+    return y > 0 && y < lv.sizeY - 1 && z > 0 && z < lv.sizeZ - 1;
+}
+
+// Cell update away from the fast interior path: next to the grid faces, or
+// (Masked) next to a solid cell. Solid cells keep p = 0.
+template <bool Masked>
+static inline void smoothCell(const UpfMultigridLevel& lv, float* p, const float* rhs, const uint8_t* flags,
+                              int x, int y, int z, size_t i)
+{
+    if (Masked && (flags[i] & kUpfCellSolid)) return;
+    float diag;
+    const float nb = neighborSum(lv, p, Masked ? flags : nullptr, x, y, z, i, diag);
+    p[i] = diag > 0.0f ? (nb - lv.h2 * rhs[i]) / diag : 0.0f;
+}
+
+// Red-black Gauss-Seidel: each colour only reads the other, so slabs of a
+// colour update in parallel. Masked levels check each cell's solid flags;
+// unmasked ones keep the flag test out of the inner loop.
+template <bool Masked>
+static void smoothSweeps(UpfMultigridLevel& lv, int sweeps)
+{
+    const int sX = lv.sizeX, sY = lv.sizeY, sZ = lv.sizeZ;
+    const size_t sXY = (size_t)sX * sY;
+    float* p = lv.p.data();
+    const float* rhs = lv.rhs.data();
+    const uint8_t* flags = levelFlags(lv);
+    const float h2 = lv.h2;
+
+    for (int s = 0; s < sweeps; s++) {
+        for (int color = 0; color < 2; color++) {
+            #pragma omp parallel for if(sZ > 8)
+            for (int z = 0; z < sZ; z++) {
+                for (int y = 0; y < sY; y++) {
+                    const size_t row = (size_t)y * sX + (size_t)z * sXY;
+                    const int xStart = (y + z + color) & 1;
+                    const bool masked = Masked && lv.rowFlags[y + (size_t)z * sY];
+                    if (!interiorRow(lv, y, z)) {
+                        for (int x = xStart; x < sX; x += 2) smoothCell<Masked>(lv, p, rhs, flags, x, y, z, row + x);
+                        continue;
+                    }
+                    for (int x = xStart; x < sX; x += 2) {
+                        const size_t i = row + x;
+                        if (x == 0 || x == sX - 1 || (masked && flags[i])) {
+                            smoothCell<Masked>(lv, p, rhs, flags, x, y, z, i);
+                            continue;
+                        }
+                        const float nb = p[i - 1] + p[i + 1] + p[i - sX] + p[i + sX] + p[i - sXY] + p[i + sXY];
+                        p[i] = (nb - h2 * rhs[i]) * (1.0f / 6.0f);
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void smooth(UpfMultigridLevel& lv, int sweeps)
+{
+    if (lv.flags.empty()) smoothSweeps<false>(lv, sweeps);
+    else smoothSweeps<true>(lv, sweeps);
+}
+
+// r = rhs - A p. Returns the sum of squared residuals.
+static double computeResidual(UpfMultigridLevel& lv)
+{
+    const int sX = lv.sizeX, sY = lv.sizeY, sZ = lv.sizeZ;
+    const size_t sXY = (size_t)sX * sY;
+    const float* p = lv.p.data();
+    const float* rhs = lv.rhs.data();
+    const uint8_t* flags = levelFlags(lv);
+    float* r = lv.r.data();
+    const float invH2 = 1.0f / lv.h2;
+    double sumSq = 0.0;
+
+    #pragma omp parallel for reduction(+:sumSq) if(sZ > 8)
+    for (int z = 0; z < sZ; z++) {
+        for (int y = 0; y < sY; y++) {
+            const size_t row = (size_t)y * sX + (size_t)z * sXY;
+            const bool interior = interiorRow(lv, y, z);
+            const bool masked = flags && lv.rowFlags[y + (size_t)z * sY];
+            for (int x = 0; x < sX; x++) {
+                const size_t i = row + x;
+                float res;
+                if (interior && x > 0 && x < sX - 1 && !(masked && flags[i])) {
+                    const float nb = p[i - 1] + p[i + 1] + p[i - sX] + p[i + sX] + p[i - sXY] + p[i + sXY];
+                    res = rhs[i] - (nb - 6.0f * p[i]) * invH2;
+                } else if (flags && (flags[i] & kUpfCellSolid)) {
+                    res = 0.0f;
+                } else {
+                    float diag;
+                    const float nb = neighborSum(lv, p, flags, x, y, z, i, diag);
+                    res = rhs[i] - (nb - diag * p[i]) * invH2;
+                }
+                r[i] = res;
+                sumSq += (double)res * res;
+            }
+        }
+    }
+    return sumSq;
+}
+
+// Coarse rhs = average of the fine residual over the 2x2x2 children.
+static void restrictResidual(const UpfMultigridLevel& fine, UpfMultigridLevel& coarse)
+{
+    const int fX = fine.sizeX, fY = fine.sizeY, fZ = fine.sizeZ;
+    const int cX = coarse.sizeX, cY = coarse.sizeY, cZ = coarse.sizeZ;
+
+    #pragma omp parallel for if(cZ > 8)
+    for (int z = 0; z < cZ; z++) {
+        for (int y = 0; y < cY; y++) {
+            for (int x = 0; x < cX; x++) {
+                float sum = 0.0f;
+                int count = 0;
+                for (int dz = 0; dz < 2 && 2 * z + dz < fZ; dz++)
+                    for (int dy = 0; dy < 2 && 2 * y + dy < fY; dy++)
+                        for (int dx = 0; dx < 2 && 2 * x + dx < fX; dx++) {
+                            sum += fine.r[(size_t)(2 * x + dx) + (size_t)(2 * y + dy) * fX + (size_t)(2 * z + dz) * fX * fY];
+                            count++;
+                        }
+                const size_t ci = (size_t)x + (size_t)y * cX + (size_t)z * cX * cY;
+                coarse.rhs[ci] = sum / (float)count;
+                coarse.p[ci] = 0.0f;
+            }
+        }
+    }
+}
+
+// Fine p += trilinear interpolation of the coarse correction. Fine cell i sits
+// a quarter coarse cell from its parent towards neighbour (i odd ? +1 : -1);
+// past the grid face that neighbour is the mirrored ghost (-parent).
+static void prolongAdd(const UpfMultigridLevel& coarse, UpfMultigridLevel& fine)
+{
+    const int fX = fine.sizeX, fY = fine.sizeY, fZ = fine.sizeZ;
+    const int cX = coarse.sizeX, cY = coarse.sizeY, cZ = coarse.sizeZ;
+    const float* e = coarse.p.data();
+    const uint8_t* flags = levelFlags(fine);
+
+    #pragma omp parallel for if(fZ > 8)
+    for (int z = 0; z < fZ; z++) {
+        const int z0 = z >> 1, z1 = (z & 1) ? z0 + 1 : z0 - 1;
+        const float wz1 = (z1 >= 0 && z1 < cZ) ? 0.25f : -0.25f;
+        const int z1c = std::min(std::max(z1, 0), cZ - 1);
+        for (int y = 0; y < fY; y++) {
+            const int y0 = y >> 1, y1 = (y & 1) ? y0 + 1 : y0 - 1;
+            const float wy1 = (y1 >= 0 && y1 < cY) ? 0.25f : -0.25f;
+            const int y1c = std::min(std::max(y1, 0), cY - 1);
+            for (int x = 0; x < fX; x++) {
+                const size_t fi = (size_t)x + (size_t)y * fX + (size_t)z * fX * fY;
+                if (flags && (flags[fi] & kUpfCellSolid)) continue;
+                const int x0 = x >> 1, x1 = (x & 1) ? x0 + 1 : x0 - 1;
+                const float wx1 = (x1 >= 0 && x1 < cX) ? 0.25f : -0.25f;
+                const int x1c = std::min(std::max(x1, 0), cX - 1);
+
+                auto at = [&](int cx, int cy, int cz) { return e[(size_t)cx + (size_t)cy * cX + (size_t)cz * cX * cY]; };
+                const float c0 = 0.75f * at(x0, y0, z0) + wx1 * at(x1c, y0, z0);
+                const float c1 = 0.75f * at(x0, y1c, z0) + wx1 * at(x1c, y1c, z0);
+                const float c2 = 0.75f * at(x0, y0, z1c) + wx1 * at(x1c, y0, z1c);
+                const float c3 = 0.75f * at(x0, y1c, z1c) + wx1 * at(x1c, y1c, z1c);
+                const float corr = 0.75f * (0.75f * c0 + wy1 * c1) + wz1 * (0.75f * c2 + wy1 * c3);
+                fine.p[fi] += corr;
+            }
+        }
+    }
+}
+
+// Level flags from a fine solid mask: a coarse cell is solid when all its
+// children are, and fluid cells next to a solid one are marked near it.
+static void buildSolidFlags(UpfMultigrid& mg, const uint8_t* solid)
+{
+    for (size_t l = 0; l < mg.levels.size(); l++) {
+        UpfMultigridLevel& lv = mg.levels[l];
+        const int sX = lv.sizeX, sY = lv.sizeY, sZ = lv.sizeZ;
+        const size_t sXY = (size_t)sX * sY;
+        lv.flags.assign(sXY * sZ, 0);
+        uint8_t* flags = lv.flags.data();
+
+        if (l == 0) {
+            for (size_t i = 0; i < lv.flags.size(); i++) flags[i] = solid[i] ? kUpfCellSolid : 0;
+        } else {
+            const UpfMultigridLevel& fine = mg.levels[l - 1];
+            const int fX = fine.sizeX, fY = fine.sizeY, fZ = fine.sizeZ;
+            #pragma omp parallel for if(sZ > 8)
+            for (int z = 0; z < sZ; z++) {
+                for (int y = 0; y < sY; y++) {
+                    for (int x = 0; x < sX; x++) {
+                        bool all = true;
+                        for (int dz = 0; dz < 2 && 2 * z + dz < fZ; dz++)
+                            for (int dy = 0; dy < 2 && 2 * y + dy < fY; dy++)
+                                for (int dx = 0; dx < 2 && 2 * x + dx < fX; dx++)
+                                    all &= (fine.flags[(size_t)(2 * x + dx) + (size_t)(2 * y + dy) * fX + (size_t)(2 * z + dz) * fX * fY] & kUpfCellSolid) != 0;
+                        if (all) flags[(size_t)x + (size_t)y * sX + (size_t)z * sXY] = kUpfCellSolid;
+                    }
+                }
+            }
+        }
+
+        #pragma omp parallel for if(sZ > 8)
+        for (int z = 0; z < sZ; z++) {
+            for (int y = 0; y < sY; y++) {
+                for (int x = 0; x < sX; x++) {
+                    const size_t i = (size_t)x + (size_t)y * sX + (size_t)z * sXY;
+                    if (flags[i] & kUpfCellSolid) continue;
+                    const bool near = (x > 0 && (flags[i - 1] & kUpfCellSolid)) || (x < sX - 1 && (flags[i + 1] & kUpfCellSolid)) ||
+                                      (y > 0 && (flags[i - sX] & kUpfCellSolid)) || (y < sY - 1 && (flags[i + sX] & kUpfCellSolid)) ||
+                                      (z > 0 && (flags[i - sXY] & kUpfCellSolid)) || (z < sZ - 1 && (flags[i + sXY] & kUpfCellSolid));
+                    if (near) flags[i] = kUpfCellNearSolid;
+                }
+            }
+        }
+
+        lv.rowFlags.assign((size_t)sY * sZ, 0);
+        for (size_t r = 0; r < lv.rowFlags.size(); r++) {
+            for (int x = 0; x < sX && !lv.rowFlags[r]; x++) lv.rowFlags[r] = flags[r * sX + x] != 0;
+        }
+    }
+}
+
+static void vCycle(UpfMultigrid& mg, size_t level)
+{
+    UpfMultigridLevel& lv = mg.levels[level];
+    if (level + 1 == mg.levels.size()) {
+        smooth(lv, kCoarsestSmooth);
+        return;
+    }
+    smooth(lv, kPreSmooth);
+    computeResidual(lv);
+    restrictResidual(lv, mg.levels[level + 1]);
+    vCycle(mg, level + 1);
+    prolongAdd(mg.levels[level + 1], lv);
+    smooth(lv, kPostSmooth);
+}
+
+void upfMultigridResize(UpfMultigrid& mg, int sizeX, int sizeY, int sizeZ)
+{
+    if (!mg.levels.empty() && mg.levels[0].sizeX == sizeX && mg.levels[0].sizeY == sizeY && mg.levels[0].sizeZ == sizeZ) {
+        return;
+    }
+
+    mg.levels.clear();
+    float h = 1.0f;
+    for (;;) {
+        UpfMultigridLevel lv;
+        lv.sizeX = sizeX; lv.sizeY = sizeY; lv.sizeZ = sizeZ;
+        lv.h2 = h * h;
+        const size_t numCells = (size_t)sizeX * sizeY * sizeZ;
+        lv.p.assign(numCells, 0.0f);
+        lv.rhs.assign(numCells, 0.0f);
+        lv.r.assign(numCells, 0.0f);
+        mg.levels.push_back(std::move(lv));
+
+        if (std::min(sizeX, std::min(sizeY, sizeZ)) <= kMinLevelSize) break;
+        sizeX = (sizeX + 1) / 2; sizeY = (sizeY + 1) / 2; sizeZ = (sizeZ + 1) / 2;
+        h *= 2.0f;
+    }
+}
+
+UpfProjectResult upfProject(UpfMultigrid& mg, const UpfProjectParams& params)
+{
+    using Clock = std::chrono::steady_clock;
+    const Clock::time_point start = Clock::now();
+
+    upfMultigridResize(mg, params.sizeX, params.sizeY, params.sizeZ);
+    UpfMultigridLevel& fine = mg.levels[0];
+    if (!params.solid) {
+        for (UpfMultigridLevel& lv : mg.levels) {
+            std::vector<uint8_t>().swap(lv.flags);
+            std::vector<uint8_t>().swap(lv.rowFlags);
+        }
+    } else if (fine.flags.empty() || mg.solidVersion != params.solidVersion) {
+        buildSolidFlags(mg, params.solid);
+        mg.solidVersion = params.solidVersion;
+    }
+    const uint8_t* flags = levelFlags(fine);
+    const int sX = params.sizeX, sY = params.sizeY, sZ = params.sizeZ;
+    const size_t sXY = (size_t)sX * sY;
+    const double numCells = (double)sXY * sZ;
+    const float* vx = params.vx;
+    const float* vy = params.vy;
+    const float* vz = params.vz;
+
+    // Divergence by central differences; velocity outside the grid repeats the
+    // edge. Solid cells hold zero velocity and no divergence.
+    double divSumSq = 0.0;
+    #pragma omp parallel for reduction(+:divSumSq) if(sZ > 8)
+    for (int z = 0; z < sZ; z++) {
+        const size_t zm = (size_t)std::max(z - 1, 0) * sXY, zp = (size_t)std::min(z + 1, sZ - 1) * sXY;
+        for (int y = 0; y < sY; y++) {
+            const size_t ym = (size_t)std::max(y - 1, 0) * sX, yp = (size_t)std::min(y + 1, sY - 1) * sX;
+            const size_t row = (size_t)y * sX + (size_t)z * sXY;
+            for (int x = 0; x < sX; x++) {
+                const int xm = std::max(x - 1, 0), xp = std::min(x + 1, sX - 1);
+                const float div = 0.5f * ((vx[row + xp] - vx[row + xm]) +
+                                          (vy[(size_t)x + yp + (size_t)z * sXY] - vy[(size_t)x + ym + (size_t)z * sXY]) +
+                                          (vz[(size_t)x + (size_t)y * sX + zp] - vz[(size_t)x + (size_t)y * sX + zm]));
+                if (flags && (flags[row + x] & kUpfCellSolid)) {
+                    fine.rhs[row + x] = 0.0f;
+                    continue;
+                }
+                fine.rhs[row + x] = div;
+                divSumSq += (double)div * div;
+            }
+        }
+    }
+
+    UpfProjectResult result = {};
+    result.divergence = (float)std::sqrt(divSumSq / numCells);
+    if (result.divergence == 0.0f) {
+        result.milliseconds = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+        return result;
+    }
+
+    // Start from zero: after the previous projection the remaining divergence
+    // is unrelated to the old pressure, which makes a poor initial guess.
+    std::fill(fine.p.begin(), fine.p.end(), 0.0f);
+    result.residual = (float)std::sqrt(computeResidual(fine) / numCells);
+    float lastCycleMs = 0.0f;
+    while (result.cycles < params.maxCycles && result.residual > params.tolerance * result.divergence) {
+        const Clock::time_point cycleStart = Clock::now();
+        const float elapsedMs = std::chrono::duration<float, std::milli>(cycleStart - start).count();
+        if (params.budgetMs > 0.0f && result.cycles > 0 && elapsedMs + lastCycleMs > params.budgetMs) break;
+
+        vCycle(mg, 0);
+        result.residual = (float)std::sqrt(computeResidual(fine) / numCells);
+        result.cycles++;
+        lastCycleMs = std::chrono::duration<float, std::milli>(Clock::now() - cycleStart).count();
+    }
+
+    // Subtract the pressure gradient. Across a wall the pressure repeats.
+    const float* p = fine.p.data();
+    #pragma omp parallel for if(sZ > 8)
+    for (int z = 0; z < sZ; z++) {
+        for (int y = 0; y < sY; y++) {
+            const size_t row = (size_t)y * sX + (size_t)z * sXY;
+            for (int x = 0; x < sX; x++) {
+                const size_t i = row + x;
+                float pxm = x > 0 ? p[i - 1] : -p[i], pxp = x < sX - 1 ? p[i + 1] : -p[i];
+                float pym = y > 0 ? p[i - sX] : -p[i], pyp = y < sY - 1 ? p[i + sX] : -p[i];
+                float pzm = z > 0 ? p[i - sXY] : -p[i], pzp = z < sZ - 1 ? p[i + sXY] : -p[i];
+                if (flags && flags[i]) {
+                    if (flags[i] & kUpfCellSolid) continue;
+                    if (x > 0 && (flags[i - 1] & kUpfCellSolid)) pxm = p[i];
+                    if (x < sX - 1 && (flags[i + 1] & kUpfCellSolid)) pxp = p[i];
+                    if (y > 0 && (flags[i - sX] & kUpfCellSolid)) pym = p[i];
+                    if (y < sY - 1 && (flags[i + sX] & kUpfCellSolid)) pyp = p[i];
+                    if (z > 0 && (flags[i - sXY] & kUpfCellSolid)) pzm = p[i];
+                    if (z < sZ - 1 && (flags[i + sXY] & kUpfCellSolid)) pzp = p[i];
+                }
+                params.vx[i] -= 0.5f * (pxp - pxm);
+                params.vy[i] -= 0.5f * (pyp - pym);
+                params.vz[i] -= 0.5f * (pzp - pzm);
+            }
+        }
+    }
+
+    result.milliseconds = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+    return result;
+}
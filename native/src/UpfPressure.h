@@ -0,0 +1,55 @@
+#pragma once
+
+// Pressure projection for the bridge's CPU solver. A geometric multigrid
+// V-cycle with a red-black Gauss-Seidel smoother solves the Poisson equation
+// for pressure; subtracting its gradient makes the velocity (approximately)
+// divergence free. The grid boundary is open (pressure 0 on the faces);
+// solid cells are walls (no pressure gradient across their faces).
+
+#include <stdint.h>
+#include <vector>
+
+struct UpfMultigridLevel {
+    int sizeX = 0, sizeY = 0, sizeZ = 0;
+    float h2 = 1.0f;           // squared cell spacing, in fine cells
+    std::vector<float> p;      // pressure (level 0) or correction (coarser levels)
+    std::vector<float> rhs;
+    std::vector<float> r;      // residual
+    std::vector<uint8_t> flags; // kUpfCellSolid / kUpfCellNearSolid per cell; empty without solids
+    std::vector<uint8_t> rowFlags; // per row (y + z * sizeY): any cell flagged
+};
+
+static constexpr uint8_t kUpfCellSolid = 1;
+static constexpr uint8_t kUpfCellNearSolid = 2;
+
+struct UpfMultigrid {
+    // Level 0 matches the grid; each level halves the resolution.
+    std::vector<UpfMultigridLevel> levels;
+    int64_t solidVersion = -1;  // UpfProjectParams::solidVersion the level flags were built from
+};
+
+struct UpfProjectParams {
+    int sizeX, sizeY, sizeZ;
+    float* vx;
+    float* vy;
+    float* vz;
+    const uint8_t* solid;   // per cell, nonzero inside obstacles; null for none
+    int64_t solidVersion;   // changes whenever solid does
+
+    int maxCycles;      // V-cycle limit
+    float budgetMs;     // stop before a cycle would exceed this (<= 0: no budget)
+    float tolerance;    // stop once residual <= tolerance * divergence
+};
+
+struct UpfProjectResult {
+    int32_t cycles;
+    float divergence;   // RMS velocity divergence before projection, per cell
+    float residual;     // RMS Poisson residual after the last cycle
+    float milliseconds;
+};
+
+// (Re)build the level hierarchy for a grid size. No-op if the size matches.
+void upfMultigridResize(UpfMultigrid& mg, int sizeX, int sizeY, int sizeZ);
+
+// Project the velocity in place.
+UpfProjectResult upfProject(UpfMultigrid& mg, const UpfProjectParams& params);
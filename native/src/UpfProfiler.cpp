@@ -0,0 +1,112 @@
+#include "UpfProfiler.h"
+#include "UpfRing.h"
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+
+// Ring capacity in records (power of two); ~30 Flow passes per capture leaves
+// room for a few seconds of frames between reads.
+static constexpr uint64_t kRingCapacity = 4096;
+static constexpr int32_t kMaxLabels = 256;
+static constexpr int32_t kLabelChars = 64;          // including the terminator
+static constexpr uint32_t kLabelSlots = 512;        // open-addressed, power of two
+
+struct LabelTable {
+    char text[kMaxLabels][kLabelChars];
+    std::atomic<int32_t> slots[kLabelSlots];    // label id + 1, 0 = empty
+    std::atomic<int32_t> count{0};
+    std::mutex insertMtx;
+
+    LabelTable()
+    {
+        for (uint32_t i = 0; i < kLabelSlots; i++) slots[i].store(0, std::memory_order_relaxed);
+    }
+};
+
+using ProfilerRing = UpfRing<UpfProfilerEntry, kRingCapacity>;
+
+static ProfilerRing& ring()
+{
+    static ProfilerRing r;
+    return r;
+}
+
+static LabelTable& labels()
+{
+    static LabelTable t;
+    return t;
+}
+
+// FNV-1a over the part of the label that is kept
+static uint32_t hashLabel(const char* label)
+{
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < kLabelChars - 1 && label[i]; i++) {
+        h = (h ^ (uint8_t)label[i]) * 16777619u;
+    }
+    return h;
+}
+
+// Probe for label; returns its id, or -1 with `slot` at the empty slot ending the chain.
+static int32_t findLabel(const LabelTable& t, const char* label, uint32_t hash, uint32_t& slot)
+{
+    for (uint32_t i = 0; i < kLabelSlots; i++) {
+        slot = (hash + i) & (kLabelSlots - 1);
+        const int32_t s = t.slots[slot].load(std::memory_order_acquire);
+        if (s == 0) return -1;
+        if (std::strncmp(t.text[s - 1], label, kLabelChars - 1) == 0) return s - 1;
+    }
+    slot = kLabelSlots;
+    return -1;
+}
+
+int32_t upfProfilerInternLabel(const char* label)
+{
+    if (!label) label = "";
+    LabelTable& t = labels();
+    const uint32_t hash = hashLabel(label);
+    uint32_t slot = 0;
+    int32_t id = findLabel(t, label, hash, slot);
+    if (id >= 0) return id;
+
+    std::lock_guard<std::mutex> lock(t.insertMtx);
+    id = findLabel(t, label, hash, slot);
+    if (id >= 0) return id;
+    const int32_t count = t.count.load(std::memory_order_relaxed);
+    if (count >= kMaxLabels || slot >= kLabelSlots) return -1;
+
+    std::strncpy(t.text[count], label, kLabelChars - 1);
+    t.text[count][kLabelChars - 1] = '\0';
+    t.count.store(count + 1, std::memory_order_release);
+    t.slots[slot].store(count + 1, std::memory_order_release);
+    return count;
+}
+
+const char* upfProfilerLabel(int32_t labelId)
+{
+    const LabelTable& t = labels();
+    if (labelId < 0 || labelId >= t.count.load(std::memory_order_acquire)) return nullptr;
+    return t.text[labelId];
+}
+
+bool upfProfilerPush(const UpfProfilerEntry& entry)
+{
+    return ring().push(entry);
+}
+
+int32_t upfProfilerRead(UpfProfilerEntry* dst, int32_t maxEntries)
+{
+    if (!dst || maxEntries <= 0) return 0;
+    return ring().popMany(dst, maxEntries);
+}
+
+int64_t upfProfilerTakeDropped()
+{
+    return ring().takeDropped();
+}
+
+void upfProfilerClear()
+{
+    ring().clear();
+}
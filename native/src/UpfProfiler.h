@@ -0,0 +1,29 @@
+#pragma once
+
+// Flow profiler captures as fixed-size records. Labels are interned once into
+// a process-wide table; entries go into a bounded lock-free ring that Unity
+// drains with Upf_ReadProfilerEntries. Nothing allocates after warm-up.
+
+#include "../include/UnityPhysXFlow.h"
+
+#include <stdint.h>
+
+// Id of a label, interning it on first use (truncated to 63 chars).
+// Returns -1 once the table is full.
+int32_t upfProfilerInternLabel(const char* label);
+
+// Interned label text, or null for an unknown id. Valid for the process lifetime.
+const char* upfProfilerLabel(int32_t labelId);
+
+// Append one record; safe from any thread. Returns false (and counts a drop)
+// if the ring is full.
+bool upfProfilerPush(const UpfProfilerEntry& entry);
+
+// Pop up to maxEntries records, oldest first. Returns the number written.
+int32_t upfProfilerRead(UpfProfilerEntry* dst, int32_t maxEntries);
+
+// Records dropped because the ring was full since the last call.
+int64_t upfProfilerTakeDropped();
+
+// Discard all queued records (labels are kept).
+void upfProfilerClear();
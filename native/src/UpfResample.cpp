@@ -0,0 +1,95 @@
+#include "UpfResample.h"
+
+#include <algorithm>
+#include <cmath>
+
+static UpfResampleAxis makeAxis(int srcN, int dstN, float scale, bool box)
+{
+    UpfResampleAxis a;
+    a.offset = 0.5f * ((float)srcN - (float)dstN * scale);
+    a.scale = scale;
+    a.first.resize(dstN);
+    a.count.resize(dstN);
+    a.weight.resize(dstN);
+    // Source cell j spans [j, j + 1)
+    for (int i = 0; i < dstN; i++) {
+        const float lo = a.offset + (float)i * scale;
+        if (box) {
+            const int j0 = std::max(0, (int)std::ceil(lo - 0.5f));
+            const int j1 = std::min(srcN, (int)std::ceil(lo + scale - 0.5f));
+            a.first[i] = std::min(j0, srcN - 1);
+            a.count[i] = std::max(0, j1 - j0);
+            a.weight[i] = 1.0f / scale;
+        } else {
+            const float c = std::min(std::max(lo + 0.5f * scale - 0.5f, 0.0f), (float)(srcN - 1));
+            const int j = std::min((int)c, srcN - 1);
+            a.first[i] = j;
+            a.count[i] = j + 1 < srcN ? 2 : 1;
+            a.weight[i] = c - (float)j;
+        }
+    }
+    return a;
+}
+
+UpfResampler upfMakeResampler(int srcX, int srcY, int srcZ, float srcCellSize,
+                              int dstX, int dstY, int dstZ, float dstCellSize)
+{
+    UpfResampler r;
+    r.srcX = srcX; r.srcY = srcY; r.srcZ = srcZ;
+    r.dstX = dstX; r.dstY = dstY; r.dstZ = dstZ;
+    const float scale = dstCellSize / srcCellSize;
+    r.box = scale > 1.0f;
+    r.x = makeAxis(srcX, dstX, scale, r.box);
+    r.y = makeAxis(srcY, dstY, scale, r.box);
+    r.z = makeAxis(srcZ, dstZ, scale, r.box);
+    return r;
+}
+
+void upfResampleFootprint(const UpfResampleAxis& a, int lo, int hi, int& outLo, int& outHi)
+{
+    // Widened by a source cell for the trilinear taps reaching across
+    const int n = (int)a.first.size();
+    outLo = std::max(0, (int)std::floor(((float)lo - 1.0f - a.offset) / a.scale));
+    outHi = std::min(n, (int)std::ceil(((float)hi + 1.0f - a.offset) / a.scale));
+}
+
+void upfResampleBox(const UpfResampler& r, const float* src, float* dst,
+                    int x0, int x1, int y0, int y1, int z0, int z1)
+{
+    const size_t sX = (size_t)r.srcX, sXY = (size_t)r.srcX * r.srcY;
+    const int dX = r.dstX, dY = r.dstY;
+
+    for (int z = z0; z < z1; z++) {
+        for (int y = y0; y < y1; y++) {
+            float* out = dst + (size_t)y * dX + (size_t)z * dX * dY;
+            if (r.box) {
+                const float wyz = r.y.weight[y] * r.z.weight[z];
+                for (int x = x0; x < x1; x++) {
+                    float sum = 0.0f;
+                    for (int k = r.z.first[z]; k < r.z.first[z] + r.z.count[z]; k++) {
+                        for (int j = r.y.first[y]; j < r.y.first[y] + r.y.count[y]; j++) {
+                            const float* row = src + (size_t)j * sX + (size_t)k * sXY;
+                            for (int i = r.x.first[x]; i < r.x.first[x] + r.x.count[x]; i++) sum += row[i];
+                        }
+                    }
+                    out[x] = sum * r.x.weight[x] * wyz;
+                }
+            } else {
+                const size_t zA = (size_t)r.z.first[z] * sXY;
+                const size_t zB = r.z.count[z] > 1 ? zA + sXY : zA;
+                const size_t yA = (size_t)r.y.first[y] * sX;
+                const size_t yB = r.y.count[y] > 1 ? yA + sX : yA;
+                const float fy = r.y.weight[y], fz = r.z.weight[z];
+                for (int x = x0; x < x1; x++) {
+                    const size_t xA = (size_t)r.x.first[x];
+                    const size_t xB = r.x.count[x] > 1 ? xA + 1 : xA;
+                    const float fx = r.x.weight[x];
+                    auto lerpX = [&](size_t row) { return src[row + xA] + fx * (src[row + xB] - src[row + xA]); };
+                    const float c0 = lerpX(yA + zA) + fy * (lerpX(yB + zA) - lerpX(yA + zA));
+                    const float c1 = lerpX(yA + zB) + fy * (lerpX(yB + zB) - lerpX(yA + zB));
+                    out[x] = c0 + fz * (c1 - c0);
+                }
+            }
+        }
+    }
+}
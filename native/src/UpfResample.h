@@ -0,0 +1,37 @@
+#pragma once
+
+// Resampling a grid's fields onto another resolution (Upf_SetGridLod). Both
+// grids are centered on the origin; a destination cell with larger cells than
+// the source averages the source cells whose centers it covers (a box filter,
+// so density is conserved), one with smaller or equal cells is interpolated
+// trilinearly, clamped at the source's edge.
+
+#include <vector>
+
+// Source taps of each destination cell along one axis. Destination cell i
+// spans [offset + i * scale, offset + (i + 1) * scale) in source cells.
+struct UpfResampleAxis {
+    float offset, scale;
+    std::vector<int> first;     // first source cell
+    std::vector<int> count;     // box: source cells from first (0 past the source); trilinear: 1 or 2
+    std::vector<float> weight;  // box: 1 / cells per destination cell; trilinear: weight of the second tap
+};
+
+struct UpfResampler {
+    int srcX, srcY, srcZ;
+    int dstX, dstY, dstZ;
+    bool box;
+    UpfResampleAxis x, y, z;
+};
+
+UpfResampler upfMakeResampler(int srcX, int srcY, int srcZ, float srcCellSize,
+                              int dstX, int dstY, int dstZ, float dstCellSize);
+
+// Destination cells [outLo, outHi) along an axis whose taps may read source
+// cells [lo, hi).
+void upfResampleFootprint(const UpfResampleAxis& a, int lo, int hi, int& outLo, int& outHi);
+
+// Write destination cells [x0, x1) x [y0, y1) x [z0, z1) of dst from src.
+// Callers split a grid into boxes to spread it across threads.
+void upfResampleBox(const UpfResampler& r, const float* src, float* dst,
+                    int x0, int x1, int y0, int y1, int z0, int z1);
@@ -0,0 +1,95 @@
+#pragma once
+
+// Bounded lock-free queue of POD records (Vyukov's MPMC design): each cell's
+// sequence number says whether it is free for the next producer or holds a
+// record for the next reader, so threads only contend on a position counter.
+// Producers never block; a push into a full ring is dropped and counted.
+
+#include <atomic>
+#include <stdint.h>
+
+template <typename T, uint64_t Capacity>
+class UpfRing {
+    static_assert((Capacity & (Capacity - 1)) == 0, "UpfRing capacity must be a power of two");
+    static constexpr uint64_t kMask = Capacity - 1;
+
+public:
+    UpfRing()
+    {
+        for (uint64_t i = 0; i < Capacity; i++) cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    UpfRing(const UpfRing&) = delete;
+    UpfRing& operator=(const UpfRing&) = delete;
+
+    bool push(const T& value)
+    {
+        uint64_t pos = enqueuePos_.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells_[pos & kMask];
+            const uint64_t seq = cell.sequence.load(std::memory_order_acquire);
+            const int64_t diff = (int64_t)(seq - pos);
+            if (diff == 0) {
+                if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = value;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool pop(T& out)
+    {
+        uint64_t pos = dequeuePos_.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells_[pos & kMask];
+            const uint64_t seq = cell.sequence.load(std::memory_order_acquire);
+            const int64_t diff = (int64_t)(seq - (pos + 1));
+            if (diff == 0) {
+                if (dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    out = cell.value;
+                    cell.sequence.store(pos + Capacity, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeuePos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Pop up to maxCount records, oldest first. Returns the number written.
+    int32_t popMany(T* dst, int32_t maxCount)
+    {
+        int32_t n = 0;
+        while (n < maxCount && pop(dst[n])) n++;
+        return n;
+    }
+
+    // Pushes dropped because the ring was full since the last call.
+    int64_t takeDropped() { return dropped_.exchange(0, std::memory_order_relaxed); }
+
+    void clear()
+    {
+        T discard;
+        while (pop(discard)) {}
+        dropped_.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    struct Cell {
+        std::atomic<uint64_t> sequence;
+        T value;
+    };
+    Cell cells_[Capacity];
+    alignas(64) std::atomic<uint64_t> enqueuePos_{0};
+    alignas(64) std::atomic<uint64_t> dequeuePos_{0};
+    std::atomic<int64_t> dropped_{0};
+};
@@ -0,0 +1,203 @@
+#include "UpfSample.h"
+
+#include <algorithm>
+
+// Points per parallel chunk; smaller batches stay on the calling thread
+static constexpr int32_t kSampleChunk = 2048;
+
+// Cell offsets to the +x, +y and +z corners (0 along axes one cell thick)
+// and the index of the grid's last cell.
+struct SampleStrides {
+    int dx, dy, dz, last;
+    explicit SampleStrides(const UpfSampleSource& src)
+        : dx(src.sizeX > 1 ? 1 : 0),
+          dy(src.sizeY > 1 ? src.sizeX : 0),
+          dz(src.sizeZ > 1 ? src.sizeX * src.sizeY : 0),
+          last(src.sizeX * src.sizeY * src.sizeZ - 1) {}
+};
+
+static inline float lerp(float a, float b, float t)
+{
+    return a + (b - a) * t;
+}
+
+// Lower corner and weight along one axis for grid coordinate g (in cells from
+// the center of cell 0), clamped so both corners are inside the grid.
+static inline int corner(float g, int n, float& frac)
+{
+    g = std::max(0.0f, std::min(g, (float)(n - 1)));
+    const int i = std::min((int)g, std::max(n - 2, 0));
+    frac = g - (float)i;
+    return i;
+}
+
+static inline bool inside(float g, int n)
+{
+    return g >= -0.5f && g < (float)n - 0.5f;
+}
+
+static void sampleScalar(const UpfSampleSource& src, const float* points, float* out, int32_t count)
+{
+    const SampleStrides s(src);
+    for (int32_t p = 0; p < count; p++) {
+        const float gx = (points[p * 3 + 0] - src.cell0[0]) * src.invCellSize;
+        const float gy = (points[p * 3 + 1] - src.cell0[1]) * src.invCellSize;
+        const float gz = (points[p * 3 + 2] - src.cell0[2]) * src.invCellSize;
+        float* o = out + (size_t)p * 4;
+        if (!inside(gx, src.sizeX) || !inside(gy, src.sizeY) || !inside(gz, src.sizeZ)) {
+            o[0] = o[1] = o[2] = o[3] = 0.0f;
+            continue;
+        }
+        float fx, fy, fz;
+        const int i = corner(gx, src.sizeX, fx) + corner(gy, src.sizeY, fy) * src.sizeX +
+                      corner(gz, src.sizeZ, fz) * src.sizeX * src.sizeY;
+        auto trilinear = [&](const float* v, int stride) {
+            auto at = [&](int c) { return v[(size_t)c * stride]; };
+            const float c00 = lerp(at(i), at(i + s.dx), fx);
+            const float c10 = lerp(at(i + s.dy), at(i + s.dy + s.dx), fx);
+            const float c01 = lerp(at(i + s.dz), at(i + s.dz + s.dx), fx);
+            const float c11 = lerp(at(i + s.dz + s.dy), at(i + s.dz + s.dy + s.dx), fx);
+            return lerp(lerp(c00, c10, fy), lerp(c01, c11, fy), fz);
+        };
+        o[0] = trilinear(src.velocity + 0, 3);
+        o[1] = trilinear(src.velocity + 1, 3);
+        o[2] = trilinear(src.velocity + 2, 3);
+        o[3] = trilinear(src.density, 1);
+    }
+}
+
+#ifdef UPF_X86
+
+// The SIMD samplers keep one point's (vx, vy, vz, density) in a 128-bit
+// lane group, so each corner is one fetch and the trilinear blend covers
+// all four channels at once.
+
+// Lower corner cell, per-axis weights (x, y, z, -) and whether the point is
+// inside the grid.
+struct SampleCorner {
+    int cell;
+    __m128 frac;
+    bool inside;
+};
+
+UPF_TARGET_SSE41 static inline SampleCorner cornerSse(const UpfSampleSource& src, const float* point)
+{
+    const __m128 p = _mm_movelh_ps(_mm_castpd_ps(_mm_load_sd((const double*)point)), _mm_load_ss(point + 2));
+    const __m128 g = _mm_mul_ps(_mm_sub_ps(p, _mm_setr_ps(src.cell0[0], src.cell0[1], src.cell0[2], 0.0f)),
+                                _mm_set1_ps(src.invCellSize));
+    const __m128 n = _mm_cvtepi32_ps(_mm_setr_epi32(src.sizeX, src.sizeY, src.sizeZ, 1));
+    const __m128 in = _mm_and_ps(_mm_cmpge_ps(g, _mm_set1_ps(-0.5f)), _mm_cmplt_ps(g, _mm_sub_ps(n, _mm_set1_ps(0.5f))));
+    const __m128 gc = _mm_max_ps(_mm_setzero_ps(), _mm_min_ps(g, _mm_sub_ps(n, _mm_set1_ps(1.0f))));
+    const __m128i cap = _mm_max_epi32(_mm_sub_epi32(_mm_cvtps_epi32(n), _mm_set1_epi32(2)), _mm_setzero_si128());
+    const __m128i i = _mm_min_epi32(_mm_cvttps_epi32(gc), cap);
+    const __m128i cell = _mm_mullo_epi32(i, _mm_setr_epi32(1, src.sizeX, src.sizeX * src.sizeY, 0));
+    SampleCorner c;
+    c.cell = _mm_cvtsi128_si32(cell) + _mm_extract_epi32(cell, 1) + _mm_extract_epi32(cell, 2);
+    c.frac = _mm_sub_ps(gc, _mm_cvtepi32_ps(i));
+    c.inside = (_mm_movemask_ps(in) & 7) == 7;
+    return c;
+}
+
+// (vx, vy, vz, density) of one cell. The velocity load runs one float past
+// the cell, so the last cell of the grid takes the narrow loads.
+UPF_TARGET_SSE41 static inline __m128 fetchSse(const UpfSampleSource& src, int cell, int lastCell)
+{
+    const float* v = src.velocity + (size_t)cell * 3;
+    __m128 r;
+    if (cell < lastCell) {
+        r = _mm_loadu_ps(v);
+    } else {
+        r = _mm_castpd_ps(_mm_load_sd((const double*)v));
+        r = _mm_insert_ps(r, _mm_load_ss(v + 2), 0x20);
+    }
+    return _mm_insert_ps(r, _mm_load_ss(src.density + cell), 0x30);
+}
+
+UPF_TARGET_SSE41 static inline __m128 lerpSse(__m128 a, __m128 b, __m128 t)
+{
+    return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+}
+
+UPF_TARGET_SSE41 static void sampleSse41(const UpfSampleSource& src, const float* points, float* out, int32_t count)
+{
+    const SampleStrides s(src);
+    for (int32_t p = 0; p < count; p++) {
+        const SampleCorner c = cornerSse(src, points + (size_t)p * 3);
+        const __m128 fx = _mm_shuffle_ps(c.frac, c.frac, _MM_SHUFFLE(0, 0, 0, 0));
+        const __m128 fy = _mm_shuffle_ps(c.frac, c.frac, _MM_SHUFFLE(1, 1, 1, 1));
+        const __m128 fz = _mm_shuffle_ps(c.frac, c.frac, _MM_SHUFFLE(2, 2, 2, 2));
+        const int i = c.cell;
+        const __m128 c00 = lerpSse(fetchSse(src, i, s.last), fetchSse(src, i + s.dx, s.last), fx);
+        const __m128 c10 = lerpSse(fetchSse(src, i + s.dy, s.last), fetchSse(src, i + s.dy + s.dx, s.last), fx);
+        const __m128 c01 = lerpSse(fetchSse(src, i + s.dz, s.last), fetchSse(src, i + s.dz + s.dx, s.last), fx);
+        const __m128 c11 = lerpSse(fetchSse(src, i + s.dz + s.dy, s.last), fetchSse(src, i + s.dz + s.dy + s.dx, s.last), fx);
+        const __m128 v = lerpSse(lerpSse(c00, c10, fy), lerpSse(c01, c11, fy), fz);
+        _mm_storeu_ps(out + (size_t)p * 4, c.inside ? v : _mm_setzero_ps());
+    }
+}
+
+// --- AVX2: two points per iteration, one per 128-bit half, blended with FMA ---
+
+UPF_TARGET_AVX2 static inline __m256 fetchPairAvx2(const UpfSampleSource& src, int a, int b, int last)
+{
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(fetchSse(src, a, last)), fetchSse(src, b, last), 1);
+}
+
+UPF_TARGET_AVX2 static inline __m256 lerpAvx2(__m256 a, __m256 b, __m256 t)
+{
+    return _mm256_fmadd_ps(_mm256_sub_ps(b, a), t, a);
+}
+
+// Weight k of both points, broadcast across each half
+UPF_TARGET_AVX2 static inline __m256 weightAvx2(__m256 frac, int k)
+{
+    return _mm256_permutevar_ps(frac, _mm256_set1_epi32(k));
+}
+
+UPF_TARGET_AVX2 static void sampleAvx2(const UpfSampleSource& src, const float* points, float* out, int32_t count)
+{
+    const SampleStrides s(src);
+    int32_t p = 0;
+    for (; p + 2 <= count; p += 2) {
+        const SampleCorner a = cornerSse(src, points + (size_t)p * 3);
+        const SampleCorner b = cornerSse(src, points + (size_t)p * 3 + 3);
+        const __m256 frac = _mm256_insertf128_ps(_mm256_castps128_ps256(a.frac), b.frac, 1);
+        const __m256 fx = weightAvx2(frac, 0), fy = weightAvx2(frac, 1), fz = weightAvx2(frac, 2);
+        const int i = a.cell, j = b.cell;
+        const __m256 c00 = lerpAvx2(fetchPairAvx2(src, i, j, s.last), fetchPairAvx2(src, i + s.dx, j + s.dx, s.last), fx);
+        const __m256 c10 = lerpAvx2(fetchPairAvx2(src, i + s.dy, j + s.dy, s.last),
+                                    fetchPairAvx2(src, i + s.dy + s.dx, j + s.dy + s.dx, s.last), fx);
+        const __m256 c01 = lerpAvx2(fetchPairAvx2(src, i + s.dz, j + s.dz, s.last),
+                                    fetchPairAvx2(src, i + s.dz + s.dx, j + s.dz + s.dx, s.last), fx);
+        const __m256 c11 = lerpAvx2(fetchPairAvx2(src, i + s.dz + s.dy, j + s.dz + s.dy, s.last),
+                                    fetchPairAvx2(src, i + s.dz + s.dy + s.dx, j + s.dz + s.dy + s.dx, s.last), fx);
+        const __m256 v = lerpAvx2(lerpAvx2(c00, c10, fy), lerpAvx2(c01, c11, fy), fz);
+        const __m256 keep = _mm256_castsi256_ps(_mm256_setr_epi32(-a.inside, -a.inside, -a.inside, -a.inside,
+                                                                  -b.inside, -b.inside, -b.inside, -b.inside));
+        _mm256_storeu_ps(out + (size_t)p * 4, _mm256_and_ps(v, keep));
+    }
+    sampleSse41(src, points + (size_t)p * 3, out + (size_t)p * 4, count - p);
+}
+
+#endif // UPF_X86
+
+UpfSampleFn upfSelectSampler(UpfSimdLevel level)
+{
+    level = std::min(level, upfDetectSimdLevel());
+#ifdef UPF_X86
+    if (level >= UpfSimd_AVX2) return sampleAvx2;
+    if (level >= UpfSimd_SSE41) return sampleSse41;
+#endif
+    return sampleScalar;
+}
+
+void upfSampleGrid(const UpfSampleSource& src, const float* points, float* out, int32_t count, UpfSimdLevel level)
+{
+    const UpfSampleFn sample = upfSelectSampler(level);
+    const int numChunks = (int)((count + kSampleChunk - 1) / kSampleChunk);
+    #pragma omp parallel for schedule(static) if(numChunks > 4)
+    for (int c = 0; c < numChunks; c++) {
+        const int32_t begin = c * kSampleChunk, end = std::min(count, begin + kSampleChunk);
+        sample(src, points + (size_t)begin * 3, out + (size_t)begin * 4, end - begin);
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+// Batched point queries against a published grid snapshot (Upf_SampleGrid):
+// velocity and density at arbitrary world positions, for gameplay systems
+// (cloth, foliage, projectiles, audio) that don't need the whole grid.
+
+#include "UpfSimd.h"
+
+#include <stdint.h>
+
+// A snapshot's fields and where they sit.
+struct UpfSampleSource {
+    int sizeX, sizeY, sizeZ;
+    float invCellSize;
+    float cell0[3];         // world position of the center of cell (0, 0, 0)
+    const float* density;   // one float per cell
+    const float* velocity;  // 3 floats per cell (vx, vy, vz)
+};
+
+// Sample count points (3 floats each) into out (4 floats each: vx, vy, vz,
+// density). Fields are interpolated trilinearly, clamped to the outermost
+// cell centers; points outside the grid read zero.
+typedef void (*UpfSampleFn)(const UpfSampleSource& src, const float* points, float* out, int32_t count);
+
+// Sampler for a SIMD level; levels above what the CPU supports fall back.
+UpfSampleFn upfSelectSampler(UpfSimdLevel level);
+
+// As UpfSampleFn, with large batches split across threads.
+void upfSampleGrid(const UpfSampleSource& src, const float* points, float* out, int32_t count, UpfSimdLevel level);
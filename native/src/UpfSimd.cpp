@@ -0,0 +1,48 @@
+#include "UpfSimd.h"
+
+#if defined(UPF_X86) && !defined(_MSC_VER)
+#include <cpuid.h>
+#endif
+
+#ifdef UPF_X86
+
+static UpfSimdLevel detectSimdLevelUncached()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    const int maxLeaf = info[0];
+    __cpuid(info, 1);
+    const bool sse41 = (info[2] & (1 << 19)) != 0;
+    const bool fma = (info[2] & (1 << 12)) != 0;
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    const bool f16c = (info[2] & (1 << 29)) != 0;
+    bool avx2 = false;
+    if (maxLeaf >= 7 && osxsave && avx && fma && f16c && (_xgetbv(0) & 6) == 6) {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+    }
+#else
+    __builtin_cpu_init();
+    const bool sse41 = __builtin_cpu_supports("sse4.1");
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    const bool f16c = __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & (1u << 29)) != 0;
+    const bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && f16c;
+#endif
+    if (avx2) return UpfSimd_AVX2;
+    if (sse41) return UpfSimd_SSE41;
+    return UpfSimd_Scalar;
+}
+
+#endif // UPF_X86
+
+UpfSimdLevel upfDetectSimdLevel()
+{
+#ifdef UPF_X86
+    static const UpfSimdLevel level = detectSimdLevelUncached();
+    return level;
+#else
+    return UpfSimd_Scalar;
+#endif
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+// SIMD levels for the bridge's CPU kernels, runtime detection, and the
+// per-function target attributes the kernels are compiled with.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define UPF_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC allows intrinsics of any level in any function; GCC/Clang need the
+// target enabled per function so the rest of the TU stays baseline x86-64.
+#if defined(UPF_X86) && !defined(_MSC_VER)
+#define UPF_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define UPF_TARGET_AVX2 __attribute__((target("avx2,fma,f16c")))
+#else
+#define UPF_TARGET_SSE41
+#define UPF_TARGET_AVX2
+#endif
+
+enum UpfSimdLevel {
+    UpfSimd_Scalar = 0,
+    UpfSimd_SSE41 = 1,
+    UpfSimd_AVX2 = 2,   // AVX2 + FMA + F16C
+};
+
+// Highest level supported by this CPU and OS (detected once).
+UpfSimdLevel upfDetectSimdLevel();
@@ -0,0 +1,301 @@
+#include "UpfTracers.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Tracers per parallel chunk
+static constexpr int32_t kTracerChunk = 4096;
+
+void UpfTracerPool::resize(size_t n)
+{
+    x.resize(n);
+    y.resize(n);
+    z.resize(n);
+    age.resize(n);
+    life.resize(n);
+}
+
+static inline float lerp(float a, float b, float t)
+{
+    return a + (b - a) * t;
+}
+
+// Cell offsets to the +x, +y and +z corners; 0 along axes one cell thick, so
+// both corners are the same cell there.
+struct TracerStrides {
+    int dx, dy, dz;
+    explicit TracerStrides(const UpfTracerField& f)
+        : dx(f.sizeX > 1 ? 1 : 0),
+          dy(f.sizeY > 1 ? f.sizeX : 0),
+          dz(f.sizeZ > 1 ? f.sizeX * f.sizeY : 0) {}
+};
+
+// Lower corner and weights of the cell around grid coordinate g (in cells
+// from the center of cell 0), clamped so both corners are inside the grid.
+static inline int corner(float g, int n, float& frac)
+{
+    g = std::max(0.0f, std::min(g, (float)(n - 1)));
+    const int i = std::min((int)g, std::max(n - 2, 0));
+    frac = g - (float)i;
+    return i;
+}
+
+static inline void sampleScalar(const UpfTracerField& f, float px, float py, float pz, float& vx, float& vy, float& vz)
+{
+    const TracerStrides s(f);
+    float fx, fy, fz;
+    const int ix = corner((px - f.cell0[0]) * f.invCellSize, f.sizeX, fx);
+    const int iy = corner((py - f.cell0[1]) * f.invCellSize, f.sizeY, fy);
+    const int iz = corner((pz - f.cell0[2]) * f.invCellSize, f.sizeZ, fz);
+    const int i = ix + iy * f.sizeX + iz * f.sizeX * f.sizeY;
+    auto trilinear = [&](const float* v) {
+        const float c00 = lerp(v[i], v[i + s.dx], fx);
+        const float c10 = lerp(v[i + s.dy], v[i + s.dy + s.dx], fx);
+        const float c01 = lerp(v[i + s.dz], v[i + s.dz + s.dx], fx);
+        const float c11 = lerp(v[i + s.dz + s.dy], v[i + s.dz + s.dy + s.dx], fx);
+        return lerp(lerp(c00, c10, fy), lerp(c01, c11, fy), fz);
+    };
+    vx = trilinear(f.vx);
+    vy = trilinear(f.vy);
+    vz = trilinear(f.vz);
+}
+
+static void stepScalar(const UpfTracerField& f, float* x, float* y, float* z, int32_t count, float dt)
+{
+    const float halfDt = 0.5f * dt;
+    for (int32_t i = 0; i < count; i++) {
+        float vx, vy, vz;
+        sampleScalar(f, x[i], y[i], z[i], vx, vy, vz);
+        sampleScalar(f, x[i] + vx * halfDt, y[i] + vy * halfDt, z[i] + vz * halfDt, vx, vy, vz);
+        x[i] += vx * dt;
+        y[i] += vy * dt;
+        z[i] += vz * dt;
+    }
+}
+
+#ifdef UPF_X86
+
+// --- SSE4.1: 4 tracers per iteration, corners fetched with scalar loads ---
+
+UPF_TARGET_SSE41 static inline __m128 lerpSse(__m128 a, __m128 b, __m128 t)
+{
+    return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+}
+
+UPF_TARGET_SSE41 static inline __m128 fetchSse(const float* f, const int* i)
+{
+    return _mm_setr_ps(f[i[0]], f[i[1]], f[i[2]], f[i[3]]);
+}
+
+UPF_TARGET_SSE41 static inline __m128 trilinearSse(const float* f, const int* i000, const TracerStrides& s, __m128 fx, __m128 fy, __m128 fz)
+{
+    const __m128 c00 = lerpSse(fetchSse(f, i000), fetchSse(f + s.dx, i000), fx);
+    const __m128 c10 = lerpSse(fetchSse(f + s.dy, i000), fetchSse(f + s.dy + s.dx, i000), fx);
+    const __m128 c01 = lerpSse(fetchSse(f + s.dz, i000), fetchSse(f + s.dz + s.dx, i000), fx);
+    const __m128 c11 = lerpSse(fetchSse(f + s.dz + s.dy, i000), fetchSse(f + s.dz + s.dy + s.dx, i000), fx);
+    return lerpSse(lerpSse(c00, c10, fy), lerpSse(c01, c11, fy), fz);
+}
+
+UPF_TARGET_SSE41 static inline __m128i cornerSse(__m128 p, float origin, __m128 invCs, int n, __m128& frac)
+{
+    __m128 g = _mm_mul_ps(_mm_sub_ps(p, _mm_set1_ps(origin)), invCs);
+    g = _mm_max_ps(_mm_setzero_ps(), _mm_min_ps(g, _mm_set1_ps((float)(n - 1))));
+    const __m128i i = _mm_min_epi32(_mm_cvttps_epi32(g), _mm_set1_epi32(std::max(n - 2, 0)));
+    frac = _mm_sub_ps(g, _mm_cvtepi32_ps(i));
+    return i;
+}
+
+UPF_TARGET_SSE41 static inline void sampleSse(const UpfTracerField& f, __m128 px, __m128 py, __m128 pz,
+                                              __m128& vx, __m128& vy, __m128& vz)
+{
+    const TracerStrides s(f);
+    const int sX = f.sizeX, sXY = f.sizeX * f.sizeY;
+    const __m128 invCs = _mm_set1_ps(f.invCellSize);
+    __m128 fx, fy, fz;
+    const __m128i ix = cornerSse(px, f.cell0[0], invCs, f.sizeX, fx);
+    const __m128i iy = cornerSse(py, f.cell0[1], invCs, f.sizeY, fy);
+    const __m128i iz = cornerSse(pz, f.cell0[2], invCs, f.sizeZ, fz);
+    const __m128i i000 = _mm_add_epi32(ix, _mm_add_epi32(_mm_mullo_epi32(iy, _mm_set1_epi32(sX)),
+                                                         _mm_mullo_epi32(iz, _mm_set1_epi32(sXY))));
+    alignas(16) int idx[4];
+    _mm_store_si128((__m128i*)idx, i000);
+    vx = trilinearSse(f.vx, idx, s, fx, fy, fz);
+    vy = trilinearSse(f.vy, idx, s, fx, fy, fz);
+    vz = trilinearSse(f.vz, idx, s, fx, fy, fz);
+}
+
+UPF_TARGET_SSE41 static void stepSse41(const UpfTracerField& f, float* x, float* y, float* z, int32_t count, float dt)
+{
+    const __m128 vdt = _mm_set1_ps(dt);
+    const __m128 halfDt = _mm_set1_ps(0.5f * dt);
+    int32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i), pz = _mm_loadu_ps(z + i);
+        __m128 vx, vy, vz;
+        sampleSse(f, px, py, pz, vx, vy, vz);
+        sampleSse(f, _mm_add_ps(px, _mm_mul_ps(vx, halfDt)), _mm_add_ps(py, _mm_mul_ps(vy, halfDt)),
+                  _mm_add_ps(pz, _mm_mul_ps(vz, halfDt)), vx, vy, vz);
+        _mm_storeu_ps(x + i, _mm_add_ps(px, _mm_mul_ps(vx, vdt)));
+        _mm_storeu_ps(y + i, _mm_add_ps(py, _mm_mul_ps(vy, vdt)));
+        _mm_storeu_ps(z + i, _mm_add_ps(pz, _mm_mul_ps(vz, vdt)));
+    }
+    stepScalar(f, x + i, y + i, z + i, count - i, dt);
+}
+
+// --- AVX2: 8 tracers per iteration with hardware gathers ---
+
+UPF_TARGET_AVX2 static inline __m256 lerpAvx2(__m256 a, __m256 b, __m256 t)
+{
+    return _mm256_fmadd_ps(_mm256_sub_ps(b, a), t, a);
+}
+
+// Both x corners of row offset r for 8 tracers: two gathers of 64-bit pairs,
+// split into the low and high corner. i000 must be in pairOrder.
+UPF_TARGET_AVX2 static inline void pairAvx2(const float* f, __m256i i000, int r, __m256& lo, __m256& hi)
+{
+    const float* base = f + r;
+    const __m256 a = _mm256_castsi256_ps(_mm256_i32gather_epi64((const long long*)base, _mm256_castsi256_si128(i000), 4));
+    const __m256 b = _mm256_castsi256_ps(_mm256_i32gather_epi64((const long long*)base, _mm256_extracti128_si256(i000, 1), 4));
+    lo = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+    hi = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+}
+
+// The splits above interleave the two gathers' lanes per 128-bit half, so
+// gathering in this order hands the corners back in tracer order.
+UPF_TARGET_AVX2 static inline __m256i pairOrder(__m256i i)
+{
+    return _mm256_permutevar8x32_epi32(i, _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7));
+}
+
+UPF_TARGET_AVX2 static inline __m256 trilinearAvx2(const float* f, __m256i i000, const TracerStrides& s, __m256 fx, __m256 fy, __m256 fz)
+{
+    __m256 a, b;
+    pairAvx2(f, i000, 0, a, b);
+    const __m256 c00 = lerpAvx2(a, b, fx);
+    pairAvx2(f, i000, s.dy, a, b);
+    const __m256 c10 = lerpAvx2(a, b, fx);
+    pairAvx2(f, i000, s.dz, a, b);
+    const __m256 c01 = lerpAvx2(a, b, fx);
+    pairAvx2(f, i000, s.dz + s.dy, a, b);
+    const __m256 c11 = lerpAvx2(a, b, fx);
+    return lerpAvx2(lerpAvx2(c00, c10, fy), lerpAvx2(c01, c11, fy), fz);
+}
+
+UPF_TARGET_AVX2 static inline __m256i cornerAvx2(__m256 p, float origin, __m256 invCs, int n, __m256& frac)
+{
+    __m256 g = _mm256_mul_ps(_mm256_sub_ps(p, _mm256_set1_ps(origin)), invCs);
+    g = _mm256_max_ps(_mm256_setzero_ps(), _mm256_min_ps(g, _mm256_set1_ps((float)(n - 1))));
+    const __m256i i = _mm256_min_epi32(_mm256_cvttps_epi32(g), _mm256_set1_epi32(std::max(n - 2, 0)));
+    frac = _mm256_sub_ps(g, _mm256_cvtepi32_ps(i));
+    return i;
+}
+
+UPF_TARGET_AVX2 static inline void sampleAvx2(const UpfTracerField& f, __m256 px, __m256 py, __m256 pz,
+                                              __m256& vx, __m256& vy, __m256& vz)
+{
+    const TracerStrides s(f);
+    const int sX = f.sizeX, sXY = f.sizeX * f.sizeY;
+    const __m256 invCs = _mm256_set1_ps(f.invCellSize);
+    __m256 fx, fy, fz;
+    const __m256i ix = cornerAvx2(px, f.cell0[0], invCs, f.sizeX, fx);
+    const __m256i iy = cornerAvx2(py, f.cell0[1], invCs, f.sizeY, fy);
+    const __m256i iz = cornerAvx2(pz, f.cell0[2], invCs, f.sizeZ, fz);
+    const __m256i i000 = pairOrder(_mm256_add_epi32(ix, _mm256_add_epi32(_mm256_mullo_epi32(iy, _mm256_set1_epi32(sX)),
+                                                                         _mm256_mullo_epi32(iz, _mm256_set1_epi32(sXY)))));
+    vx = trilinearAvx2(f.vx, i000, s, fx, fy, fz);
+    vy = trilinearAvx2(f.vy, i000, s, fx, fy, fz);
+    vz = trilinearAvx2(f.vz, i000, s, fx, fy, fz);
+}
+
+UPF_TARGET_AVX2 static void stepAvx2(const UpfTracerField& f, float* x, float* y, float* z, int32_t count, float dt)
+{
+    // The pair gathers read an x neighbour, which grids one cell thick in x lack
+    if (f.sizeX < 2) {
+        stepSse41(f, x, y, z, count, dt);
+        return;
+    }
+    const __m256 vdt = _mm256_set1_ps(dt);
+    const __m256 halfDt = _mm256_set1_ps(0.5f * dt);
+    int32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i), pz = _mm256_loadu_ps(z + i);
+        __m256 vx, vy, vz;
+        sampleAvx2(f, px, py, pz, vx, vy, vz);
+        sampleAvx2(f, _mm256_fmadd_ps(vx, halfDt, px), _mm256_fmadd_ps(vy, halfDt, py),
+                   _mm256_fmadd_ps(vz, halfDt, pz), vx, vy, vz);
+        _mm256_storeu_ps(x + i, _mm256_fmadd_ps(vx, vdt, px));
+        _mm256_storeu_ps(y + i, _mm256_fmadd_ps(vy, vdt, py));
+        _mm256_storeu_ps(z + i, _mm256_fmadd_ps(vz, vdt, pz));
+    }
+    stepScalar(f, x + i, y + i, z + i, count - i, dt);
+}
+
+#endif // UPF_X86
+
+UpfTracerStepFn upfSelectTracerStep(UpfSimdLevel level)
+{
+    level = std::min(level, upfDetectSimdLevel());
+#ifdef UPF_X86
+    if (level >= UpfSimd_AVX2) return stepAvx2;
+    if (level >= UpfSimd_SSE41) return stepSse41;
+#endif
+    return stepScalar;
+}
+
+void upfAdvanceTracers(UpfTracerPool& pool, const UpfTracerField& f, float dt, UpfSimdLevel level,
+                       std::vector<float>& packed)
+{
+    const int32_t count = (int32_t)pool.size();
+    const int numChunks = (int)((count + kTracerChunk - 1) / kTracerChunk);
+    const UpfTracerStepFn step = upfSelectTracerStep(level);
+
+    // The grid spans half a cell past the outermost cell centers
+    const int size[3] = { f.sizeX, f.sizeY, f.sizeZ };
+    float lo[3], hi[3];
+    for (int k = 0; k < 3; k++) {
+        lo[k] = f.cell0[k] - 0.5f / f.invCellSize;
+        hi[k] = lo[k] + (float)size[k] / f.invCellSize;
+    }
+
+    packed.resize((size_t)count * 4);
+    std::vector<uint8_t> dead((size_t)count);
+    #pragma omp parallel for schedule(dynamic, 1) if(numChunks > 1)
+    for (int c = 0; c < numChunks; c++) {
+        const int32_t begin = c * kTracerChunk, end = std::min(count, begin + kTracerChunk);
+        float* x = pool.x.data();
+        float* y = pool.y.data();
+        float* z = pool.z.data();
+        step(f, x + begin, y + begin, z + begin, end - begin, dt);
+        for (int32_t i = begin; i < end; i++) {
+            const float age = pool.age[i] + dt;
+            pool.age[i] = age;
+            float* out = packed.data() + (size_t)i * 4;
+            out[0] = x[i];
+            out[1] = y[i];
+            out[2] = z[i];
+            out[3] = age / pool.life[i];
+            dead[i] = age >= pool.life[i] || !(x[i] >= lo[0] && x[i] < hi[0] && y[i] >= lo[1] && y[i] < hi[1] &&
+                                               z[i] >= lo[2] && z[i] < hi[2]);
+        }
+    }
+
+    // Move the last live tracer into each dead one's slot
+    int32_t live = count;
+    for (int32_t i = 0; i < live;) {
+        if (!dead[i]) {
+            i++;
+            continue;
+        }
+        live--;
+        if (i == live) break;
+        pool.x[i] = pool.x[live];
+        pool.y[i] = pool.y[live];
+        pool.z[i] = pool.z[live];
+        pool.age[i] = pool.age[live];
+        pool.life[i] = pool.life[live];
+        std::copy(packed.begin() + (size_t)live * 4, packed.begin() + (size_t)live * 4 + 4, packed.begin() + (size_t)i * 4);
+        dead[i] = dead[live];
+    }
+    pool.resize(live);
+    packed.resize((size_t)live * 4);
+}
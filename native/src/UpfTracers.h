@@ -0,0 +1,44 @@
+#pragma once
+
+// Tracer particles for the bridge: massless points (sparks, embers) carried
+// by a grid's velocity. Positions are in world space and stored
+// structure-of-arrays, so the midpoint (RK2) step moves 8 tracers at a time
+// with AVX2 gathers.
+
+#include "UpfSimd.h"
+
+#include <stdint.h>
+#include <vector>
+
+// A grid's velocity planes (world units per second) and where they sit.
+struct UpfTracerField {
+    int sizeX, sizeY, sizeZ;
+    float invCellSize;
+    float cell0[3];         // world position of the center of cell (0, 0, 0)
+    const float* vx;
+    const float* vy;
+    const float* vz;
+};
+
+// Live tracers; age and life in seconds.
+struct UpfTracerPool {
+    std::vector<float> x, y, z;
+    std::vector<float> age, life;
+
+    size_t size() const { return x.size(); }
+    void resize(size_t n);
+};
+
+// Move count tracers one midpoint step of dt. Velocity is sampled
+// trilinearly, clamped to the outermost cell centers.
+typedef void (*UpfTracerStepFn)(const UpfTracerField& f, float* x, float* y, float* z, int32_t count, float dt);
+
+// Step kernel for a SIMD level; levels above what the CPU supports fall back.
+UpfTracerStepFn upfSelectTracerStep(UpfSimdLevel level);
+
+// Step every tracer of the pool by dt and age it, then drop those past their
+// life or outside the grid; the last live tracers fill the gaps, so the pool
+// is not kept in order. The survivors are also written to packed, 4 floats
+// each: x, y, z and age / life. Chunks of the pool run in parallel.
+void upfAdvanceTracers(UpfTracerPool& pool, const UpfTracerField& f, float dt, UpfSimdLevel level,
+                       std::vector<float>& packed);
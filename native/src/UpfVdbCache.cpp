@@ -0,0 +1,805 @@
+#include "UpfVdbCache.h"
+#include "UpfGridState.h"
+
+#define PNANOVDB_C
+#define PNANOVDB_BUF_BOUNDS_CHECK
+#include "nanovdb/PNanoVDB.h"
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <unordered_map>
+
+// NanoVDB leaves are 8^3 voxels, the solver's brick size
+static constexpr int kLeafDim = 8;
+// Frames queued for the recorder's writer before Append blocks
+static constexpr size_t kMaxQueuedFrames = 4;
+// Leaf flags: bounding box and statistics are valid
+static constexpr uint32_t kLeafFlags = (1u << 1) | (1u << 4);
+// Seconds a playback time may fall short of a frame's time and still show it
+static constexpr double kFrameTimeSlack = 1e-4;
+
+template <typename T>
+static void put(uint8_t* base, uint64_t offset, T value)
+{
+    std::memcpy(base + offset, &value, sizeof(T));
+}
+
+template <typename T>
+static T get(const uint8_t* base, uint64_t offset)
+{
+    T value;
+    std::memcpy(&value, base + offset, sizeof(T));
+    return value;
+}
+
+static void setMaskBit(uint8_t* base, uint64_t maskOffset, uint32_t bit)
+{
+    const uint64_t word = maskOffset + 4u * (bit >> 5);
+    put<uint32_t>(base, word, get<uint32_t>(base, word) | (1u << (bit & 31u)));
+}
+
+static void putCoord(uint8_t* base, uint64_t offset, const int32_t c[3])
+{
+    put<int32_t>(base, offset + 0, c[0]);
+    put<int32_t>(base, offset + 4, c[1]);
+    put<int32_t>(base, offset + 8, c[2]);
+}
+
+// --- Encoding ---
+
+namespace {
+
+// Nodes of a frame's trees, breadth first and sorted the way NanoVDB tables
+// are indexed. Both grids of a frame share them.
+struct VdbNode {
+    int32_t origin[3];
+    int32_t bboxMin[3], bboxMax[3];   // active voxels, inclusive
+    int32_t first, count;             // children in the next level's list
+};
+
+struct VdbTree {
+    std::vector<VdbNode> uppers, lowers, leaves;
+    int32_t bboxMin[3], bboxMax[3];
+    uint64_t voxelCount = 0;
+};
+
+struct VdbLayout {
+    uint64_t tree, root, tiles, uppers, lowers, leaves, size;
+};
+
+struct FrameFields {
+    int sizeX, sizeY, sizeZ;
+    float cellSize;
+};
+
+} // namespace
+
+static VdbLayout vdbLayout(uint32_t type, const VdbTree& t)
+{
+    const pnanovdb_grid_type_constants_t& k = pnanovdb_grid_type_constants[type];
+    VdbLayout l;
+    l.tree = PNANOVDB_GRID_SIZE;
+    l.root = l.tree + PNANOVDB_TREE_SIZE;
+    l.tiles = l.root + k.root_size;
+    l.uppers = l.tiles + t.uppers.size() * (uint64_t)k.root_tile_size;
+    l.lowers = l.uppers + t.uppers.size() * (uint64_t)k.upper_size;
+    l.leaves = l.lowers + t.lowers.size() * (uint64_t)k.lower_size;
+    l.size = l.leaves + t.leaves.size() * (uint64_t)k.leaf_size;
+    return l;
+}
+
+static void growBbox(int32_t mn[3], int32_t mx[3], const int32_t cmn[3], const int32_t cmx[3])
+{
+    for (int a = 0; a < 3; a++) {
+        mn[a] = std::min(mn[a], cmn[a]);
+        mx[a] = std::max(mx[a], cmx[a]);
+    }
+}
+
+// Group leaf origins into lower (128^3) and upper (4096^3) nodes.
+static void buildVdbTree(const FrameFields& f, std::vector<VdbNode>& leaves, VdbTree& t)
+{
+    auto nodeOrder = [](const VdbNode& a, const VdbNode& b) {
+        for (int shift : { 12, 7, 3 }) {
+            const int32_t ka[3] = { a.origin[0] >> shift, a.origin[1] >> shift, a.origin[2] >> shift };
+            const int32_t kb[3] = { b.origin[0] >> shift, b.origin[1] >> shift, b.origin[2] >> shift };
+            if (ka[0] != kb[0]) return ka[0] < kb[0];
+            if (ka[1] != kb[1]) return ka[1] < kb[1];
+            if (ka[2] != kb[2]) return ka[2] < kb[2];
+        }
+        return false;
+    };
+    std::sort(leaves.begin(), leaves.end(), nodeOrder);
+    t.leaves = std::move(leaves);
+
+    for (int a = 0; a < 3; a++) { t.bboxMin[a] = INT32_MAX; t.bboxMax[a] = INT32_MIN; }
+    t.voxelCount = 0;
+    for (VdbNode& leaf : t.leaves) {
+        const int size[3] = { f.sizeX, f.sizeY, f.sizeZ };
+        for (int a = 0; a < 3; a++) {
+            leaf.bboxMin[a] = leaf.origin[a];
+            leaf.bboxMax[a] = std::min(leaf.origin[a] + kLeafDim, size[a]) - 1;
+        }
+        t.voxelCount += (uint64_t)(leaf.bboxMax[0] - leaf.bboxMin[0] + 1) * (leaf.bboxMax[1] - leaf.bboxMin[1] + 1) *
+                        (leaf.bboxMax[2] - leaf.bboxMin[2] + 1);
+        growBbox(t.bboxMin, t.bboxMax, leaf.bboxMin, leaf.bboxMax);
+    }
+
+    auto group = [](const std::vector<VdbNode>& children, int mask, std::vector<VdbNode>& parents) {
+        parents.clear();
+        for (int32_t i = 0; i < (int32_t)children.size(); i++) {
+            const VdbNode& c = children[i];
+            const int32_t origin[3] = { c.origin[0] & ~mask, c.origin[1] & ~mask, c.origin[2] & ~mask };
+            if (parents.empty() || std::memcmp(parents.back().origin, origin, sizeof(origin)) != 0) {
+                VdbNode p = {};
+                std::memcpy(p.origin, origin, sizeof(origin));
+                std::memcpy(p.bboxMin, c.bboxMin, sizeof(p.bboxMin));
+                std::memcpy(p.bboxMax, c.bboxMax, sizeof(p.bboxMax));
+                p.first = i;
+                parents.push_back(p);
+            }
+            VdbNode& p = parents.back();
+            growBbox(p.bboxMin, p.bboxMax, c.bboxMin, c.bboxMax);
+            p.count++;
+        }
+    };
+    group(t.leaves, 127, t.lowers);
+    group(t.lowers, 4095, t.uppers);
+}
+
+// Write one grid of C components (1: Float, 3: Vec3f) at base.
+template <int C>
+static void writeVdbGrid(uint8_t* base, const VdbTree& t, const FrameFields& f, const float* const planes[C],
+                         uint32_t gridIndex, const char* name, uint32_t gridClass)
+{
+    const uint32_t type = C == 1 ? PNANOVDB_GRID_TYPE_FLOAT : PNANOVDB_GRID_TYPE_VEC3F;
+    const pnanovdb_grid_type_constants_t& k = pnanovdb_grid_type_constants[type];
+    const VdbLayout l = vdbLayout(type, t);
+    const int32_t numLeaves = (int32_t)t.leaves.size();
+
+    // Leaf values (NanoVDB orders voxels x major), per-leaf min/max
+    std::vector<float> leafMin((size_t)numLeaves * C), leafMax((size_t)numLeaves * C);
+    #pragma omp parallel for schedule(static) if(numLeaves > 64)
+    for (int32_t i = 0; i < numLeaves; i++) {
+        const VdbNode& n = t.leaves[i];
+        uint8_t* leaf = base + l.leaves + (uint64_t)i * k.leaf_size;
+        putCoord(leaf, PNANOVDB_LEAF_OFF_BBOX_MIN, n.bboxMin);
+        put<uint32_t>(leaf, PNANOVDB_LEAF_OFF_BBOX_DIF_AND_FLAGS,
+                      (uint32_t)(n.bboxMax[0] - n.bboxMin[0]) | (uint32_t)(n.bboxMax[1] - n.bboxMin[1]) << 8 |
+                      (uint32_t)(n.bboxMax[2] - n.bboxMin[2]) << 16 | kLeafFlags << 24);
+
+        float mn[C], mx[C];
+        for (int c = 0; c < C; c++) { mn[c] = INFINITY; mx[c] = -INFINITY; }
+        double sum = 0.0, sumSq = 0.0;
+        int active = 0;
+        for (int z = n.bboxMin[2]; z <= n.bboxMax[2]; z++) {
+            for (int y = n.bboxMin[1]; y <= n.bboxMax[1]; y++) {
+                const size_t row = (size_t)y * f.sizeX + (size_t)z * f.sizeX * f.sizeY;
+                for (int x = n.bboxMin[0]; x <= n.bboxMax[0]; x++) {
+                    const uint32_t v = (uint32_t)(x & 7) << 6 | (uint32_t)(y & 7) << 3 | (uint32_t)(z & 7);
+                    setMaskBit(leaf, PNANOVDB_LEAF_OFF_VALUE_MASK, v);
+                    float lengthSq = 0.0f;
+                    for (int c = 0; c < C; c++) {
+                        const float value = planes[c][row + x];
+                        put<float>(leaf, k.leaf_off_table + ((uint64_t)v * C + c) * 4u, value);
+                        mn[c] = std::min(mn[c], value);
+                        mx[c] = std::max(mx[c], value);
+                        lengthSq += value * value;
+                    }
+                    // Average and deviation of the value (Float) or its length (Vec3f)
+                    const double s = C == 1 ? planes[0][row + x] : std::sqrt(lengthSq);
+                    sum += s;
+                    sumSq += s * s;
+                    active++;
+                }
+            }
+        }
+        const double ave = sum / active;
+        for (int c = 0; c < C; c++) {
+            put<float>(leaf, k.leaf_off_min + 4u * c, mn[c]);
+            put<float>(leaf, k.leaf_off_max + 4u * c, mx[c]);
+            leafMin[(size_t)i * C + c] = mn[c];
+            leafMax[(size_t)i * C + c] = mx[c];
+        }
+        put<float>(leaf, k.leaf_off_ave, (float)ave);
+        put<float>(leaf, k.leaf_off_stddev, (float)std::sqrt(std::max(0.0, sumSq / active - ave * ave)));
+    }
+
+    // Inner nodes: child masks, child offsets and min/max of their children.
+    // levelMin/levelMax hold the stats of the level below the one being written.
+    std::vector<float>& levelMin = leafMin;
+    std::vector<float>& levelMax = leafMax;
+    auto writeInner = [&](const std::vector<VdbNode>& nodes, const std::vector<VdbNode>& children,
+                          uint64_t nodesOffset, uint32_t nodeSize, uint64_t childrenOffset, uint32_t childSize,
+                          uint32_t childMaskOff, uint32_t offMin, uint32_t offMax, uint32_t offTable,
+                          int log2Dim, int childLog2Dim) {
+        const int32_t mask = (1 << (log2Dim + childLog2Dim)) - 1;
+        std::vector<float> nodeMin(nodes.size() * C), nodeMax(nodes.size() * C);
+        for (size_t j = 0; j < nodes.size(); j++) {
+            const VdbNode& n = nodes[j];
+            const uint64_t nodeAddr = nodesOffset + j * nodeSize;
+            uint8_t* node = base + nodeAddr;
+            putCoord(node, 0, n.bboxMin);
+            putCoord(node, 12, n.bboxMax);
+            float mn[C], mx[C];
+            for (int c = 0; c < C; c++) { mn[c] = INFINITY; mx[c] = -INFINITY; }
+            for (int32_t i = n.first; i < n.first + n.count; i++) {
+                const int32_t* o = children[i].origin;
+                const uint32_t bit = (uint32_t)((o[0] & mask) >> childLog2Dim) << (2 * log2Dim) |
+                                     (uint32_t)((o[1] & mask) >> childLog2Dim) << log2Dim |
+                                     (uint32_t)((o[2] & mask) >> childLog2Dim);
+                setMaskBit(node, childMaskOff, bit);
+                put<int64_t>(node, offTable + (uint64_t)k.table_stride * bit,
+                             (int64_t)(childrenOffset + (uint64_t)i * childSize) - (int64_t)nodeAddr);
+                for (int c = 0; c < C; c++) {
+                    mn[c] = std::min(mn[c], levelMin[(size_t)i * C + c]);
+                    mx[c] = std::max(mx[c], levelMax[(size_t)i * C + c]);
+                }
+            }
+            for (int c = 0; c < C; c++) {
+                put<float>(node, offMin + 4u * c, mn[c]);
+                put<float>(node, offMax + 4u * c, mx[c]);
+                nodeMin[j * C + c] = mn[c];
+                nodeMax[j * C + c] = mx[c];
+            }
+        }
+        levelMin.swap(nodeMin);
+        levelMax.swap(nodeMax);
+    };
+    writeInner(t.lowers, t.leaves, l.lowers, k.lower_size, l.leaves, k.leaf_size, PNANOVDB_LOWER_OFF_CHILD_MASK,
+               k.lower_off_min, k.lower_off_max, k.lower_off_table, 4, 3);
+    writeInner(t.uppers, t.lowers, l.uppers, k.upper_size, l.lowers, k.lower_size, PNANOVDB_UPPER_OFF_CHILD_MASK,
+               k.upper_off_min, k.upper_off_max, k.upper_off_table, 5, 7);
+
+    // Root: one tile per upper node
+    uint8_t* root = base + l.root;
+    float rootMin[C] = {}, rootMax[C] = {};
+    if (!t.uppers.empty()) {
+        putCoord(root, PNANOVDB_ROOT_OFF_BBOX_MIN, t.bboxMin);
+        putCoord(root, PNANOVDB_ROOT_OFF_BBOX_MAX, t.bboxMax);
+        for (int c = 0; c < C; c++) { rootMin[c] = INFINITY; rootMax[c] = -INFINITY; }
+    }
+    put<uint32_t>(root, PNANOVDB_ROOT_OFF_TABLE_SIZE, (uint32_t)t.uppers.size());
+    for (size_t j = 0; j < t.uppers.size(); j++) {
+        uint8_t* tile = base + l.tiles + j * k.root_tile_size;
+        const pnanovdb_coord_t origin = { t.uppers[j].origin[0], t.uppers[j].origin[1], t.uppers[j].origin[2] };
+        put<uint64_t>(tile, PNANOVDB_ROOT_TILE_OFF_KEY, pnanovdb_coord_to_key(&origin));
+        put<int64_t>(tile, PNANOVDB_ROOT_TILE_OFF_CHILD, (int64_t)(l.uppers + j * k.upper_size - l.root));
+        for (int c = 0; c < C; c++) {
+            rootMin[c] = std::min(rootMin[c], levelMin[j * C + c]);
+            rootMax[c] = std::max(rootMax[c], levelMax[j * C + c]);
+        }
+    }
+    for (int c = 0; c < C; c++) {
+        put<float>(root, k.root_off_min + 4u * c, rootMin[c]);
+        put<float>(root, k.root_off_max + 4u * c, rootMax[c]);
+    }
+
+    uint8_t* tree = base + l.tree;
+    if (!t.leaves.empty()) {
+        put<uint64_t>(tree, PNANOVDB_TREE_OFF_NODE_OFFSET_LEAF, l.leaves - l.tree);
+        put<uint64_t>(tree, PNANOVDB_TREE_OFF_NODE_OFFSET_LOWER, l.lowers - l.tree);
+        put<uint64_t>(tree, PNANOVDB_TREE_OFF_NODE_OFFSET_UPPER, l.uppers - l.tree);
+    }
+    put<uint64_t>(tree, PNANOVDB_TREE_OFF_NODE_OFFSET_ROOT, l.root - l.tree);
+    put<uint32_t>(tree, PNANOVDB_TREE_OFF_NODE_COUNT_LEAF, (uint32_t)t.leaves.size());
+    put<uint32_t>(tree, PNANOVDB_TREE_OFF_NODE_COUNT_LOWER, (uint32_t)t.lowers.size());
+    put<uint32_t>(tree, PNANOVDB_TREE_OFF_NODE_COUNT_UPPER, (uint32_t)t.uppers.size());
+    put<uint64_t>(tree, PNANOVDB_TREE_OFF_VOXEL_COUNT, t.voxelCount);
+
+    // Grid: index-to-world map placing voxel i's center at (i + 0.5) * cellSize - half extent
+    const double cs = f.cellSize;
+    const double origin[3] = { 0.5 * cs - 0.5 * cs * f.sizeX, 0.5 * cs - 0.5 * cs * f.sizeY, 0.5 * cs - 0.5 * cs * f.sizeZ };
+    put<uint64_t>(base, PNANOVDB_GRID_OFF_MAGIC, PNANOVDB_MAGIC_NUMBER);
+    put<uint64_t>(base, PNANOVDB_GRID_OFF_CHECKSUM, ~0ull);
+    put<uint32_t>(base, PNANOVDB_GRID_OFF_VERSION, pnanovdb_make_version(PNANOVDB_MAJOR_VERSION_NUMBER,
+                  PNANOVDB_MINOR_VERSION_NUMBER, PNANOVDB_PATCH_VERSION_NUMBER));
+    put<uint32_t>(base, PNANOVDB_GRID_OFF_FLAGS, PNANOVDB_GRID_FLAGS_HAS_BBOX | PNANOVDB_GRID_FLAGS_HAS_MIN_MAX |
+                  PNANOVDB_GRID_FLAGS_IS_BREADTH_FIRST);
+    put<uint32_t>(base, PNANOVDB_GRID_OFF_GRID_INDEX, gridIndex);
+    put<uint32_t>(base, PNANOVDB_GRID_OFF_GRID_COUNT, 2u);
+    put<uint64_t>(base, PNANOVDB_GRID_OFF_GRID_SIZE, l.size);
+    std::memcpy(base + PNANOVDB_GRID_OFF_GRID_NAME, name, std::strlen(name));
+    const uint64_t map = PNANOVDB_GRID_OFF_MAP;
+    for (int a = 0; a < 3; a++) {
+        put<float>(base, map + PNANOVDB_MAP_OFF_MATF + 4u * (a * 4), (float)cs);
+        put<float>(base, map + PNANOVDB_MAP_OFF_INVMATF + 4u * (a * 4), (float)(1.0 / cs));
+        put<float>(base, map + PNANOVDB_MAP_OFF_VECF + 4u * a, (float)origin[a]);
+        put<double>(base, map + PNANOVDB_MAP_OFF_MATD + 8u * (a * 4), cs);
+        put<double>(base, map + PNANOVDB_MAP_OFF_INVMATD + 8u * (a * 4), 1.0 / cs);
+        put<double>(base, map + PNANOVDB_MAP_OFF_VECD + 8u * a, origin[a]);
+        put<double>(base, PNANOVDB_GRID_OFF_VOXEL_SIZE + 8u * a, cs);
+        if (!t.leaves.empty()) {
+            put<double>(base, PNANOVDB_GRID_OFF_WORLD_BBOX + 8u * a, (t.bboxMin[a] - 0.5) * cs + origin[a]);
+            put<double>(base, PNANOVDB_GRID_OFF_WORLD_BBOX + 8u * (a + 3), (t.bboxMax[a] + 0.5) * cs + origin[a]);
+        }
+    }
+    put<float>(base, map + PNANOVDB_MAP_OFF_TAPERF, 1.0f);
+    put<double>(base, map + PNANOVDB_MAP_OFF_TAPERD, 1.0);
+    put<uint32_t>(base, PNANOVDB_GRID_OFF_GRID_CLASS, gridClass);
+    put<uint32_t>(base, PNANOVDB_GRID_OFF_GRID_TYPE, type);
+}
+
+void upfVdbEncodeFrame(int sizeX, int sizeY, int sizeZ, float cellSize,
+                       const float* density, const float* vx, const float* vy, const float* vz,
+                       const uint8_t* brickVisited, std::vector<uint32_t>& frame)
+{
+    const FrameFields f = { sizeX, sizeY, sizeZ, cellSize };
+    const int bX = (sizeX + kLeafDim - 1) / kLeafDim;
+    const int bY = (sizeY + kLeafDim - 1) / kLeafDim;
+    const int bZ = (sizeZ + kLeafDim - 1) / kLeafDim;
+    const int32_t numBricks = bX * bY * bZ;
+
+    // Visited bricks holding anything become leaves
+    std::vector<uint8_t> keep(numBricks, 0);
+    #pragma omp parallel for schedule(dynamic, 16) if(numBricks > 64)
+    for (int32_t b = 0; b < numBricks; b++) {
+        if (!brickVisited[b]) continue;
+        const int x0 = (b % bX) * kLeafDim, y0 = (b / bX % bY) * kLeafDim, z0 = (b / (bX * bY)) * kLeafDim;
+        const int x1 = std::min(x0 + kLeafDim, sizeX), y1 = std::min(y0 + kLeafDim, sizeY), z1 = std::min(z0 + kLeafDim, sizeZ);
+        bool any = false;
+        for (int z = z0; z < z1 && !any; z++) {
+            for (int y = y0; y < y1 && !any; y++) {
+                const size_t row = (size_t)y * sizeX + (size_t)z * sizeX * sizeY;
+                for (int x = x0; x < x1; x++) {
+                    if (density[row + x] != 0.0f || vx[row + x] != 0.0f || vy[row + x] != 0.0f || vz[row + x] != 0.0f) {
+                        any = true;
+                        break;
+                    }
+                }
+            }
+        }
+        keep[b] = any ? 1 : 0;
+    }
+    std::vector<VdbNode> leaves;
+    for (int32_t b = 0; b < numBricks; b++) {
+        if (!keep[b]) continue;
+        VdbNode n = {};
+        n.origin[0] = (b % bX) * kLeafDim;
+        n.origin[1] = (b / bX % bY) * kLeafDim;
+        n.origin[2] = (b / (bX * bY)) * kLeafDim;
+        leaves.push_back(n);
+    }
+    VdbTree t;
+    buildVdbTree(f, leaves, t);
+
+    const VdbLayout densityLayout = vdbLayout(PNANOVDB_GRID_TYPE_FLOAT, t);
+    const VdbLayout velocityLayout = vdbLayout(PNANOVDB_GRID_TYPE_VEC3F, t);
+    frame.assign((size_t)((densityLayout.size + velocityLayout.size) / 4u), 0u);
+    uint8_t* base = (uint8_t*)frame.data();
+    const float* const densityPlanes[1] = { density };
+    const float* const velocityPlanes[3] = { vx, vy, vz };
+    writeVdbGrid<1>(base, t, f, densityPlanes, 0, "density", PNANOVDB_GRID_CLASS_FOG_VOLUME);
+    writeVdbGrid<3>(base + densityLayout.size, t, f, velocityPlanes, 1, "velocity", PNANOVDB_GRID_CLASS_UNKNOWN);
+}
+
+// --- Decoding ---
+
+bool upfVdbDecodeFrame(const std::vector<uint32_t>& frame, int sizeX, int sizeY, int sizeZ,
+                       float* density, float* vx, float* vy, float* vz, uint8_t* brickWritten)
+{
+    const uint8_t* base = (const uint8_t*)frame.data();
+    const uint64_t size = frame.size() * 4u;
+    const int bX = (sizeX + kLeafDim - 1) / kLeafDim;
+    const int bY = (sizeY + kLeafDim - 1) / kLeafDim;
+
+    // Validate both grids first: same leaves, all inside the grid
+    const uint8_t* grids[2];
+    uint32_t leafCount = 0;
+    uint64_t offset = 0;
+    for (int g = 0; g < 2; g++) {
+        if (size - offset < PNANOVDB_GRID_SIZE + PNANOVDB_TREE_SIZE) return false;
+        const uint8_t* grid = base + offset;
+        const uint32_t type = g == 0 ? PNANOVDB_GRID_TYPE_FLOAT : PNANOVDB_GRID_TYPE_VEC3F;
+        const uint64_t gridSize = get<uint64_t>(grid, PNANOVDB_GRID_OFF_GRID_SIZE);
+        if (get<uint64_t>(grid, PNANOVDB_GRID_OFF_MAGIC) != PNANOVDB_MAGIC_NUMBER ||
+            get<uint32_t>(grid, PNANOVDB_GRID_OFF_GRID_TYPE) != type || gridSize > size - offset) {
+            return false;
+        }
+        const uint8_t* tree = grid + PNANOVDB_GRID_SIZE;
+        const uint32_t count = get<uint32_t>(tree, PNANOVDB_TREE_OFF_NODE_COUNT_LEAF);
+        const uint64_t leavesOffset = PNANOVDB_GRID_SIZE + get<uint64_t>(tree, PNANOVDB_TREE_OFF_NODE_OFFSET_LEAF);
+        const uint64_t leafSize = pnanovdb_grid_type_constants[type].leaf_size;
+        if (count > 0 && (leavesOffset > gridSize || count > (gridSize - leavesOffset) / leafSize)) return false;
+        if (g == 1 && count != leafCount) return false;
+        leafCount = count;
+        grids[g] = grid + leavesOffset;
+        offset += gridSize;
+    }
+    for (uint32_t i = 0; i < leafCount; i++) {
+        const uint8_t* d = grids[0] + (uint64_t)i * pnanovdb_grid_type_constants[PNANOVDB_GRID_TYPE_FLOAT].leaf_size;
+        const uint8_t* v = grids[1] + (uint64_t)i * pnanovdb_grid_type_constants[PNANOVDB_GRID_TYPE_VEC3F].leaf_size;
+        if (std::memcmp(d + PNANOVDB_LEAF_OFF_BBOX_MIN, v + PNANOVDB_LEAF_OFF_BBOX_MIN, 12) != 0) return false;
+        const int32_t x0 = get<int32_t>(d, 0), y0 = get<int32_t>(d, 4), z0 = get<int32_t>(d, 8);
+        if (x0 < 0 || y0 < 0 || z0 < 0 || x0 >= sizeX || y0 >= sizeY || z0 >= sizeZ ||
+            (x0 | y0 | z0) % kLeafDim != 0) {
+            return false;
+        }
+    }
+
+    const pnanovdb_grid_type_constants_t& kd = pnanovdb_grid_type_constants[PNANOVDB_GRID_TYPE_FLOAT];
+    const pnanovdb_grid_type_constants_t& kv = pnanovdb_grid_type_constants[PNANOVDB_GRID_TYPE_VEC3F];
+    const int32_t numLeaves = (int32_t)leafCount;
+    #pragma omp parallel for schedule(static) if(numLeaves > 64)
+    for (int32_t i = 0; i < numLeaves; i++) {
+        const uint8_t* d = grids[0] + (uint64_t)i * kd.leaf_size;
+        const uint8_t* v = grids[1] + (uint64_t)i * kv.leaf_size;
+        const int x0 = get<int32_t>(d, 0), y0 = get<int32_t>(d, 4), z0 = get<int32_t>(d, 8);
+        const int x1 = std::min(x0 + kLeafDim, sizeX), y1 = std::min(y0 + kLeafDim, sizeY), z1 = std::min(z0 + kLeafDim, sizeZ);
+        for (int z = z0; z < z1; z++) {
+            for (int y = y0; y < y1; y++) {
+                const size_t row = (size_t)y * sizeX + (size_t)z * sizeX * sizeY;
+                for (int x = x0; x < x1; x++) {
+                    const uint32_t n = (uint32_t)(x & 7) << 6 | (uint32_t)(y & 7) << 3 | (uint32_t)(z & 7);
+                    density[row + x] = get<float>(d, kd.leaf_off_table + 4u * n);
+                    vx[row + x] = get<float>(v, kv.leaf_off_table + 12u * n + 0);
+                    vy[row + x] = get<float>(v, kv.leaf_off_table + 12u * n + 4);
+                    vz[row + x] = get<float>(v, kv.leaf_off_table + 12u * n + 8);
+                }
+            }
+        }
+        brickWritten[x0 / kLeafDim + (y0 / kLeafDim) * bX + (z0 / kLeafDim) * bX * bY] = 1;
+    }
+    return true;
+}
+
+// --- Zero-run compression ---
+// A stream of runs: zero word count, literal word count, the literal words.
+
+static void packZeroRuns(const std::vector<uint32_t>& src, std::vector<uint32_t>& dst)
+{
+    dst.clear();
+    const size_t n = src.size();
+    size_t i = 0;
+    while (i < n) {
+        const size_t zerosStart = i;
+        while (i < n && src[i] == 0) i++;
+        const size_t literalStart = i;
+        // Literals run until at least 4 zeros in a row (or the end)
+        while (i < n) {
+            if (src[i] != 0) { i++; continue; }
+            size_t z = i;
+            while (z < n && src[z] == 0 && z - i < 4) z++;
+            if (z - i >= 4 || z == n) break;
+            i = z;
+        }
+        dst.push_back((uint32_t)(literalStart - zerosStart));
+        dst.push_back((uint32_t)(i - literalStart));
+        dst.insert(dst.end(), src.begin() + literalStart, src.begin() + i);
+    }
+}
+
+static bool unpackZeroRuns(const std::vector<uint32_t>& src, std::vector<uint32_t>& dst)
+{
+    size_t out = 0, i = 0;
+    while (i + 2 <= src.size()) {
+        const size_t zeros = src[i], literals = src[i + 1];
+        i += 2;
+        if (zeros > dst.size() - out || literals > dst.size() - out - zeros || literals > src.size() - i) return false;
+        std::fill(dst.begin() + out, dst.begin() + out + zeros, 0u);
+        out += zeros;
+        std::copy(src.begin() + i, src.begin() + i + literals, dst.begin() + out);
+        out += literals;
+        i += literals;
+    }
+    return out == dst.size() && i == src.size();
+}
+
+static bool seekFile(FILE* file, uint64_t offset)
+{
+#ifdef _WIN32
+    return _fseeki64(file, (long long)offset, SEEK_SET) == 0;
+#else
+    return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+// --- Recorder ---
+
+struct UpfVdbRecorder {
+    FILE* file = nullptr;
+    UpfVdbCacheHeader header = {};
+    std::vector<UpfVdbIndexEntry> index;
+    uint64_t end = 0;
+    bool failed = false;
+
+    std::thread thread;
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<std::pair<float, std::vector<uint32_t>>> queue;
+    bool stop = false;
+};
+
+static void writeRecorderFrame(UpfVdbRecorder* r, float time, const std::vector<uint32_t>& words, std::vector<uint32_t>& packed)
+{
+    packZeroRuns(words, packed);
+    UpfVdbChunkHeader chunk = {};
+    chunk.magic = kUpfVdbChunkMagic;
+    chunk.frame = (int32_t)r->index.size();
+    chunk.time = time;
+    chunk.rawWords = (uint32_t)words.size();
+    chunk.storedBytes = packed.size() * 4u;
+    const bool ok = std::fwrite(&chunk, sizeof(chunk), 1, r->file) == 1 &&
+                    std::fwrite(packed.data(), 4, packed.size(), r->file) == packed.size();
+    if (!ok) {
+        r->failed = true;
+        return;
+    }
+    r->index.push_back({ r->end, time, 0u });
+    r->end += sizeof(chunk) + chunk.storedBytes;
+}
+
+static void recorderMain(UpfVdbRecorder* r)
+{
+    std::vector<uint32_t> packed;
+    std::unique_lock<std::mutex> lock(r->mtx);
+    for (;;) {
+        r->cv.wait(lock, [r] { return r->stop || !r->queue.empty(); });
+        if (r->queue.empty()) return;
+        // The frame stays queued while it is written, so Append counts it
+        const float time = r->queue.front().first;
+        const std::vector<uint32_t>& words = r->queue.front().second;
+        lock.unlock();
+        if (!r->failed) writeRecorderFrame(r, time, words, packed);
+        lock.lock();
+        r->queue.pop_front();
+        r->cv.notify_all();
+    }
+}
+
+UpfVdbRecorder* upfVdbRecorderOpen(const char* path, int sizeX, int sizeY, int sizeZ, float cellSize)
+{
+    FILE* file = upfOpenFile(path, "wb");
+    if (!file) return nullptr;
+
+    UpfVdbRecorder* r = new UpfVdbRecorder();
+    r->file = file;
+    std::memcpy(r->header.magic, kUpfVdbCacheMagic, sizeof(r->header.magic));
+    r->header.version = kUpfVdbCacheVersion;
+    r->header.headerBytes = sizeof(UpfVdbCacheHeader);
+    r->header.sizeX = sizeX; r->header.sizeY = sizeY; r->header.sizeZ = sizeZ;
+    r->header.cellSize = cellSize;
+    r->failed = std::fwrite(&r->header, sizeof(r->header), 1, file) != 1;
+    r->end = sizeof(r->header);
+    r->thread = std::thread(recorderMain, r);
+    return r;
+}
+
+void upfVdbRecorderAppend(UpfVdbRecorder* r, float time, std::vector<uint32_t>&& frame)
+{
+    std::unique_lock<std::mutex> lock(r->mtx);
+    r->cv.wait(lock, [r] { return r->queue.size() < kMaxQueuedFrames; });
+    r->queue.emplace_back(time, std::move(frame));
+    r->cv.notify_all();
+}
+
+int32_t upfVdbRecorderClose(UpfVdbRecorder* r)
+{
+    if (!r) return -1;
+    {
+        std::lock_guard<std::mutex> lock(r->mtx);
+        r->stop = true;
+    }
+    r->cv.notify_all();
+    r->thread.join();
+
+    r->header.frameCount = (int32_t)r->index.size();
+    r->header.indexOffset = r->end;
+    bool ok = !r->failed &&
+              std::fwrite(r->index.data(), sizeof(UpfVdbIndexEntry), r->index.size(), r->file) == r->index.size() &&
+              seekFile(r->file, 0) && std::fwrite(&r->header, sizeof(r->header), 1, r->file) == 1;
+    ok = std::fclose(r->file) == 0 && ok;
+    const int32_t frames = r->header.frameCount;
+    delete r;
+    return ok ? frames : -2;
+}
+
+// --- Player ---
+
+struct UpfVdbPlayer {
+    FILE* file = nullptr;
+    UpfVdbCacheHeader header = {};
+    double maxFrameWords = 0.0;
+    std::vector<UpfVdbIndexEntry> index;
+    int32_t readAhead = 0;
+    bool loop = false;
+    double duration = 0.0;
+
+    std::thread thread;
+    std::mutex mtx;
+    std::condition_variable cv;
+    int32_t want = 0;
+    bool stop = false;
+    std::unordered_map<int32_t, std::shared_ptr<const std::vector<uint32_t>>> frames;
+};
+
+// Frame i places after the wanted one, or -1 past the end.
+static int32_t windowFrame(const UpfVdbPlayer* p, int32_t i)
+{
+    const int32_t count = (int32_t)p->index.size();
+    int32_t f = p->want + i;
+    if (f >= count) {
+        if (!p->loop) return -1;
+        f %= count;
+    }
+    return f;
+}
+
+// Words in a frame of this grid size with every brick a leaf in its own lower
+// and upper node. In double, since corrupt sizes would overflow integers.
+static double maxFrameWords(const UpfVdbCacheHeader& h)
+{
+    auto nodes = [&h](double dim) {
+        return std::ceil(h.sizeX / dim) * std::ceil(h.sizeY / dim) * std::ceil(h.sizeZ / dim);
+    };
+    const double leaves = nodes(kLeafDim);
+    double bytes = 0.0;
+    for (uint32_t type : { PNANOVDB_GRID_TYPE_FLOAT, PNANOVDB_GRID_TYPE_VEC3F }) {
+        const pnanovdb_grid_type_constants_t& k = pnanovdb_grid_type_constants[type];
+        bytes += PNANOVDB_GRID_SIZE + PNANOVDB_TREE_SIZE + k.root_size +
+                 leaves * ((double)k.root_tile_size + k.upper_size + k.lower_size + k.leaf_size);
+    }
+    return bytes / 4.0;
+}
+
+static std::shared_ptr<const std::vector<uint32_t>> readPlayerFrame(UpfVdbPlayer* p, int32_t frame)
+{
+    UpfVdbChunkHeader chunk;
+    if (!seekFile(p->file, p->index[frame].offset) || std::fread(&chunk, sizeof(chunk), 1, p->file) != 1) return nullptr;
+    if (chunk.magic != kUpfVdbChunkMagic || chunk.storedBytes % 4u != 0 || chunk.rawWords > p->maxFrameWords ||
+        chunk.storedBytes / 4u > 2u * (uint64_t)chunk.rawWords + 2u) {
+        return nullptr;
+    }
+    std::vector<uint32_t> packed((size_t)(chunk.storedBytes / 4u));
+    if (std::fread(packed.data(), 4, packed.size(), p->file) != packed.size()) return nullptr;
+    std::shared_ptr<std::vector<uint32_t>> words = std::make_shared<std::vector<uint32_t>>(chunk.rawWords);
+    if (!unpackZeroRuns(packed, *words)) return nullptr;
+    return words;
+}
+
+static void playerMain(UpfVdbPlayer* p)
+{
+    std::unique_lock<std::mutex> lock(p->mtx);
+    while (!p->stop) {
+        // Drop frames outside the window, then load its first missing frame
+        for (auto it = p->frames.begin(); it != p->frames.end();) {
+            bool keep = false;
+            for (int32_t i = 0; i <= p->readAhead && !keep; i++) keep = windowFrame(p, i) == it->first;
+            it = keep ? std::next(it) : p->frames.erase(it);
+        }
+        int32_t next = -1;
+        for (int32_t i = 0; i <= p->readAhead; i++) {
+            const int32_t f = windowFrame(p, i);
+            if (f < 0) break;
+            if (!p->frames.count(f)) { next = f; break; }
+        }
+        if (next < 0) {
+            p->cv.wait(lock);
+            continue;
+        }
+        lock.unlock();
+        // A frame that can't be allocated reads as missing, like a corrupt one
+        std::shared_ptr<const std::vector<uint32_t>> words;
+        try {
+            words = readPlayerFrame(p, next);
+        } catch (const std::bad_alloc&) {
+            words = nullptr;
+        }
+        lock.lock();
+        p->frames[next] = std::move(words);
+        p->cv.notify_all();
+    }
+}
+
+// Rebuild the index of a file whose recording never stopped.
+static void scanChunks(UpfVdbPlayer* p)
+{
+    uint64_t offset = p->header.headerBytes;
+    UpfVdbChunkHeader chunk;
+    while (seekFile(p->file, offset) && std::fread(&chunk, sizeof(chunk), 1, p->file) == 1 &&
+           chunk.magic == kUpfVdbChunkMagic && chunk.frame == (int32_t)p->index.size()) {
+        // Stop at a chunk cut short by the end of the file
+        if (chunk.storedBytes == 0 || !seekFile(p->file, offset + sizeof(chunk) + chunk.storedBytes - 1) ||
+            std::fgetc(p->file) == EOF) {
+            break;
+        }
+        p->index.push_back({ offset, chunk.time, 0u });
+        offset += sizeof(chunk) + chunk.storedBytes;
+    }
+}
+
+UpfVdbPlayer* upfVdbPlayerOpen(const char* path, int32_t readAhead, bool loop)
+{
+    FILE* file = upfOpenFile(path, "rb");
+    if (!file) return nullptr;
+
+    UpfVdbPlayer* p = new UpfVdbPlayer();
+    p->file = file;
+    p->readAhead = std::max(0, std::min(readAhead, 64));
+    p->loop = loop;
+    UpfVdbCacheHeader& h = p->header;
+    const bool valid = std::fread(&h, sizeof(h), 1, file) == 1 &&
+                       std::memcmp(h.magic, kUpfVdbCacheMagic, sizeof(h.magic)) == 0 &&
+                       h.version == kUpfVdbCacheVersion && h.headerBytes == sizeof(UpfVdbCacheHeader) &&
+                       h.sizeX > 0 && h.sizeY > 0 && h.sizeZ > 0 && h.cellSize > 0.0f;
+    if (valid && h.indexOffset != 0 && h.frameCount > 0) {
+        p->index.resize((size_t)h.frameCount);
+        if (!seekFile(file, h.indexOffset) ||
+            std::fread(p->index.data(), sizeof(UpfVdbIndexEntry), p->index.size(), file) != p->index.size()) {
+            p->index.clear();
+        }
+    } else if (valid) {
+        scanChunks(p);
+    }
+    if (!valid || p->index.empty()) {
+        std::fclose(file);
+        delete p;
+        return nullptr;
+    }
+
+    p->maxFrameWords = maxFrameWords(h);
+    const size_t count = p->index.size();
+    const double span = p->index[count - 1].time - p->index[0].time;
+    p->duration = count > 1 ? span + span / (count - 1) : std::max(0.0f, p->index[0].time);
+    p->thread = std::thread(playerMain, p);
+    return p;
+}
+
+void upfVdbPlayerClose(UpfVdbPlayer* p)
+{
+    if (!p) return;
+    {
+        std::lock_guard<std::mutex> lock(p->mtx);
+        p->stop = true;
+    }
+    p->cv.notify_all();
+    p->thread.join();
+    std::fclose(p->file);
+    delete p;
+}
+
+UpfVdbPlayerInfo upfVdbPlayerInfo(const UpfVdbPlayer* p)
+{
+    UpfVdbPlayerInfo info;
+    info.sizeX = p->header.sizeX;
+    info.sizeY = p->header.sizeY;
+    info.sizeZ = p->header.sizeZ;
+    info.cellSize = p->header.cellSize;
+    info.frameCount = (int32_t)p->index.size();
+    info.duration = (float)p->duration;
+    return info;
+}
+
+int32_t upfVdbPlayerFrameAt(const UpfVdbPlayer* p, double time)
+{
+    if (p->loop && p->duration > 0.0) {
+        time = std::fmod(time, p->duration);
+        if (time < 0.0) time += p->duration;
+    }
+    // Last frame recorded at or before the time (frame 0 shows from time 0).
+    // Recorded times are floats, so steps of the recorded dt may land just short.
+    const double t0 = p->index[0].time;
+    time += kFrameTimeSlack;
+    auto it = std::upper_bound(p->index.begin(), p->index.end(), time,
+                               [t0](double t, const UpfVdbIndexEntry& e) { return t < e.time - t0; });
+    return std::max<int32_t>(0, (int32_t)(it - p->index.begin()) - 1);
+}
+
+std::shared_ptr<const std::vector<uint32_t>> upfVdbPlayerFetch(UpfVdbPlayer* p, int32_t frame)
+{
+    if (frame < 0 || frame >= (int32_t)p->index.size()) return nullptr;
+    std::unique_lock<std::mutex> lock(p->mtx);
+    if (p->want != frame) {
+        p->want = frame;
+        p->cv.notify_all();
+    }
+    p->cv.wait(lock, [p, frame] { return p->frames.count(frame) != 0; });
+    return p->frames[frame];
+}
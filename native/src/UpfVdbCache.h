@@ -0,0 +1,97 @@
+#pragma once
+
+// Grid sequences recorded as NanoVDB frames (Upf_StartGridRecording) and
+// played back without simulating (Upf_CreatePlaybackGrid). A frame is a
+// NanoVDB buffer holding a Float "density" grid and a Vec3f "velocity" grid
+// with one leaf per non-empty 8^3 brick. Cache files are chunked:
+//
+//   UpfVdbCacheHeader | chunk 0 | chunk 1 | ... | UpfVdbIndexEntry per frame
+//
+// Each chunk is a UpfVdbChunkHeader and the frame's buffer, zero-run
+// compressed (NanoVDB's upper and lower node tables are mostly empty). The
+// index is written when recording stops; a file without one is recovered by
+// walking the chunk headers.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+static constexpr char kUpfVdbCacheMagic[8] = { 'U', 'P', 'F', 'V', 'D', 'B', 'C', '\0' };
+static constexpr uint32_t kUpfVdbCacheVersion = 1;
+static constexpr uint32_t kUpfVdbChunkMagic = 0x46465055u; // "UPFF"
+
+struct UpfVdbCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerBytes;       // sizeof(UpfVdbCacheHeader) when written
+    int32_t sizeX, sizeY, sizeZ;
+    float cellSize;
+    int32_t frameCount;         // 0 until recording stops
+    uint32_t reserved;
+    uint64_t indexOffset;       // 0 until recording stops
+};
+
+struct UpfVdbChunkHeader {
+    uint32_t magic;
+    int32_t frame;
+    float time;                 // simulated seconds since recording started
+    uint32_t rawWords;          // size of the NanoVDB buffer in 32-bit words
+    uint64_t storedBytes;       // compressed bytes following this header
+};
+
+struct UpfVdbIndexEntry {
+    uint64_t offset;            // of the chunk header
+    float time;
+    uint32_t reserved;
+};
+
+// Encode fields of a grid centered on the origin into a frame. Only bricks
+// flagged in brickVisited (8^3 cells, the NanoVDB leaf size) may be non-zero;
+// those that are all zero are skipped too.
+void upfVdbEncodeFrame(int sizeX, int sizeY, int sizeZ, float cellSize,
+                       const float* density, const float* vx, const float* vy, const float* vz,
+                       const uint8_t* brickVisited, std::vector<uint32_t>& frame);
+
+// Write a frame's leaves into the planes and flag the bricks they cover in
+// brickWritten; other cells are left alone. Returns false if the buffer is
+// not a frame of this grid size.
+bool upfVdbDecodeFrame(const std::vector<uint32_t>& frame, int sizeX, int sizeY, int sizeZ,
+                       float* density, float* vx, float* vy, float* vz, uint8_t* brickWritten);
+
+// Appends frames to a cache file. Compression and writes run on the
+// recorder's own thread.
+struct UpfVdbRecorder;
+
+UpfVdbRecorder* upfVdbRecorderOpen(const char* path, int sizeX, int sizeY, int sizeZ, float cellSize);
+
+// Queue a frame; blocks while the writer is several frames behind.
+void upfVdbRecorderAppend(UpfVdbRecorder* recorder, float time, std::vector<uint32_t>&& frame);
+
+// Flush, write the index and close. Returns the number of frames written,
+// or -2 if a write failed.
+int32_t upfVdbRecorderClose(UpfVdbRecorder* recorder);
+
+// Streams frames of a cache file, reading (and decompressing) the frames
+// after the last one fetched on a background thread.
+struct UpfVdbPlayer;
+
+struct UpfVdbPlayerInfo {
+    int sizeX, sizeY, sizeZ;
+    float cellSize;
+    int32_t frameCount;
+    float duration;             // time of the last frame plus one frame interval
+};
+
+// Returns null if the file is missing, not a cache or holds no frames.
+UpfVdbPlayer* upfVdbPlayerOpen(const char* path, int32_t readAhead, bool loop);
+void upfVdbPlayerClose(UpfVdbPlayer* player);
+
+UpfVdbPlayerInfo upfVdbPlayerInfo(const UpfVdbPlayer* player);
+
+// Frame showing at a playback time (wrapped when looping, else clamped).
+int32_t upfVdbPlayerFrameAt(const UpfVdbPlayer* player, double time);
+
+// The frame's NanoVDB buffer, waiting for the reader if it is not loaded
+// yet; null if it could not be read. Moves the read-ahead window to it.
+std::shared_ptr<const std::vector<uint32_t>> upfVdbPlayerFetch(UpfVdbPlayer* player, int32_t frame);